@@ -0,0 +1,129 @@
+
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include "../interpreter/interpreter.h"
+#include "../interpreter/error.h"
+
+#include "module_writer.h"
+
+/*
+* Bulk memory benchmark
+* Times the memory.fill and memory.copy instructions against the equivalent
+* byte loops written in WebAssembly. Run with the optional arguments
+* <byte count> <repetitions>.
+*/
+
+using WASM::u8, WASM::u32, WASM::i32;
+using Clock = std::chrono::steady_clock;
+
+// Copies go from the start of the memory into its second half
+constexpr u32 memoryPages = 64;
+constexpr u32 copyDestination = memoryPages * 65536 / 2;
+
+static ModuleWriter generateModule() {
+	constexpr u8 I32 = 0x7F;
+
+	ModuleWriter writer;
+	auto typeIdx = writer.addType({ { I32 }, {} });
+	writer.setMemory(memoryPages);
+
+	// memory.fill(0, 0x5A, n)
+	ModuleWriter::Bytes fillBuiltin;
+	fillBuiltin.byte(0x41).i32Leb(0).byte(0x41).i32Leb(0x5A).byte(0x20).u32Leb(0).bytes({ 0xFC, 0x0B, 0x00 });
+	writer.exportFunction("fillBuiltin", writer.addFunction(typeIdx, {}, fillBuiltin));
+
+	// memory.copy(copyDestination, 0, n)
+	ModuleWriter::Bytes copyBuiltin;
+	copyBuiltin.byte(0x41).i32Leb(copyDestination).byte(0x41).i32Leb(0).byte(0x20).u32Leb(0).bytes({ 0xFC, 0x0A, 0x00, 0x00 });
+	writer.exportFunction("copyBuiltin", writer.addFunction(typeIdx, {}, copyBuiltin));
+
+	// Emits "block loop (br_if 1 (i >= n)) <body> i++ br 0 end end" with i in local 1
+	auto byteLoop = [](const ModuleWriter::Bytes& body) {
+		ModuleWriter::Bytes loop;
+		loop.bytes({ 0x02, 0x40, 0x03, 0x40 });
+		loop.byte(0x20).u32Leb(1).byte(0x20).u32Leb(0).byte(0x4F).byte(0x0D).u32Leb(1);
+		loop.append(body);
+		loop.byte(0x20).u32Leb(1).byte(0x41).i32Leb(1).byte(0x6A).byte(0x21).u32Leb(1);
+		loop.byte(0x0C).u32Leb(0).bytes({ 0x0B, 0x0B });
+		return loop;
+	};
+
+	// store8(i, 0x5A)
+	ModuleWriter::Bytes fillBody;
+	fillBody.byte(0x20).u32Leb(1).byte(0x41).i32Leb(0x5A).byte(0x3A).u32Leb(0).u32Leb(0);
+	writer.exportFunction("fillLoop", writer.addFunction(typeIdx, { { 1, I32 } }, byteLoop(fillBody)));
+
+	// store8(i + copyDestination, load8_u(i))
+	ModuleWriter::Bytes copyBody;
+	copyBody.byte(0x20).u32Leb(1).byte(0x41).i32Leb(copyDestination).byte(0x6A);
+	copyBody.byte(0x20).u32Leb(1).byte(0x2D).u32Leb(0).u32Leb(0).byte(0x3A).u32Leb(0).u32Leb(0);
+	writer.exportFunction("copyLoop", writer.addFunction(typeIdx, { { 1, I32 } }, byteLoop(copyBody)));
+
+	// if (load8_u(i) != 0x5A || load8_u(i + copyDestination) != 0x5A) unreachable
+	ModuleWriter::Bytes verifyBody;
+	verifyBody.byte(0x20).u32Leb(1).byte(0x2D).u32Leb(0).u32Leb(0).byte(0x41).i32Leb(0x5A).byte(0x47);
+	verifyBody.byte(0x20).u32Leb(1).byte(0x2D).u32Leb(0).u32Leb(copyDestination).byte(0x41).i32Leb(0x5A).byte(0x47);
+	verifyBody.byte(0x72).bytes({ 0x04, 0x40, 0x00, 0x0B });
+	writer.exportFunction("verify", writer.addFunction(typeIdx, { { 1, I32 } }, byteLoop(verifyBody)));
+
+	return writer;
+}
+
+int main(int argc, char** argv) {
+	u32 byteCount = argc > 1 ? std::stoul(argv[1]) : 1024 * 1024;
+	u32 repetitions = argc > 2 ? std::stoul(argv[2]) : 10;
+
+	if (byteCount > copyDestination) {
+		std::cerr << "Byte count may be at most " << copyDestination << std::endl;
+		return 1;
+	}
+
+	try {
+		auto path = generateModule().writeTemporary("bulkmemorybench");
+
+		WASM::Interpreter interpreter;
+		interpreter.loadModule(path);
+		interpreter.compileAndLinkModules();
+
+		auto function = [&](const char* name) { return interpreter.functionByName("bulkmemorybench", name); };
+		auto verify = function("verify");
+
+		auto timeFunction = [&](const WASM::FunctionHandle& handle) {
+			double best = std::numeric_limits<double>::max();
+			for (u32 i = 0; i != repetitions; i++) {
+				auto start = Clock::now();
+				interpreter.runFunction(handle, (i32)byteCount);
+				best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+			return best;
+		};
+
+		auto report = [&](const char* name, double ms) {
+			std::cout << "  " << name << ms << " ms (" << (double)byteCount / (ms * 1000.0) << " MB/s)\n";
+		};
+
+		std::cout << "Bulk memory: " << byteCount << " bytes, best of " << repetitions << "\n";
+
+		auto fillLoopTime = timeFunction(function("fillLoop"));
+		auto copyLoopTime = timeFunction(function("copyLoop"));
+		interpreter.runFunction(verify, (i32)byteCount);
+		report("fill loop:    ", fillLoopTime);
+		report("copy loop:    ", copyLoopTime);
+
+		auto fillBuiltinTime = timeFunction(function("fillBuiltin"));
+		auto copyBuiltinTime = timeFunction(function("copyBuiltin"));
+		interpreter.runFunction(verify, (i32)byteCount);
+		report("memory.fill:  ", fillBuiltinTime);
+		report("memory.copy:  ", copyBuiltinTime);
+	}
+	catch (WASM::Error& e) {
+		std::cerr << "Caught wasm error: " << e << std::endl;
+		return 1;
+	}
+	catch (std::exception& e) {
+		std::cerr << "Caught generic error: " << e.what() << std::endl;
+		return 1;
+	}
+}
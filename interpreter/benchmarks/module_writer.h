@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <optional>
+#include <initializer_list>
+
+#include "../interpreter/util.h"
+
+/*
+* Module Writer
+* Minimal encoder for WebAssembly binaries so the benchmarks can generate
+* their own input modules instead of depending on an external toolchain.
+* Only the handful of sections the benchmarks need are supported.
+*/
+class ModuleWriter {
+public:
+	using u8 = WASM::u8;
+	using u32 = WASM::u32;
+	using i32 = WASM::i32;
+	using i64 = WASM::i64;
+
+	class Bytes {
+	public:
+		Bytes& byte(u8 b) { data.push_back(b); return *this; }
+		Bytes& bytes(std::initializer_list<u8> bs) { data.insert(data.end(), bs); return *this; }
+		Bytes& append(const Bytes& other) { data.insert(data.end(), other.data.begin(), other.data.end()); return *this; }
+
+		Bytes& u32Leb(u32 value) {
+			do {
+				u8 b = value & 0x7F;
+				value >>= 7;
+				data.push_back(value ? (b | 0x80) : b);
+			} while (value);
+			return *this;
+		}
+
+		Bytes& i64Leb(i64 value) {
+			while (true) {
+				u8 b = value & 0x7F;
+				value >>= 7;
+				bool done = (value == 0 && !(b & 0x40)) || (value == -1 && (b & 0x40));
+				data.push_back(done ? b : (b | 0x80));
+				if (done) {
+					return *this;
+				}
+			}
+		}
+
+		Bytes& i32Leb(i32 value) { return i64Leb(value); }
+
+		Bytes& name(const std::string& n) {
+			u32Leb((u32)n.size());
+			data.insert(data.end(), n.begin(), n.end());
+			return *this;
+		}
+
+		std::vector<u8> data;
+	};
+
+	struct FunctionType {
+		std::vector<u8> parameters;
+		std::vector<u8> results;
+	};
+
+	struct LocalGroup {
+		u32 count;
+		u8 type;
+	};
+
+	u32 addType(FunctionType type) {
+		types.push_back(std::move(type));
+		return (u32)types.size() - 1;
+	}
+
+	// Imports have to be added before any function is defined, as they come
+	// first in the function index space
+	u32 importFunction(const std::string& moduleName, const std::string& n, u32 typeIdx) {
+		assert(functions.empty());
+		Bytes import;
+		import.name(moduleName).name(n).byte(0x00).u32Leb(typeIdx);
+		imports.push_back(std::move(import));
+		return numImportedFunctions++;
+	}
+
+	void importMemory(const std::string& moduleName, const std::string& n, u32 minPages) {
+		Bytes import;
+		import.name(moduleName).name(n).byte(0x02).byte(0x00).u32Leb(minPages);
+		imports.push_back(std::move(import));
+	}
+
+	u32 addFunction(u32 typeIdx, std::vector<LocalGroup> locals, const Bytes& body) {
+		Bytes code;
+		code.u32Leb((u32)locals.size());
+		for (auto& group : locals) {
+			code.u32Leb(group.count).byte(group.type);
+		}
+		code.append(body).byte(0x0B);
+
+		functions.push_back(typeIdx);
+		codes.push_back(std::move(code));
+		return numImportedFunctions + (u32)functions.size() - 1;
+	}
+
+	void exportFunction(const std::string& n, u32 funcIdx) {
+		exports.push_back({ n, funcIdx });
+	}
+
+	void setMemory(u32 minPages) { memoryPages = minPages; }
+
+	std::vector<u8> encode() const {
+		Bytes module;
+		module.bytes({ 0x00, 0x61, 0x73, 0x6D, 0x01, 0x00, 0x00, 0x00 });
+
+		Bytes typeSection;
+		typeSection.u32Leb((u32)types.size());
+		for (auto& type : types) {
+			typeSection.byte(0x60).u32Leb((u32)type.parameters.size());
+			for (auto t : type.parameters) { typeSection.byte(t); }
+			typeSection.u32Leb((u32)type.results.size());
+			for (auto t : type.results) { typeSection.byte(t); }
+		}
+		appendSection(module, 1, typeSection);
+
+		if (!imports.empty()) {
+			Bytes importSection;
+			importSection.u32Leb((u32)imports.size());
+			for (auto& import : imports) { importSection.append(import); }
+			appendSection(module, 2, importSection);
+		}
+
+		Bytes functionSection;
+		functionSection.u32Leb((u32)functions.size());
+		for (auto idx : functions) { functionSection.u32Leb(idx); }
+		appendSection(module, 3, functionSection);
+
+		if (memoryPages) {
+			Bytes memorySection;
+			memorySection.u32Leb(1).byte(0x00).u32Leb(*memoryPages);
+			appendSection(module, 5, memorySection);
+		}
+
+		Bytes exportSection;
+		exportSection.u32Leb((u32)exports.size());
+		for (auto& exp : exports) {
+			exportSection.name(exp.name).byte(0x00).u32Leb(exp.funcIdx);
+		}
+		appendSection(module, 7, exportSection);
+
+		Bytes codeSection;
+		codeSection.u32Leb((u32)codes.size());
+		for (auto& code : codes) {
+			codeSection.u32Leb((u32)code.data.size()).append(code);
+		}
+		appendSection(module, 10, codeSection);
+
+		return std::move(module.data);
+	}
+
+	// Writes the module to the temp directory and returns its path. The file name
+	// doubles as the module name when loaded by the interpreter.
+	std::string writeTemporary(const std::string& moduleName) const {
+		auto path = std::filesystem::temp_directory_path() / (moduleName + ".wasm");
+		auto bytes = encode();
+		std::ofstream file{ path, std::ios::binary };
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return path.string();
+	}
+
+private:
+	struct Export {
+		std::string name;
+		u32 funcIdx;
+	};
+
+	static void appendSection(Bytes& module, u8 id, const Bytes& content) {
+		module.byte(id).u32Leb((u32)content.data.size()).append(content);
+	}
+
+	std::vector<FunctionType> types;
+	std::vector<Bytes> imports;
+	u32 numImportedFunctions{ 0 };
+	std::vector<u32> functions;
+	std::vector<Bytes> codes;
+	std::vector<Export> exports;
+	std::optional<u32> memoryPages;
+};
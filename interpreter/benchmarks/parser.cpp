@@ -0,0 +1,163 @@
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "../interpreter/interpreter.h"
+#include "../interpreter/buffer.h"
+#include "../interpreter/error.h"
+
+#include "module_writer.h"
+
+/*
+* Parser benchmark
+* Times the module loader on a large generated module and the LEB128 decoder
+* of the buffer iterator against a byte wise reference decoder. Run with the
+* optional arguments <function count> <repetitions>.
+*/
+
+using WASM::u8, WASM::u32, WASM::u64, WASM::i32, WASM::i64;
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template<typename F>
+static double bestOf(u32 repetitions, F&& function) {
+	double best = std::numeric_limits<double>::max();
+	for (u32 i = 0; i != repetitions; i++) {
+		auto start = Clock::now();
+		function();
+		best = std::min(best, millisecondsSince(start));
+	}
+	return best;
+}
+
+static ModuleWriter generateModule(u32 functionCount) {
+	// Every function is a chain of the same few instruction patterns with large
+	// immediates, so most LEB128 values take several bytes to encode
+	constexpr u32 unitsPerFunction = 64;
+	constexpr u8 I32 = 0x7F, I64 = 0x7E;
+
+	ModuleWriter writer;
+	auto typeIdx = writer.addType({ { I32, I32 }, { I32 } });
+	writer.setMemory(1);
+
+	for (u32 f = 0; f != functionCount; f++) {
+		ModuleWriter::Bytes body;
+		for (u32 i = 0; i != unitsPerFunction; i++) {
+			auto seed = f * unitsPerFunction + i;
+			body.byte(0x20).u32Leb(0).byte(0x41).i32Leb((i32)(seed * 7919 + 100000)).byte(0x6A).byte(0x21).u32Leb(2);
+			body.byte(0x42).i64Leb((i64)seed * 0x123456789LL).byte(0x21).u32Leb(4);
+			body.byte(0x20).u32Leb(2).byte(0x28).u32Leb(2).u32Leb(seed * 131 % 60000).byte(0x20).u32Leb(1).byte(0x73).byte(0x21).u32Leb(3);
+			body.byte(0x02).byte(0x40).byte(0x20).u32Leb(3).byte(0x0D).u32Leb(0).byte(0x0B);
+
+			if (f > 0 && i % 8 == 0) {
+				body.byte(0x20).u32Leb(3).byte(0x20).u32Leb(2).byte(0x10).u32Leb(f - 1).byte(0x21).u32Leb(3);
+			}
+		}
+		body.byte(0x20).u32Leb(3);
+
+		auto funcIdx = writer.addFunction(typeIdx, { { 2, I32 }, { 1, I64 } }, body);
+		if (f % 64 == 0) {
+			writer.exportFunction("f" + std::to_string(f), funcIdx);
+		}
+	}
+
+	return writer;
+}
+
+static void benchmarkModuleLoading(u32 functionCount, u32 repetitions) {
+	auto writer = generateModule(functionCount);
+	auto path = writer.writeTemporary("parserbench");
+	auto fileSize = WASM::Buffer::fromFile(path).size();
+
+	std::cout << "Generated module: " << functionCount << " functions, " << fileSize << " bytes\n";
+
+	auto readTime = bestOf(repetitions, [&]() { WASM::Buffer::fromFile(path); });
+
+	double loadTime = std::numeric_limits<double>::max();
+	double compileTime = std::numeric_limits<double>::max();
+	for (u32 i = 0; i != repetitions; i++) {
+		WASM::Interpreter interpreter;
+
+		auto start = Clock::now();
+		interpreter.loadModule(path);
+		loadTime = std::min(loadTime, millisecondsSince(start));
+
+		start = Clock::now();
+		interpreter.compileAndLinkModules();
+		compileTime = std::min(compileTime, millisecondsSince(start));
+	}
+
+	auto megabytesPerSecond = [&](double ms) { return (double)fileSize / (ms * 1000.0); };
+	std::cout << "  read file:            " << readTime << " ms\n";
+	std::cout << "  loadModule:           " << loadTime << " ms (" << megabytesPerSecond(loadTime) << " MB/s)\n";
+	std::cout << "  compileAndLink:       " << compileTime << " ms\n";
+}
+
+static void benchmarkLEB128(u32 repetitions) {
+	// Values are spread over all encoded lengths from one to five bytes
+	constexpr u32 valueCount = 4 * 1024 * 1024;
+	std::mt19937 generator{ 42 };
+	ModuleWriter::Bytes bytes;
+	for (u32 i = 0; i != valueCount; i++) {
+		auto bits = generator() % 32 + 1;
+		bytes.u32Leb(generator() >> (32 - bits));
+	}
+
+	WASM::Buffer buffer{ std::move(bytes.data) };
+	std::cout << "LEB128 buffer: " << valueCount << " values, " << buffer.size() << " bytes\n";
+
+	u64 fastSum = 0, referenceSum = 0;
+	auto fastTime = bestOf(repetitions, [&]() {
+		auto it = buffer.iterator();
+		fastSum = 0;
+		for (u32 i = 0; i != valueCount; i++) {
+			fastSum += it.nextU32();
+		}
+	});
+
+	auto referenceTime = bestOf(repetitions, [&]() {
+		auto it = buffer.iterator();
+		referenceSum = 0;
+		for (u32 i = 0; i != valueCount; i++) {
+			u32 value = 0, shift = 0;
+			u8 byte;
+			do {
+				byte = it.nextU8();
+				value |= (u32)(byte & 0x7F) << shift;
+				shift += 7;
+			} while (byte & 0x80);
+			referenceSum += value;
+		}
+	});
+
+	if (fastSum != referenceSum) {
+		throw std::runtime_error{ "LEB128 decoders disagree" };
+	}
+
+	auto nanosecondsPerValue = [&](double ms) { return ms * 1000000.0 / valueCount; };
+	std::cout << "  BufferIterator::nextU32: " << fastTime << " ms (" << nanosecondsPerValue(fastTime) << " ns/value)\n";
+	std::cout << "  byte wise reference:     " << referenceTime << " ms (" << nanosecondsPerValue(referenceTime) << " ns/value)\n";
+}
+
+int main(int argc, char** argv) {
+	u32 functionCount = argc > 1 ? std::stoul(argv[1]) : 4000;
+	u32 repetitions = argc > 2 ? std::stoul(argv[2]) : 5;
+
+	try {
+		benchmarkModuleLoading(functionCount, repetitions);
+		benchmarkLEB128(repetitions);
+	}
+	catch (WASM::Error& e) {
+		std::cerr << "Caught wasm error: " << e << std::endl;
+		return 1;
+	}
+	catch (std::exception& e) {
+		std::cerr << "Caught generic error: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,62 @@
+#include <cassert>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "address_space.h"
+
+using namespace WASM;
+
+AddressSpaceReservation::AddressSpaceReservation(sizeType numBytes)
+	: mByteSize{ numBytes }
+{
+	// Empty ranges cannot be reserved, but also never get committed
+	if (!numBytes) {
+		return;
+	}
+
+#ifdef _WIN32
+	mBase = static_cast<u8*>(VirtualAlloc(nullptr, numBytes, MEM_RESERVE, PAGE_NOACCESS));
+#else
+	auto address = mmap(nullptr, numBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	mBase = address != MAP_FAILED ? static_cast<u8*>(address) : nullptr;
+#endif
+
+	if (!mBase) {
+		throw std::runtime_error{ "Could not reserve address space" };
+	}
+}
+
+AddressSpaceReservation::~AddressSpaceReservation()
+{
+	if (!mBase) {
+		return;
+	}
+
+#ifdef _WIN32
+	VirtualFree(mBase, 0, MEM_RELEASE);
+#else
+	munmap(mBase, mByteSize);
+#endif
+}
+
+bool AddressSpaceReservation::commit(sizeType offset, sizeType numBytes)
+{
+	// The offset and size are expected to be multiples of the page size of the system
+	assert(offset + numBytes <= mByteSize);
+	if (!numBytes) {
+		return true;
+	}
+
+#ifdef _WIN32
+	return VirtualAlloc(mBase + offset, numBytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	return mprotect(mBase + offset, numBytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "util.h"
+
+namespace WASM {
+	/*
+	* Address Space Reservation class
+	* Reserves a range of virtual addresses without backing it with physical
+	* memory. Parts of the range only become accessible once they are committed,
+	* which backs them with zeroed pages. The range stays at the same address
+	* until the reservation is destroyed, which releases all of it.
+	*/
+	class AddressSpaceReservation {
+	public:
+		AddressSpaceReservation(sizeType);
+		AddressSpaceReservation(const AddressSpaceReservation&) = delete;
+		AddressSpaceReservation(AddressSpaceReservation&&) = delete;
+		~AddressSpaceReservation();
+
+		u8* data() const { return mBase; }
+		sizeType sizeInBytes() const { return mByteSize; }
+
+		bool commit(sizeType, sizeType);
+
+	private:
+		u8* mBase{ nullptr };
+		sizeType mByteSize{ 0 };
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory_resource>
+
+#include "util.h"
+
+namespace WASM {
+	/*
+	* Arena class
+	* Monotonic memory resource for the many small allocations made while
+	* loading a module. Memory is handed out by bumping a pointer and is
+	* only released as a whole when the arena is destroyed. Containers
+	* keep a pointer to the arena, hence it cannot be moved and has to
+	* outlive all of them.
+	*/
+	class Arena {
+	public:
+		static constexpr sizeType DefaultInitialSize = 64 * 1024;
+
+		Arena(sizeType initialSize = DefaultInitialSize) : mResource{ initialSize } {}
+		Arena(const Arena&) = delete;
+		Arena(Arena&&) = delete;
+
+		std::pmr::memory_resource* resource() { return &mResource; }
+
+	private:
+		std::pmr::monotonic_buffer_resource mResource;
+	};
+}
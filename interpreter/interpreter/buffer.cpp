@@ -1,5 +1,7 @@
 #include <fstream>
 #include <cassert>
+#include <cstring>
+#include <bit>
 
 #include "buffer.h"
 
@@ -17,6 +19,52 @@ class LEB128Decoder {
 public:
 
 	static constexpr u32 ByteCount = sizeof(T);
+	static constexpr u32 BitCount = ByteCount * 8;
+	static constexpr u32 MaxEncodedByteCount = (BitCount + 6) / 7;
+
+	// Decodes an integer that is encoded as a single byte
+	static T decodeSingleByte(u8 byte) {
+		assert((byte & 0x80) == 0);
+		if constexpr (std::is_signed_v<T>) {
+			// Move the sign bit to the top of the byte and shift it back down
+			return static_cast<T>(static_cast<i8>(byte << 1) >> 1);
+		}
+		return static_cast<T>(byte);
+	}
+
+	// Decodes an integer from the first bytes of a little endian word without
+	// looping over each byte. Fails if the encoding is longer than the word or
+	// the maximum encoding length of the integer type.
+	static bool decodeWord(u64 word, T& value, u32& length) {
+		// Each byte with a cleared continuation bit terminates an integer
+		auto stopBits = ~word & 0x8080808080808080ull;
+		if (!stopBits) {
+			return false;
+		}
+
+		auto stopBitIndex = std::countr_zero(stopBits);
+		length = (stopBitIndex / 8) + 1;
+		if (length > MaxEncodedByteCount) {
+			return false;
+		}
+
+		// Drop all bytes after the last one and pack the 7-bit groups together
+		auto bits = word & (~0ull >> (63 - stopBitIndex)) & 0x7F7F7F7F7F7F7F7Full;
+		bits = ((bits & 0x7F007F007F007F00ull) >> 1) | (bits & 0x007F007F007F007Full);
+		bits = ((bits & 0x3FFF00003FFF0000ull) >> 2) | (bits & 0x00003FFF00003FFFull);
+		bits = ((bits & 0x0FFFFFFF00000000ull) >> 4) | (bits & 0x000000000FFFFFFFull);
+
+		if constexpr (std::is_signed_v<T>) {
+			// Sign extend from the highest decoded bit
+			auto shift = 64 - 7 * length;
+			value = static_cast<T>(static_cast<i64>(bits << shift) >> shift);
+		}
+		else {
+			value = static_cast<T>(bits);
+		}
+
+		return true;
+	}
 
 	// Signed decoding
 	template<typename TStream, typename TSFINAEHelper = T>
@@ -25,14 +73,16 @@ public:
 		u32 shift = 0;
 		for (u32 i = 0; i != ByteCount+2; i++) {
 			auto byte = stream.nextU8();
-			value |= (byte & 0x7F) << shift;
+			if (shift < BitCount) {
+				value |= static_cast<T>(byte & 0x7F) << shift;
+			}
+			shift += 7;
 			if ((byte & 0x80) == 0) {
-				if (shift < 32 && (byte & 0x40) != 0) {
-					return value | (~0 << shift);
+				if (shift < BitCount && (byte & 0x40) != 0) {
+					return value | (static_cast<T>(~0) << shift);
 				}
 				return value;
 			}
-			shift += 7;
 		}
 
 		return value;
@@ -45,7 +95,9 @@ public:
 		u32 shift = 0;
 		for (u32 i = 0; i != ByteCount+2; i++) {
 			auto byte = stream.nextU8();
-			value |= (byte & 0x7F) << shift;
+			if (shift < BitCount) {
+				value |= static_cast<T>(byte & 0x7F) << shift;
+			}
 			if ((byte & 0x80) == 0) {
 				break;
 			}
@@ -192,22 +244,22 @@ void BufferIterator::assertU8(u8 expectedByte)
 
 u32 BufferIterator::nextU32()
 {
-	return LEB128Decoder<u32>{}.decode(*this);
+	return nextLEB128<u32>();
 }
 
 u64 BufferIterator::nextU64()
 {
-	return LEB128Decoder<u64>{}.decode(*this);
+	return nextLEB128<u64>();
 }
 
 i32 BufferIterator::nextI32()
 {
-	return LEB128Decoder<i32>{}.decode(*this);
+	return nextLEB128<i32>();
 }
 
 i64 BufferIterator::nextI64()
 {
-	return LEB128Decoder<i64>{}.decode(*this);
+	return nextLEB128<i64>();
 }
 
 f32 BufferIterator::nextF32()
@@ -316,6 +368,32 @@ BufferIterator& BufferIterator::operator+=(u32 offset)
 	return *this;
 }
 
+template<typename T>
+T BufferIterator::nextLEB128()
+{
+	// Most integers in a module are small indices or constants, that
+	// fit into a single byte
+	if (hasNext() && *mPosition < 0x80) {
+		return LEB128Decoder<T>::decodeSingleByte(*(mPosition++));
+	}
+
+	// Decode the integer at once if a whole word can be loaded
+	if (hasNext(8)) {
+		u64 word;
+		std::memcpy(&word, mPosition, sizeof(word));
+
+		T value;
+		u32 length;
+		if (LEB128Decoder<T>::decodeWord(word, value, length)) {
+			mPosition += length;
+			return value;
+		}
+	}
+
+	// Decode byte by byte near the end of the buffer or for over long encodings
+	return LEB128Decoder<T>{}.decode(*this);
+}
+
 bool BufferIterator::hasSameBase(const BufferIterator& other) const
 {
 	// Check if the pointer intevals overlap. If the pointers are in valid ranges
@@ -63,6 +63,9 @@ namespace WASM {
 		bool hasSameBase(const BufferIterator&) const;
 
 	private:
+		template<typename T>
+		T nextLEB128();
+
 		u8* mPosition{ nullptr };
 		u8* mEndPosition{ nullptr };
 	};
@@ -120,6 +123,7 @@ namespace WASM {
 
 		sizeType size() const { return mLength; }
 		bool isEmpty() const { return mLength == 0; }
+		bool hasInRange(const u8* ptr) const { return mBegin <= ptr && ptr < (mBegin + mLength); }
 
 		u8& operator[](sizeType idx) { assert(idx < mLength); return mBegin[idx]; }
 		const u8& operator[](sizeType idx) const { assert(idx < mLength); return mBegin[idx]; }
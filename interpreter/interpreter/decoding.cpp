@@ -70,10 +70,15 @@ Module ModuleParser::toModule(Interpreter& interpreter)
 }
 
 std::string ModuleParser::parseNameString()
+{
+	return std::string{ parseNameStringView() };
+}
+
+std::string_view ModuleParser::parseNameStringView()
 {
 	auto nameLength = nextU32();
 	auto nameSlice = nextSliceOf(nameLength);
-	return nameSlice.toString();
+	return { reinterpret_cast<const char*>(nameSlice.begin()), nameSlice.size() };
 }
 
 void ModuleParser::parseHeader()
@@ -213,10 +218,20 @@ void ModuleParser::parseTypeSection()
 	// The type section consist of a single vector of function types
 	// https://webassembly.github.io/spec/core/binary/modules.html#type-section
 
+	// Each type is deduplicated against the types of all loaded modules right away,
+	// so that typed references can be compared across modules by their interpreter
+	// type index. Types may therefore only reference the types preceding them.
 	auto numFunctionTypes = nextU32();
 	mFunctionTypes.reserve(mFunctionTypes.size()+ numFunctionTypes);
 	for (u32 i = 0; i != numFunctionTypes; i++) {
 		auto functionType = parseFunctionType();
+
+		auto findIt = std::find(interpreterFunctionTypes.begin(), interpreterFunctionTypes.end(), functionType);
+		auto typeIdx = (u32)(findIt - interpreterFunctionTypes.begin());
+		if (findIt == interpreterFunctionTypes.end()) {
+			interpreterFunctionTypes.emplace_back(functionType);
+		}
+		mInterpreterTypeIndices.emplace_back( typeIdx );
 		mFunctionTypes.emplace_back( std::move(functionType) );
 	}
 
@@ -447,7 +462,7 @@ ModuleParser::NameMap ModuleParser::parseNameMap()
 	// and a name each forming pairs. Indices have to appear in order.
 	// https://webassembly.github.io/spec/core/appendix/custom.html#name-maps
 
-	NameMap nameMap;
+	NameMap nameMap{ mArena->resource() };
 
 	auto numNameAssoc = nextU32();
 	nameMap.reserve(numNameAssoc);
@@ -456,13 +471,13 @@ ModuleParser::NameMap ModuleParser::parseNameMap()
 
 	for (u32 i = 0; i != numNameAssoc; i++) {
 		auto nameIdx = nextU32();
-		auto name = parseNameString();
+		auto name = parseNameStringView();
 
 		if (i!= 0 && nameIdx <= prevNameIdx) {
 			throwParsingError("Expected name indices in increasing order for name map.");
 		}
 
-		nameMap.emplace( nameIdx, std::move(name) );
+		nameMap.emplace( nameIdx, name );
 		prevNameIdx = nameIdx;
 	}
 
@@ -476,7 +491,7 @@ ModuleParser::IndirectNameMap ModuleParser::parseIndirectNameMap()
 	// as two map levels are formed. Indices have to appear in order.
 	// https://webassembly.github.io/spec/core/appendix/custom.html#name-maps
 
-	IndirectNameMap indirectMap;
+	IndirectNameMap indirectMap{ mArena->resource() };
 
 	auto numGroups = nextU32();
 	indirectMap.reserve(numGroups);
@@ -531,7 +546,7 @@ std::vector<ValType>& ModuleParser::parseResultTypeVector(bool doClearVector)
 	auto resultNum = nextU32();
 	cachedResultTypeVector.reserve(cachedResultTypeVector.size()+ resultNum);
 	for (u32 i = 0; i != resultNum; i++) {
-		auto valType = ValType::fromInt(nextU8());
+		auto valType = nextValType();
 		if (!valType.isValid()) {
 			throwParsingError("Found invalid val type while parsing result type vector");
 		}
@@ -551,7 +566,7 @@ TableType ModuleParser::parseTableType()
 		throwParsingError("Not enough bytes to parse table type");
 	}
 
-	auto elementRefType = ValType::fromInt(nextU8());
+	auto elementRefType = nextValType();
 	if (!elementRefType.isReference()) {
 		throwParsingError("Expected reference val type for table element type");
 	}
@@ -582,7 +597,7 @@ GlobalType ModuleParser::parseGlobalType()
 		throwParsingError("Not enough bytes to parse global");
 	}
 
-	auto valType = ValType::fromInt(nextU8());
+	auto valType = nextValType();
 	if (!valType.isValid()) {
 		throwParsingError("Invalid valtype for global");
 	}
@@ -615,21 +630,26 @@ Limits ModuleParser::parseLimits()
 {
 	// A limits object starts with a byte flag inicating whether a max value
 	// is present. Either only a min value or a min and a max value follow.
+	// The threads proposal adds the shared flag as second bit. The memory64 proposal
+	// adds the third bit for 64bit indices, whose limits are encoded as u64.
 	// https://webassembly.github.io/spec/core/binary/types.html#limits
+	// https://github.com/WebAssembly/threads/blob/main/proposals/threads/Overview.md#spec-changes
+	// https://github.com/WebAssembly/memory64/blob/main/proposals/memory64/Overview.md#binary-format
 
-	auto hasMaximum = nextU8();
-	if (hasMaximum == 0x00) {
-		auto mMin = nextU32();
-		return { mMin };
-	}
-	else if (hasMaximum == 0x01) {
-		auto mMin = nextU32();
-		auto mMax = nextU32();
-		return { mMin, mMax };
+	auto flags = nextU8();
+	if (flags > 0x07) {
+		throwParsingError("Invalid limits format. Expected a value from 0x00 to 0x07");
 	}
-	else {
-		throwParsingError("Invalid limits format. Expected 0x00 or 0x01");
+
+	bool isShared = flags & 0x02;
+	bool is64 = flags & 0x04;
+	u64 mMin = is64 ? nextU64() : nextU32();
+	if (flags & 0x01) {
+		u64 mMax = is64 ? nextU64() : nextU32();
+		return { mMin, mMax, isShared, is64 };
 	}
+
+	return { mMin, {}, isShared, is64 };
 }
 
 Expression ModuleParser::parseInitExpression()
@@ -645,7 +665,7 @@ Expression ModuleParser::parseInitExpression()
 	// FIXME: All constant instructions have a producing stack effect, which means
 	// that only a single instruction could ever be read in. So maybe ditch the vector
 
-	std::vector<Instruction> instructions;
+	std::pmr::vector<Instruction> instructions{ mArena->resource() };
 	auto beginPos = mIt;
 	while (hasNext()) {
 		auto& ins = instructions.emplace_back(Instruction::fromWASMBytes(mIt));
@@ -724,7 +744,7 @@ Element ModuleParser::parseElement()
 	};
 
 	const auto parseReferenceType = [this]() {
-		auto refType = ValType::fromInt(nextU8());
+		auto refType = nextValType();
 		if (!refType.isReference()) {
 			throwParsingError("Expected reference type for element");
 		}
@@ -818,10 +838,13 @@ FunctionCode ModuleParser::parseFunctionCode()
 	auto numLocals = nextU32();
 	
 	// Read the locals
-	std::vector<CompressedLocalTypes> locals;
+	std::pmr::vector<CompressedLocalTypes> locals{ mArena->resource() };
 	for (u32 i = 0; i != numLocals; i++) {
 		auto localCount = nextU32();
-		auto localType = ValType::fromInt(nextU8());
+		auto localType = nextValType();
+		if (!localType.isValid()) {
+			throwParsingError("Found invalid val type while parsing locals");
+		}
 		locals.emplace_back(localCount, localType);
 	}
 
@@ -836,13 +859,13 @@ FunctionCode ModuleParser::parseFunctionCode()
 		throwParsingError("Invalid funcion code item. Expected 0x0B at end of expression");
 	}
 
-	std::vector<Instruction> instructions;
+	std::pmr::vector<Instruction> instructions{ mArena->resource() };
 	auto codeIt = codeSlice.iterator();
 	while (codeIt.hasNext()) {
 		instructions.emplace_back(Instruction::fromWASMBytes(codeIt));
 	}
 
-	return { Expression{codeSlice, instructions}, std::move(locals) };
+	return { Expression{codeSlice, std::move(instructions)}, std::move(locals) };
 }
 
 DataItem WASM::ModuleParser::parseDataItem()
@@ -947,32 +970,34 @@ bool FunctionType::takesVoidReturnsVoid() const
 	return parameters().empty() && results().empty();
 }
 
-u32 FunctionType::parameterStackSectionSizeInBytes() const
+u32 FunctionType::parameterStackSectionSizeInBytes(bool alignedStack) const
 {
-	if (requiredParameterStackBytes.has_value()) {
-		return *requiredParameterStackBytes;
+	auto& cachedBytes = requiredParameterStackBytes[alignedStack];
+	if (cachedBytes.has_value()) {
+		return *cachedBytes;
 	}
 
 	u32 numBytesParameters = 0;
 	for (auto valType : parameters()) {
-		numBytesParameters+= valType.sizeInBytes();
+		numBytesParameters+= valType.stackSizeInBytes(alignedStack);
 	}
-	requiredParameterStackBytes = numBytesParameters;
+	cachedBytes = numBytesParameters;
 
 	return numBytesParameters;
 }
 
-u32 FunctionType::resultStackSectionSizeInBytes() const
+u32 FunctionType::resultStackSectionSizeInBytes(bool alignedStack) const
 {
-	if (requiredResultStackBytes.has_value()) {
-		return *requiredResultStackBytes;
+	auto& cachedBytes = requiredResultStackBytes[alignedStack];
+	if (cachedBytes.has_value()) {
+		return *cachedBytes;
 	}
 
 	u32 numBytesResults = 0;
 	for (auto valType : results()) {
-		numBytesResults += valType.sizeInBytes();
+		numBytesResults += valType.stackSizeInBytes(alignedStack);
 	}
-	requiredResultStackBytes = numBytesResults;
+	cachedBytes = numBytesResults;
 
 	return numBytesResults;
 }
@@ -985,7 +1010,23 @@ bool WASM::FunctionType::takesValuesAsParameters(std::span<Value> values) const
 	}
 
 	for (u32 i = 0; i != params.size(); i++) {
-		if (params[i] != values[i].type()) {
+		if (!values[i].hasType(params[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool WASM::FunctionType::returnsValuesAsResults(std::span<Value> values) const
+{
+	auto res = results();
+	if (res.size() != values.size()) {
+		return false;
+	}
+
+	for (u32 i = 0; i != res.size(); i++) {
+		if (!values[i].hasType(res[i])) {
 			return false;
 		}
 	}
@@ -1033,14 +1074,15 @@ bool FunctionType::operator==(const FunctionType& other) const
 		return false;
 	}
 
+	// Typed references have to reference the same type
 	for (u32 i = 0; i != parameters().size(); i++) {
-		if (parameters()[i] != other.parameters()[i]) {
+		if (parameters()[i].encoded() != other.parameters()[i].encoded()) {
 			return false;
 		}
 	}
 
 	for (u32 i = 0; i != results().size(); i++) {
-		if (results()[i] != other.results()[i]) {
+		if (results()[i].encoded() != other.results()[i].encoded()) {
 			return false;
 		}
 	}
@@ -1055,17 +1097,26 @@ void Limits::print(std::ostream& out) const
 		out << ", " << *mMax;
 	}
 	out << ')';
+
+	if (mIsShared) {
+		out << " shared";
+	}
+
+	if (mIs64) {
+		out << " i64";
+	}
 }
 
-bool Limits::isValid(u32 range) const
+bool Limits::isValid(u64 range) const
 {
 	// The min value must be smaller or equal to the specified range for a 
 	// limit to be valid. Further it must be smaller or equal to the max
 	// value if one is present. The max value must also be smaller or equal
-	// to the specified range, or be not present.
+	// to the specified range, or be not present. Shared limits always
+	// require a max value.
 	// https://webassembly.github.io/spec/core/valid/types.html#valid-limits
 
-	if (mMin > range) {
+	if (mMin > range || (mIsShared && !mMax.has_value())) {
 		return false;
 	}
 
@@ -1081,10 +1132,11 @@ bool Limits::matches(const Limits& other) const
 	// To have this limits object match another limits object the min value
 	// has to be greater or equal to the other. If the other does not have 
 	// a max value return true. If the other has a max value, this object 
-	// needs to have one too, which also has to be smaller or equal.
+	// needs to have one too, which also has to be smaller or equal. Both
+	// have to agree on whether they are shared and on their index type.
 	// https://webassembly.github.io/spec/core/valid/types.html#match-limits
 
-	if (mMin < other.mMin) {
+	if (mMin < other.mMin || mIsShared != other.mIsShared || mIs64 != other.mIs64) {
 		return false;
 	}
 
@@ -1165,14 +1217,14 @@ void Element::print(std::ostream& out) const
 	}
 }
 
-LinkedElement Element::decodeAndLink(ModuleElementIndex index, Module& module) const
+LinkedElement Element::decodeAndLink(ModuleElementIndex index, Module& module, Arena& arena) const
 {
 	u32 tableOffset = mTablePosition.has_value() ? mTablePosition->tableOffset.constantI32() : 0;
 	if (mMode == ElementMode::Passive) {
 		return { index, mMode, refType, tableIndex(), tableOffset };
 	}
 
-	std::vector<Nullable<Function>> functionPointers;
+	std::pmr::vector<Nullable<Function>> functionPointers{ arena.resource() };
 	auto appendFunction = [&](ModuleFunctionIndex functionIdx) {
 		auto function= module.functionByIndex(functionIdx);
 		assert(function.has_value()); // FIXME: Throw instead
@@ -1239,12 +1291,24 @@ void Expression::print(std::ostream& out) const
 	}
 }
 
+void Expression::replaceInstructions(std::span<const Instruction> instructions)
+{
+	// Rewritten instructions keep referring to the original bytes
+	mInstructions.assign(instructions.begin(), instructions.end());
+}
+
 i32 Expression::constantI32() const
 {
 	assert(mInstructions.size() > 0);
 	return mInstructions.front().asI32Constant();
 }
 
+i64 Expression::constantI64() const
+{
+	assert(mInstructions.size() > 0);
+	return mInstructions.front().asI64Constant();
+}
+
 std::optional<ModuleFunctionIndex> Expression::constantFuncRefAsIndex() const
 {
 	assert(mInstructions.size() > 0);
@@ -1353,7 +1417,7 @@ void ModuleValidator::validate(const ParsingState& parser)
 	parsingState = nullptr;
 }
 
-const FunctionType& ModuleValidator::functionTypeByIndex(ModuleFunctionIndex funcIdx)
+ModuleTypeIndex ModuleValidator::typeIndexOfFunction(ModuleFunctionIndex funcIdx)
 {
 	ModuleTypeIndex typeIdx{ 0 };
 	if (funcIdx < s().importedFunctions().size()) {
@@ -1361,17 +1425,22 @@ const FunctionType& ModuleValidator::functionTypeByIndex(ModuleFunctionIndex fun
 	}
 	else {
 		funcIdx -= s().importedFunctions().size();
-		if (funcIdx > s().functions().size()) {
+		if (funcIdx >= s().functions().size()) {
 			throwValidationError("Invalid function index");
 		}
 
 		typeIdx = s().functions()[funcIdx.value];
 	}
 	
-	if (typeIdx > s().functionTypes().size()) {
+	if (typeIdx >= s().functionTypes().size()) {
 		throwValidationError("Function references invalid type index");
 	}
-	return s().functionTypes()[typeIdx.value];
+	return typeIdx;
+}
+
+const FunctionType& ModuleValidator::functionTypeByIndex(ModuleFunctionIndex funcIdx)
+{
+	return s().functionTypes()[typeIndexOfFunction(funcIdx).value];
 }
 
 void ModuleValidator::validateFunction(LocalFunctionIndex funcNum)
@@ -1408,6 +1477,19 @@ void ModuleValidator::validateTableType(const TableType& tableType)
 		throwValidationError("Invalid table limits definition");
 	}
 
+	if (tableType.limits().isShared()) {
+		throwValidationError("Tables cannot be shared");
+	}
+
+	if (tableType.limits().is64()) {
+		throwValidationError("Tables cannot use 64bit indices");
+	}
+
+	// Tables of non-nullable references would need an init expression for their elements
+	if (!tableType.valType().isDefaultable()) {
+		throwValidationError("Tables cannot have non-nullable element types");
+	}
+
 	if (introspector.has_value()) {
 		introspector->onValidatingTableType(tableType);
 	}
@@ -1416,15 +1498,20 @@ void ModuleValidator::validateTableType(const TableType& tableType)
 void ModuleValidator::validateMemoryType(const MemoryType& memoryType)
 {
 	// Validating a memory (type) checks whether the limit is valid within the range
-	// 0...2^16
+	// 0...2^16, or 0...2^48 for memories with 64bit indices
 	// https://webassembly.github.io/spec/core/valid/modules.html#memories
 	// https://webassembly.github.io/spec/core/valid/types.html#memory-types
 
-	constexpr u32 memoryRange = 0x10000;
-	if (!memoryType.limits().isValid(memoryRange)) {
+	auto& limits = memoryType.limits();
+	u64 memoryRange = limits.is64() ? 0x1000000000000 : 0x10000;
+	if (!limits.isValid(memoryRange)) {
 		throwValidationError("Invalid range limits definition");
 	}
 
+	if (limits.is64() && limits.isShared()) {
+		throwValidationError("Shared memories with 64bit indices are not supported");
+	}
+
 	if (introspector.has_value()) {
 		introspector->onValidatingMemoryType(memoryType);
 	}
@@ -1525,7 +1612,7 @@ void ModuleValidator::validateElementSegment(const Element& elem)
 		}
 
 		auto& table = s().tableTypes()[tableIdx.value - numImportedTables];
-		if (table.valType() != elem.valType()) {
+		if (!elem.valType().isSubtypeOf(table.valType())) {
 			throwValidationError("Element segment type missmatch with reference table");
 		}
 
@@ -1590,7 +1677,15 @@ void ModuleValidator::validateDataItem(const DataItem& dataItem)
 		throwValidationError("Data item references invalid memory index");
 	}
 
-	validateConstantExpression(memoryPosition->mOffsetExpression, ValType::I32);
+	// Memories with 64bit indices take an i64 offset
+	auto memoryIdx = memoryPosition->mMemoryIndex.value;
+	auto numImportedMemories = s().importedMemoryTypes().size();
+	auto& memoryType = memoryIdx < numImportedMemories
+		? s().importedMemoryTypes()[memoryIdx].memoryType()
+		: s().memoryTypes()[memoryIdx - numImportedMemories];
+	auto offsetType = memoryType.limits().is64() ? ValType::I64 : ValType::I32;
+
+	validateConstantExpression(memoryPosition->mOffsetExpression, offsetType);
 
 	if (introspector.has_value()) {
 		introspector->onValidatingDataItem(dataItem);
@@ -1618,14 +1713,22 @@ void ModuleValidator::validateConstantExpression(const Expression& exp, ValType
 	}
 
 	auto resultType = ins.constantType();
-	if (resultType.has_value() && *resultType != expectedType) {
-		throwValidationError("Constant expression yields unexpected type");
-	}
-
 	if (ins == InstructionType::GlobalGet) {
 		if (ins.globalIndex() >= s().importedGlobalTypes().size()) {
 			throwValidationError("Init expression references invalid global index");
 		}
+		resultType = s().importedGlobalTypes()[ins.globalIndex().value].globalType().valType();
+	}
+	else if (ins == InstructionType::ReferenceNull) {
+		resultType = s().resolveTypeIndex(ins.referenceType());
+	}
+	else if (ins == InstructionType::ReferenceFunction) {
+		auto typeIdx = typeIndexOfFunction(ins.functionIndex());
+		resultType = ValType::fromTypeIndex(s().interpreterTypeIndices()[typeIdx.value].value, false);
+	}
+
+	if (resultType.has_value() && !resultType->isSubtypeOf(expectedType)) {
+		throwValidationError("Constant expression yields unexpected type");
 	}
 }
 
@@ -1634,6 +1737,20 @@ void ModuleValidator::throwValidationError(const char* msg) const
 	throw ValidationError{ s().path(), msg };
 }
 
+ValType ParsingState::resolveTypeIndex(ValType type) const
+{
+	// Maps the module type index of a typed reference to its interpreter type index
+	if (!type.hasTypeIndex()) {
+		return type;
+	}
+
+	if (type.typeIndex() >= mInterpreterTypeIndices.size()) {
+		return ValType{ 0u };
+	}
+
+	return type.withTypeIndex(mInterpreterTypeIndices[type.typeIndex()].value);
+}
+
 void ParsingState::clear()
 {
 	mPath.clear();
@@ -1641,6 +1758,7 @@ void ParsingState::clear()
 	mIt = {};
 	mCustomSections.clear();
 	mFunctionTypes.clear();
+	mInterpreterTypeIndices.clear();
 	mFunctions.clear();
 	mTableTypes.clear();;
 	mMemoryTypes.clear();
@@ -1697,8 +1815,14 @@ bool WASM::GlobalImport::resolveFromResolvedGlobal(std::optional<ResolvedGlobal>
 	// already.
 	// Types are compatible if they are the same.
 	// https://webassembly.github.io/spec/core/valid/types.html#globals
-	auto expectedBytes = mGlobalType.valType().sizeInBytes();
-	if (expectedBytes != resolvedGlobal->type.valType().sizeInBytes()) {
+	// Typed references have to match exactly, as their values are not checked again.
+	auto expectedType = mGlobalType.valType();
+	auto actualType = resolvedGlobal->type.valType();
+	auto expectedBytes = expectedType.sizeInBytes();
+	auto typesDiffer = expectedType.isReference() || actualType.isReference()
+		? expectedType.encoded() != actualType.encoded()
+		: expectedBytes != actualType.sizeInBytes();
+	if (typesDiffer) {
 		if (expectedBytes == 4) {
 			mResolvedGlobal32.clear();
 		}
@@ -1836,11 +1960,11 @@ bool TableImport::tryResolveFromModuleWithName(ModuleBase& module)
 bool TableImport::isTypeCompatible() const
 {
 	// Types are compatible if the external table limits match the import declaration, 
-	// and if both val types are the same.
+	// and if both val types are the same, including their nullability and type index.
 	// https://webassembly.github.io/spec/core/valid/types.html#tables
 
 	return isResolved()
-		&& mResolvedTable->type() == mTableType.valType()
+		&& mResolvedTable->type().encoded() == mTableType.valType().encoded()
 		&& mResolvedTable->limits().matches(mTableType.limits());
 }
 
@@ -1900,7 +2024,8 @@ LinkedDataItem WASM::DataItem::decodeAndLink(ModuleDataIndex index, Interpreter&
 
 	assert(mMemoryPosition.has_value());
 	auto moduleMemoryIdx = mMemoryPosition->mMemoryIndex;
-	auto memoryOffset = (u32) mMemoryPosition->mOffsetExpression.constantI32();
+	auto& offsetExpression = mMemoryPosition->mOffsetExpression;
+	auto memoryOffset = offsetExpression[0] == InstructionType::I64Const ? (u64)offsetExpression.constantI64() : (u32)offsetExpression.constantI32();
 
 	auto memory = module.memoryByIndex(moduleMemoryIdx);
 	assert(memory.has_value());
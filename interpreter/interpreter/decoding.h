@@ -7,6 +7,7 @@
 
 #include "nullable.h"
 #include "instruction.h"
+#include "arena.h"
 
 namespace WASM {
 	struct CompressedLocalTypes {
@@ -16,13 +17,14 @@ namespace WASM {
 	
 	class Expression {
 	public:
-		Expression(BufferSlice b, std::vector<Instruction> i)
+		Expression(BufferSlice b, std::pmr::vector<Instruction> i)
 			: mBytes{ b }, mInstructions{ std::move(i) } {}
 
 		const BufferSlice& bytes() const { return mBytes; }
 
 		void printBytes(std::ostream&) const;
 		void print(std::ostream&) const;
+		void replaceInstructions(std::span<const Instruction>);
 
 		auto size() const { return mInstructions.size(); }
 		auto begin() const { return mInstructions.cbegin(); }
@@ -30,12 +32,13 @@ namespace WASM {
 		const auto& operator[](sizeType idx) const { return mInstructions[idx]; }
 
 		i32 constantI32() const;
+		i64 constantI64() const;
 		std::optional<ModuleFunctionIndex> constantFuncRefAsIndex() const;
 		u64 constantUntypedValue(Module&) const;
 
 	private:
 		BufferSlice mBytes;
-		std::vector<Instruction> mInstructions;
+		std::pmr::vector<Instruction> mInstructions;
 	};
 
 	class FunctionType {
@@ -50,9 +53,10 @@ namespace WASM {
 
 		bool returnsVoid() const;
 		bool takesVoidReturnsVoid() const;
-		u32 parameterStackSectionSizeInBytes() const;
-		u32 resultStackSectionSizeInBytes() const;
+		u32 parameterStackSectionSizeInBytes(bool) const;
+		u32 resultStackSectionSizeInBytes(bool) const;
 		bool takesValuesAsParameters(std::span<Value>) const;
+		bool returnsValuesAsResults(std::span<Value>) const;
 		void print(std::ostream&) const;
 
 		bool operator==(const FunctionType&) const;
@@ -78,25 +82,31 @@ namespace WASM {
 
 		std::variant<LocalArray, HeapArray> storage;
 
-		mutable std::optional<u32> requiredParameterStackBytes;
-		mutable std::optional<u32> requiredResultStackBytes;
+		// Cached for unaligned and aligned stacks
+		mutable std::optional<u32> requiredParameterStackBytes[2];
+		mutable std::optional<u32> requiredResultStackBytes[2];
 	};
 
 	class Limits {
 	public:
-		Limits( u32 i ) : mMin{ i }, mMax{} {}
-		Limits( u32 i, u32 a ) : mMin{ i }, mMax{ a } {}
+		Limits( u64 i ) : mMin{ i }, mMax{} {}
+		Limits( u64 i, u64 a ) : mMin{ i }, mMax{ a } {}
+		Limits( u64 i, std::optional<u64> a, bool s, bool x = false ) : mMin{ i }, mMax{ a }, mIsShared{ s }, mIs64{ x } {}
 
 		auto min() const { return mMin; }
 		auto& max() const { return mMax; }
+		bool isShared() const { return mIsShared; }
+		bool is64() const { return mIs64; }
 
 		void print(std::ostream&) const;
-		bool isValid(u32 range) const;
+		bool isValid(u64 range) const;
 		bool matches(const Limits&) const;
 	
 	private:
-		u32 mMin;
-		std::optional<u32> mMax;
+		u64 mMin;
+		std::optional<u64> mMax;
+		bool mIsShared{ false };
+		bool mIs64{ false };
 	};
 
 	class TableType {
@@ -224,7 +234,7 @@ namespace WASM {
 		Nullable<const std::vector<Expression>> initExpressions() const;
 
 		void print(std::ostream& out) const;
-		LinkedElement decodeAndLink(ModuleElementIndex, Module&) const;
+		LinkedElement decodeAndLink(ModuleElementIndex, Module&, Arena&) const;
 
 	private:
 		ElementMode mMode;
@@ -260,7 +270,7 @@ namespace WASM {
 
 	class FunctionCode {
 	public:
-		FunctionCode(Expression c, std::vector<CompressedLocalTypes> l)
+		FunctionCode(Expression c, std::pmr::vector<CompressedLocalTypes> l)
 			: code{ std::move(c) }, compressedLocalTypes{ std::move(l) } {}
 
 		const auto& locals() const { return compressedLocalTypes; }
@@ -275,7 +285,7 @@ namespace WASM {
 		friend class BytecodeFunction;
 
 		Expression code;
-		std::vector<CompressedLocalTypes> compressedLocalTypes;
+		std::pmr::vector<CompressedLocalTypes> compressedLocalTypes;
 	};
 
 	class Imported {
@@ -386,12 +396,13 @@ namespace WASM {
 
 	class ParsingState {
 	public:
-		using NameMap = std::unordered_map<u32, std::string>;
-		using IndirectNameMap = std::unordered_map<u32, NameMap>;
+		using NameMap = std::pmr::unordered_map<u32, std::pmr::string>;
+		using IndirectNameMap = std::pmr::unordered_map<u32, NameMap>;
 
 		auto& path() const { return mPath; }
 		auto& customSections() const { return mCustomSections; }
 		auto& functionTypes() const { return mFunctionTypes; }
+		auto& interpreterTypeIndices() const { return mInterpreterTypeIndices; }
 		auto& functions() const { return mFunctions; }
 		auto& tableTypes() const { return mTableTypes; }
 		auto& memoryTypes() const { return mMemoryTypes; }
@@ -416,20 +427,28 @@ namespace WASM {
 		auto releaseFunctionCodes() { return std::move(mFunctionCodes); }
 		auto releaseFunctionNames() { return std::move(mFunctionNames); }
 		auto releaseFunctionLocalNames() { return std::move(mFunctionLocalNames); }
+		auto releaseArena() { return std::move(mArena); }
 
 		auto& mutateImportedFunctions() { return mImportedFunctions; }
 		auto& mutateImportedTableTypes() { return mImportedTableTypes; }
 		auto& mutateImportedMemoryTypes() { return mImportedMemoryTypes; }
 		auto& mutateImportedGlobalTypes() { return mImportedGlobalTypes; }
 
+		ValType resolveTypeIndex(ValType) const;
+
 	protected:
 		void clear();
 
+		// All arena allocated items have to be declared after the arena, so
+		// they are destroyed before it
+		std::unique_ptr<Arena> mArena{ std::make_unique<Arena>() };
+
 		std::string mPath;
 		Buffer mData;
 		BufferIterator mIt;
 		std::unordered_map<std::string, BufferSlice> mCustomSections;
 		std::vector<FunctionType> mFunctionTypes;
+		std::vector<InterpreterTypeIndex> mInterpreterTypeIndices;
 		std::vector<ModuleTypeIndex> mFunctions;
 		std::vector<TableType> mTableTypes;
 		std::vector<MemoryType> mMemoryTypes;
@@ -447,13 +466,14 @@ namespace WASM {
 		std::vector<GlobalImport> mImportedGlobalTypes;
 
 		std::string mName;
-		NameMap mFunctionNames;
-		IndirectNameMap mFunctionLocalNames;
+		NameMap mFunctionNames{ mArena->resource() };
+		IndirectNameMap mFunctionLocalNames{ mArena->resource() };
 	};
 
 	class ModuleParser : public ParsingState {
 	public:
-		ModuleParser(Nullable<Introspector> intro) : introspector{ intro } {}
+		ModuleParser(Nullable<Introspector> intro, std::vector<FunctionType>& types)
+			: introspector{ intro }, interpreterFunctionTypes{ types } {}
 
 		void parse(Buffer, std::string);
 		Module toModule(Interpreter&);
@@ -464,7 +484,9 @@ namespace WASM {
 		void assertU8(u8 byte) { mIt.assertU8(byte); }
 
 		u32 nextU32() { return mIt.nextU32(); }
+		u64 nextU64() { return mIt.nextU64(); }
 		i32 nextI32() { return mIt.nextI32(); }
+		ValType nextValType() { return resolveTypeIndex(ValType::fromWASMBytes(mIt)); }
 
 		u32 nextBigEndianU32() { return mIt.nextBigEndianU32(); }
 		
@@ -473,6 +495,7 @@ namespace WASM {
 		BufferSlice sliceFrom(const BufferIterator& pos) const { return mIt.sliceFrom(pos); }
 
 		std::string parseNameString();
+		std::string_view parseNameStringView();
 
 		void parseHeader();
 		void parseSection();
@@ -515,6 +538,7 @@ namespace WASM {
 		void throwParsingError(const char*) const;
 
 		Nullable<Introspector> introspector;
+		std::vector<FunctionType>& interpreterFunctionTypes;
 		std::vector<ValType> cachedResultTypeVector;
 	};
 
@@ -528,6 +552,7 @@ namespace WASM {
 	private:
 		const ParsingState& s() const { assert(parsingState); return *parsingState; }
 
+		ModuleTypeIndex typeIndexOfFunction(ModuleFunctionIndex);
 		const FunctionType& functionTypeByIndex(ModuleFunctionIndex);
 		const TableType& tableTypeByIndex(ModuleTableIndex);
 		const MemoryType& memoryTypeByIndex(ModuleMemoryIndex);
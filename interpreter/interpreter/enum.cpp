@@ -3,6 +3,7 @@
 
 #include "enum.h"
 #include "bytecode.h"
+#include "buffer.h"
 
 using namespace WASM;
 
@@ -28,7 +29,7 @@ const char* SectionType::name() const
 
 bool ValType::isNumber() const
 {
-	switch (value) {
+	switch (*this) {
 	case I32:
 	case I64:
 	case F32:
@@ -41,17 +42,22 @@ bool ValType::isNumber() const
 
 bool ValType::isVector() const
 {
-	return value == V128;
+	return *this == V128;
 }
 
 bool ValType::isReference() const
 {
-	return value == FuncRef || value == ExternRef;
+	return *this == FuncRef || *this == ExternRef;
 }
 
 bool ValType::isValid() const
 {
-	switch (value) {
+	// Only references may be non-nullable or have a type index
+	if (value > KindMask && !isReference()) {
+		return false;
+	}
+
+	switch (*this) {
 	case I32:
 	case I64:
 	case F32:
@@ -67,7 +73,7 @@ bool ValType::isValid() const
 
 const char* ValType::name() const
 {
-	switch (value) {
+	switch (*this) {
 	case I32: return "I32";
 	case I64: return "I64";
 	case F32: return "F32";
@@ -81,7 +87,7 @@ const char* ValType::name() const
 
 u32 ValType::sizeInBytes() const
 {
-	switch (value) {
+	switch (*this) {
 	case I32: return 4;
 	case I64: return 8;
 	case F32: return 4;
@@ -94,6 +100,80 @@ u32 ValType::sizeInBytes() const
 	}
 }
 
+u32 ValType::stackSizeInBytes(bool alignedStack) const
+{
+	// Aligned stacks put each value into full 8 byte slots
+	return alignUp(sizeInBytes(), alignedStack ? 8 : 4);
+}
+
+ValType ValType::withTypeIndex(u32 idx) const
+{
+	assert(hasTypeIndex());
+	if (idx > (~0u >> TypeIndexShift)) {
+		return ValType{ 0u };
+	}
+	return ValType{ (value & ~(~0u << TypeIndexShift)) | (idx << TypeIndexShift) };
+}
+
+bool ValType::isSubtypeOf(ValType other) const
+{
+	if (*this != other) {
+		return false;
+	}
+
+	// A nullable reference cannot be used where a non-nullable one is expected
+	if (isNullable() && !other.isNullable()) {
+		return false;
+	}
+
+	// Typed function references are subtypes of the abstract function heap type
+	return !other.hasTypeIndex() || (hasTypeIndex() && typeIndex() == other.typeIndex());
+}
+
+/*
+* Typed function references
+* Nullable (0x63) and non-nullable (0x64) reference types are followed by a
+* heap type. A concrete heap type keeps the type index as found in the module,
+* which has to be mapped to an interpreter type index before it can be
+* compared. Invalid heap types result in an invalid ValType.
+*/
+ValType ValType::fromWASMBytes(BufferIterator& it)
+{
+	auto byte = it.peekU8();
+	if (byte != 0x63 && byte != 0x64) {
+		it.nextU8();
+		return ValType{ byte };
+	}
+
+	it.nextU8();
+	return fromWASMHeapType(it, byte == 0x63);
+}
+
+ValType ValType::fromWASMHeapType(BufferIterator& it, bool isNullable)
+{
+	auto nullableFlag = isNullable ? 0u : NonNullableFlag;
+	auto heapType = it.nextI64();
+	if (heapType == -0x10) {
+		return ValType{ FuncRef | nullableFlag };
+	}
+
+	if (heapType == -0x11) {
+		return ValType{ ExternRef | nullableFlag };
+	}
+
+	if (heapType >= 0 && heapType <= ~0u) {
+		return fromTypeIndex((u32)heapType, isNullable);
+	}
+
+	return ValType{ 0u };
+}
+
+ValType ValType::fromTypeIndex(u32 idx, bool isNullable)
+{
+	auto nullableFlag = isNullable ? 0u : NonNullableFlag;
+	return ValType{ FuncRef | nullableFlag | TypeIndexFlag }.withTypeIndex(idx);
+}
+
 const char* ExportType::name() const
 {
 	switch (value) {
@@ -154,12 +234,21 @@ const char* Bytecode::name() const {
 		case JumpTable: return "JumpTable";
 		case ReturnFew: return "ReturnFew";
 		case ReturnMany: return "ReturnMany";
+		case ReturnLeaf: return "ReturnLeaf";
 		case Call: return "Call";
 		case CallIndirect: return "CallIndirect";
 		case CallHost: return "CallHost";
+		case ReturnCall: return "ReturnCall";
+		case ReturnCallIndirect: return "ReturnCallIndirect";
+		case CallReference: return "CallReference";
+		case ReturnCallReference: return "ReturnCallReference";
+		case CallLeaf: return "CallLeaf";
 		case Entry: return "Entry";
+		case EntryLeaf: return "EntryLeaf";
+		case ConsumeFuel: return "ConsumeFuel";
 		case I32Drop: return "I32Drop";
 		case I64Drop: return "I64Drop";
+		case DropKeep: return "DropKeep";
 		case I32Select: return "I32Select";
 		case I64Select: return "I64Select";
 		case I32LocalGetFar: return "I32LocalGetFar";
@@ -186,6 +275,8 @@ const char* Bytecode::name() const {
 		case TableGrow: return "TableGrow";
 		case TableSize: return "TableSize";
 		case TableFill: return "TableFill";
+		case ReferenceAsNonNull: return "ReferenceAsNonNull";
+		case ReferenceTestNull: return "ReferenceTestNull";
 		case I32LoadNear: return "I32LoadNear";
 		case I64LoadNear: return "I64LoadNear";
 		case I32LoadFar: return "F32LoadFar";
@@ -351,6 +442,40 @@ const char* Bytecode::name() const {
 		case I64TruncateSaturateF32U: return "I64TruncateSaturateF32U";
 		case I64TruncateSaturateF64S: return "I64TruncateSaturateF64S";
 		case I64TruncateSaturateF64U: return "I64TruncateSaturateF64U";
+		case AtomicFence: return "AtomicFence";
+		case MemoryAtomicNotify: return "MemoryAtomicNotify";
+		case MemoryAtomicWait32: return "MemoryAtomicWait32";
+		case MemoryAtomicWait64: return "MemoryAtomicWait64";
+		case I32AtomicLoad: return "I32AtomicLoad";
+		case I64AtomicLoad: return "I64AtomicLoad";
+		case I32AtomicLoad8u: return "I32AtomicLoad8u";
+		case I32AtomicLoad16u: return "I32AtomicLoad16u";
+		case I64AtomicLoad8u: return "I64AtomicLoad8u";
+		case I64AtomicLoad16u: return "I64AtomicLoad16u";
+		case I64AtomicLoad32u: return "I64AtomicLoad32u";
+		case I32AtomicStore: return "I32AtomicStore";
+		case I64AtomicStore: return "I64AtomicStore";
+		case I32AtomicStore8: return "I32AtomicStore8";
+		case I32AtomicStore16: return "I32AtomicStore16";
+		case I64AtomicStore8: return "I64AtomicStore8";
+		case I64AtomicStore16: return "I64AtomicStore16";
+		case I64AtomicStore32: return "I64AtomicStore32";
+		case I32AtomicRmw: return "I32AtomicRmw";
+		case I64AtomicRmw: return "I64AtomicRmw";
+		case I32AtomicRmw8u: return "I32AtomicRmw8u";
+		case I32AtomicRmw16u: return "I32AtomicRmw16u";
+		case I64AtomicRmw8u: return "I64AtomicRmw8u";
+		case I64AtomicRmw16u: return "I64AtomicRmw16u";
+		case I64AtomicRmw32u: return "I64AtomicRmw32u";
+		case I32AtomicRmwCompareExchange: return "I32AtomicRmwCompareExchange";
+		case I64AtomicRmwCompareExchange: return "I64AtomicRmwCompareExchange";
+		case I32AtomicRmw8CompareExchangeU: return "I32AtomicRmw8CompareExchangeU";
+		case I32AtomicRmw16CompareExchangeU: return "I32AtomicRmw16CompareExchangeU";
+		case I64AtomicRmw8CompareExchangeU: return "I64AtomicRmw8CompareExchangeU";
+		case I64AtomicRmw16CompareExchangeU: return "I64AtomicRmw16CompareExchangeU";
+		case I64AtomicRmw32CompareExchangeU: return "I64AtomicRmw32CompareExchangeU";
+		case VectorInstruction: return "VectorInstruction";
+		case Memory64Instruction: return "Memory64Instruction";
 		default: return "<unknown byte code>";
 	}
 }
@@ -371,15 +496,24 @@ BytecodeArguments Bytecode::arguments() const
 	case JumpTable: return BA::SingleU32;
 	case ReturnFew: return BA::SingleU8;
 	case ReturnMany: return BA::SingleU32;
+	case ReturnLeaf: return BA::DualU32;
 	case Call: return BA::SingleU64SingleU32;
 	case CallIndirect: return BA::DualU32;
 	case CallHost: return BA::SingleU64;
+	case ReturnCall: return BA::SingleU64SingleU32;
+	case ReturnCallIndirect: return BA::DualU32;
+	case CallReference: return BA::None;
+	case ReturnCallReference: return BA::None;
+	case CallLeaf: return BA::SingleU64;
 	case Entry: return BA::DualU32;
+	case EntryLeaf: return BA::SingleU32;
+	case ConsumeFuel: return BA::SingleU32;
 	case I32Drop:
 	case I64Drop:
 	case I32Select:
 	case I64Select:
 		return BA::None;
+	case DropKeep: return BA::DualU32;
 	case I32LocalGetFar:
 	case I32LocalSetFar:
 	case I32LocalTeeFar:
@@ -409,6 +543,9 @@ BytecodeArguments Bytecode::arguments() const
 	case TableCopy:
 	case TableInit:
 		return BA::DualU32;
+	case ReferenceAsNonNull:
+	case ReferenceTestNull:
+		return BA::None;
 	case I32LoadNear:
 	case I64LoadNear:
 	case I32StoreNear:
@@ -579,6 +716,44 @@ BytecodeArguments Bytecode::arguments() const
 	case I64TruncateSaturateF64S:
 	case I64TruncateSaturateF64U:
 		return BA::None;
+	case AtomicFence:
+		return BA::None;
+	case MemoryAtomicNotify:
+	case MemoryAtomicWait32:
+	case MemoryAtomicWait64:
+	case I32AtomicLoad:
+	case I64AtomicLoad:
+	case I32AtomicLoad8u:
+	case I32AtomicLoad16u:
+	case I64AtomicLoad8u:
+	case I64AtomicLoad16u:
+	case I64AtomicLoad32u:
+	case I32AtomicStore:
+	case I64AtomicStore:
+	case I32AtomicStore8:
+	case I32AtomicStore16:
+	case I64AtomicStore8:
+	case I64AtomicStore16:
+	case I64AtomicStore32:
+	case I32AtomicRmwCompareExchange:
+	case I64AtomicRmwCompareExchange:
+	case I32AtomicRmw8CompareExchangeU:
+	case I32AtomicRmw16CompareExchangeU:
+	case I64AtomicRmw8CompareExchangeU:
+	case I64AtomicRmw16CompareExchangeU:
+	case I64AtomicRmw32CompareExchangeU:
+		return BA::SingleU32;
+	case VectorInstruction:
+	case Memory64Instruction:
+		return BA::SingleU8;
+	case I32AtomicRmw:
+	case I64AtomicRmw:
+	case I32AtomicRmw8u:
+	case I32AtomicRmw16u:
+	case I64AtomicRmw8u:
+	case I64AtomicRmw16u:
+	case I64AtomicRmw32u:
+		return BA::DualU32;
 	default: return BA::None;
 	}
 }
@@ -627,6 +802,307 @@ u32 BytecodeArguments::sizeInBytes() const
 	}
 }
 
+const char* VectorOperation::name() const
+{
+	switch (value) {
+		case V128Load: return "V128Load";
+		case V128Load8x8S: return "V128Load8x8S";
+		case V128Load8x8U: return "V128Load8x8U";
+		case V128Load16x4S: return "V128Load16x4S";
+		case V128Load16x4U: return "V128Load16x4U";
+		case V128Load32x2S: return "V128Load32x2S";
+		case V128Load32x2U: return "V128Load32x2U";
+		case V128Load8Splat: return "V128Load8Splat";
+		case V128Load16Splat: return "V128Load16Splat";
+		case V128Load32Splat: return "V128Load32Splat";
+		case V128Load64Splat: return "V128Load64Splat";
+		case V128Store: return "V128Store";
+		case V128Const: return "V128Const";
+		case I8x16Shuffle: return "I8x16Shuffle";
+		case I8x16Swizzle: return "I8x16Swizzle";
+		case I8x16Splat: return "I8x16Splat";
+		case I16x8Splat: return "I16x8Splat";
+		case I32x4Splat: return "I32x4Splat";
+		case I64x2Splat: return "I64x2Splat";
+		case F32x4Splat: return "F32x4Splat";
+		case F64x2Splat: return "F64x2Splat";
+		case I8x16ExtractLaneS: return "I8x16ExtractLaneS";
+		case I8x16ExtractLaneU: return "I8x16ExtractLaneU";
+		case I8x16ReplaceLane: return "I8x16ReplaceLane";
+		case I16x8ExtractLaneS: return "I16x8ExtractLaneS";
+		case I16x8ExtractLaneU: return "I16x8ExtractLaneU";
+		case I16x8ReplaceLane: return "I16x8ReplaceLane";
+		case I32x4ExtractLane: return "I32x4ExtractLane";
+		case I32x4ReplaceLane: return "I32x4ReplaceLane";
+		case I64x2ExtractLane: return "I64x2ExtractLane";
+		case I64x2ReplaceLane: return "I64x2ReplaceLane";
+		case F32x4ExtractLane: return "F32x4ExtractLane";
+		case F32x4ReplaceLane: return "F32x4ReplaceLane";
+		case F64x2ExtractLane: return "F64x2ExtractLane";
+		case F64x2ReplaceLane: return "F64x2ReplaceLane";
+		case I8x16Equal: return "I8x16Equal";
+		case I8x16NotEqual: return "I8x16NotEqual";
+		case I8x16LesserS: return "I8x16LesserS";
+		case I8x16LesserU: return "I8x16LesserU";
+		case I8x16GreaterS: return "I8x16GreaterS";
+		case I8x16GreaterU: return "I8x16GreaterU";
+		case I8x16LesserEqualS: return "I8x16LesserEqualS";
+		case I8x16LesserEqualU: return "I8x16LesserEqualU";
+		case I8x16GreaterEqualS: return "I8x16GreaterEqualS";
+		case I8x16GreaterEqualU: return "I8x16GreaterEqualU";
+		case I16x8Equal: return "I16x8Equal";
+		case I16x8NotEqual: return "I16x8NotEqual";
+		case I16x8LesserS: return "I16x8LesserS";
+		case I16x8LesserU: return "I16x8LesserU";
+		case I16x8GreaterS: return "I16x8GreaterS";
+		case I16x8GreaterU: return "I16x8GreaterU";
+		case I16x8LesserEqualS: return "I16x8LesserEqualS";
+		case I16x8LesserEqualU: return "I16x8LesserEqualU";
+		case I16x8GreaterEqualS: return "I16x8GreaterEqualS";
+		case I16x8GreaterEqualU: return "I16x8GreaterEqualU";
+		case I32x4Equal: return "I32x4Equal";
+		case I32x4NotEqual: return "I32x4NotEqual";
+		case I32x4LesserS: return "I32x4LesserS";
+		case I32x4LesserU: return "I32x4LesserU";
+		case I32x4GreaterS: return "I32x4GreaterS";
+		case I32x4GreaterU: return "I32x4GreaterU";
+		case I32x4LesserEqualS: return "I32x4LesserEqualS";
+		case I32x4LesserEqualU: return "I32x4LesserEqualU";
+		case I32x4GreaterEqualS: return "I32x4GreaterEqualS";
+		case I32x4GreaterEqualU: return "I32x4GreaterEqualU";
+		case F32x4Equal: return "F32x4Equal";
+		case F32x4NotEqual: return "F32x4NotEqual";
+		case F32x4Lesser: return "F32x4Lesser";
+		case F32x4Greater: return "F32x4Greater";
+		case F32x4LesserEqual: return "F32x4LesserEqual";
+		case F32x4GreaterEqual: return "F32x4GreaterEqual";
+		case F64x2Equal: return "F64x2Equal";
+		case F64x2NotEqual: return "F64x2NotEqual";
+		case F64x2Lesser: return "F64x2Lesser";
+		case F64x2Greater: return "F64x2Greater";
+		case F64x2LesserEqual: return "F64x2LesserEqual";
+		case F64x2GreaterEqual: return "F64x2GreaterEqual";
+		case V128Not: return "V128Not";
+		case V128And: return "V128And";
+		case V128AndNot: return "V128AndNot";
+		case V128Or: return "V128Or";
+		case V128Xor: return "V128Xor";
+		case V128BitSelect: return "V128BitSelect";
+		case V128AnyTrue: return "V128AnyTrue";
+		case V128Load8Lane: return "V128Load8Lane";
+		case V128Load16Lane: return "V128Load16Lane";
+		case V128Load32Lane: return "V128Load32Lane";
+		case V128Load64Lane: return "V128Load64Lane";
+		case V128Store8Lane: return "V128Store8Lane";
+		case V128Store16Lane: return "V128Store16Lane";
+		case V128Store32Lane: return "V128Store32Lane";
+		case V128Store64Lane: return "V128Store64Lane";
+		case V128Load32Zero: return "V128Load32Zero";
+		case V128Load64Zero: return "V128Load64Zero";
+		case F32x4DemoteF64x2Zero: return "F32x4DemoteF64x2Zero";
+		case F64x2PromoteLowF32x4: return "F64x2PromoteLowF32x4";
+		case I8x16Absolute: return "I8x16Absolute";
+		case I8x16Negate: return "I8x16Negate";
+		case I8x16CountOnes: return "I8x16CountOnes";
+		case I8x16AllTrue: return "I8x16AllTrue";
+		case I8x16Bitmask: return "I8x16Bitmask";
+		case I8x16NarrowI16x8S: return "I8x16NarrowI16x8S";
+		case I8x16NarrowI16x8U: return "I8x16NarrowI16x8U";
+		case F32x4Ceil: return "F32x4Ceil";
+		case F32x4Floor: return "F32x4Floor";
+		case F32x4Truncate: return "F32x4Truncate";
+		case F32x4Nearest: return "F32x4Nearest";
+		case I8x16ShiftLeft: return "I8x16ShiftLeft";
+		case I8x16ShiftRightS: return "I8x16ShiftRightS";
+		case I8x16ShiftRightU: return "I8x16ShiftRightU";
+		case I8x16Add: return "I8x16Add";
+		case I8x16AddSaturateS: return "I8x16AddSaturateS";
+		case I8x16AddSaturateU: return "I8x16AddSaturateU";
+		case I8x16Subtract: return "I8x16Subtract";
+		case I8x16SubtractSaturateS: return "I8x16SubtractSaturateS";
+		case I8x16SubtractSaturateU: return "I8x16SubtractSaturateU";
+		case F64x2Ceil: return "F64x2Ceil";
+		case F64x2Floor: return "F64x2Floor";
+		case I8x16MinimumS: return "I8x16MinimumS";
+		case I8x16MinimumU: return "I8x16MinimumU";
+		case I8x16MaximumS: return "I8x16MaximumS";
+		case I8x16MaximumU: return "I8x16MaximumU";
+		case F64x2Truncate: return "F64x2Truncate";
+		case I8x16AverageU: return "I8x16AverageU";
+		case I16x8ExtendAddPairwiseI8x16S: return "I16x8ExtendAddPairwiseI8x16S";
+		case I16x8ExtendAddPairwiseI8x16U: return "I16x8ExtendAddPairwiseI8x16U";
+		case I32x4ExtendAddPairwiseI16x8S: return "I32x4ExtendAddPairwiseI16x8S";
+		case I32x4ExtendAddPairwiseI16x8U: return "I32x4ExtendAddPairwiseI16x8U";
+		case I16x8Absolute: return "I16x8Absolute";
+		case I16x8Negate: return "I16x8Negate";
+		case I16x8Q15MultiplyRoundSaturateS: return "I16x8Q15MultiplyRoundSaturateS";
+		case I16x8AllTrue: return "I16x8AllTrue";
+		case I16x8Bitmask: return "I16x8Bitmask";
+		case I16x8NarrowI32x4S: return "I16x8NarrowI32x4S";
+		case I16x8NarrowI32x4U: return "I16x8NarrowI32x4U";
+		case I16x8ExtendLowI8x16S: return "I16x8ExtendLowI8x16S";
+		case I16x8ExtendHighI8x16S: return "I16x8ExtendHighI8x16S";
+		case I16x8ExtendLowI8x16U: return "I16x8ExtendLowI8x16U";
+		case I16x8ExtendHighI8x16U: return "I16x8ExtendHighI8x16U";
+		case I16x8ShiftLeft: return "I16x8ShiftLeft";
+		case I16x8ShiftRightS: return "I16x8ShiftRightS";
+		case I16x8ShiftRightU: return "I16x8ShiftRightU";
+		case I16x8Add: return "I16x8Add";
+		case I16x8AddSaturateS: return "I16x8AddSaturateS";
+		case I16x8AddSaturateU: return "I16x8AddSaturateU";
+		case I16x8Subtract: return "I16x8Subtract";
+		case I16x8SubtractSaturateS: return "I16x8SubtractSaturateS";
+		case I16x8SubtractSaturateU: return "I16x8SubtractSaturateU";
+		case F64x2Nearest: return "F64x2Nearest";
+		case I16x8Multiply: return "I16x8Multiply";
+		case I16x8MinimumS: return "I16x8MinimumS";
+		case I16x8MinimumU: return "I16x8MinimumU";
+		case I16x8MaximumS: return "I16x8MaximumS";
+		case I16x8MaximumU: return "I16x8MaximumU";
+		case I16x8AverageU: return "I16x8AverageU";
+		case I16x8ExtendMultiplyLowI8x16S: return "I16x8ExtendMultiplyLowI8x16S";
+		case I16x8ExtendMultiplyHighI8x16S: return "I16x8ExtendMultiplyHighI8x16S";
+		case I16x8ExtendMultiplyLowI8x16U: return "I16x8ExtendMultiplyLowI8x16U";
+		case I16x8ExtendMultiplyHighI8x16U: return "I16x8ExtendMultiplyHighI8x16U";
+		case I32x4Absolute: return "I32x4Absolute";
+		case I32x4Negate: return "I32x4Negate";
+		case I32x4AllTrue: return "I32x4AllTrue";
+		case I32x4Bitmask: return "I32x4Bitmask";
+		case I32x4ExtendLowI16x8S: return "I32x4ExtendLowI16x8S";
+		case I32x4ExtendHighI16x8S: return "I32x4ExtendHighI16x8S";
+		case I32x4ExtendLowI16x8U: return "I32x4ExtendLowI16x8U";
+		case I32x4ExtendHighI16x8U: return "I32x4ExtendHighI16x8U";
+		case I32x4ShiftLeft: return "I32x4ShiftLeft";
+		case I32x4ShiftRightS: return "I32x4ShiftRightS";
+		case I32x4ShiftRightU: return "I32x4ShiftRightU";
+		case I32x4Add: return "I32x4Add";
+		case I32x4Subtract: return "I32x4Subtract";
+		case I32x4Multiply: return "I32x4Multiply";
+		case I32x4MinimumS: return "I32x4MinimumS";
+		case I32x4MinimumU: return "I32x4MinimumU";
+		case I32x4MaximumS: return "I32x4MaximumS";
+		case I32x4MaximumU: return "I32x4MaximumU";
+		case I32x4DotI16x8S: return "I32x4DotI16x8S";
+		case I32x4ExtendMultiplyLowI16x8S: return "I32x4ExtendMultiplyLowI16x8S";
+		case I32x4ExtendMultiplyHighI16x8S: return "I32x4ExtendMultiplyHighI16x8S";
+		case I32x4ExtendMultiplyLowI16x8U: return "I32x4ExtendMultiplyLowI16x8U";
+		case I32x4ExtendMultiplyHighI16x8U: return "I32x4ExtendMultiplyHighI16x8U";
+		case I64x2Absolute: return "I64x2Absolute";
+		case I64x2Negate: return "I64x2Negate";
+		case I64x2AllTrue: return "I64x2AllTrue";
+		case I64x2Bitmask: return "I64x2Bitmask";
+		case I64x2ExtendLowI32x4S: return "I64x2ExtendLowI32x4S";
+		case I64x2ExtendHighI32x4S: return "I64x2ExtendHighI32x4S";
+		case I64x2ExtendLowI32x4U: return "I64x2ExtendLowI32x4U";
+		case I64x2ExtendHighI32x4U: return "I64x2ExtendHighI32x4U";
+		case I64x2ShiftLeft: return "I64x2ShiftLeft";
+		case I64x2ShiftRightS: return "I64x2ShiftRightS";
+		case I64x2ShiftRightU: return "I64x2ShiftRightU";
+		case I64x2Add: return "I64x2Add";
+		case I64x2Subtract: return "I64x2Subtract";
+		case I64x2Multiply: return "I64x2Multiply";
+		case I64x2Equal: return "I64x2Equal";
+		case I64x2NotEqual: return "I64x2NotEqual";
+		case I64x2LesserS: return "I64x2LesserS";
+		case I64x2GreaterS: return "I64x2GreaterS";
+		case I64x2LesserEqualS: return "I64x2LesserEqualS";
+		case I64x2GreaterEqualS: return "I64x2GreaterEqualS";
+		case I64x2ExtendMultiplyLowI32x4S: return "I64x2ExtendMultiplyLowI32x4S";
+		case I64x2ExtendMultiplyHighI32x4S: return "I64x2ExtendMultiplyHighI32x4S";
+		case I64x2ExtendMultiplyLowI32x4U: return "I64x2ExtendMultiplyLowI32x4U";
+		case I64x2ExtendMultiplyHighI32x4U: return "I64x2ExtendMultiplyHighI32x4U";
+		case F32x4Absolute: return "F32x4Absolute";
+		case F32x4Negate: return "F32x4Negate";
+		case F32x4SquareRoot: return "F32x4SquareRoot";
+		case F32x4Add: return "F32x4Add";
+		case F32x4Subtract: return "F32x4Subtract";
+		case F32x4Multiply: return "F32x4Multiply";
+		case F32x4Divide: return "F32x4Divide";
+		case F32x4Minimum: return "F32x4Minimum";
+		case F32x4Maximum: return "F32x4Maximum";
+		case F32x4PseudoMinimum: return "F32x4PseudoMinimum";
+		case F32x4PseudoMaximum: return "F32x4PseudoMaximum";
+		case F64x2Absolute: return "F64x2Absolute";
+		case F64x2Negate: return "F64x2Negate";
+		case F64x2SquareRoot: return "F64x2SquareRoot";
+		case F64x2Add: return "F64x2Add";
+		case F64x2Subtract: return "F64x2Subtract";
+		case F64x2Multiply: return "F64x2Multiply";
+		case F64x2Divide: return "F64x2Divide";
+		case F64x2Minimum: return "F64x2Minimum";
+		case F64x2Maximum: return "F64x2Maximum";
+		case F64x2PseudoMinimum: return "F64x2PseudoMinimum";
+		case F64x2PseudoMaximum: return "F64x2PseudoMaximum";
+		case I32x4TruncateSaturateF32x4S: return "I32x4TruncateSaturateF32x4S";
+		case I32x4TruncateSaturateF32x4U: return "I32x4TruncateSaturateF32x4U";
+		case F32x4ConvertI32x4S: return "F32x4ConvertI32x4S";
+		case F32x4ConvertI32x4U: return "F32x4ConvertI32x4U";
+		case I32x4TruncateSaturateF64x2SZero: return "I32x4TruncateSaturateF64x2SZero";
+		case I32x4TruncateSaturateF64x2UZero: return "I32x4TruncateSaturateF64x2UZero";
+		case F64x2ConvertLowI32x4S: return "F64x2ConvertLowI32x4S";
+		case F64x2ConvertLowI32x4U: return "F64x2ConvertLowI32x4U";
+		case LocalGet: return "LocalGet";
+		case LocalSet: return "LocalSet";
+		case LocalTee: return "LocalTee";
+		case Select: return "Select";
+		default: return "<unknown vector operation>";
+	}
+}
+
+u32 VectorOperation::operandSizeInBytes() const
+{
+	// Operands printed after the operation byte
+	switch (value) {
+	case V128Const:
+	case I8x16Shuffle:
+		return 16;
+	case V128Load8Lane:
+	case V128Load16Lane:
+	case V128Load32Lane:
+	case V128Load64Lane:
+	case V128Store8Lane:
+	case V128Store16Lane:
+	case V128Store32Lane:
+	case V128Store64Lane:
+		return 5; // Memory offset and lane index
+	case V128Load:
+	case V128Load8x8S:
+	case V128Load8x8U:
+	case V128Load16x4S:
+	case V128Load16x4U:
+	case V128Load32x2S:
+	case V128Load32x2U:
+	case V128Load8Splat:
+	case V128Load16Splat:
+	case V128Load32Splat:
+	case V128Load64Splat:
+	case V128Store:
+	case V128Load32Zero:
+	case V128Load64Zero:
+	case LocalGet:
+	case LocalSet:
+	case LocalTee:
+		return 4;
+	case I8x16ExtractLaneS:
+	case I8x16ExtractLaneU:
+	case I8x16ReplaceLane:
+	case I16x8ExtractLaneS:
+	case I16x8ExtractLaneU:
+	case I16x8ReplaceLane:
+	case I32x4ExtractLane:
+	case I32x4ReplaceLane:
+	case I64x2ExtractLane:
+	case I64x2ReplaceLane:
+	case F32x4ExtractLane:
+	case F32x4ReplaceLane:
+	case F64x2ExtractLane:
+	case F64x2ReplaceLane:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 const char* ImportType::name() const
 {
 	switch (value) {
@@ -646,3 +1122,27 @@ const char* WASM::DataItemMode::name() const
 		default: return "<unknown data item mode>";
 	}
 }
+
+const char* WASM::MemoryBoundsMode::name() const
+{
+	switch (value) {
+		case Checked: return "Checked";
+		case Strict: return "Strict";
+		case Unchecked: return "Unchecked";
+		default: return "<unknown memory bounds mode>";
+	}
+}
+
+const char* WASM::AtomicOperation::name() const
+{
+	switch (value) {
+		case Add: return "Add";
+		case Subtract: return "Subtract";
+		case And: return "And";
+		case Or: return "Or";
+		case Xor: return "Xor";
+		case Exchange: return "Exchange";
+		case CompareExchange: return "CompareExchange";
+		default: return "<unknown atomic operation>";
+	}
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cassert>
+
 #include "util.h"
 
 namespace WASM {
+	class BufferIterator;
+
 	template<typename TSpecial, typename TStorage= u32>
 	class Enum {
 	public:
@@ -49,7 +53,15 @@ namespace WASM {
 		const char* name() const;
 	};
 
-	class ValType : public Enum<ValType, u8> {
+	/*
+	* Val Type class
+	* Besides the kind of a value type, typed references also carry their
+	* nullability and the interpreter type index of their heap type. Comparing
+	* and switching over a ValType only looks at its kind, so that typed
+	* references behave like FuncRef and ExternRef unless they are explicitly
+	* checked for subtyping.
+	*/
+	class ValType : public Enum<ValType, u32> {
 	public:
 		enum TEnum {
 			I32 = 0x7F,
@@ -62,11 +74,23 @@ namespace WASM {
 			NumberOfItems = 0x80
 		};
 
-		using Enum<ValType, u8>::Enum;
-		constexpr ValType(TEnum e) : Enum<ValType, u8>{ e } {}
+		using Enum<ValType, u32>::Enum;
+		constexpr ValType(TEnum e) : Enum<ValType, u32>{ e } {}
 
 		// Requried for the local array in FunctionType
-		ValType() : Enum<ValType, u8>{ TEnum::I32 } {}
+		ValType() : Enum<ValType, u32>{ TEnum::I32 } {}
+
+		constexpr operator int() const { return value & KindMask; }
+
+		bool isNullable() const { return !(value & NonNullableFlag); }
+		bool isDefaultable() const { return isNullable(); }
+		bool hasTypeIndex() const { return value & TypeIndexFlag; }
+		u32 typeIndex() const { assert(hasTypeIndex()); return value >> TypeIndexShift; }
+		u32 encoded() const { return value; }
+
+		ValType asNonNullable() const { return ValType{ value | NonNullableFlag }; }
+		ValType withTypeIndex(u32) const;
+		bool isSubtypeOf(ValType) const;
 
 		bool isNumber() const;
 		bool isVector() const;
@@ -74,6 +98,12 @@ namespace WASM {
 		bool isValid() const;
 		const char* name() const;
 		u32 sizeInBytes() const;
+		u32 stackSizeInBytes(bool) const;
+
+		static ValType fromWASMBytes(BufferIterator&);
+		static ValType fromWASMHeapType(BufferIterator&, bool = true);
+		static ValType fromEncoded(u32 x) { return ValType{ x }; }
+		static ValType fromTypeIndex(u32, bool);
 
 		template<typename T>
 		static constexpr ValType fromType() {
@@ -86,6 +116,12 @@ namespace WASM {
 		template<> static constexpr ValType fromType<i64>() { return ValType::I64; }
 		template<> static constexpr ValType fromType<f32>() { return ValType::F32; }
 		template<> static constexpr ValType fromType<f64>() { return ValType::F64; }
+
+	private:
+		static constexpr u32 KindMask = 0xFF;
+		static constexpr u32 NonNullableFlag = 0x100;
+		static constexpr u32 TypeIndexFlag = 0x200;
+		static constexpr u32 TypeIndexShift = 10;
 	};
 
 	class ExportType : public Enum<ExportType> {
@@ -186,4 +222,51 @@ namespace WASM {
 
 		const char* name() const;
 	};
+
+	/*
+	* Memory Bounds Mode enum
+	* Selects how the interpreter checks linear memory accesses. Checked is
+	* the default, Strict additionally takes the access width and the full
+	* effective address into account and Unchecked skips all checks, which
+	* is only safe for trusted modules.
+	*/
+	class MemoryBoundsMode : public Enum<MemoryBoundsMode> {
+	public:
+		enum TEnum {
+			Checked,
+			Strict,
+			Unchecked,
+			NumberOfItems
+		};
+
+		using Enum<MemoryBoundsMode>::Enum;
+		MemoryBoundsMode(TEnum e) : Enum<MemoryBoundsMode>{ e } {}
+
+		const char* name() const;
+	};
+
+	/*
+	* AtomicOperation enum
+	* Operation performed by an atomic read-modify-write instruction. The
+	* bytecode only encodes the access width and takes the operation as an
+	* operand, as the bytecode space is too small for every combination.
+	*/
+	class AtomicOperation : public Enum<AtomicOperation> {
+	public:
+		enum TEnum {
+			Add,
+			Subtract,
+			And,
+			Or,
+			Xor,
+			Exchange,
+			CompareExchange,
+			NumberOfItems
+		};
+
+		using Enum<AtomicOperation>::Enum;
+		AtomicOperation(TEnum e) : Enum<AtomicOperation>{ e } {}
+
+		const char* name() const;
+	};
 }
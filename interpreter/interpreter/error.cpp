@@ -58,3 +58,8 @@ void WASM::LookupError::print(std::ostream& o) const
 
 	o << "Lookup error in module '" << moduleName << "' for item " << "'" << *itemName << "': " << message;
 }
+
+void WASM::InterruptError::print(std::ostream& o) const
+{
+	o << "Interrupted execution: " << message;
+}
@@ -85,6 +85,14 @@ namespace WASM {
 		std::string moduleName;
 		std::optional<std::string> itemName;
 	};
+
+	class InterruptError : public Error {
+	public:
+		InterruptError(std::string m)
+			: Error{ std::move(m) } {}
+
+		virtual void print(std::ostream& o) const override;
+	};
 }
 
 std::ostream& operator<<(std::ostream&, const WASM::Error&);
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "executor.h"
+
+using namespace WASM;
+
+// Worker that runs on the current thread, used to keep tasks submitted by
+// running tasks local to their worker
+static thread_local const Executor* currentExecutor{ nullptr };
+static thread_local u32 currentWorkerIndex{ 0 };
+
+void Executor::Metrics::print(std::ostream& out) const
+{
+	out << "Executor: " << submittedTasks << " submitted, " << completedTasks << " completed, "
+		<< failedTasks << " failed, " << stolenTasks << " stolen, " << yieldedSlices << " yielded slices" << std::endl;
+	out << "Throughput: " << tasksPerSecond << " tasks/s, queue latency " << averageQueueLatency.count()
+		<< "us average " << maxQueueLatency.count() << "us max" << std::endl;
+}
+
+Executor::Executor(u32 numWorkers, const std::function<void(Interpreter&)>& setup, std::chrono::microseconds slice)
+	: timeSlice{ slice }, startTime{ Clock::now() }
+{
+	if (!numWorkers) {
+		throw std::runtime_error{ "Executor requires at least one worker" };
+	}
+
+	if (timeSlice.count() <= 0) {
+		throw std::runtime_error{ "Executor time slice has to be positive" };
+	}
+
+	// Set up all interpreters before any thread is started, so that errors surface here
+	workers.reserve(numWorkers);
+	for (u32 i = 0; i != numWorkers; i++) {
+		auto worker = std::make_unique<Worker>();
+		worker->interpreter = std::make_unique<Interpreter>();
+		setup(*worker->interpreter);
+		worker->interpreter->enableInterrupts();
+		workers.emplace_back(std::move(worker));
+	}
+
+	for (u32 i = 0; i != numWorkers; i++) {
+		workers[i]->thread = std::jthread{ [this, i](std::stop_token stopToken) { runWorker(i, stopToken); } };
+	}
+
+	timerThread = std::jthread{ [this](std::stop_token stopToken) { runTimeSliceTimer(stopToken); } };
+}
+
+Executor::~Executor()
+{
+	// The workers have to be stopped before the shared state is destroyed. Running calls
+	// yield at their next safepoint and are dropped together with all queued tasks
+	timerThread = {};
+
+	for (auto& worker : workers) {
+		worker->thread.request_stop();
+		worker->interpreter->requestYield();
+	}
+
+	for (auto& worker : workers) {
+		worker->thread.join();
+	}
+}
+
+void Executor::submit(Task task)
+{
+	// Tasks submitted from a worker go to its own deque, other threads distribute them
+	u32 index = currentExecutor == this
+		? currentWorkerIndex
+		: nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+	{
+		std::scoped_lock lock{ idleMutex };
+		queuedTaskCount++;
+		unfinishedTaskCount++;
+	}
+
+	submittedTasks.fetch_add(1, std::memory_order_relaxed);
+
+	auto& worker = *workers[index];
+	{
+		std::scoped_lock lock{ worker.mutex };
+		worker.tasks.push_back({ std::move(task), Clock::now() });
+	}
+
+	idleCondition.notify_one();
+}
+
+void Executor::waitUntilIdle()
+{
+	if (currentExecutor == this) {
+		throw std::runtime_error{ "Cannot wait for the executor from one of its workers" };
+	}
+
+	std::unique_lock lock{ idleMutex };
+	finishedCondition.wait(lock, [&]() { return unfinishedTaskCount == 0; });
+}
+
+Executor::Metrics Executor::metrics() const
+{
+	Metrics metrics;
+	metrics.submittedTasks = submittedTasks.load(std::memory_order_relaxed);
+	metrics.completedTasks = completedTasks.load(std::memory_order_relaxed);
+	metrics.failedTasks = failedTasks.load(std::memory_order_relaxed);
+	metrics.stolenTasks = stolenTasks.load(std::memory_order_relaxed);
+	metrics.yieldedSlices = yieldedSlices.load(std::memory_order_relaxed);
+
+	auto elapsedSeconds = std::chrono::duration<double>{ Clock::now() - startTime }.count();
+	if (elapsedSeconds > 0.0) {
+		metrics.tasksPerSecond = (double)(metrics.completedTasks + metrics.failedTasks) / elapsedSeconds;
+	}
+
+	auto numStartedTasks = startedTasks.load(std::memory_order_relaxed);
+	if (numStartedTasks) {
+		metrics.averageQueueLatency = std::chrono::microseconds{ totalQueueLatency.load(std::memory_order_relaxed) / numStartedTasks };
+	}
+	metrics.maxQueueLatency = std::chrono::microseconds{ maxQueueLatency.load(std::memory_order_relaxed) };
+
+	return metrics;
+}
+
+void Executor::runWorker(u32 index, std::stop_token stopToken)
+{
+	currentExecutor = this;
+	currentWorkerIndex = index;
+
+	auto& worker = *workers[index];
+	bool preferYieldedTask = false;
+
+	while (!stopToken.stop_requested()) {
+		std::optional<QueuedTask> task;
+		std::optional<YieldedTask> yieldedTask;
+
+		// Alternate between resuming yielded calls and starting new tasks, so that
+		// neither can starve the other. New tasks are taken from the back of the deque
+		{
+			std::scoped_lock lock{ worker.mutex };
+			if (!worker.yieldedTasks.empty() && (preferYieldedTask || worker.tasks.empty())) {
+				yieldedTask.emplace(std::move(worker.yieldedTasks.front()));
+				worker.yieldedTasks.pop_front();
+			}
+			else if (!worker.tasks.empty()) {
+				task.emplace(std::move(worker.tasks.back()));
+				worker.tasks.pop_back();
+			}
+		}
+		preferYieldedTask = !preferYieldedTask;
+
+		if (yieldedTask.has_value()) {
+			resumeTask(worker, std::move(*yieldedTask));
+			continue;
+		}
+
+		if (!task.has_value()) {
+			task = stealTask(index);
+		}
+
+		if (task.has_value()) {
+			startTask(worker, std::move(*task));
+			continue;
+		}
+
+		std::unique_lock lock{ idleMutex };
+		idleCondition.wait(lock, stopToken, [&]() { return queuedTaskCount > 0; });
+	}
+}
+
+void Executor::runTimeSliceTimer(std::stop_token stopToken)
+{
+	// Check several times per slice, so that calls do not overrun it by much. A request
+	// that arrives just after a call finished makes the next call yield early instead
+	auto interval = std::max(timeSlice / 4, std::chrono::microseconds{ 100 });
+	while (!stopToken.stop_requested()) {
+		std::this_thread::sleep_for(interval);
+
+		auto now = Clock::now().time_since_epoch().count();
+		for (auto& worker : workers) {
+			auto sliceStartTime = worker->sliceStartTime.load(std::memory_order_relaxed);
+			if (sliceStartTime && Clock::duration{ now - sliceStartTime } >= timeSlice) {
+				worker->interpreter->requestYield();
+			}
+		}
+	}
+}
+
+std::optional<Executor::QueuedTask> Executor::stealTask(u32 thiefIndex)
+{
+	// Only tasks that were not started yet can be stolen, as suspended calls are bound
+	// to the interpreter of their worker. The oldest tasks are taken from the front
+	for (u32 i = 1; i < workers.size(); i++) {
+		auto& victim = *workers[(thiefIndex + i) % workers.size()];
+
+		std::scoped_lock lock{ victim.mutex };
+		if (!victim.tasks.empty()) {
+			QueuedTask task{ std::move(victim.tasks.front()) };
+			victim.tasks.pop_front();
+			stolenTasks.fetch_add(1, std::memory_order_relaxed);
+			return task;
+		}
+	}
+
+	return {};
+}
+
+void Executor::startTask(Worker& worker, QueuedTask queuedTask)
+{
+	{
+		std::scoped_lock lock{ idleMutex };
+		queuedTaskCount--;
+	}
+
+	u64 latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - queuedTask.submitTime).count();
+	startedTasks.fetch_add(1, std::memory_order_relaxed);
+	totalQueueLatency.fetch_add(latency, std::memory_order_relaxed);
+
+	auto currentMaxLatency = maxQueueLatency.load(std::memory_order_relaxed);
+	while (latency > currentMaxLatency && !maxQueueLatency.compare_exchange_weak(currentMaxLatency, latency, std::memory_order_relaxed)) {}
+
+	auto& task = queuedTask.task;
+	auto& interpreter = *worker.interpreter;
+	worker.sliceStartTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
+	std::optional<ResumableResult> result;
+	try {
+		auto handle = interpreter.functionByName(task.moduleName, task.functionName);
+		result.emplace(interpreter.executeResumableFunction(handle.mFunction, task.arguments));
+	}
+	catch (...) {
+		worker.sliceStartTime.store(0, std::memory_order_relaxed);
+		failTask(task, std::current_exception());
+		return;
+	}
+
+	finishTask(worker, task, std::move(*result));
+}
+
+void Executor::resumeTask(Worker& worker, YieldedTask yieldedTask)
+{
+	worker.sliceStartTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
+	std::optional<ResumableResult> result;
+	try {
+		result.emplace(worker.interpreter->resumeFunction(std::move(yieldedTask.call)));
+	}
+	catch (...) {
+		worker.sliceStartTime.store(0, std::memory_order_relaxed);
+		failTask(yieldedTask.task, std::current_exception());
+		return;
+	}
+
+	finishTask(worker, yieldedTask.task, std::move(*result));
+}
+
+void Executor::finishTask(Worker& worker, Task& task, ResumableResult result)
+{
+	worker.sliceStartTime.store(0, std::memory_order_relaxed);
+
+	// The values point into the stack of the interpreter and are only valid until the next call
+	if (auto values = std::get_if<ValuePack>(&result)) {
+		if (task.onResult) {
+			task.onResult(*values);
+		}
+
+		completedTasks.fetch_add(1, std::memory_order_relaxed);
+		countFinishedTask();
+		return;
+	}
+
+	auto& call = std::get<SuspendedCall>(result);
+	if (!call.hasYielded()) {
+		failTask(task, std::make_exception_ptr(std::runtime_error{ "Executor tasks cannot be suspended by host functions" }));
+		return;
+	}
+
+	yieldedSlices.fetch_add(1, std::memory_order_relaxed);
+
+	std::scoped_lock lock{ worker.mutex };
+	worker.yieldedTasks.push_back({ std::move(task), std::move(call) });
+}
+
+void Executor::failTask(Task& task, std::exception_ptr exception)
+{
+	if (task.onError) {
+		task.onError(exception);
+	}
+
+	failedTasks.fetch_add(1, std::memory_order_relaxed);
+	countFinishedTask();
+}
+
+void Executor::countFinishedTask()
+{
+	std::scoped_lock lock{ idleMutex };
+	if (!--unfinishedTaskCount) {
+		finishedCondition.notify_all();
+	}
+}
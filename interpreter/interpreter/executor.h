@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "interpreter.h"
+
+namespace WASM {
+	/*
+	* Executor class
+	* Runs large numbers of independent guest function calls on a fixed pool
+	* of worker threads. Each worker owns its own interpreter instance and a
+	* deque of tasks, which it works off from the back while idle workers
+	* steal tasks from the front. Calls that run longer than the time slice
+	* are asked to yield at their next safepoint and are resumed later by the
+	* same worker, as their stack is bound to its interpreter. Result values
+	* only live until the result callback returns, and callbacks must not
+	* throw.
+	*/
+	class Executor {
+	public:
+		struct Task {
+			std::string moduleName;
+			std::string functionName;
+			std::vector<Value> arguments;
+			std::function<void(const ValuePack&)> onResult;
+			std::function<void(std::exception_ptr)> onError;
+		};
+
+		struct Metrics {
+			u64 submittedTasks{ 0 };
+			u64 completedTasks{ 0 };
+			u64 failedTasks{ 0 };
+			u64 stolenTasks{ 0 };
+			u64 yieldedSlices{ 0 };
+			double tasksPerSecond{ 0.0 };
+			std::chrono::microseconds averageQueueLatency{ 0 };
+			std::chrono::microseconds maxQueueLatency{ 0 };
+
+			void print(std::ostream&) const;
+		};
+
+		Executor(u32, const std::function<void(Interpreter&)>&, std::chrono::microseconds = std::chrono::milliseconds{ 10 });
+		Executor(const Executor&) = delete;
+		Executor(Executor&&) = delete;
+		~Executor();
+
+		u32 workerCount() const { return (u32)workers.size(); }
+
+		void submit(Task);
+		void waitUntilIdle();
+		Metrics metrics() const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct QueuedTask {
+			Task task;
+			Clock::time_point submitTime;
+		};
+
+		struct YieldedTask {
+			Task task;
+			SuspendedCall call;
+		};
+
+		struct Worker {
+			std::unique_ptr<Interpreter> interpreter;
+			std::mutex mutex;
+			std::deque<QueuedTask> tasks;
+			std::deque<YieldedTask> yieldedTasks;
+			std::atomic<i64> sliceStartTime{ 0 };
+
+			// Declared last, so that the thread is stopped before anything else is destroyed
+			std::jthread thread;
+		};
+
+		void runWorker(u32, std::stop_token);
+		void runTimeSliceTimer(std::stop_token);
+		std::optional<QueuedTask> stealTask(u32);
+		void startTask(Worker&, QueuedTask);
+		void resumeTask(Worker&, YieldedTask);
+		void finishTask(Worker&, Task&, ResumableResult);
+		void failTask(Task&, std::exception_ptr);
+		void countFinishedTask();
+
+		std::chrono::microseconds timeSlice;
+		Clock::time_point startTime;
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<u32> nextWorker{ 0 };
+
+		std::mutex idleMutex;
+		std::condition_variable_any idleCondition;
+		std::condition_variable finishedCondition;
+		u64 queuedTaskCount{ 0 };
+		u64 unfinishedTaskCount{ 0 };
+
+		std::atomic<u64> submittedTasks{ 0 };
+		std::atomic<u64> completedTasks{ 0 };
+		std::atomic<u64> failedTasks{ 0 };
+		std::atomic<u64> stolenTasks{ 0 };
+		std::atomic<u64> yieldedSlices{ 0 };
+		std::atomic<u64> startedTasks{ 0 };
+		std::atomic<u64> totalQueueLatency{ 0 };
+		std::atomic<u64> maxQueueLatency{ 0 };
+
+		// Declared last, so that the thread is stopped before anything else is destroyed
+		std::jthread timerThread;
+	};
+}
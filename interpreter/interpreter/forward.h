@@ -4,6 +4,7 @@ namespace WASM {
 	class Buffer;
 	class BufferSlice;
 	class BufferIterator;
+	class Arena;
 
 	template<typename, int> struct TypedIndex;
 
@@ -51,7 +52,13 @@ namespace WASM {
 	class Value;
 	class ValuePack;
 	class FunctionHandle;
+	class SuspendedCall;
 	class Interpreter;
+	class SamplingProfiler;
+	class BytecodeCounter;
+	class ExecutionTracer;
+	class Executor;
+	class Reactor;
 
 	class Function;
 	class BytecodeFunction;
@@ -59,6 +66,7 @@ namespace WASM {
 	class LinkedElement;
 	class LinkedDataItem;
 	class Memory;
+	class SharedMemory;
 	class GlobalBase;
 	template<typename> class Global;
 	struct ResolvedGlobal;
@@ -83,6 +91,7 @@ namespace WASM {
 
 	class Bytecode;
 	class BytecodeArguments;
+	class VectorOperation;
 
 	class Introspector;
 	class DebugLogger;
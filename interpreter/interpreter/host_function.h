@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <tuple>
 
 #include "module.h"
@@ -7,6 +8,42 @@
 
 namespace WASM {
 
+	/*
+	* Host Result class
+	* Return type of host functions that can suspend the calling guest function
+	* instead of returning their result right away. The result is provided when
+	* the suspended call is resumed later on.
+	*/
+	template<typename T>
+	class HostResult {
+	public:
+		HostResult(T v) : mValue{ std::move(v) } {}
+
+		static HostResult pending() { return {}; }
+
+		bool isPending() const { return !mValue.has_value(); }
+		T& value() { return *mValue; }
+
+	private:
+		HostResult() = default;
+
+		std::optional<T> mValue;
+	};
+
+	template<>
+	class HostResult<void> {
+	public:
+		static HostResult ready() { return { false }; }
+		static HostResult pending() { return { true }; }
+
+		bool isPending() const { return mIsPending; }
+
+	private:
+		HostResult(bool p) : mIsPending{ p } {}
+
+		bool mIsPending;
+	};
+
 	class HostFunctionBase : public Function {
 	public:
 
@@ -19,8 +56,10 @@ namespace WASM {
 		void setLinkedFunctionType(InterpreterTypeIndex idx) { mInterpreterTypeIndex = idx; }
 		void print(std::ostream&) const;
 
-		virtual u32* executeFunction(u32*)= 0;
-		virtual u32* executeFunction(std::span<Value>, u32*) = 0;
+		// Return a null pointer if the function is pending. Aligned stacks put each
+		// parameter and result into full 8 byte slots.
+		virtual u32* executeFunction(u32*, bool)= 0;
+		virtual u32* executeFunction(std::span<Value>, u32*, bool) = 0;
 
 	protected:
 
@@ -38,16 +77,24 @@ namespace WASM {
 
 		HostFunction(HostFunction&&) = default;
 
-		virtual u32* executeFunction(u32* stackPointer) override {
-			return ParameterPopper<typename TTyper::Parameters>::popParametersAndCall(stackPointer, *this);
+		virtual u32* executeFunction(u32* stackPointer, bool alignedStack) override {
+			using Popper = ParameterPopper<typename TTyper::Parameters>;
+			if (alignedStack) {
+				return Popper::template popParametersAndCall<true>(stackPointer, *this);
+			}
+			return Popper::template popParametersAndCall<false>(stackPointer, *this);
 		}
 
-		virtual u32* executeFunction(std::span<Value> params, u32* stackPointer) override {
+		virtual u32* executeFunction(std::span<Value> params, u32* stackPointer, bool alignedStack) override {
 			if (params.size() < TTyper::Parameters::Size) {
 				throw std::runtime_error{"Parameter count mismatch for host function call"};
 			}
 
-			return ParameterReader<typename TTyper::Parameters>::readParametersAndCall(params, stackPointer, *this);
+			using Reader = ParameterReader<typename TTyper::Parameters>;
+			if (alignedStack) {
+				return Reader::template readParametersAndCall<true>(params, stackPointer, *this);
+			}
+			return Reader::template readParametersAndCall<false>(params, stackPointer, *this);
 		}
 
 	protected:
@@ -105,6 +152,9 @@ namespace WASM {
 			}
 		};
 
+		template<typename U>
+		struct ResultTypeBuilder<HostResult<U>> : ResultTypeBuilder<U> {};
+
 		template<typename>
 		struct ParameterTypeBuilder {};
 
@@ -118,62 +168,72 @@ namespace WASM {
 		// Stack handling infrastructure for popping/pushing call parameters/results
 
 		// Pop the parameters from the stack
-		template<typename ... Us, typename ...Vs>
+		template<bool AlignedStack, typename ... Us, typename ...Vs>
 		static u32* callAfterPoppingParameters(u32* stackPointer, HostFunction& self, Vs ... params) {
 			if constexpr (sizeof...(Us) == 0) {
-				return CallerAndResultPusher<typename TTyper::Result>::callAndPushResults(stackPointer, self, params...);
+				return CallerAndResultPusher<typename TTyper::Result>::template callAndPushResults<AlignedStack>(stackPointer, self, params...);
 			}
 			else {
-				return popNextParameter<Us...>(stackPointer, self, params...);
+				return popNextParameter<AlignedStack, Us...>(stackPointer, self, params...);
 			}
 		}
 
-		template<typename U, typename ... Us, typename ...Vs>
+		template<bool AlignedStack, typename U, typename ... Us, typename ...Vs>
 		static u32* popNextParameter(u32* stackPointer, HostFunction& self, Vs ... params) {
 			static_assert(sizeof(U) % 4 == 0, "Host function parameter size not divisible by 4");
-			stackPointer -= (sizeof(U) / 4);
+			stackPointer -= stackSlotsOf<U, AlignedStack>;
 			U param= (U) *reinterpret_cast<U*>(stackPointer);
-			return callAfterPoppingParameters<Us...>(stackPointer, self, params..., param);
+			return callAfterPoppingParameters<AlignedStack, Us...>(stackPointer, self, params..., param);
 		}
 
 		// Read the parameters from the parameters array
-		template<typename ... Us, typename ...Vs>
+		template<bool AlignedStack, typename ... Us, typename ...Vs>
 		static u32* callAfterReadingParameters(const std::span<Value>& paramArray, u32* stackPointer, HostFunction& self, Vs ... params) {
 			if constexpr (sizeof...(Us) == 0) {
-				return CallerAndResultPusher<typename TTyper::Result>::callAndPushResults(stackPointer, self, params...);
+				return CallerAndResultPusher<typename TTyper::Result>::template callAndPushResults<AlignedStack>(stackPointer, self, params...);
 			}
 			else {
-				return readNextParameter<Us...>(paramArray, stackPointer, self, params...);
+				return readNextParameter<AlignedStack, Us...>(paramArray, stackPointer, self, params...);
 			}
 		}
 
-		template<typename U, typename ... Us, typename ...Vs>
+		template<bool AlignedStack, typename U, typename ... Us, typename ...Vs>
 		static u32* readNextParameter(const std::span<Value>& paramArray, u32* stackPointer, HostFunction& self, Vs ... params) {
 			constexpr sizeType idx = sizeof...(params);
 			U param = paramArray[idx].as<U>();
-			return callAfterReadingParameters<Us...>(paramArray, stackPointer, self, params..., param);
+			return callAfterReadingParameters<AlignedStack, Us...>(paramArray, stackPointer, self, params..., param);
 		}
 
 		// Push the result to stack
-		template<typename U>
+		template<bool AlignedStack, typename U>
 		static u32* pushResult(u32* stackPointer, U val) {
 			*reinterpret_cast<U*>(stackPointer) = val;
 			static_assert(sizeof(U) % 4 == 0, "Host function return value size not divisible by 4");
-			stackPointer += (sizeof(U) / 4);
+			stackPointer += stackSlotsOf<U, AlignedStack>;
 			return stackPointer;
 		}
 
-		template<int Idx, typename U>
+		template<bool AlignedStack, int Idx, typename U>
 		static u32* pushResultTuple(u32* stackPointer, U& resultTuple) {
 			if constexpr (Idx >= std::tuple_size_v<U>) {
 				return stackPointer;
 			}
 			else {
-				stackPointer = pushResult(stackPointer, std::get<Idx>(resultTuple));
-				return pushResultTuple<Idx + 1>(stackPointer, resultTuple);
+				stackPointer = pushResult<AlignedStack>(stackPointer, std::get<Idx>(resultTuple));
+				return pushResultTuple<AlignedStack, Idx + 1>(stackPointer, resultTuple);
 			}
 		}
 
+		template<bool AlignedStack, typename U>
+		static u32* pushResultValue(u32* stackPointer, U& result) {
+			return pushResult<AlignedStack>(stackPointer, result);
+		}
+
+		template<bool AlignedStack, typename ...Us>
+		static u32* pushResultValue(u32* stackPointer, std::tuple<Us...>& result) {
+			return pushResultTuple<AlignedStack, 0>(stackPointer, result);
+		}
+
 		// Pop paramters from the stack depending on the function's 
 		// paramter types and do the function call
 		template<typename>
@@ -181,8 +241,9 @@ namespace WASM {
 
 		template<typename ...Us>
 		struct ParameterPopper<Detail::ParameterPack<Us...>> {
+			template<bool AlignedStack>
 			static u32* popParametersAndCall(u32* stackPointer, HostFunction& self) {
-				return callAfterPoppingParameters<Us...>(stackPointer, self);
+				return callAfterPoppingParameters<AlignedStack, Us...>(stackPointer, self);
 			}
 		};
 
@@ -193,24 +254,25 @@ namespace WASM {
 
 		template<typename ...Us>
 		struct ParameterReader<Detail::ParameterPack<Us...>> {
+			template<bool AlignedStack>
 			static u32* readParametersAndCall(const std::span<Value>& paramArray, u32* stackPointer, HostFunction& self) {
-				return callAfterReadingParameters<Us...>(paramArray, stackPointer, self);
+				return callAfterReadingParameters<AlignedStack, Us...>(paramArray, stackPointer, self);
 			}
 		};
 
 		// Push the return value to the stack depending on the function's return type
 		template<typename U>
 		struct CallerAndResultPusher {
-			template<typename ...Vs>
+			template<bool AlignedStack, typename ...Vs>
 			static u32* callAndPushResults(u32* stackPointer, HostFunction& self, Vs... params) {
 				auto result = self.function(params...);
-				return pushResult(stackPointer, result);
+				return pushResult<AlignedStack>(stackPointer, result);
 			}
 		};
 
 		template<>
 		struct CallerAndResultPusher<void> {
-			template<typename ...Vs>
+			template<bool AlignedStack, typename ...Vs>
 			static u32* callAndPushResults(u32* stackPointer, HostFunction& self, Vs... params) {
 				self.function(params...);
 				return stackPointer;
@@ -219,10 +281,29 @@ namespace WASM {
 
 		template<typename ...Us>
 		struct CallerAndResultPusher<std::tuple<Us...>> {
-			template<typename ...Vs>
+			template<bool AlignedStack, typename ...Vs>
+			static u32* callAndPushResults(u32* stackPointer, HostFunction& self, Vs... params) {
+				auto result = self.function(params...);
+				return pushResultTuple<AlignedStack, 0>(stackPointer, result);
+			}
+		};
+
+		// Pending results are signaled with a null pointer instead of a stack pointer
+		template<typename U>
+		struct CallerAndResultPusher<HostResult<U>> {
+			template<bool AlignedStack, typename ...Vs>
 			static u32* callAndPushResults(u32* stackPointer, HostFunction& self, Vs... params) {
 				auto result = self.function(params...);
-				return pushResultTuple<sizeof...(Us)>(stackPointer, result);
+				if (result.isPending()) {
+					return nullptr;
+				}
+
+				if constexpr (std::is_void_v<U>) {
+					return stackPointer;
+				}
+				else {
+					return pushResultValue<AlignedStack>(stackPointer, result.value());
+				}
 			}
 		};
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -11,6 +12,9 @@ namespace WASM {
 	public:
 		HostMemory(u32 min) : MemoryType{ Limits{min} } {}
 		HostMemory(u32 min, u32 max) : MemoryType{ Limits{min, max} } {}
+		HostMemory(std::shared_ptr<SharedMemory> m) : MemoryType{ m->limits() }, mSharedMemory{ std::move(m) } {}
+
+		auto& sharedMemory() const { return mSharedMemory; }
 
 		template<typename T>
 		std::span<T> memoryView() {
@@ -24,6 +28,7 @@ namespace WASM {
 		void setLinkedInstance(Memory& m) { mLinkedInstance = m; }
 
 		Nullable<Memory> mLinkedInstance;
+		std::shared_ptr<SharedMemory> mSharedMemory;
 	};
 
 	class HostGlobal final : public DeclaredGlobalBase {
@@ -63,6 +68,7 @@ namespace WASM {
 
 		HostModuleBuilder& defineGlobal(std::string name, ValType type, u64 initValue= 0, bool isMutable= true);
 		HostModuleBuilder& defineMemory(std::string name, u32 minSize, std::optional<u32> maxSize = {});
+		HostModuleBuilder& defineSharedMemory(std::string name, std::shared_ptr<SharedMemory>);
 
 		HostModule toModule(Interpreter&);
 
@@ -1,6 +1,8 @@
 #include <stdexcept>
 #include <cassert>
 #include <ostream>
+#include <array>
+#include <algorithm>
 
 #include "module.h"
 #include "bytecode.h"
@@ -12,224 +14,597 @@ static constexpr bool isPowerOfTwo(u64 x) {
 	return (x & (x - 1)) == 0;
 }
 
+/*
+* Opcode lookup tables
+* Map the opcode byte of an instruction to its type. Bytes that are
+* no valid opcode or that prefix a secondary opcode are marked with
+* special values outside of the range of instruction types.
+*
+* https://webassembly.github.io/spec/core/binary/instructions.html
+*/
+static constexpr u32 InvalidOpcode = InstructionType::NumberOfItems;
+static constexpr u32 SecondaryOpcodePrefix = InstructionType::NumberOfItems + 1;
+static constexpr u32 VectorOpcodePrefix = InstructionType::NumberOfItems + 2;
+static constexpr u32 AtomicOpcodePrefix = InstructionType::NumberOfItems + 3;
+static_assert(AtomicOpcodePrefix <= 0xFFFF);
+
+static constexpr auto primaryOpcodeTable = []() {
+	using IT = InstructionType;
+	std::array<u16, 256> table{};
+	table.fill(InvalidOpcode);
+
+	table[0x00] = IT::Unreachable;
+	table[0x01] = IT::NoOperation;
+	table[0x02] = IT::Block;
+	table[0x03] = IT::Loop;
+	table[0x04] = IT::If;
+	table[0x05] = IT::Else;
+	table[0x0B] = IT::End;
+	table[0x0C] = IT::Branch;
+	table[0x0D] = IT::BranchIf;
+	table[0x0E] = IT::BranchTable;
+	table[0x0F] = IT::Return;
+	table[0x10] = IT::Call;
+	table[0x11] = IT::CallIndirect;
+	table[0x12] = IT::ReturnCall;
+	table[0x13] = IT::ReturnCallIndirect;
+	table[0x14] = IT::CallReference;
+	table[0x15] = IT::ReturnCallReference;
+	table[0x1A] = IT::Drop;
+	table[0x1B] = IT::Select;
+	table[0x1C] = IT::SelectFrom;
+	table[0x20] = IT::LocalGet;
+	table[0x21] = IT::LocalSet;
+	table[0x22] = IT::LocalTee;
+	table[0x23] = IT::GlobalGet;
+	table[0x24] = IT::GlobalSet;
+	table[0x25] = IT::TableGet;
+	table[0x26] = IT::TableSet;
+	table[0x28] = IT::I32Load;
+	table[0x29] = IT::I64Load;
+	table[0x2A] = IT::F32Load;
+	table[0x2B] = IT::F64Load;
+	table[0x2C] = IT::I32Load8s;
+	table[0x2D] = IT::I32Load8u;
+	table[0x2E] = IT::I32Load16s;
+	table[0x2F] = IT::I32Load16u;
+	table[0x30] = IT::I64Load8s;
+	table[0x31] = IT::I64Load8u;
+	table[0x32] = IT::I64Load16s;
+	table[0x33] = IT::I64Load16u;
+	table[0x34] = IT::I64Load32s;
+	table[0x35] = IT::I64Load32u;
+	table[0x36] = IT::I32Store;
+	table[0x37] = IT::I64Store;
+	table[0x38] = IT::F32Store;
+	table[0x39] = IT::F64Store;
+	table[0x3A] = IT::I32Store8;
+	table[0x3B] = IT::I32Store16;
+	table[0x3C] = IT::I64Store8;
+	table[0x3D] = IT::I64Store16;
+	table[0x3E] = IT::I64Store32;
+	table[0x3F] = IT::MemorySize;
+	table[0x40] = IT::MemoryGrow;
+	table[0x41] = IT::I32Const;
+	table[0x42] = IT::I64Const;
+	table[0x43] = IT::F32Const;
+	table[0x44] = IT::F64Const;
+	table[0x45] = IT::I32EqualZero;
+	table[0x46] = IT::I32Equal;
+	table[0x47] = IT::I32NotEqual;
+	table[0x48] = IT::I32LesserS;
+	table[0x49] = IT::I32LesserU;
+	table[0x4A] = IT::I32GreaterS;
+	table[0x4B] = IT::I32GreaterU;
+	table[0x4C] = IT::I32LesserEqualS;
+	table[0x4D] = IT::I32LesserEqualU;
+	table[0x4E] = IT::I32GreaterEqualS;
+	table[0x4F] = IT::I32GreaterEqualU;
+	table[0x50] = IT::I64EqualZero;
+	table[0x51] = IT::I64Equal;
+	table[0x52] = IT::I64NotEqual;
+	table[0x53] = IT::I64LesserS;
+	table[0x54] = IT::I64LesserU;
+	table[0x55] = IT::I64GreaterS;
+	table[0x56] = IT::I64GreaterU;
+	table[0x57] = IT::I64LesserEqualS;
+	table[0x58] = IT::I64LesserEqualU;
+	table[0x59] = IT::I64GreaterEqualS;
+	table[0x5A] = IT::I64GreaterEqualU;
+	table[0x5B] = IT::F32Equal;
+	table[0x5C] = IT::F32NotEqual;
+	table[0x5D] = IT::F32Lesser;
+	table[0x5E] = IT::F32Greater;
+	table[0x5F] = IT::F32LesserEqual;
+	table[0x60] = IT::F32GreaterEqual;
+	table[0x61] = IT::F64Equal;
+	table[0x62] = IT::F64NotEqual;
+	table[0x63] = IT::F64Lesser;
+	table[0x64] = IT::F64Greater;
+	table[0x65] = IT::F64LesserEqual;
+	table[0x66] = IT::F64GreaterEqual;
+	table[0x67] = IT::I32CountLeadingZeros;
+	table[0x68] = IT::I32CountTrailingZeros;
+	table[0x69] = IT::I32CountOnes;
+	table[0x6A] = IT::I32Add;
+	table[0x6B] = IT::I32Subtract;
+	table[0x6C] = IT::I32Multiply;
+	table[0x6D] = IT::I32DivideS;
+	table[0x6E] = IT::I32DivideU;
+	table[0x6F] = IT::I32RemainderS;
+	table[0x70] = IT::I32RemainderU;
+	table[0x71] = IT::I32And;
+	table[0x72] = IT::I32Or;
+	table[0x73] = IT::I32Xor;
+	table[0x74] = IT::I32ShiftLeft;
+	table[0x75] = IT::I32ShiftRightS;
+	table[0x76] = IT::I32ShiftRightU;
+	table[0x77] = IT::I32RotateLeft;
+	table[0x78] = IT::I32RotateRight;
+	table[0x79] = IT::I64CountLeadingZeros;
+	table[0x7A] = IT::I64CountTrailingZeros;
+	table[0x7B] = IT::I64CountOnes;
+	table[0x7C] = IT::I64Add;
+	table[0x7D] = IT::I64Subtract;
+	table[0x7E] = IT::I64Multiply;
+	table[0x7F] = IT::I64DivideS;
+	table[0x80] = IT::I64DivideU;
+	table[0x81] = IT::I64RemainderS;
+	table[0x82] = IT::I64RemainderU;
+	table[0x83] = IT::I64And;
+	table[0x84] = IT::I64Or;
+	table[0x85] = IT::I64Xor;
+	table[0x86] = IT::I64ShiftLeft;
+	table[0x87] = IT::I64ShiftRightS;
+	table[0x88] = IT::I64ShiftRightU;
+	table[0x89] = IT::I64RotateLeft;
+	table[0x8A] = IT::I64RotateRight;
+	table[0x8B] = IT::F32Absolute;
+	table[0x8C] = IT::F32Negate;
+	table[0x8D] = IT::F32Ceil;
+	table[0x8E] = IT::F32Floor;
+	table[0x8F] = IT::F32Truncate;
+	table[0x90] = IT::F32Nearest;
+	table[0x91] = IT::F32SquareRoot;
+	table[0x92] = IT::F32Add;
+	table[0x93] = IT::F32Subtract;
+	table[0x94] = IT::F32Multiply;
+	table[0x95] = IT::F32Divide;
+	table[0x96] = IT::F32Minimum;
+	table[0x97] = IT::F32Maximum;
+	table[0x98] = IT::F32CopySign;
+	table[0x99] = IT::F64Absolute;
+	table[0x9A] = IT::F64Negate;
+	table[0x9B] = IT::F64Ceil;
+	table[0x9C] = IT::F64Floor;
+	table[0x9D] = IT::F64Truncate;
+	table[0x9E] = IT::F64Nearest;
+	table[0x9F] = IT::F64SquareRoot;
+	table[0xA0] = IT::F64Add;
+	table[0xA1] = IT::F64Subtract;
+	table[0xA2] = IT::F64Multiply;
+	table[0xA3] = IT::F64Divide;
+	table[0xA4] = IT::F64Minimum;
+	table[0xA5] = IT::F64Maximum;
+	table[0xA6] = IT::F64CopySign;
+	table[0xA7] = IT::I32WrapI64;
+	table[0xA8] = IT::I32TruncateF32S;
+	table[0xA9] = IT::I32TruncateF32U;
+	table[0xAA] = IT::I32TruncateF64S;
+	table[0xAB] = IT::I32TruncateF64U;
+	table[0xAC] = IT::I64ExtendI32S;
+	table[0xAD] = IT::I64ExtendI32U;
+	table[0xAE] = IT::I64TruncateF32S;
+	table[0xAF] = IT::I64TruncateF32U;
+	table[0xB0] = IT::I64TruncateF64S;
+	table[0xB1] = IT::I64TruncateF64U;
+	table[0xB2] = IT::F32ConvertI32S;
+	table[0xB3] = IT::F32ConvertI32U;
+	table[0xB4] = IT::F32ConvertI64S;
+	table[0xB5] = IT::F32ConvertI64U;
+	table[0xB6] = IT::F32DemoteF64;
+	table[0xB7] = IT::F64ConvertI32S;
+	table[0xB8] = IT::F64ConvertI32U;
+	table[0xB9] = IT::F64ConvertI64S;
+	table[0xBA] = IT::F64ConvertI64U;
+	table[0xBB] = IT::F64PromoteF32;
+	table[0xBC] = IT::I32ReinterpretF32;
+	table[0xBD] = IT::I64ReinterpretF64;
+	table[0xBE] = IT::F32ReinterpretI32;
+	table[0xBF] = IT::F64ReinterpretI64;
+	table[0xC0] = IT::I32Extend8s;
+	table[0xC1] = IT::I32Extend16s;
+	table[0xC2] = IT::I64Extend8s;
+	table[0xC3] = IT::I64Extend16s;
+	table[0xC4] = IT::I64Extend32s;
+	table[0xD0] = IT::ReferenceNull;
+	table[0xD1] = IT::ReferenceIsNull;
+	table[0xD2] = IT::ReferenceFunction;
+	table[0xD4] = IT::ReferenceAsNonNull;
+	table[0xD5] = IT::BranchOnNull;
+	table[0xD6] = IT::BranchOnNonNull;
+	table[0xFC] = SecondaryOpcodePrefix;
+	table[0xFD] = VectorOpcodePrefix;
+	table[0xFE] = AtomicOpcodePrefix;
+	return table;
+}();
+
+static constexpr std::array<u16, 18> secondaryOpcodeTable{
+	InstructionType::I32TruncateSaturateF32S,
+	InstructionType::I32TruncateSaturateF32U,
+	InstructionType::I32TruncateSaturateF64S,
+	InstructionType::I32TruncateSaturateF64U,
+	InstructionType::I64TruncateSaturateF32S,
+	InstructionType::I64TruncateSaturateF32U,
+	InstructionType::I64TruncateSaturateF64S,
+	InstructionType::I64TruncateSaturateF64U,
+	InstructionType::MemoryInit,
+	InstructionType::DataDrop,
+	InstructionType::MemoryCopy,
+	InstructionType::MemoryFill,
+	InstructionType::TableInit,
+	InstructionType::ElementDrop,
+	InstructionType::TableCopy,
+	InstructionType::TableGrow,
+	InstructionType::TableSize,
+	InstructionType::TableFill,
+};
+
+// Opcodes of the fixed-width SIMD proposal
+// https://github.com/WebAssembly/simd/blob/main/proposals/simd/BinarySIMD.md
+static constexpr std::array<u16, 0x100> vectorOpcodeTable = []() {
+	using IT = InstructionType;
+	std::array<u16, 0x100> table{};
+	table.fill(InvalidOpcode);
+
+	table[0x00] = IT::V128Load;
+	table[0x01] = IT::V128Load8x8S;
+	table[0x02] = IT::V128Load8x8U;
+	table[0x03] = IT::V128Load16x4S;
+	table[0x04] = IT::V128Load16x4U;
+	table[0x05] = IT::V128Load32x2S;
+	table[0x06] = IT::V128Load32x2U;
+	table[0x07] = IT::V128Load8Splat;
+	table[0x08] = IT::V128Load16Splat;
+	table[0x09] = IT::V128Load32Splat;
+	table[0x0A] = IT::V128Load64Splat;
+	table[0x0B] = IT::V128Store;
+	table[0x0C] = IT::V128Const;
+	table[0x0D] = IT::I8x16Shuffle;
+	table[0x0E] = IT::I8x16Swizzle;
+	table[0x0F] = IT::I8x16Splat;
+	table[0x10] = IT::I16x8Splat;
+	table[0x11] = IT::I32x4Splat;
+	table[0x12] = IT::I64x2Splat;
+	table[0x13] = IT::F32x4Splat;
+	table[0x14] = IT::F64x2Splat;
+	table[0x15] = IT::I8x16ExtractLaneS;
+	table[0x16] = IT::I8x16ExtractLaneU;
+	table[0x17] = IT::I8x16ReplaceLane;
+	table[0x18] = IT::I16x8ExtractLaneS;
+	table[0x19] = IT::I16x8ExtractLaneU;
+	table[0x1A] = IT::I16x8ReplaceLane;
+	table[0x1B] = IT::I32x4ExtractLane;
+	table[0x1C] = IT::I32x4ReplaceLane;
+	table[0x1D] = IT::I64x2ExtractLane;
+	table[0x1E] = IT::I64x2ReplaceLane;
+	table[0x1F] = IT::F32x4ExtractLane;
+	table[0x20] = IT::F32x4ReplaceLane;
+	table[0x21] = IT::F64x2ExtractLane;
+	table[0x22] = IT::F64x2ReplaceLane;
+	table[0x23] = IT::I8x16Equal;
+	table[0x24] = IT::I8x16NotEqual;
+	table[0x25] = IT::I8x16LesserS;
+	table[0x26] = IT::I8x16LesserU;
+	table[0x27] = IT::I8x16GreaterS;
+	table[0x28] = IT::I8x16GreaterU;
+	table[0x29] = IT::I8x16LesserEqualS;
+	table[0x2A] = IT::I8x16LesserEqualU;
+	table[0x2B] = IT::I8x16GreaterEqualS;
+	table[0x2C] = IT::I8x16GreaterEqualU;
+	table[0x2D] = IT::I16x8Equal;
+	table[0x2E] = IT::I16x8NotEqual;
+	table[0x2F] = IT::I16x8LesserS;
+	table[0x30] = IT::I16x8LesserU;
+	table[0x31] = IT::I16x8GreaterS;
+	table[0x32] = IT::I16x8GreaterU;
+	table[0x33] = IT::I16x8LesserEqualS;
+	table[0x34] = IT::I16x8LesserEqualU;
+	table[0x35] = IT::I16x8GreaterEqualS;
+	table[0x36] = IT::I16x8GreaterEqualU;
+	table[0x37] = IT::I32x4Equal;
+	table[0x38] = IT::I32x4NotEqual;
+	table[0x39] = IT::I32x4LesserS;
+	table[0x3A] = IT::I32x4LesserU;
+	table[0x3B] = IT::I32x4GreaterS;
+	table[0x3C] = IT::I32x4GreaterU;
+	table[0x3D] = IT::I32x4LesserEqualS;
+	table[0x3E] = IT::I32x4LesserEqualU;
+	table[0x3F] = IT::I32x4GreaterEqualS;
+	table[0x40] = IT::I32x4GreaterEqualU;
+	table[0x41] = IT::F32x4Equal;
+	table[0x42] = IT::F32x4NotEqual;
+	table[0x43] = IT::F32x4Lesser;
+	table[0x44] = IT::F32x4Greater;
+	table[0x45] = IT::F32x4LesserEqual;
+	table[0x46] = IT::F32x4GreaterEqual;
+	table[0x47] = IT::F64x2Equal;
+	table[0x48] = IT::F64x2NotEqual;
+	table[0x49] = IT::F64x2Lesser;
+	table[0x4A] = IT::F64x2Greater;
+	table[0x4B] = IT::F64x2LesserEqual;
+	table[0x4C] = IT::F64x2GreaterEqual;
+	table[0x4D] = IT::V128Not;
+	table[0x4E] = IT::V128And;
+	table[0x4F] = IT::V128AndNot;
+	table[0x50] = IT::V128Or;
+	table[0x51] = IT::V128Xor;
+	table[0x52] = IT::V128BitSelect;
+	table[0x53] = IT::V128AnyTrue;
+	table[0x54] = IT::V128Load8Lane;
+	table[0x55] = IT::V128Load16Lane;
+	table[0x56] = IT::V128Load32Lane;
+	table[0x57] = IT::V128Load64Lane;
+	table[0x58] = IT::V128Store8Lane;
+	table[0x59] = IT::V128Store16Lane;
+	table[0x5A] = IT::V128Store32Lane;
+	table[0x5B] = IT::V128Store64Lane;
+	table[0x5C] = IT::V128Load32Zero;
+	table[0x5D] = IT::V128Load64Zero;
+	table[0x5E] = IT::F32x4DemoteF64x2Zero;
+	table[0x5F] = IT::F64x2PromoteLowF32x4;
+	table[0x60] = IT::I8x16Absolute;
+	table[0x61] = IT::I8x16Negate;
+	table[0x62] = IT::I8x16CountOnes;
+	table[0x63] = IT::I8x16AllTrue;
+	table[0x64] = IT::I8x16Bitmask;
+	table[0x65] = IT::I8x16NarrowI16x8S;
+	table[0x66] = IT::I8x16NarrowI16x8U;
+	table[0x67] = IT::F32x4Ceil;
+	table[0x68] = IT::F32x4Floor;
+	table[0x69] = IT::F32x4Truncate;
+	table[0x6A] = IT::F32x4Nearest;
+	table[0x6B] = IT::I8x16ShiftLeft;
+	table[0x6C] = IT::I8x16ShiftRightS;
+	table[0x6D] = IT::I8x16ShiftRightU;
+	table[0x6E] = IT::I8x16Add;
+	table[0x6F] = IT::I8x16AddSaturateS;
+	table[0x70] = IT::I8x16AddSaturateU;
+	table[0x71] = IT::I8x16Subtract;
+	table[0x72] = IT::I8x16SubtractSaturateS;
+	table[0x73] = IT::I8x16SubtractSaturateU;
+	table[0x74] = IT::F64x2Ceil;
+	table[0x75] = IT::F64x2Floor;
+	table[0x76] = IT::I8x16MinimumS;
+	table[0x77] = IT::I8x16MinimumU;
+	table[0x78] = IT::I8x16MaximumS;
+	table[0x79] = IT::I8x16MaximumU;
+	table[0x7A] = IT::F64x2Truncate;
+	table[0x7B] = IT::I8x16AverageU;
+	table[0x7C] = IT::I16x8ExtendAddPairwiseI8x16S;
+	table[0x7D] = IT::I16x8ExtendAddPairwiseI8x16U;
+	table[0x7E] = IT::I32x4ExtendAddPairwiseI16x8S;
+	table[0x7F] = IT::I32x4ExtendAddPairwiseI16x8U;
+	table[0x80] = IT::I16x8Absolute;
+	table[0x81] = IT::I16x8Negate;
+	table[0x82] = IT::I16x8Q15MultiplyRoundSaturateS;
+	table[0x83] = IT::I16x8AllTrue;
+	table[0x84] = IT::I16x8Bitmask;
+	table[0x85] = IT::I16x8NarrowI32x4S;
+	table[0x86] = IT::I16x8NarrowI32x4U;
+	table[0x87] = IT::I16x8ExtendLowI8x16S;
+	table[0x88] = IT::I16x8ExtendHighI8x16S;
+	table[0x89] = IT::I16x8ExtendLowI8x16U;
+	table[0x8A] = IT::I16x8ExtendHighI8x16U;
+	table[0x8B] = IT::I16x8ShiftLeft;
+	table[0x8C] = IT::I16x8ShiftRightS;
+	table[0x8D] = IT::I16x8ShiftRightU;
+	table[0x8E] = IT::I16x8Add;
+	table[0x8F] = IT::I16x8AddSaturateS;
+	table[0x90] = IT::I16x8AddSaturateU;
+	table[0x91] = IT::I16x8Subtract;
+	table[0x92] = IT::I16x8SubtractSaturateS;
+	table[0x93] = IT::I16x8SubtractSaturateU;
+	table[0x94] = IT::F64x2Nearest;
+	table[0x95] = IT::I16x8Multiply;
+	table[0x96] = IT::I16x8MinimumS;
+	table[0x97] = IT::I16x8MinimumU;
+	table[0x98] = IT::I16x8MaximumS;
+	table[0x99] = IT::I16x8MaximumU;
+	table[0x9B] = IT::I16x8AverageU;
+	table[0x9C] = IT::I16x8ExtendMultiplyLowI8x16S;
+	table[0x9D] = IT::I16x8ExtendMultiplyHighI8x16S;
+	table[0x9E] = IT::I16x8ExtendMultiplyLowI8x16U;
+	table[0x9F] = IT::I16x8ExtendMultiplyHighI8x16U;
+	table[0xA0] = IT::I32x4Absolute;
+	table[0xA1] = IT::I32x4Negate;
+	table[0xA3] = IT::I32x4AllTrue;
+	table[0xA4] = IT::I32x4Bitmask;
+	table[0xA7] = IT::I32x4ExtendLowI16x8S;
+	table[0xA8] = IT::I32x4ExtendHighI16x8S;
+	table[0xA9] = IT::I32x4ExtendLowI16x8U;
+	table[0xAA] = IT::I32x4ExtendHighI16x8U;
+	table[0xAB] = IT::I32x4ShiftLeft;
+	table[0xAC] = IT::I32x4ShiftRightS;
+	table[0xAD] = IT::I32x4ShiftRightU;
+	table[0xAE] = IT::I32x4Add;
+	table[0xB1] = IT::I32x4Subtract;
+	table[0xB5] = IT::I32x4Multiply;
+	table[0xB6] = IT::I32x4MinimumS;
+	table[0xB7] = IT::I32x4MinimumU;
+	table[0xB8] = IT::I32x4MaximumS;
+	table[0xB9] = IT::I32x4MaximumU;
+	table[0xBA] = IT::I32x4DotI16x8S;
+	table[0xBC] = IT::I32x4ExtendMultiplyLowI16x8S;
+	table[0xBD] = IT::I32x4ExtendMultiplyHighI16x8S;
+	table[0xBE] = IT::I32x4ExtendMultiplyLowI16x8U;
+	table[0xBF] = IT::I32x4ExtendMultiplyHighI16x8U;
+	table[0xC0] = IT::I64x2Absolute;
+	table[0xC1] = IT::I64x2Negate;
+	table[0xC3] = IT::I64x2AllTrue;
+	table[0xC4] = IT::I64x2Bitmask;
+	table[0xC7] = IT::I64x2ExtendLowI32x4S;
+	table[0xC8] = IT::I64x2ExtendHighI32x4S;
+	table[0xC9] = IT::I64x2ExtendLowI32x4U;
+	table[0xCA] = IT::I64x2ExtendHighI32x4U;
+	table[0xCB] = IT::I64x2ShiftLeft;
+	table[0xCC] = IT::I64x2ShiftRightS;
+	table[0xCD] = IT::I64x2ShiftRightU;
+	table[0xCE] = IT::I64x2Add;
+	table[0xD1] = IT::I64x2Subtract;
+	table[0xD5] = IT::I64x2Multiply;
+	table[0xD6] = IT::I64x2Equal;
+	table[0xD7] = IT::I64x2NotEqual;
+	table[0xD8] = IT::I64x2LesserS;
+	table[0xD9] = IT::I64x2GreaterS;
+	table[0xDA] = IT::I64x2LesserEqualS;
+	table[0xDB] = IT::I64x2GreaterEqualS;
+	table[0xDC] = IT::I64x2ExtendMultiplyLowI32x4S;
+	table[0xDD] = IT::I64x2ExtendMultiplyHighI32x4S;
+	table[0xDE] = IT::I64x2ExtendMultiplyLowI32x4U;
+	table[0xDF] = IT::I64x2ExtendMultiplyHighI32x4U;
+	table[0xE0] = IT::F32x4Absolute;
+	table[0xE1] = IT::F32x4Negate;
+	table[0xE3] = IT::F32x4SquareRoot;
+	table[0xE4] = IT::F32x4Add;
+	table[0xE5] = IT::F32x4Subtract;
+	table[0xE6] = IT::F32x4Multiply;
+	table[0xE7] = IT::F32x4Divide;
+	table[0xE8] = IT::F32x4Minimum;
+	table[0xE9] = IT::F32x4Maximum;
+	table[0xEA] = IT::F32x4PseudoMinimum;
+	table[0xEB] = IT::F32x4PseudoMaximum;
+	table[0xEC] = IT::F64x2Absolute;
+	table[0xED] = IT::F64x2Negate;
+	table[0xEF] = IT::F64x2SquareRoot;
+	table[0xF0] = IT::F64x2Add;
+	table[0xF1] = IT::F64x2Subtract;
+	table[0xF2] = IT::F64x2Multiply;
+	table[0xF3] = IT::F64x2Divide;
+	table[0xF4] = IT::F64x2Minimum;
+	table[0xF5] = IT::F64x2Maximum;
+	table[0xF6] = IT::F64x2PseudoMinimum;
+	table[0xF7] = IT::F64x2PseudoMaximum;
+	table[0xF8] = IT::I32x4TruncateSaturateF32x4S;
+	table[0xF9] = IT::I32x4TruncateSaturateF32x4U;
+	table[0xFA] = IT::F32x4ConvertI32x4S;
+	table[0xFB] = IT::F32x4ConvertI32x4U;
+	table[0xFC] = IT::I32x4TruncateSaturateF64x2SZero;
+	table[0xFD] = IT::I32x4TruncateSaturateF64x2UZero;
+	table[0xFE] = IT::F64x2ConvertLowI32x4S;
+	table[0xFF] = IT::F64x2ConvertLowI32x4U;
+	return table;
+}();
+
+// Opcodes of the threads proposal
+// https://github.com/WebAssembly/threads/blob/main/proposals/threads/Overview.md
+static constexpr std::array<u16, 79> atomicOpcodeTable = []() {
+	using IT = InstructionType;
+	std::array<u16, 79> table{};
+	table.fill(InvalidOpcode);
+
+	table[0x00] = IT::MemoryAtomicNotify;
+	table[0x01] = IT::MemoryAtomicWait32;
+	table[0x02] = IT::MemoryAtomicWait64;
+	table[0x03] = IT::AtomicFence;
+	table[0x10] = IT::I32AtomicLoad;
+	table[0x11] = IT::I64AtomicLoad;
+	table[0x12] = IT::I32AtomicLoad8u;
+	table[0x13] = IT::I32AtomicLoad16u;
+	table[0x14] = IT::I64AtomicLoad8u;
+	table[0x15] = IT::I64AtomicLoad16u;
+	table[0x16] = IT::I64AtomicLoad32u;
+	table[0x17] = IT::I32AtomicStore;
+	table[0x18] = IT::I64AtomicStore;
+	table[0x19] = IT::I32AtomicStore8;
+	table[0x1A] = IT::I32AtomicStore16;
+	table[0x1B] = IT::I64AtomicStore8;
+	table[0x1C] = IT::I64AtomicStore16;
+	table[0x1D] = IT::I64AtomicStore32;
+	table[0x1E] = IT::I32AtomicRmwAdd;
+	table[0x1F] = IT::I64AtomicRmwAdd;
+	table[0x20] = IT::I32AtomicRmw8AddU;
+	table[0x21] = IT::I32AtomicRmw16AddU;
+	table[0x22] = IT::I64AtomicRmw8AddU;
+	table[0x23] = IT::I64AtomicRmw16AddU;
+	table[0x24] = IT::I64AtomicRmw32AddU;
+	table[0x25] = IT::I32AtomicRmwSubtract;
+	table[0x26] = IT::I64AtomicRmwSubtract;
+	table[0x27] = IT::I32AtomicRmw8SubtractU;
+	table[0x28] = IT::I32AtomicRmw16SubtractU;
+	table[0x29] = IT::I64AtomicRmw8SubtractU;
+	table[0x2A] = IT::I64AtomicRmw16SubtractU;
+	table[0x2B] = IT::I64AtomicRmw32SubtractU;
+	table[0x2C] = IT::I32AtomicRmwAnd;
+	table[0x2D] = IT::I64AtomicRmwAnd;
+	table[0x2E] = IT::I32AtomicRmw8AndU;
+	table[0x2F] = IT::I32AtomicRmw16AndU;
+	table[0x30] = IT::I64AtomicRmw8AndU;
+	table[0x31] = IT::I64AtomicRmw16AndU;
+	table[0x32] = IT::I64AtomicRmw32AndU;
+	table[0x33] = IT::I32AtomicRmwOr;
+	table[0x34] = IT::I64AtomicRmwOr;
+	table[0x35] = IT::I32AtomicRmw8OrU;
+	table[0x36] = IT::I32AtomicRmw16OrU;
+	table[0x37] = IT::I64AtomicRmw8OrU;
+	table[0x38] = IT::I64AtomicRmw16OrU;
+	table[0x39] = IT::I64AtomicRmw32OrU;
+	table[0x3A] = IT::I32AtomicRmwXor;
+	table[0x3B] = IT::I64AtomicRmwXor;
+	table[0x3C] = IT::I32AtomicRmw8XorU;
+	table[0x3D] = IT::I32AtomicRmw16XorU;
+	table[0x3E] = IT::I64AtomicRmw8XorU;
+	table[0x3F] = IT::I64AtomicRmw16XorU;
+	table[0x40] = IT::I64AtomicRmw32XorU;
+	table[0x41] = IT::I32AtomicRmwExchange;
+	table[0x42] = IT::I64AtomicRmwExchange;
+	table[0x43] = IT::I32AtomicRmw8ExchangeU;
+	table[0x44] = IT::I32AtomicRmw16ExchangeU;
+	table[0x45] = IT::I64AtomicRmw8ExchangeU;
+	table[0x46] = IT::I64AtomicRmw16ExchangeU;
+	table[0x47] = IT::I64AtomicRmw32ExchangeU;
+	table[0x48] = IT::I32AtomicRmwCompareExchange;
+	table[0x49] = IT::I64AtomicRmwCompareExchange;
+	table[0x4A] = IT::I32AtomicRmw8CompareExchangeU;
+	table[0x4B] = IT::I32AtomicRmw16CompareExchangeU;
+	table[0x4C] = IT::I64AtomicRmw8CompareExchangeU;
+	table[0x4D] = IT::I64AtomicRmw16CompareExchangeU;
+	table[0x4E] = IT::I64AtomicRmw32CompareExchangeU;
+	return table;
+}();
+
 InstructionType InstructionType::fromWASMBytes(BufferIterator& it)
 {
-	auto byte = it.nextU8();
-	switch (byte) {
-		case 0x00: return Unreachable;
-		case 0x01: return NoOperation;
-		case 0x02: return Block;
-		case 0x03: return Loop;
-		case 0x04: return If;
-		case 0x05: return Else;
-		case 0x0B: return End;
-		case 0x0C: return Branch;
-		case 0x0D: return BranchIf;
-		case 0x0E: return BranchTable;
-		case 0x0F: return Return;
-		case 0x10: return Call;
-		case 0x11: return CallIndirect;
-		case 0x1A: return Drop;
-		case 0x1B: return Select;
-		case 0x1C: return SelectFrom;
-		case 0x20: return LocalGet;
-		case 0x21: return LocalSet;
-		case 0x22: return LocalTee;
-		case 0x23: return GlobalGet;
-		case 0x24: return GlobalSet;
-		case 0x25: return TableGet;
-		case 0x26: return TableSet;
-		case 0x28: return I32Load;
-		case 0x29: return I64Load;
-		case 0x2A: return F32Load;
-		case 0x2B: return F64Load;
-		case 0x2C: return I32Load8s;
-		case 0x2D: return I32Load8u;
-		case 0x2E: return I32Load16s;
-		case 0x2F: return I32Load16u;
-		case 0x30: return I64Load8s;
-		case 0x31: return I64Load8u;
-		case 0x32: return I64Load16s;
-		case 0x33: return I64Load16u;
-		case 0x34: return I64Load32s;
-		case 0x35: return I64Load32u;
-		case 0x36: return I32Store;
-		case 0x37: return I64Store;
-		case 0x38: return F32Store;
-		case 0x39: return F64Store;
-		case 0x3A: return I32Store8;
-		case 0x3B: return I32Store16;
-		case 0x3C: return I64Store8;
-		case 0x3D: return I64Store16;
-		case 0x3E: return I64Store32;
-		case 0x3F: return MemorySize;
-		case 0x40: return MemoryGrow;
-		case 0x41: return I32Const;
-		case 0x42: return I64Const;
-		case 0x43: return F32Const;
-		case 0x44: return F64Const;
-		case 0x45: return I32EqualZero;
-		case 0x46: return I32Equal;
-		case 0x47: return I32NotEqual;
-		case 0x48: return I32LesserS;
-		case 0x49: return I32LesserU;
-		case 0x4A: return I32GreaterS;
-		case 0x4B: return I32GreaterU;
-		case 0x4C: return I32LesserEqualS;
-		case 0x4D: return I32LesserEqualU;
-		case 0x4E: return I32GreaterEqualS;
-		case 0x4F: return I32GreaterEqualU;
-		case 0x50: return I64EqualZero;
-		case 0x51: return I64Equal;
-		case 0x52: return I64NotEqual;
-		case 0x53: return I64LesserS;
-		case 0x54: return I64LesserU;
-		case 0x55: return I64GreaterS;
-		case 0x56: return I64GreaterU;
-		case 0x57: return I64LesserEqualS;
-		case 0x58: return I64LesserEqualU;
-		case 0x59: return I64GreaterEqualS;
-		case 0x5A: return I64GreaterEqualU;
-		case 0x5B: return F32Equal;
-		case 0x5C: return F32NotEqual;
-		case 0x5D: return F32Lesser;
-		case 0x5E: return F32Greater;
-		case 0x5F: return F32LesserEqual;
-		case 0x60: return F32GreaterEqual;
-		case 0x61: return F64Equal;
-		case 0x62: return F64NotEqual;
-		case 0x63: return F64Lesser;
-		case 0x64: return F64Greater;
-		case 0x65: return F64LesserEqual;
-		case 0x66: return F64GreaterEqual;
-		case 0x67: return I32CountLeadingZeros;
-		case 0x68: return I32CountTrailingZeros;
-		case 0x69: return I32CountOnes;
-		case 0x6A: return I32Add;
-		case 0x6B: return I32Subtract;
-		case 0x6C: return I32Multiply;
-		case 0x6D: return I32DivideS;
-		case 0x6E: return I32DivideU;
-		case 0x6F: return I32RemainderS;
-		case 0x70: return I32RemainderU;
-		case 0x71: return I32And;
-		case 0x72: return I32Or;
-		case 0x73: return I32Xor;
-		case 0x74: return I32ShiftLeft;
-		case 0x75: return I32ShiftRightS;
-		case 0x76: return I32ShiftRightU;
-		case 0x77: return I32RotateLeft;
-		case 0x78: return I32RotateRight;
-		case 0x79: return I64CountLeadingZeros;
-		case 0x7A: return I64CountTrailingZeros;
-		case 0x7B: return I64CountOnes;
-		case 0x7C: return I64Add;
-		case 0x7D: return I64Subtract;
-		case 0x7E: return I64Multiply;
-		case 0x7F: return I64DivideS;
-		case 0x80: return I64DivideU;
-		case 0x81: return I64RemainderS;
-		case 0x82: return I64RemainderU;
-		case 0x83: return I64And;
-		case 0x84: return I64Or;
-		case 0x85: return I64Xor;
-		case 0x86: return I64ShiftLeft;
-		case 0x87: return I64ShiftRightS;
-		case 0x88: return I64ShiftRightU;
-		case 0x89: return I64RotateLeft;
-		case 0x8A: return I64RotateRight;
-		case 0x8B: return F32Absolute;
-		case 0x8C: return F32Negate;
-		case 0x8D: return F32Ceil;
-		case 0x8E: return F32Floor;
-		case 0x8F: return F32Truncate;
-		case 0x90: return F32Nearest;
-		case 0x91: return F32SquareRoot;
-		case 0x92: return F32Add;
-		case 0x93: return F32Subtract;
-		case 0x94: return F32Multiply;
-		case 0x95: return F32Divide;
-		case 0x96: return F32Minimum;
-		case 0x97: return F32Maximum;
-		case 0x98: return F32CopySign;
-		case 0x99: return F64Absolute;
-		case 0x9A: return F64Negate;
-		case 0x9B: return F64Ceil;
-		case 0x9C: return F64Floor;
-		case 0x9D: return F64Truncate;
-		case 0x9E: return F64Nearest;
-		case 0x9F: return F64SquareRoot;
-		case 0xA0: return F64Add;
-		case 0xA1: return F64Subtract;
-		case 0xA2: return F64Multiply;
-		case 0xA3: return F64Divide;
-		case 0xA4: return F64Minimum;
-		case 0xA5: return F64Maximum;
-		case 0xA6: return F64CopySign;
-		case 0xA7: return I32WrapI64;
-		case 0xA8: return I32TruncateF32S;
-		case 0xA9: return I32TruncateF32U;
-		case 0xAA: return I32TruncateF64S;
-		case 0xAB: return I32TruncateF64U;
-		case 0xAC: return I64ExtendI32S;
-		case 0xAD: return I64ExtendI32U;
-		case 0xAE: return I64TruncateF32S;
-		case 0xAF: return I64TruncateF32U;
-		case 0xB0: return I64TruncateF64S;
-		case 0xB1: return I64TruncateF64U;
-		case 0xB2: return F32ConvertI32S;
-		case 0xB3: return F32ConvertI32U;
-		case 0xB4: return F32ConvertI64S;
-		case 0xB5: return F32ConvertI64U;
-		case 0xB6: return F32DemoteF64;
-		case 0xB7: return F64ConvertI32S;
-		case 0xB8: return F64ConvertI32U;
-		case 0xB9: return F64ConvertI64S;
-		case 0xBA: return F64ConvertI64U;
-		case 0xBB: return F64PromoteF32;
-		case 0xBC: return I32ReinterpretF32;
-		case 0xBD: return I64ReinterpretF64;
-		case 0xBE: return F32ReinterpretI32;
-		case 0xBF: return F64ReinterpretI64;
-		case 0xC0: return I32Extend8s;
-		case 0xC1: return I32Extend16s;
-		case 0xC2: return I64Extend8s;
-		case 0xC3: return I64Extend16s;
-		case 0xC4: return I64Extend32s;
-		case 0xD0: return ReferenceNull;
-		case 0xD1: return ReferenceIsNull;
-		case 0xD2: return ReferenceFunction;
-		case 0xFC: {
-			auto extension = it.nextU32();
-			switch (extension) {
-			case 0: return I32TruncateSaturateF32S;
-			case 1: return I32TruncateSaturateF32U;
-			case 2: return I32TruncateSaturateF64S;
-			case 3: return I32TruncateSaturateF64U;
-			case 4: return I64TruncateSaturateF32S;
-			case 5: return I64TruncateSaturateF32U;
-			case 6: return I64TruncateSaturateF64S;
-			case 7: return I64TruncateSaturateF64U;
-			case 8: return MemoryInit;
-			case 9: return DataDrop;
-			case 10: return MemoryCopy;
-			case 11: return MemoryFill;
-			case 12: return TableInit;
-			case 13: return ElementDrop;
-			case 14: return TableCopy;
-			case 15: return TableGrow;
-			case 16: return TableSize;
-			case 17: return TableFill;
-			default:
-				throw std::runtime_error{ "Unknown secondary instruction byte code." };
-			}
+	auto entry = primaryOpcodeTable[it.nextU8()];
+	if (entry < InvalidOpcode) {
+		return InstructionType{ entry };
+	}
+
+	if (entry == SecondaryOpcodePrefix) {
+		auto extension = it.nextU32();
+		if (extension >= secondaryOpcodeTable.size()) {
+			throw std::runtime_error{ "Unknown secondary instruction byte code." };
+		}
+		return InstructionType{ secondaryOpcodeTable[extension] };
+	}
+
+	if (entry == VectorOpcodePrefix) {
+		auto extension = it.nextU32();
+		if (extension >= vectorOpcodeTable.size() || vectorOpcodeTable[extension] == InvalidOpcode) {
+			throw std::runtime_error{ "Unknown vector instruction byte code." };
 		}
-		case 0xFD:
-			throw std::runtime_error{ "Vector instructions are not supported." };
-		
-		default:
-			throw std::runtime_error{ "Unknown instruction byte code." };
+		return InstructionType{ vectorOpcodeTable[extension] };
 	}
+
+	if (entry == AtomicOpcodePrefix) {
+		auto extension = it.nextU32();
+		if (extension >= atomicOpcodeTable.size() || atomicOpcodeTable[extension] == InvalidOpcode) {
+			throw std::runtime_error{ "Unknown atomic instruction byte code." };
+		}
+		return InstructionType{ atomicOpcodeTable[extension] };
+	}
+
+	throw std::runtime_error{ "Unknown instruction byte code." };
 }
 
 const char* InstructionType::name() const
@@ -248,6 +623,10 @@ const char* InstructionType::name() const
 		case Return: return "Return";
 		case Call: return "Call";
 		case CallIndirect: return "CallIndirect";
+		case ReturnCall: return "ReturnCall";
+		case ReturnCallIndirect: return "ReturnCallIndirect";
+		case CallReference: return "CallReference";
+		case ReturnCallReference: return "ReturnCallReference";
 		case Drop: return "Drop";
 		case Select: return "Select";
 		case SelectFrom: return "SelectFrom";
@@ -259,6 +638,9 @@ const char* InstructionType::name() const
 		case ReferenceNull: return "ReferenceNull";
 		case ReferenceIsNull: return "ReferenceIsNull";
 		case ReferenceFunction: return "ReferenceFunction";
+		case ReferenceAsNonNull: return "ReferenceAsNonNull";
+		case BranchOnNull: return "BranchOnNull";
+		case BranchOnNonNull: return "BranchOnNonNull";
 		case TableGet: return "TableGet";
 		case TableSet: return "TableSet";
 		case TableInit: return "TableInit";
@@ -436,6 +818,309 @@ const char* InstructionType::name() const
 		case I64TruncateSaturateF32U: return "I64TruncateSaturateF32U";
 		case I64TruncateSaturateF64S: return "I64TruncateSaturateF64S";
 		case I64TruncateSaturateF64U: return "I64TruncateSaturateF64U";
+		case AtomicFence: return "AtomicFence";
+		case MemoryAtomicNotify: return "MemoryAtomicNotify";
+		case MemoryAtomicWait32: return "MemoryAtomicWait32";
+		case MemoryAtomicWait64: return "MemoryAtomicWait64";
+		case I32AtomicLoad: return "I32AtomicLoad";
+		case I64AtomicLoad: return "I64AtomicLoad";
+		case I32AtomicLoad8u: return "I32AtomicLoad8u";
+		case I32AtomicLoad16u: return "I32AtomicLoad16u";
+		case I64AtomicLoad8u: return "I64AtomicLoad8u";
+		case I64AtomicLoad16u: return "I64AtomicLoad16u";
+		case I64AtomicLoad32u: return "I64AtomicLoad32u";
+		case I32AtomicStore: return "I32AtomicStore";
+		case I64AtomicStore: return "I64AtomicStore";
+		case I32AtomicStore8: return "I32AtomicStore8";
+		case I32AtomicStore16: return "I32AtomicStore16";
+		case I64AtomicStore8: return "I64AtomicStore8";
+		case I64AtomicStore16: return "I64AtomicStore16";
+		case I64AtomicStore32: return "I64AtomicStore32";
+		case I32AtomicRmwAdd: return "I32AtomicRmwAdd";
+		case I64AtomicRmwAdd: return "I64AtomicRmwAdd";
+		case I32AtomicRmw8AddU: return "I32AtomicRmw8AddU";
+		case I32AtomicRmw16AddU: return "I32AtomicRmw16AddU";
+		case I64AtomicRmw8AddU: return "I64AtomicRmw8AddU";
+		case I64AtomicRmw16AddU: return "I64AtomicRmw16AddU";
+		case I64AtomicRmw32AddU: return "I64AtomicRmw32AddU";
+		case I32AtomicRmwSubtract: return "I32AtomicRmwSubtract";
+		case I64AtomicRmwSubtract: return "I64AtomicRmwSubtract";
+		case I32AtomicRmw8SubtractU: return "I32AtomicRmw8SubtractU";
+		case I32AtomicRmw16SubtractU: return "I32AtomicRmw16SubtractU";
+		case I64AtomicRmw8SubtractU: return "I64AtomicRmw8SubtractU";
+		case I64AtomicRmw16SubtractU: return "I64AtomicRmw16SubtractU";
+		case I64AtomicRmw32SubtractU: return "I64AtomicRmw32SubtractU";
+		case I32AtomicRmwAnd: return "I32AtomicRmwAnd";
+		case I64AtomicRmwAnd: return "I64AtomicRmwAnd";
+		case I32AtomicRmw8AndU: return "I32AtomicRmw8AndU";
+		case I32AtomicRmw16AndU: return "I32AtomicRmw16AndU";
+		case I64AtomicRmw8AndU: return "I64AtomicRmw8AndU";
+		case I64AtomicRmw16AndU: return "I64AtomicRmw16AndU";
+		case I64AtomicRmw32AndU: return "I64AtomicRmw32AndU";
+		case I32AtomicRmwOr: return "I32AtomicRmwOr";
+		case I64AtomicRmwOr: return "I64AtomicRmwOr";
+		case I32AtomicRmw8OrU: return "I32AtomicRmw8OrU";
+		case I32AtomicRmw16OrU: return "I32AtomicRmw16OrU";
+		case I64AtomicRmw8OrU: return "I64AtomicRmw8OrU";
+		case I64AtomicRmw16OrU: return "I64AtomicRmw16OrU";
+		case I64AtomicRmw32OrU: return "I64AtomicRmw32OrU";
+		case I32AtomicRmwXor: return "I32AtomicRmwXor";
+		case I64AtomicRmwXor: return "I64AtomicRmwXor";
+		case I32AtomicRmw8XorU: return "I32AtomicRmw8XorU";
+		case I32AtomicRmw16XorU: return "I32AtomicRmw16XorU";
+		case I64AtomicRmw8XorU: return "I64AtomicRmw8XorU";
+		case I64AtomicRmw16XorU: return "I64AtomicRmw16XorU";
+		case I64AtomicRmw32XorU: return "I64AtomicRmw32XorU";
+		case I32AtomicRmwExchange: return "I32AtomicRmwExchange";
+		case I64AtomicRmwExchange: return "I64AtomicRmwExchange";
+		case I32AtomicRmw8ExchangeU: return "I32AtomicRmw8ExchangeU";
+		case I32AtomicRmw16ExchangeU: return "I32AtomicRmw16ExchangeU";
+		case I64AtomicRmw8ExchangeU: return "I64AtomicRmw8ExchangeU";
+		case I64AtomicRmw16ExchangeU: return "I64AtomicRmw16ExchangeU";
+		case I64AtomicRmw32ExchangeU: return "I64AtomicRmw32ExchangeU";
+		case I32AtomicRmwCompareExchange: return "I32AtomicRmwCompareExchange";
+		case I64AtomicRmwCompareExchange: return "I64AtomicRmwCompareExchange";
+		case I32AtomicRmw8CompareExchangeU: return "I32AtomicRmw8CompareExchangeU";
+		case I32AtomicRmw16CompareExchangeU: return "I32AtomicRmw16CompareExchangeU";
+		case I64AtomicRmw8CompareExchangeU: return "I64AtomicRmw8CompareExchangeU";
+		case I64AtomicRmw16CompareExchangeU: return "I64AtomicRmw16CompareExchangeU";
+		case I64AtomicRmw32CompareExchangeU: return "I64AtomicRmw32CompareExchangeU";
+		case V128Load: return "V128Load";
+		case V128Load8x8S: return "V128Load8x8S";
+		case V128Load8x8U: return "V128Load8x8U";
+		case V128Load16x4S: return "V128Load16x4S";
+		case V128Load16x4U: return "V128Load16x4U";
+		case V128Load32x2S: return "V128Load32x2S";
+		case V128Load32x2U: return "V128Load32x2U";
+		case V128Load8Splat: return "V128Load8Splat";
+		case V128Load16Splat: return "V128Load16Splat";
+		case V128Load32Splat: return "V128Load32Splat";
+		case V128Load64Splat: return "V128Load64Splat";
+		case V128Store: return "V128Store";
+		case V128Const: return "V128Const";
+		case I8x16Shuffle: return "I8x16Shuffle";
+		case I8x16Swizzle: return "I8x16Swizzle";
+		case I8x16Splat: return "I8x16Splat";
+		case I16x8Splat: return "I16x8Splat";
+		case I32x4Splat: return "I32x4Splat";
+		case I64x2Splat: return "I64x2Splat";
+		case F32x4Splat: return "F32x4Splat";
+		case F64x2Splat: return "F64x2Splat";
+		case I8x16ExtractLaneS: return "I8x16ExtractLaneS";
+		case I8x16ExtractLaneU: return "I8x16ExtractLaneU";
+		case I8x16ReplaceLane: return "I8x16ReplaceLane";
+		case I16x8ExtractLaneS: return "I16x8ExtractLaneS";
+		case I16x8ExtractLaneU: return "I16x8ExtractLaneU";
+		case I16x8ReplaceLane: return "I16x8ReplaceLane";
+		case I32x4ExtractLane: return "I32x4ExtractLane";
+		case I32x4ReplaceLane: return "I32x4ReplaceLane";
+		case I64x2ExtractLane: return "I64x2ExtractLane";
+		case I64x2ReplaceLane: return "I64x2ReplaceLane";
+		case F32x4ExtractLane: return "F32x4ExtractLane";
+		case F32x4ReplaceLane: return "F32x4ReplaceLane";
+		case F64x2ExtractLane: return "F64x2ExtractLane";
+		case F64x2ReplaceLane: return "F64x2ReplaceLane";
+		case I8x16Equal: return "I8x16Equal";
+		case I8x16NotEqual: return "I8x16NotEqual";
+		case I8x16LesserS: return "I8x16LesserS";
+		case I8x16LesserU: return "I8x16LesserU";
+		case I8x16GreaterS: return "I8x16GreaterS";
+		case I8x16GreaterU: return "I8x16GreaterU";
+		case I8x16LesserEqualS: return "I8x16LesserEqualS";
+		case I8x16LesserEqualU: return "I8x16LesserEqualU";
+		case I8x16GreaterEqualS: return "I8x16GreaterEqualS";
+		case I8x16GreaterEqualU: return "I8x16GreaterEqualU";
+		case I16x8Equal: return "I16x8Equal";
+		case I16x8NotEqual: return "I16x8NotEqual";
+		case I16x8LesserS: return "I16x8LesserS";
+		case I16x8LesserU: return "I16x8LesserU";
+		case I16x8GreaterS: return "I16x8GreaterS";
+		case I16x8GreaterU: return "I16x8GreaterU";
+		case I16x8LesserEqualS: return "I16x8LesserEqualS";
+		case I16x8LesserEqualU: return "I16x8LesserEqualU";
+		case I16x8GreaterEqualS: return "I16x8GreaterEqualS";
+		case I16x8GreaterEqualU: return "I16x8GreaterEqualU";
+		case I32x4Equal: return "I32x4Equal";
+		case I32x4NotEqual: return "I32x4NotEqual";
+		case I32x4LesserS: return "I32x4LesserS";
+		case I32x4LesserU: return "I32x4LesserU";
+		case I32x4GreaterS: return "I32x4GreaterS";
+		case I32x4GreaterU: return "I32x4GreaterU";
+		case I32x4LesserEqualS: return "I32x4LesserEqualS";
+		case I32x4LesserEqualU: return "I32x4LesserEqualU";
+		case I32x4GreaterEqualS: return "I32x4GreaterEqualS";
+		case I32x4GreaterEqualU: return "I32x4GreaterEqualU";
+		case F32x4Equal: return "F32x4Equal";
+		case F32x4NotEqual: return "F32x4NotEqual";
+		case F32x4Lesser: return "F32x4Lesser";
+		case F32x4Greater: return "F32x4Greater";
+		case F32x4LesserEqual: return "F32x4LesserEqual";
+		case F32x4GreaterEqual: return "F32x4GreaterEqual";
+		case F64x2Equal: return "F64x2Equal";
+		case F64x2NotEqual: return "F64x2NotEqual";
+		case F64x2Lesser: return "F64x2Lesser";
+		case F64x2Greater: return "F64x2Greater";
+		case F64x2LesserEqual: return "F64x2LesserEqual";
+		case F64x2GreaterEqual: return "F64x2GreaterEqual";
+		case V128Not: return "V128Not";
+		case V128And: return "V128And";
+		case V128AndNot: return "V128AndNot";
+		case V128Or: return "V128Or";
+		case V128Xor: return "V128Xor";
+		case V128BitSelect: return "V128BitSelect";
+		case V128AnyTrue: return "V128AnyTrue";
+		case V128Load8Lane: return "V128Load8Lane";
+		case V128Load16Lane: return "V128Load16Lane";
+		case V128Load32Lane: return "V128Load32Lane";
+		case V128Load64Lane: return "V128Load64Lane";
+		case V128Store8Lane: return "V128Store8Lane";
+		case V128Store16Lane: return "V128Store16Lane";
+		case V128Store32Lane: return "V128Store32Lane";
+		case V128Store64Lane: return "V128Store64Lane";
+		case V128Load32Zero: return "V128Load32Zero";
+		case V128Load64Zero: return "V128Load64Zero";
+		case F32x4DemoteF64x2Zero: return "F32x4DemoteF64x2Zero";
+		case F64x2PromoteLowF32x4: return "F64x2PromoteLowF32x4";
+		case I8x16Absolute: return "I8x16Absolute";
+		case I8x16Negate: return "I8x16Negate";
+		case I8x16CountOnes: return "I8x16CountOnes";
+		case I8x16AllTrue: return "I8x16AllTrue";
+		case I8x16Bitmask: return "I8x16Bitmask";
+		case I8x16NarrowI16x8S: return "I8x16NarrowI16x8S";
+		case I8x16NarrowI16x8U: return "I8x16NarrowI16x8U";
+		case F32x4Ceil: return "F32x4Ceil";
+		case F32x4Floor: return "F32x4Floor";
+		case F32x4Truncate: return "F32x4Truncate";
+		case F32x4Nearest: return "F32x4Nearest";
+		case I8x16ShiftLeft: return "I8x16ShiftLeft";
+		case I8x16ShiftRightS: return "I8x16ShiftRightS";
+		case I8x16ShiftRightU: return "I8x16ShiftRightU";
+		case I8x16Add: return "I8x16Add";
+		case I8x16AddSaturateS: return "I8x16AddSaturateS";
+		case I8x16AddSaturateU: return "I8x16AddSaturateU";
+		case I8x16Subtract: return "I8x16Subtract";
+		case I8x16SubtractSaturateS: return "I8x16SubtractSaturateS";
+		case I8x16SubtractSaturateU: return "I8x16SubtractSaturateU";
+		case F64x2Ceil: return "F64x2Ceil";
+		case F64x2Floor: return "F64x2Floor";
+		case I8x16MinimumS: return "I8x16MinimumS";
+		case I8x16MinimumU: return "I8x16MinimumU";
+		case I8x16MaximumS: return "I8x16MaximumS";
+		case I8x16MaximumU: return "I8x16MaximumU";
+		case F64x2Truncate: return "F64x2Truncate";
+		case I8x16AverageU: return "I8x16AverageU";
+		case I16x8ExtendAddPairwiseI8x16S: return "I16x8ExtendAddPairwiseI8x16S";
+		case I16x8ExtendAddPairwiseI8x16U: return "I16x8ExtendAddPairwiseI8x16U";
+		case I32x4ExtendAddPairwiseI16x8S: return "I32x4ExtendAddPairwiseI16x8S";
+		case I32x4ExtendAddPairwiseI16x8U: return "I32x4ExtendAddPairwiseI16x8U";
+		case I16x8Absolute: return "I16x8Absolute";
+		case I16x8Negate: return "I16x8Negate";
+		case I16x8Q15MultiplyRoundSaturateS: return "I16x8Q15MultiplyRoundSaturateS";
+		case I16x8AllTrue: return "I16x8AllTrue";
+		case I16x8Bitmask: return "I16x8Bitmask";
+		case I16x8NarrowI32x4S: return "I16x8NarrowI32x4S";
+		case I16x8NarrowI32x4U: return "I16x8NarrowI32x4U";
+		case I16x8ExtendLowI8x16S: return "I16x8ExtendLowI8x16S";
+		case I16x8ExtendHighI8x16S: return "I16x8ExtendHighI8x16S";
+		case I16x8ExtendLowI8x16U: return "I16x8ExtendLowI8x16U";
+		case I16x8ExtendHighI8x16U: return "I16x8ExtendHighI8x16U";
+		case I16x8ShiftLeft: return "I16x8ShiftLeft";
+		case I16x8ShiftRightS: return "I16x8ShiftRightS";
+		case I16x8ShiftRightU: return "I16x8ShiftRightU";
+		case I16x8Add: return "I16x8Add";
+		case I16x8AddSaturateS: return "I16x8AddSaturateS";
+		case I16x8AddSaturateU: return "I16x8AddSaturateU";
+		case I16x8Subtract: return "I16x8Subtract";
+		case I16x8SubtractSaturateS: return "I16x8SubtractSaturateS";
+		case I16x8SubtractSaturateU: return "I16x8SubtractSaturateU";
+		case F64x2Nearest: return "F64x2Nearest";
+		case I16x8Multiply: return "I16x8Multiply";
+		case I16x8MinimumS: return "I16x8MinimumS";
+		case I16x8MinimumU: return "I16x8MinimumU";
+		case I16x8MaximumS: return "I16x8MaximumS";
+		case I16x8MaximumU: return "I16x8MaximumU";
+		case I16x8AverageU: return "I16x8AverageU";
+		case I16x8ExtendMultiplyLowI8x16S: return "I16x8ExtendMultiplyLowI8x16S";
+		case I16x8ExtendMultiplyHighI8x16S: return "I16x8ExtendMultiplyHighI8x16S";
+		case I16x8ExtendMultiplyLowI8x16U: return "I16x8ExtendMultiplyLowI8x16U";
+		case I16x8ExtendMultiplyHighI8x16U: return "I16x8ExtendMultiplyHighI8x16U";
+		case I32x4Absolute: return "I32x4Absolute";
+		case I32x4Negate: return "I32x4Negate";
+		case I32x4AllTrue: return "I32x4AllTrue";
+		case I32x4Bitmask: return "I32x4Bitmask";
+		case I32x4ExtendLowI16x8S: return "I32x4ExtendLowI16x8S";
+		case I32x4ExtendHighI16x8S: return "I32x4ExtendHighI16x8S";
+		case I32x4ExtendLowI16x8U: return "I32x4ExtendLowI16x8U";
+		case I32x4ExtendHighI16x8U: return "I32x4ExtendHighI16x8U";
+		case I32x4ShiftLeft: return "I32x4ShiftLeft";
+		case I32x4ShiftRightS: return "I32x4ShiftRightS";
+		case I32x4ShiftRightU: return "I32x4ShiftRightU";
+		case I32x4Add: return "I32x4Add";
+		case I32x4Subtract: return "I32x4Subtract";
+		case I32x4Multiply: return "I32x4Multiply";
+		case I32x4MinimumS: return "I32x4MinimumS";
+		case I32x4MinimumU: return "I32x4MinimumU";
+		case I32x4MaximumS: return "I32x4MaximumS";
+		case I32x4MaximumU: return "I32x4MaximumU";
+		case I32x4DotI16x8S: return "I32x4DotI16x8S";
+		case I32x4ExtendMultiplyLowI16x8S: return "I32x4ExtendMultiplyLowI16x8S";
+		case I32x4ExtendMultiplyHighI16x8S: return "I32x4ExtendMultiplyHighI16x8S";
+		case I32x4ExtendMultiplyLowI16x8U: return "I32x4ExtendMultiplyLowI16x8U";
+		case I32x4ExtendMultiplyHighI16x8U: return "I32x4ExtendMultiplyHighI16x8U";
+		case I64x2Absolute: return "I64x2Absolute";
+		case I64x2Negate: return "I64x2Negate";
+		case I64x2AllTrue: return "I64x2AllTrue";
+		case I64x2Bitmask: return "I64x2Bitmask";
+		case I64x2ExtendLowI32x4S: return "I64x2ExtendLowI32x4S";
+		case I64x2ExtendHighI32x4S: return "I64x2ExtendHighI32x4S";
+		case I64x2ExtendLowI32x4U: return "I64x2ExtendLowI32x4U";
+		case I64x2ExtendHighI32x4U: return "I64x2ExtendHighI32x4U";
+		case I64x2ShiftLeft: return "I64x2ShiftLeft";
+		case I64x2ShiftRightS: return "I64x2ShiftRightS";
+		case I64x2ShiftRightU: return "I64x2ShiftRightU";
+		case I64x2Add: return "I64x2Add";
+		case I64x2Subtract: return "I64x2Subtract";
+		case I64x2Multiply: return "I64x2Multiply";
+		case I64x2Equal: return "I64x2Equal";
+		case I64x2NotEqual: return "I64x2NotEqual";
+		case I64x2LesserS: return "I64x2LesserS";
+		case I64x2GreaterS: return "I64x2GreaterS";
+		case I64x2LesserEqualS: return "I64x2LesserEqualS";
+		case I64x2GreaterEqualS: return "I64x2GreaterEqualS";
+		case I64x2ExtendMultiplyLowI32x4S: return "I64x2ExtendMultiplyLowI32x4S";
+		case I64x2ExtendMultiplyHighI32x4S: return "I64x2ExtendMultiplyHighI32x4S";
+		case I64x2ExtendMultiplyLowI32x4U: return "I64x2ExtendMultiplyLowI32x4U";
+		case I64x2ExtendMultiplyHighI32x4U: return "I64x2ExtendMultiplyHighI32x4U";
+		case F32x4Absolute: return "F32x4Absolute";
+		case F32x4Negate: return "F32x4Negate";
+		case F32x4SquareRoot: return "F32x4SquareRoot";
+		case F32x4Add: return "F32x4Add";
+		case F32x4Subtract: return "F32x4Subtract";
+		case F32x4Multiply: return "F32x4Multiply";
+		case F32x4Divide: return "F32x4Divide";
+		case F32x4Minimum: return "F32x4Minimum";
+		case F32x4Maximum: return "F32x4Maximum";
+		case F32x4PseudoMinimum: return "F32x4PseudoMinimum";
+		case F32x4PseudoMaximum: return "F32x4PseudoMaximum";
+		case F64x2Absolute: return "F64x2Absolute";
+		case F64x2Negate: return "F64x2Negate";
+		case F64x2SquareRoot: return "F64x2SquareRoot";
+		case F64x2Add: return "F64x2Add";
+		case F64x2Subtract: return "F64x2Subtract";
+		case F64x2Multiply: return "F64x2Multiply";
+		case F64x2Divide: return "F64x2Divide";
+		case F64x2Minimum: return "F64x2Minimum";
+		case F64x2Maximum: return "F64x2Maximum";
+		case F64x2PseudoMinimum: return "F64x2PseudoMinimum";
+		case F64x2PseudoMaximum: return "F64x2PseudoMaximum";
+		case I32x4TruncateSaturateF32x4S: return "I32x4TruncateSaturateF32x4S";
+		case I32x4TruncateSaturateF32x4U: return "I32x4TruncateSaturateF32x4U";
+		case F32x4ConvertI32x4S: return "F32x4ConvertI32x4S";
+		case F32x4ConvertI32x4U: return "F32x4ConvertI32x4U";
+		case I32x4TruncateSaturateF64x2SZero: return "I32x4TruncateSaturateF64x2SZero";
+		case I32x4TruncateSaturateF64x2UZero: return "I32x4TruncateSaturateF64x2UZero";
+		case F64x2ConvertLowI32x4S: return "F64x2ConvertLowI32x4S";
+		case F64x2ConvertLowI32x4U: return "F64x2ConvertLowI32x4U";
 		default: return "<unknown instruction type>";
 	}
 }
@@ -445,6 +1130,14 @@ Instruction Instruction::fromWASMBytes(BufferIterator& it)
 	bool is64BitMemoryInstruction= false;
 	using IT = InstructionType;
 	auto type = InstructionType::fromWASMBytes(it);
+	if (type.isAtomicMemory()) {
+		return parseAtomicMemoryInstruction(type, it);
+	}
+
+	if (type.isVector()) {
+		return parseVectorInstruction(type, it);
+	}
+
 	switch (type) {
 	case IT::Unreachable:
 	case IT::NoOperation:
@@ -457,7 +1150,9 @@ Instruction Instruction::fromWASMBytes(BufferIterator& it)
 	case IT::End:
 		return { type };
 	case IT::Branch:
-	case IT::BranchIf: {
+	case IT::BranchIf:
+	case IT::BranchOnNull:
+	case IT::BranchOnNonNull: {
 		auto lableIdx = it.nextU32();
 		return { type, lableIdx };
 	}
@@ -465,15 +1160,22 @@ Instruction Instruction::fromWASMBytes(BufferIterator& it)
 		return parseBranchTableInstruction( it );
 	case IT::Return:
 		return { type };
-	case IT::Call: {
+	case IT::Call:
+	case IT::ReturnCall: {
 		auto funcIdx = it.nextU32();
 		return { type, funcIdx };
 	}
-	case IT::CallIndirect:{
+	case IT::CallIndirect:
+	case IT::ReturnCallIndirect: {
 		auto typeIdx = it.nextU32();
 		auto tableIdx = it.nextU32();
 		return { type, typeIdx, tableIdx }; 
 	}
+	case IT::CallReference:
+	case IT::ReturnCallReference: {
+		auto typeIdx = it.nextU32();
+		return { type, typeIdx };
+	}
 	case IT::Drop:
 	case IT::Select:
 		return { type };
@@ -488,13 +1190,14 @@ Instruction Instruction::fromWASMBytes(BufferIterator& it)
 		return { type, localIdx };
 	}
 	case IT::ReferenceNull:{
-		auto refType = ValType::fromInt(it.nextU8());
+		auto refType = ValType::fromWASMHeapType(it);
 		if (!refType.isReference()) {
-			throw std::runtime_error{ "Expected reference type for ref.null instruction" };
+			throw std::runtime_error{ "Expected heap type for ref.null instruction" };
 		}
-		return { type, (u32)refType }; 
+		return { type, refType.encoded() }; 
 	}
 	case IT::ReferenceIsNull:
+	case IT::ReferenceAsNonNull:
 		return { type };
 	case IT::ReferenceFunction: {
 		auto funcIdx = it.nextU32();
@@ -572,6 +1275,10 @@ Instruction Instruction::fromWASMBytes(BufferIterator& it)
 		it.assertU8(0x00);
 		return { type }; 
 	}
+	case IT::AtomicFence: {
+		it.assertU8(0x00); // Reserved ordering byte
+		return { type };
+	}
 	case IT::MemoryFill: {
 		it.assertU8(0x00); // Only memory idx 0x00 is supported
 		return { type }; 
@@ -742,11 +1449,19 @@ Instruction Instruction::parseBlockTypeInstruction(InstructionType type, BufferI
 		return { type, BlockType::None };
 	}
 
+	if (blockType == 0x63 || blockType == 0x64) {
+		auto valType = ValType::fromWASMBytes(it);
+		if (!valType.isValid()) {
+			throw std::runtime_error{ "Expected valid heap type for block type" };
+		}
+		return { type, BlockType::ValType, valType.encoded() };
+	}
+
 	if (blockType < ValType::NumberOfItems) {
 		auto valType = ValType::fromInt(blockType);
 		if (valType.isValid()) {
 			it.nextU8();
-			return { type, BlockType::ValType, (u32)valType };
+			return { type, BlockType::ValType, valType.encoded() };
 		}
 	}
 
@@ -770,12 +1485,121 @@ Instruction Instruction::parseBranchTableInstruction(BufferIterator& it)
 	return { InstructionType::BranchTable, position, defaultLabel };
 }
 
+Instruction Instruction::parseAtomicMemoryInstruction(InstructionType type, BufferIterator& it)
+{
+	// Unlike normal memory instructions atomics have to declare their natural alignment
+	auto alignment = it.nextU32();
+	auto offset = it.nextU32();
+	if (alignment >= 32 || (0x1u << alignment) != type.atomicAccessSizeInBytes()) {
+		throw std::runtime_error{ "Atomic memory alignment has to equal the access size" };
+	}
+	return { type, alignment, offset };
+}
+
+Instruction Instruction::parseVectorInstruction(InstructionType type, BufferIterator& it)
+{
+	using IT = InstructionType;
+
+	// Memory arguments may not declare an alignment larger than the natural one
+	auto parseMemoryArgument = [&](u32 accessSizeInBytes) -> Instruction {
+		auto alignment = it.nextU32();
+		auto offset = it.nextU32();
+		if (alignment >= 32 || (0x1u << alignment) > accessSizeInBytes) {
+			throw std::runtime_error{ "Vector memory alignment exceeds the access size" };
+		}
+		return { type, alignment, offset };
+	};
+
+	auto parseLaneIndex = [&](u32 numLanes) {
+		auto laneIdx = it.nextU8();
+		if (laneIdx >= numLanes) {
+			throw std::runtime_error{ "Vector lane index out of range" };
+		}
+		return laneIdx;
+	};
+
+	auto parseMemoryLaneArgument = [&](u32 accessSizeInBytes) {
+		auto instruction = parseMemoryArgument(accessSizeInBytes);
+		instruction.operandC = parseLaneIndex(16 / accessSizeInBytes);
+		return instruction;
+	};
+
+	switch (type) {
+	case IT::V128Load8Splat:
+		return parseMemoryArgument(1);
+	case IT::V128Load16Splat:
+		return parseMemoryArgument(2);
+	case IT::V128Load32Splat:
+	case IT::V128Load32Zero:
+		return parseMemoryArgument(4);
+	case IT::V128Load8x8S:
+	case IT::V128Load8x8U:
+	case IT::V128Load16x4S:
+	case IT::V128Load16x4U:
+	case IT::V128Load32x2S:
+	case IT::V128Load32x2U:
+	case IT::V128Load64Splat:
+	case IT::V128Load64Zero:
+		return parseMemoryArgument(8);
+	case IT::V128Load:
+	case IT::V128Store:
+		return parseMemoryArgument(16);
+	case IT::V128Load8Lane:
+	case IT::V128Store8Lane:
+		return parseMemoryLaneArgument(1);
+	case IT::V128Load16Lane:
+	case IT::V128Store16Lane:
+		return parseMemoryLaneArgument(2);
+	case IT::V128Load32Lane:
+	case IT::V128Store32Lane:
+		return parseMemoryLaneArgument(4);
+	case IT::V128Load64Lane:
+	case IT::V128Store64Lane:
+		return parseMemoryLaneArgument(8);
+	case IT::V128Const:
+	case IT::I8x16Shuffle: {
+		if (!it.hasNext(16)) {
+			throw std::runtime_error{ "Expected 16 immediate bytes for vector instruction" };
+		}
+
+		auto position = it.positionPointer();
+		it += 16;
+		if (type == IT::I8x16Shuffle && std::any_of(position, position + 16, [](u8 laneIdx) { return laneIdx >= 32; })) {
+			throw std::runtime_error{ "Vector shuffle lane index out of range" };
+		}
+		return { type, position };
+	}
+	case IT::I64x2ExtractLane:
+	case IT::I64x2ReplaceLane:
+	case IT::F64x2ExtractLane:
+	case IT::F64x2ReplaceLane:
+		return { type, parseLaneIndex(2) };
+	case IT::I32x4ExtractLane:
+	case IT::I32x4ReplaceLane:
+	case IT::F32x4ExtractLane:
+	case IT::F32x4ReplaceLane:
+		return { type, parseLaneIndex(4) };
+	case IT::I16x8ExtractLaneS:
+	case IT::I16x8ExtractLaneU:
+	case IT::I16x8ReplaceLane:
+		return { type, parseLaneIndex(8) };
+	case IT::I8x16ExtractLaneS:
+	case IT::I8x16ExtractLaneU:
+	case IT::I8x16ReplaceLane:
+		return { type, parseLaneIndex(16) };
+	default:
+		return { type };
+	}
+}
+
 Instruction Instruction::parseSelectVectorInstruction(BufferIterator& it)
 {
-	// Consume all values in the vector (each valtype is a single byte)
+	// Consume all values in the vector (typed references span multiple bytes)
 	auto position = it.positionPointer();
 	auto numTypes = it.nextU32();
-	it += numTypes;
+	for (u32 i = 0; i != numTypes; i++) {
+		ValType::fromWASMBytes(it);
+	}
 
 	return { InstructionType::SelectFrom, position };
 }
@@ -800,9 +1624,10 @@ void Instruction::printSelectVectorInstruction(std::ostream& out, const BufferSl
 	assert(type == InstructionType::SelectFrom);
 	out << type.name() << " [";
 
-	auto types = selectTypeVector(data);
-	for (auto typeNum : types) {
-		out << " " << ValType::fromInt(typeNum).name();
+	auto it = selectTypeVector(data);
+	auto numTypes = it.nextU32();
+	for (u32 i = 0; i != numTypes; i++) {
+		out << " " << ValType::fromWASMBytes(it).name();
 	}
 
 	out << " ]";
@@ -1025,6 +1850,48 @@ bool InstructionType::isMemory() const
 	}
 }
 
+bool InstructionType::isAtomicMemory() const
+{
+	// The atomic fence is the only instruction of the threads proposal that does not access memory
+	return value >= MemoryAtomicNotify && value <= I64AtomicRmw32CompareExchangeU;
+}
+
+bool InstructionType::isVector() const
+{
+	return value >= V128Load && value <= F64x2ConvertLowI32x4U;
+}
+
+bool InstructionType::isVectorMemory() const
+{
+	switch (value) {
+	case V128Load:
+	case V128Load8x8S:
+	case V128Load8x8U:
+	case V128Load16x4S:
+	case V128Load16x4U:
+	case V128Load32x2S:
+	case V128Load32x2U:
+	case V128Load8Splat:
+	case V128Load16Splat:
+	case V128Load32Splat:
+	case V128Load64Splat:
+	case V128Store:
+	case V128Load8Lane:
+	case V128Load16Lane:
+	case V128Load32Lane:
+	case V128Load64Lane:
+	case V128Store8Lane:
+	case V128Store16Lane:
+	case V128Store32Lane:
+	case V128Store64Lane:
+	case V128Load32Zero:
+	case V128Load64Zero:
+		return true;
+	default:
+		return false;
+	}
+}
+
 bool InstructionType::requiresMemoryInstance() const
 {
 	switch (value) {
@@ -1058,7 +1925,7 @@ bool InstructionType::requiresMemoryInstance() const
 	case MemoryFill:
 		return true;
 	default:
-		return false;
+		return isAtomicMemory() || isVectorMemory();
 	}
 }
 
@@ -1075,9 +1942,69 @@ bool InstructionType::isBitCastConversionOnly() const
 	}
 }
 
+// Atomic loads, stores and read-modify-write instructions all come in the same seven
+// access widths in the same order, so their properties follow from the enum position
+struct AtomicAccessWidth {
+	ValType::TEnum valueType;
+	u32 sizeInBytes;
+};
+
+static constexpr std::array<AtomicAccessWidth, 7> atomicAccessWidths{ {
+	{ ValType::I32, 4 },
+	{ ValType::I64, 8 },
+	{ ValType::I32, 1 },
+	{ ValType::I32, 2 },
+	{ ValType::I64, 1 },
+	{ ValType::I64, 2 },
+	{ ValType::I64, 4 }
+} };
+
+static std::optional<AtomicAccessWidth> atomicAccessWidth(InstructionType type)
+{
+	using IT = InstructionType;
+	if (type < IT::I32AtomicLoad || type > IT::I64AtomicRmw32CompareExchangeU) {
+		return {};
+	}
+
+	return atomicAccessWidths[(type - IT::I32AtomicLoad) % atomicAccessWidths.size()];
+}
+
+std::optional<AtomicOperation> InstructionType::atomicOperation() const
+{
+	if (value < I32AtomicRmwAdd || value > I64AtomicRmw32CompareExchangeU) {
+		return {};
+	}
+
+	return AtomicOperation::fromInt((value - I32AtomicRmwAdd) / atomicAccessWidths.size());
+}
+
+u32 InstructionType::atomicAccessSizeInBytes() const
+{
+	assert(isAtomicMemory());
+	switch (value) {
+	case MemoryAtomicNotify:
+	case MemoryAtomicWait32:
+		return 4;
+	case MemoryAtomicWait64:
+		return 8;
+	default:
+		return atomicAccessWidth(*this)->sizeInBytes;
+	}
+}
+
 std::optional<ValType> InstructionType::resultType() const
 {
 	using IT = InstructionType;
+	if (isAtomicMemory()) {
+		// Stores are the only atomic memory instructions without a result
+		if (value >= I32AtomicStore && value < I32AtomicRmwAdd) {
+			return {};
+		}
+
+		auto width = atomicAccessWidth(*this);
+		return width.has_value() ? ValType{ width->valueType } : ValType{ ValType::I32 };
+	}
+
 	switch (value) {
 	case IT::I32Add:
 	case IT::I32Subtract:
@@ -1275,6 +2202,16 @@ std::optional<ValType> InstructionType::resultType() const
 std::optional<ValType> InstructionType::operandType() const
 {
 	using IT = InstructionType;
+	if (isAtomicMemory()) {
+		// Type of the value operand besides the address, the operands of notify and
+		// wait instructions have to be handled by the caller
+		auto width = atomicAccessWidth(*this);
+		if (!width.has_value() || value < I32AtomicStore) {
+			return {};
+		}
+		return ValType{ width->valueType };
+	}
+
 	switch (value) {
 	case IT::I32Add:
 	case IT::I32Subtract:
@@ -1473,7 +2410,7 @@ void Instruction::printBlockTypeInstruction(std::ostream& out) const
 	out << type.name() << " " << blockType.name();
 
 	if (blockType == BlockType::ValType) {
-		auto valType = ValType::fromInt(operandB);
+		auto valType = ValType::fromEncoded(operandB);
 		assert(valType.isValid());
 		out << " " << valType.name();
 		return;
@@ -1485,12 +2422,53 @@ void Instruction::printBlockTypeInstruction(std::ostream& out) const
 }
 
 
+void Instruction::printAtomicMemoryInstruction(std::ostream& out) const
+{
+	out << type.name() << " Alignment: " << operandA << " Offset: " << operandB;
+}
+
+void Instruction::printVectorInstruction(std::ostream& out) const
+{
+	out << type.name();
+
+	using IT = InstructionType;
+	if (type == IT::V128Const || type == IT::I8x16Shuffle) {
+		out << " [" << std::hex;
+		for (auto byte : vectorImmediate()) {
+			out << " " << (u32)byte;
+		}
+		out << std::dec << " ]";
+		return;
+	}
+
+	if (type.isVectorMemory()) {
+		out << " Alignment: " << operandA << " Offset: " << operandB;
+	}
+
+	// Lane instructions have a lane byte with or without a memory argument
+	auto operandSize = toVectorOperation().operandSizeInBytes();
+	if (operandSize == 1 || operandSize == 5) {
+		out << " Lane: " << vectorLaneIndex();
+	}
+}
+
 void Instruction::print(std::ostream& out, const BufferSlice& data) const
 {
 	using IT = InstructionType;
+	if (type.isAtomicMemory()) {
+		printAtomicMemoryInstruction(out);
+		return;
+	}
+
+	if (type.isVector()) {
+		printVectorInstruction(out);
+		return;
+	}
+
 	switch (type) {
 	case IT::Unreachable:
 	case IT::NoOperation:
+	case IT::AtomicFence:
 		out << type.name();
 		break;
 	case IT::Block:
@@ -1504,6 +2482,8 @@ void Instruction::print(std::ostream& out, const BufferSlice& data) const
 		break;
 	case IT::Branch:
 	case IT::BranchIf:
+	case IT::BranchOnNull:
+	case IT::BranchOnNonNull:
 		out << type.name() << " Label: " << operandA;
 		break;
 	case IT::BranchTable:
@@ -1513,11 +2493,17 @@ void Instruction::print(std::ostream& out, const BufferSlice& data) const
 		out << type.name();
 		break;
 	case IT::Call: 
+	case IT::ReturnCall:
 		out << type.name() << " Function: " << operandA;
 		break;
 	case IT::CallIndirect: 
+	case IT::ReturnCallIndirect:
 		out << type.name() << " Type: " << operandA << " Table: " << operandB;
 		break;
+	case IT::CallReference:
+	case IT::ReturnCallReference:
+		out << type.name() << " Type: " << operandA;
+		break;
 	case IT::Drop:
 	case IT::Select:
 		out << type.name();
@@ -1532,9 +2518,10 @@ void Instruction::print(std::ostream& out, const BufferSlice& data) const
 		out << type.name() << " " << operandA;
 		break;
 	case IT::ReferenceNull:
-		out << type.name() << " Type: " << ValType::fromInt(operandA).name();
+		out << type.name() << " Type: " << referenceType().name();
 		break;
 	case IT::ReferenceIsNull:
+	case IT::ReferenceAsNonNull:
 		out << type.name();
 		break;
 	case IT::ReferenceFunction:
@@ -1779,25 +2766,58 @@ ModuleGlobalIndex Instruction::globalIndex() const
 }
 
 ModuleFunctionIndex Instruction::functionIndex() const {
-	assert(type == InstructionType::Call || type == InstructionType::CallIndirect);
+	assert(type == InstructionType::Call || type == InstructionType::CallIndirect || type == InstructionType::ReturnCall || type == InstructionType::ReturnCallIndirect || type == InstructionType::ReferenceFunction);
 	return ModuleFunctionIndex{ operandA };
 }
 
 u32 Instruction::memoryOffset() const
 {
-	assert(type.isMemory());
+	assert(type.isMemory() || type.isAtomicMemory() || type.isVectorMemory());
 	return operandB;
 }
 
+u32 Instruction::vectorLaneIndex() const
+{
+	assert(type.isVector());
+	// Memory lane instructions keep their memory argument in the first two operands
+	return type.isVectorMemory() ? operandC : operandA;
+}
+
+std::span<const u8, 16> Instruction::vectorImmediate() const
+{
+	assert(type == InstructionType::V128Const || type == InstructionType::I8x16Shuffle);
+	return std::span<const u8, 16>{ vectorPointer, 16 };
+}
+
+VectorOperation Instruction::toVectorOperation() const
+{
+	// Vector operations mirror the vector instruction types in the same order
+	static_assert((u32)VectorOperation::F64x2ConvertLowI32x4U == InstructionType::F64x2ConvertLowI32x4U - InstructionType::V128Load);
+	assert(type.isVector());
+	return VectorOperation::fromInt(type - InstructionType::V128Load);
+}
+
 ModuleDataIndex Instruction::dataSegmentIndex() const
 {
 	assert(type == InstructionType::MemoryInit || type == InstructionType::DataDrop);
 	return ModuleDataIndex{ operandA };
 }
 
+ModuleTypeIndex Instruction::callTypeIndex() const
+{
+	assert(type == InstructionType::CallReference || type == InstructionType::ReturnCallReference);
+	return ModuleTypeIndex{ operandA };
+}
+
+ValType Instruction::referenceType() const
+{
+	assert(type == InstructionType::ReferenceNull);
+	return ValType::fromEncoded(operandA);
+}
+
 ModuleTableIndex Instruction::callTableIndex() const
 {
-	assert(type == InstructionType::CallIndirect);
+	assert(type == InstructionType::CallIndirect || type == InstructionType::ReturnCallIndirect);
 	return ModuleTableIndex{ operandB };
 }
 
@@ -1825,6 +2845,12 @@ i32 Instruction::asI32Constant() const
 	return i32Constant;
 }
 
+i64 Instruction::asI64Constant() const
+{
+	assert(type == InstructionType::I64Const);
+	return i64Constant;
+}
+
 u32 Instruction::asIF32Constant() const
 {
 	assert(type == InstructionType::I32Const || type == InstructionType::F32Const); 
@@ -1847,13 +2873,12 @@ std::optional<ModuleFunctionIndex> Instruction::asReferenceIndex() const
 	return {};
 }
 
-std::span<const u8> Instruction::selectTypeVector(const BufferSlice& data) const
+BufferIterator Instruction::selectTypeVector(const BufferSlice& data) const
 {
 	assert(type == InstructionType::SelectFrom);
 	auto it = const_cast<BufferSlice&>(data).iterator();
 	it.moveTo(vectorPointer);
-	auto numTypes = it.nextU32();
-	return { it.positionPointer(), numTypes };
+	return it;
 }
 
 BufferIterator Instruction::branchTableVector(const BufferSlice& data) const
@@ -1868,6 +2893,10 @@ std::optional<Bytecode> Instruction::toBytecode() const
 {
 	using IT = InstructionType;
 	using BA = Bytecode;
+	if (type.isVector()) {
+		return BA::VectorInstruction;
+	}
+
 	switch (type) {
 		case IT::Unreachable: return BA::Unreachable;
 		case IT::NoOperation:
@@ -1883,6 +2912,11 @@ std::optional<Bytecode> Instruction::toBytecode() const
 		case IT::Return: return {};
 		case IT::Call: return BA::Call;
 		case IT::CallIndirect: return BA::CallIndirect;
+		case IT::ReturnCall:
+		case IT::ReturnCallIndirect:
+			return {};
+		case IT::CallReference: return BA::CallReference;
+		case IT::ReturnCallReference: return {};
 		case IT::Drop:
 		case IT::Select:
 		case IT::SelectFrom:
@@ -1896,6 +2930,10 @@ std::optional<Bytecode> Instruction::toBytecode() const
 		case IT::ReferenceIsNull:
 		case IT::ReferenceFunction:
 			return {};
+		case IT::ReferenceAsNonNull: return BA::ReferenceAsNonNull;
+		case IT::BranchOnNull:
+		case IT::BranchOnNonNull:
+			return {};
 		case IT::TableGet: return BA::TableGet;
 		case IT::TableSet: return BA::TableSet;
 		case IT::TableInit: return BA::TableInit;
@@ -2077,11 +3115,89 @@ std::optional<Bytecode> Instruction::toBytecode() const
 		case IT::I64TruncateSaturateF32U: return BA::I64TruncateSaturateF32U;
 		case IT::I64TruncateSaturateF64S: return BA::I64TruncateSaturateF64S;
 		case IT::I64TruncateSaturateF64U: return BA::I64TruncateSaturateF64U;
+		case IT::AtomicFence: return BA::AtomicFence;
+		case IT::MemoryAtomicNotify: return BA::MemoryAtomicNotify;
+		case IT::MemoryAtomicWait32: return BA::MemoryAtomicWait32;
+		case IT::MemoryAtomicWait64: return BA::MemoryAtomicWait64;
+		case IT::I32AtomicLoad: return BA::I32AtomicLoad;
+		case IT::I64AtomicLoad: return BA::I64AtomicLoad;
+		case IT::I32AtomicLoad8u: return BA::I32AtomicLoad8u;
+		case IT::I32AtomicLoad16u: return BA::I32AtomicLoad16u;
+		case IT::I64AtomicLoad8u: return BA::I64AtomicLoad8u;
+		case IT::I64AtomicLoad16u: return BA::I64AtomicLoad16u;
+		case IT::I64AtomicLoad32u: return BA::I64AtomicLoad32u;
+		case IT::I32AtomicStore: return BA::I32AtomicStore;
+		case IT::I64AtomicStore: return BA::I64AtomicStore;
+		case IT::I32AtomicStore8: return BA::I32AtomicStore8;
+		case IT::I32AtomicStore16: return BA::I32AtomicStore16;
+		case IT::I64AtomicStore8: return BA::I64AtomicStore8;
+		case IT::I64AtomicStore16: return BA::I64AtomicStore16;
+		case IT::I64AtomicStore32: return BA::I64AtomicStore32;
+		case IT::I32AtomicRmwAdd:
+		case IT::I32AtomicRmwSubtract:
+		case IT::I32AtomicRmwAnd:
+		case IT::I32AtomicRmwOr:
+		case IT::I32AtomicRmwXor:
+		case IT::I32AtomicRmwExchange:
+			return BA::I32AtomicRmw;
+		case IT::I64AtomicRmwAdd:
+		case IT::I64AtomicRmwSubtract:
+		case IT::I64AtomicRmwAnd:
+		case IT::I64AtomicRmwOr:
+		case IT::I64AtomicRmwXor:
+		case IT::I64AtomicRmwExchange:
+			return BA::I64AtomicRmw;
+		case IT::I32AtomicRmw8AddU:
+		case IT::I32AtomicRmw8SubtractU:
+		case IT::I32AtomicRmw8AndU:
+		case IT::I32AtomicRmw8OrU:
+		case IT::I32AtomicRmw8XorU:
+		case IT::I32AtomicRmw8ExchangeU:
+			return BA::I32AtomicRmw8u;
+		case IT::I32AtomicRmw16AddU:
+		case IT::I32AtomicRmw16SubtractU:
+		case IT::I32AtomicRmw16AndU:
+		case IT::I32AtomicRmw16OrU:
+		case IT::I32AtomicRmw16XorU:
+		case IT::I32AtomicRmw16ExchangeU:
+			return BA::I32AtomicRmw16u;
+		case IT::I64AtomicRmw8AddU:
+		case IT::I64AtomicRmw8SubtractU:
+		case IT::I64AtomicRmw8AndU:
+		case IT::I64AtomicRmw8OrU:
+		case IT::I64AtomicRmw8XorU:
+		case IT::I64AtomicRmw8ExchangeU:
+			return BA::I64AtomicRmw8u;
+		case IT::I64AtomicRmw16AddU:
+		case IT::I64AtomicRmw16SubtractU:
+		case IT::I64AtomicRmw16AndU:
+		case IT::I64AtomicRmw16OrU:
+		case IT::I64AtomicRmw16XorU:
+		case IT::I64AtomicRmw16ExchangeU:
+			return BA::I64AtomicRmw16u;
+		case IT::I64AtomicRmw32AddU:
+		case IT::I64AtomicRmw32SubtractU:
+		case IT::I64AtomicRmw32AndU:
+		case IT::I64AtomicRmw32OrU:
+		case IT::I64AtomicRmw32XorU:
+		case IT::I64AtomicRmw32ExchangeU:
+			return BA::I64AtomicRmw32u;
+		case IT::I32AtomicRmwCompareExchange: return BA::I32AtomicRmwCompareExchange;
+		case IT::I64AtomicRmwCompareExchange: return BA::I64AtomicRmwCompareExchange;
+		case IT::I32AtomicRmw8CompareExchangeU: return BA::I32AtomicRmw8CompareExchangeU;
+		case IT::I32AtomicRmw16CompareExchangeU: return BA::I32AtomicRmw16CompareExchangeU;
+		case IT::I64AtomicRmw8CompareExchangeU: return BA::I64AtomicRmw8CompareExchangeU;
+		case IT::I64AtomicRmw16CompareExchangeU: return BA::I64AtomicRmw16CompareExchangeU;
+		case IT::I64AtomicRmw32CompareExchangeU: return BA::I64AtomicRmw32CompareExchangeU;
 	}
 }
 
 u32 Instruction::maxPrintedByteLength(const BufferSlice& data) const
 {
+	if (type.isVector()) {
+		return 2+ toVectorOperation().operandSizeInBytes();
+	}
+
 	auto bytecode = toBytecode();
 	if (bytecode.has_value()) {
 		return 1+ bytecode->arguments().sizeInBytes();
@@ -2099,21 +3215,28 @@ u32 Instruction::maxPrintedByteLength(const BufferSlice& data) const
 	case IT::End:
 		return 0;
 	case IT::Branch:
+		return 19; // Fuel charge, drop-keep and far jump
 	case IT::BranchIf:
-		return 5; // Far jump
+		return 21; // Fuel charge, short skip, drop-keep and far jump
 	case IT::BranchTable: {
 		auto numLabels = branchTableVector(data).nextU32();
-		return 9 + numLabels * 4;
+		// Fuel charge, table and a drop-keep trampoline for each label
+		return 14 + numLabels * 4 + (numLabels + 1) * 14;
 	}
-	case IT::Return: return 5;
+	case IT::Return: return 14; // Fuel charge and return
+	case IT::ReturnCall:
+	case IT::ReturnCallIndirect:
+		return 19; // Host functions are called followed by a fuel charge and a return
+	case IT::ReturnCallReference:
+		return 11; // Host functions are followed by a fuel charge and a return
 	case IT::Drop:
 	case IT::Select:
 	case IT::SelectFrom:
-		return 1;
+		return 2; // Vectors need two bytes
 	case IT::LocalGet:
 	case IT::LocalSet:
 	case IT::LocalTee:
-		return 5;
+		return 6; // Vectors use the long form with an operation byte
 	case IT::GlobalGet:
 	case IT::GlobalSet:
 		return 9;
@@ -2122,6 +3245,9 @@ u32 Instruction::maxPrintedByteLength(const BufferSlice& data) const
 		return 9;
 	case IT::ReferenceIsNull:
 		return 1;
+	case IT::BranchOnNull:
+	case IT::BranchOnNonNull:
+		return 23; // Fuel charge, null test, short skip, drop and branch exit
 	case IT::I32Load:
 	case IT::I64Load:
 	case IT::F32Load:
@@ -2156,9 +3282,7 @@ std::optional<ValType> InstructionType::constantType() const
 	case InstructionType::I64Const: return ValType::I64;
 	case InstructionType::F32Const: return ValType::F32;
 	case InstructionType::F64Const: return ValType::F64;
-	case InstructionType::ReferenceNull: return ValType::FuncRef;
-	case InstructionType::ReferenceFunction: return ValType::FuncRef;
-		// GlobalGet has to be handled manually be the caller
+		// GlobalGet and reference instructions have to be handled manually be the caller
 	}
 
 	return {};
@@ -24,6 +24,10 @@ namespace WASM {
 			Return,
 			Call,
 			CallIndirect,
+			ReturnCall,
+			ReturnCallIndirect,
+			CallReference,
+			ReturnCallReference,
 			Drop,
 			Select,
 			SelectFrom,
@@ -35,6 +39,9 @@ namespace WASM {
 			ReferenceNull,
 			ReferenceIsNull,
 			ReferenceFunction,
+			ReferenceAsNonNull,
+			BranchOnNull,
+			BranchOnNonNull,
 			TableGet,
 			TableSet,
 			TableInit,
@@ -212,6 +219,309 @@ namespace WASM {
 			I64TruncateSaturateF32U,
 			I64TruncateSaturateF64S,
 			I64TruncateSaturateF64U,
+			AtomicFence,
+			MemoryAtomicNotify,
+			MemoryAtomicWait32,
+			MemoryAtomicWait64,
+			I32AtomicLoad,
+			I64AtomicLoad,
+			I32AtomicLoad8u,
+			I32AtomicLoad16u,
+			I64AtomicLoad8u,
+			I64AtomicLoad16u,
+			I64AtomicLoad32u,
+			I32AtomicStore,
+			I64AtomicStore,
+			I32AtomicStore8,
+			I32AtomicStore16,
+			I64AtomicStore8,
+			I64AtomicStore16,
+			I64AtomicStore32,
+			I32AtomicRmwAdd,
+			I64AtomicRmwAdd,
+			I32AtomicRmw8AddU,
+			I32AtomicRmw16AddU,
+			I64AtomicRmw8AddU,
+			I64AtomicRmw16AddU,
+			I64AtomicRmw32AddU,
+			I32AtomicRmwSubtract,
+			I64AtomicRmwSubtract,
+			I32AtomicRmw8SubtractU,
+			I32AtomicRmw16SubtractU,
+			I64AtomicRmw8SubtractU,
+			I64AtomicRmw16SubtractU,
+			I64AtomicRmw32SubtractU,
+			I32AtomicRmwAnd,
+			I64AtomicRmwAnd,
+			I32AtomicRmw8AndU,
+			I32AtomicRmw16AndU,
+			I64AtomicRmw8AndU,
+			I64AtomicRmw16AndU,
+			I64AtomicRmw32AndU,
+			I32AtomicRmwOr,
+			I64AtomicRmwOr,
+			I32AtomicRmw8OrU,
+			I32AtomicRmw16OrU,
+			I64AtomicRmw8OrU,
+			I64AtomicRmw16OrU,
+			I64AtomicRmw32OrU,
+			I32AtomicRmwXor,
+			I64AtomicRmwXor,
+			I32AtomicRmw8XorU,
+			I32AtomicRmw16XorU,
+			I64AtomicRmw8XorU,
+			I64AtomicRmw16XorU,
+			I64AtomicRmw32XorU,
+			I32AtomicRmwExchange,
+			I64AtomicRmwExchange,
+			I32AtomicRmw8ExchangeU,
+			I32AtomicRmw16ExchangeU,
+			I64AtomicRmw8ExchangeU,
+			I64AtomicRmw16ExchangeU,
+			I64AtomicRmw32ExchangeU,
+			I32AtomicRmwCompareExchange,
+			I64AtomicRmwCompareExchange,
+			I32AtomicRmw8CompareExchangeU,
+			I32AtomicRmw16CompareExchangeU,
+			I64AtomicRmw8CompareExchangeU,
+			I64AtomicRmw16CompareExchangeU,
+			I64AtomicRmw32CompareExchangeU,
+			V128Load,
+			V128Load8x8S,
+			V128Load8x8U,
+			V128Load16x4S,
+			V128Load16x4U,
+			V128Load32x2S,
+			V128Load32x2U,
+			V128Load8Splat,
+			V128Load16Splat,
+			V128Load32Splat,
+			V128Load64Splat,
+			V128Store,
+			V128Const,
+			I8x16Shuffle,
+			I8x16Swizzle,
+			I8x16Splat,
+			I16x8Splat,
+			I32x4Splat,
+			I64x2Splat,
+			F32x4Splat,
+			F64x2Splat,
+			I8x16ExtractLaneS,
+			I8x16ExtractLaneU,
+			I8x16ReplaceLane,
+			I16x8ExtractLaneS,
+			I16x8ExtractLaneU,
+			I16x8ReplaceLane,
+			I32x4ExtractLane,
+			I32x4ReplaceLane,
+			I64x2ExtractLane,
+			I64x2ReplaceLane,
+			F32x4ExtractLane,
+			F32x4ReplaceLane,
+			F64x2ExtractLane,
+			F64x2ReplaceLane,
+			I8x16Equal,
+			I8x16NotEqual,
+			I8x16LesserS,
+			I8x16LesserU,
+			I8x16GreaterS,
+			I8x16GreaterU,
+			I8x16LesserEqualS,
+			I8x16LesserEqualU,
+			I8x16GreaterEqualS,
+			I8x16GreaterEqualU,
+			I16x8Equal,
+			I16x8NotEqual,
+			I16x8LesserS,
+			I16x8LesserU,
+			I16x8GreaterS,
+			I16x8GreaterU,
+			I16x8LesserEqualS,
+			I16x8LesserEqualU,
+			I16x8GreaterEqualS,
+			I16x8GreaterEqualU,
+			I32x4Equal,
+			I32x4NotEqual,
+			I32x4LesserS,
+			I32x4LesserU,
+			I32x4GreaterS,
+			I32x4GreaterU,
+			I32x4LesserEqualS,
+			I32x4LesserEqualU,
+			I32x4GreaterEqualS,
+			I32x4GreaterEqualU,
+			F32x4Equal,
+			F32x4NotEqual,
+			F32x4Lesser,
+			F32x4Greater,
+			F32x4LesserEqual,
+			F32x4GreaterEqual,
+			F64x2Equal,
+			F64x2NotEqual,
+			F64x2Lesser,
+			F64x2Greater,
+			F64x2LesserEqual,
+			F64x2GreaterEqual,
+			V128Not,
+			V128And,
+			V128AndNot,
+			V128Or,
+			V128Xor,
+			V128BitSelect,
+			V128AnyTrue,
+			V128Load8Lane,
+			V128Load16Lane,
+			V128Load32Lane,
+			V128Load64Lane,
+			V128Store8Lane,
+			V128Store16Lane,
+			V128Store32Lane,
+			V128Store64Lane,
+			V128Load32Zero,
+			V128Load64Zero,
+			F32x4DemoteF64x2Zero,
+			F64x2PromoteLowF32x4,
+			I8x16Absolute,
+			I8x16Negate,
+			I8x16CountOnes,
+			I8x16AllTrue,
+			I8x16Bitmask,
+			I8x16NarrowI16x8S,
+			I8x16NarrowI16x8U,
+			F32x4Ceil,
+			F32x4Floor,
+			F32x4Truncate,
+			F32x4Nearest,
+			I8x16ShiftLeft,
+			I8x16ShiftRightS,
+			I8x16ShiftRightU,
+			I8x16Add,
+			I8x16AddSaturateS,
+			I8x16AddSaturateU,
+			I8x16Subtract,
+			I8x16SubtractSaturateS,
+			I8x16SubtractSaturateU,
+			F64x2Ceil,
+			F64x2Floor,
+			I8x16MinimumS,
+			I8x16MinimumU,
+			I8x16MaximumS,
+			I8x16MaximumU,
+			F64x2Truncate,
+			I8x16AverageU,
+			I16x8ExtendAddPairwiseI8x16S,
+			I16x8ExtendAddPairwiseI8x16U,
+			I32x4ExtendAddPairwiseI16x8S,
+			I32x4ExtendAddPairwiseI16x8U,
+			I16x8Absolute,
+			I16x8Negate,
+			I16x8Q15MultiplyRoundSaturateS,
+			I16x8AllTrue,
+			I16x8Bitmask,
+			I16x8NarrowI32x4S,
+			I16x8NarrowI32x4U,
+			I16x8ExtendLowI8x16S,
+			I16x8ExtendHighI8x16S,
+			I16x8ExtendLowI8x16U,
+			I16x8ExtendHighI8x16U,
+			I16x8ShiftLeft,
+			I16x8ShiftRightS,
+			I16x8ShiftRightU,
+			I16x8Add,
+			I16x8AddSaturateS,
+			I16x8AddSaturateU,
+			I16x8Subtract,
+			I16x8SubtractSaturateS,
+			I16x8SubtractSaturateU,
+			F64x2Nearest,
+			I16x8Multiply,
+			I16x8MinimumS,
+			I16x8MinimumU,
+			I16x8MaximumS,
+			I16x8MaximumU,
+			I16x8AverageU,
+			I16x8ExtendMultiplyLowI8x16S,
+			I16x8ExtendMultiplyHighI8x16S,
+			I16x8ExtendMultiplyLowI8x16U,
+			I16x8ExtendMultiplyHighI8x16U,
+			I32x4Absolute,
+			I32x4Negate,
+			I32x4AllTrue,
+			I32x4Bitmask,
+			I32x4ExtendLowI16x8S,
+			I32x4ExtendHighI16x8S,
+			I32x4ExtendLowI16x8U,
+			I32x4ExtendHighI16x8U,
+			I32x4ShiftLeft,
+			I32x4ShiftRightS,
+			I32x4ShiftRightU,
+			I32x4Add,
+			I32x4Subtract,
+			I32x4Multiply,
+			I32x4MinimumS,
+			I32x4MinimumU,
+			I32x4MaximumS,
+			I32x4MaximumU,
+			I32x4DotI16x8S,
+			I32x4ExtendMultiplyLowI16x8S,
+			I32x4ExtendMultiplyHighI16x8S,
+			I32x4ExtendMultiplyLowI16x8U,
+			I32x4ExtendMultiplyHighI16x8U,
+			I64x2Absolute,
+			I64x2Negate,
+			I64x2AllTrue,
+			I64x2Bitmask,
+			I64x2ExtendLowI32x4S,
+			I64x2ExtendHighI32x4S,
+			I64x2ExtendLowI32x4U,
+			I64x2ExtendHighI32x4U,
+			I64x2ShiftLeft,
+			I64x2ShiftRightS,
+			I64x2ShiftRightU,
+			I64x2Add,
+			I64x2Subtract,
+			I64x2Multiply,
+			I64x2Equal,
+			I64x2NotEqual,
+			I64x2LesserS,
+			I64x2GreaterS,
+			I64x2LesserEqualS,
+			I64x2GreaterEqualS,
+			I64x2ExtendMultiplyLowI32x4S,
+			I64x2ExtendMultiplyHighI32x4S,
+			I64x2ExtendMultiplyLowI32x4U,
+			I64x2ExtendMultiplyHighI32x4U,
+			F32x4Absolute,
+			F32x4Negate,
+			F32x4SquareRoot,
+			F32x4Add,
+			F32x4Subtract,
+			F32x4Multiply,
+			F32x4Divide,
+			F32x4Minimum,
+			F32x4Maximum,
+			F32x4PseudoMinimum,
+			F32x4PseudoMaximum,
+			F64x2Absolute,
+			F64x2Negate,
+			F64x2SquareRoot,
+			F64x2Add,
+			F64x2Subtract,
+			F64x2Multiply,
+			F64x2Divide,
+			F64x2Minimum,
+			F64x2Maximum,
+			F64x2PseudoMinimum,
+			F64x2PseudoMaximum,
+			I32x4TruncateSaturateF32x4S,
+			I32x4TruncateSaturateF32x4U,
+			F32x4ConvertI32x4S,
+			F32x4ConvertI32x4U,
+			I32x4TruncateSaturateF64x2SZero,
+			I32x4TruncateSaturateF64x2UZero,
+			F64x2ConvertLowI32x4S,
+			F64x2ConvertLowI32x4U,
 
 			NumberOfItems
 		};
@@ -226,11 +536,16 @@ namespace WASM {
 		bool isUnary() const;
 		bool isBlock() const;
 		bool isMemory() const;
+		bool isAtomicMemory() const;
+		bool isVector() const;
+		bool isVectorMemory() const;
 		bool requiresMemoryInstance() const;
 		bool isBitCastConversionOnly() const;
 		std::optional<ValType> operandType() const;
 		std::optional<ValType> resultType() const;
 		std::optional<ValType> constantType() const;
+		std::optional<AtomicOperation> atomicOperation() const;
+		u32 atomicAccessSizeInBytes() const;
 
 		const char* name() const;
 	};
@@ -297,16 +612,22 @@ namespace WASM {
 		ModuleTableIndex tableIndex() const;
 		u32 memoryOffset() const;
 		ModuleDataIndex dataSegmentIndex() const;
+		ModuleTypeIndex callTypeIndex() const;
+		ValType referenceType() const;
 		ModuleTableIndex callTableIndex() const;
 		ModuleElementIndex elementIndex() const;
 		ModuleTableIndex sourceTableIndex() const;
+		u32 vectorLaneIndex() const;
+		std::span<const u8, 16> vectorImmediate() const;
+		VectorOperation toVectorOperation() const;
 
 		i32 asI32Constant() const;
+		i64 asI64Constant() const;
 		u32 asIF32Constant() const;
 		u64 asIF64Constant() const;
 		std::optional<ModuleFunctionIndex> asReferenceIndex() const;
 
-		std::span<const u8> selectTypeVector(const BufferSlice&) const;
+		BufferIterator selectTypeVector(const BufferSlice&) const;
 		BufferIterator branchTableVector(const BufferSlice&) const;
 
 		std::optional<Bytecode> toBytecode() const;
@@ -316,10 +637,14 @@ namespace WASM {
 		static Instruction parseBlockTypeInstruction(InstructionType, BufferIterator&);
 		static Instruction parseBranchTableInstruction(BufferIterator&);
 		static Instruction parseSelectVectorInstruction(BufferIterator&);
+		static Instruction parseAtomicMemoryInstruction(InstructionType, BufferIterator&);
+		static Instruction parseVectorInstruction(InstructionType, BufferIterator&);
 
 		void printBlockTypeInstruction(std::ostream&) const;
 		void printBranchTableInstruction(std::ostream&, const BufferSlice&) const;
 		void printSelectVectorInstruction(std::ostream&, const BufferSlice&) const;
+		void printAtomicMemoryInstruction(std::ostream&) const;
+		void printVectorInstruction(std::ostream&) const;
 
 		InstructionType type;
 		u32 operandC;
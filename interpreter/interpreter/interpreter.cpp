@@ -4,14 +4,39 @@
 #include <iomanip>
 #include <cassert>
 #include <bit>
+#include <algorithm>
+#include <atomic>
 
 #include "interpreter.h"
 #include "introspection.h"
 #include "bytecode.h"
 #include "error.h"
+#include "simd.h"
 
 using namespace WASM;
 
+static u32* pushValuesToStack(u32* stackPointer, std::span<Value> values, bool alignedStack)
+{
+	for (auto& value : values) {
+		auto numBytes = value.sizeInBytes();
+		if (numBytes == 4) {
+			*stackPointer = value.as<u32>();
+		}
+		else if (numBytes == 8) {
+			*reinterpret_cast<u64*>(stackPointer) = value.as<u64>();
+		}
+		else if (numBytes == 16) {
+			value.copyVectorTo(stackPointer);
+		}
+		else {
+			throw std::runtime_error{ "Only 32bit, 64bit and 128bit values are supported" };
+		}
+		stackPointer += value.type().stackSizeInBytes(alignedStack) / 4;
+	}
+
+	return stackPointer;
+}
+
 template<typename U, typename T>
 __forceinline U truncateSaturate(T x) {
 	if (std::isnan(x)) {
@@ -29,6 +54,19 @@ __forceinline U truncateSaturate(T x) {
 	return x;
 }
 
+template<typename T>
+__forceinline T atomicReadModifyWrite(std::atomic_ref<T> reference, u32 operation, T operand) {
+	switch (operation) {
+	case AtomicOperation::Add: return reference.fetch_add(operand);
+	case AtomicOperation::Subtract: return reference.fetch_sub(operand);
+	case AtomicOperation::And: return reference.fetch_and(operand);
+	case AtomicOperation::Or: return reference.fetch_or(operand);
+	case AtomicOperation::Xor: return reference.fetch_xor(operand);
+	case AtomicOperation::Exchange: return reference.exchange(operand);
+	default: assert(false); return 0;
+	}
+}
+
 
 HostFunctionBase::HostFunctionBase(ModuleFunctionIndex idx, FunctionType ft)
 	: Function{ idx }, mFunctionType { std::move(ft) } {}
@@ -51,7 +89,7 @@ void Interpreter::loadModule(std::string path)
 	auto introspector = Nullable<Introspector>::fromPointer(attachedIntrospector);
 
 	auto buffer = Buffer::fromFile(path);
-	ModuleParser parser{ introspector };
+	ModuleParser parser{ introspector, loadedFunctionTypes };
 	parser.parse(std::move(buffer), std::move(path));
 
 	ModuleValidator validator{ introspector };
@@ -94,9 +132,85 @@ void Interpreter::compileAndLinkModules()
 		compiler.compile();
 	}
 
+	layoutBytecode();
+
 	hasLinkedAndCompiled = true;
 }
 
+void Interpreter::enableHotColdBytecodeLayout(bool enable)
+{
+	// The bytecode is laid out once when compiling
+	if (hasLinkedAndCompiled) {
+		throw std::runtime_error{ "Cannot change bytecode layout after linking step" };
+	}
+
+	useHotColdBytecodeLayout = enable;
+}
+
+void Interpreter::enableFuelMetering(bool enable)
+{
+	// The fuel charges are compiled into the bytecode
+	if (hasLinkedAndCompiled) {
+		throw std::runtime_error{ "Cannot change fuel metering after linking step" };
+	}
+
+	useFuelMetering = enable;
+}
+
+void Interpreter::enableAlignedBytecode(bool enable)
+{
+	// The operand padding and the stack slot offsets are compiled into the bytecode
+	if (hasLinkedAndCompiled) {
+		throw std::runtime_error{ "Cannot change bytecode operand alignment after linking step" };
+	}
+
+	useAlignedBytecode = enable;
+}
+
+void Interpreter::enableFunctionInlining(bool enable)
+{
+	// Small functions are inlined into their callers when compiling
+	if (hasLinkedAndCompiled) {
+		throw std::runtime_error{ "Cannot change function inlining after linking step" };
+	}
+
+	useFunctionInlining = enable;
+}
+
+void Interpreter::enableOptimizer(bool enable)
+{
+	// Hot functions are optimized before they are compiled
+	if (hasLinkedAndCompiled) {
+		throw std::runtime_error{ "Cannot change optimizer after linking step" };
+	}
+
+	useOptimizer = enable;
+}
+
+void Interpreter::useOptimizerProfile(const BytecodeCounter& counter)
+{
+	// The counts of a previous run replace the estimate of which functions are hot
+	if (hasLinkedAndCompiled) {
+		throw std::runtime_error{ "Cannot change optimizer profile after linking step" };
+	}
+
+	optimizerProfile = counter;
+}
+
+void Interpreter::addFuel(u64 amount)
+{
+	if (!useFuelMetering) {
+		throw std::runtime_error{ "Cannot add fuel without fuel metering enabled" };
+	}
+
+	if (amount > (u64)std::numeric_limits<i64>::max() - fuelRemaining) {
+		throw std::runtime_error{ "Fuel overflow" };
+	}
+
+	fuelRemaining += amount;
+	fuelAdded += amount;
+}
+
 FunctionHandle WASM::Interpreter::functionByName(std::string_view moduleName, std::string_view functionName)
 {
 	// FIXME: This std::string allocation is only required becaude ::find does not accept string_view keys
@@ -126,6 +240,140 @@ void Interpreter::attachIntrospector(std::unique_ptr<Introspector> introspector)
 	attachedIntrospector = std::move(introspector);
 }
 
+void Interpreter::attachProfiler(SamplingProfiler& profiler)
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot attach profiler while interpreting" };
+	}
+
+	attachedProfiler = profiler;
+}
+
+void Interpreter::detachProfiler()
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot detach profiler while interpreting" };
+	}
+
+	attachedProfiler.clear();
+}
+
+void Interpreter::attachBytecodeCounter(BytecodeCounter& counter)
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot attach bytecode counter while interpreting" };
+	}
+
+	attachedBytecodeCounter = counter;
+}
+
+void Interpreter::detachBytecodeCounter()
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot detach bytecode counter while interpreting" };
+	}
+
+	attachedBytecodeCounter.clear();
+}
+
+void Interpreter::setMemoryBoundsMode(MemoryBoundsMode mode)
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot change memory bounds mode while interpreting" };
+	}
+
+	memoryBoundsMode = mode;
+}
+
+void Interpreter::enableLiveTracing(bool enable)
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot change live tracing while interpreting" };
+	}
+
+	allowLiveTracing = enable;
+}
+
+void Interpreter::attachExecutionTracer(std::shared_ptr<ExecutionTracer> tracer)
+{
+	// May be called from any thread. Without live tracing enabled the tracer
+	// only gets swapped when the next function is run.
+	std::scoped_lock lock{ tracerMutex };
+	requestedTracer = std::move(tracer);
+	safepointRequests.fetch_or(SafepointRequest::SwitchTracer, std::memory_order_release);
+}
+
+void Interpreter::detachExecutionTracer()
+{
+	attachExecutionTracer({});
+}
+
+void Interpreter::enableInterrupts(bool enable)
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Cannot change interrupts while interpreting" };
+	}
+
+	allowInterrupts = enable;
+}
+
+void Interpreter::interrupt()
+{
+	// May be called from any thread. If no function is running, the next one that
+	// is run gets interrupted at its first safepoint.
+	if (!allowInterrupts) {
+		throw std::runtime_error{ "Cannot interrupt without interrupts enabled" };
+	}
+
+	safepointRequests.fetch_or(SafepointRequest::Interrupt, std::memory_order_release);
+}
+
+void Interpreter::requestYield()
+{
+	// May be called from any thread. The running function is suspended at its next
+	// safepoint and returned as a yielded call by runResumableFunction().
+	if (!allowInterrupts) {
+		throw std::runtime_error{ "Cannot yield without interrupts enabled" };
+	}
+
+	safepointRequests.fetch_or(SafepointRequest::Yield, std::memory_order_release);
+}
+
+void Interpreter::setDeadline(std::chrono::steady_clock::time_point time)
+{
+	if (!allowInterrupts) {
+		throw std::runtime_error{ "Cannot set deadline without interrupts enabled" };
+	}
+
+	// Setting a new deadline drops an expiry left over from an old one
+	{
+		std::scoped_lock lock{ deadlineMutex };
+		deadline = time;
+		safepointRequests.fetch_and(~(u32)SafepointRequest::DeadlineExpired, std::memory_order_relaxed);
+	}
+
+	if (!deadlineTimerThread.joinable()) {
+		deadlineTimerThread = std::jthread{ [this](std::stop_token stopToken) {
+			runDeadlineTimer(stopToken);
+		} };
+	}
+
+	deadlineCondition.notify_all();
+}
+
+void Interpreter::clearDeadline()
+{
+	// The deadline might have passed after the guarded call returned, which must
+	// not interrupt the next call. Interrupts requested explicitly are kept.
+	{
+		std::scoped_lock lock{ deadlineMutex };
+		deadline.reset();
+		safepointRequests.fetch_and(~(u32)SafepointRequest::DeadlineExpired, std::memory_order_relaxed);
+	}
+
+	deadlineCondition.notify_all();
+}
+
 void Interpreter::registerModuleName(NonNull<ModuleBase> module)
 {
 	auto result = moduleNameMap.emplace(module->name(), module);
@@ -145,7 +393,40 @@ void Interpreter::registerModuleName(NonNull<ModuleBase> module)
 	}
 }
 
+void Interpreter::layoutBytecode()
+{
+	std::vector<BytecodeArena::Entry> functions;
+	functions.reserve(allFunctions.size());
+	for (auto& module : wasmModules) {
+		for (auto& function : module.functions()) {
+			functions.emplace_back(function, module);
+		}
+	}
+
+	// Place the functions that are called most and contain loops at the front, so
+	// that the hot code shares as few pages as possible. The estimate is only
+	// based on the static number of call sites and loops of each function.
+	if (useHotColdBytecodeLayout) {
+		std::stable_sort(functions.begin(), functions.end(), [](auto& a, auto& b) {
+			return a.function->estimatedHotness() > b.function->estimatedHotness();
+		});
+	}
+
+	bytecodeArena = BytecodeArena{ functions };
+}
+
 ValuePack Interpreter::executeFunction(Function& function, std::span<Value> values)
+{
+	auto result = executeResumableFunction(function, values);
+	auto valuePack = std::get_if<ValuePack>(&result);
+	if (!valuePack) {
+		throw std::runtime_error{ "Host function suspended a call that is not resumable" };
+	}
+
+	return *valuePack;
+}
+
+ResumableResult Interpreter::executeResumableFunction(Function& function, std::span<Value> values)
 {
 	if (isInterpreting) {
 		throw std::runtime_error{ "Recursive interpretation loops are currently not supported" };
@@ -157,22 +438,146 @@ ValuePack Interpreter::executeFunction(Function& function, std::span<Value> valu
 
 	auto bytecodeFunction = function.asBytecodeFunction();
 	if (bytecodeFunction.has_value()) {
-		return runInterpreterLoop(*bytecodeFunction, values);
+		pushEntryFrame(*bytecodeFunction, values);
+		return runConfiguredInterpreterLoop(*bytecodeFunction);
 	}
 
-	if (!mStackBase) {
-		// FIXME: Do not hardcode stack size
-		mStackBase= std::make_unique<u32[]>(4096);
-	}
+	acquireStack();
 
 	auto hostFunction = function.asHostFunction();
 	assert(hostFunction.has_value());
-	auto stackPointer= hostFunction->executeFunction(values, mStackBase.get());
+	auto stackPointer= hostFunction->executeFunction(values, mStackBase.get(), useAlignedBytecode);
+	if (!stackPointer) {
+		throw std::runtime_error{ "Host function cannot suspend without a calling guest function" };
+	}
 
-	return ValuePack{ function.functionType(), true, {mStackBase.get(), (sizeType)(stackPointer - mStackBase.get())} };
+	return ValuePack{ function.functionType(), true, {mStackBase.get(), (sizeType)(stackPointer - mStackBase.get())}, useAlignedBytecode };
 
 }
 
+ResumableResult Interpreter::resumeFunction(SuspendedCall call, std::span<Value> results)
+{
+	if (isInterpreting) {
+		throw std::runtime_error{ "Recursive interpretation loops are currently not supported" };
+	}
+
+	if (!call.mStackBase) {
+		throw std::runtime_error{ "Suspended call was already resumed" };
+	}
+
+	// The stack refers to functions and memories owned by the suspending interpreter
+	if (call.mInterpreter != this) {
+		throw std::runtime_error{ "Suspended call belongs to a different interpreter" };
+	}
+
+	// Yielded calls do not expect any results
+	auto pendingFunction = call.pendingFunction();
+	if (pendingFunction.has_value() ? !pendingFunction->functionType().returnsValuesAsResults(results) : !results.empty()) {
+		throw std::runtime_error{ "Invalid results provided to suspended call" };
+	}
+
+	// Continue on the stack of the suspended call as if the host function returned
+	releaseStack(std::move(mStackBase));
+	mStackBase = std::move(call.mStackBase);
+
+	auto stackPointer = pushValuesToStack(call.mStackPointer, results, useAlignedBytecode);
+	saveState(call.mInstructionPointer, stackPointer, call.mFramePointer, call.mMemoryPointer);
+
+	return runConfiguredInterpreterLoop(*call.mEntryFunction);
+}
+
+ResumableResult Interpreter::runConfiguredInterpreterLoop(const BytecodeFunction& function)
+{
+	assert(!isInterpreting);
+	isInterpreting = true;
+
+	// Traps and interrupts unwind all frames of the call, which leaves the
+	// interpreter ready to run the next function
+	try {
+		// Resumed calls have already entered the function
+		updateActiveTracer();
+		if (activeTracer && mInstructionPointer == function.bytecode().begin()) {
+			auto lookup = findFunctionByBytecodePointer(function.bytecode().begin());
+			assert(lookup.has_value());
+			activeTracer->onFunctionEnter(function, lookup->module);
+		}
+
+		// Only sample the time spent in the loop
+		if (attachedProfiler.has_value()) {
+			attachedProfiler->discardPendingSamples();
+		}
+
+		// A loop variant returns without a result when it stopped at a safepoint. The
+		// state is saved, so that execution continues in the newly selected variant.
+		while (true) {
+			auto result = runSelectedInterpreterLoop(function);
+			if (result.has_value()) {
+				isInterpreting = false;
+				return *result;
+			}
+
+			// Hand the stack and the saved state over to the caller
+			if (pendingHostFunction.has_value() || handleSafepointRequests()) {
+				SuspendedCall call{ *this, std::move(mStackBase), function, pendingHostFunction };
+				call.mInstructionPointer = mInstructionPointer;
+				call.mStackPointer = mStackPointer;
+				call.mFramePointer = mFramePointer;
+				call.mMemoryPointer = mMemoryPointer;
+
+				pendingHostFunction.clear();
+				isInterpreting = false;
+				return call;
+			}
+		}
+	}
+	catch (...) {
+		saveState(nullptr, mStackBase.get(), mStackBase.get(), nullptr);
+		pendingHostFunction.clear();
+		isInterpreting = false;
+		throw;
+	}
+}
+
+std::optional<ValuePack> Interpreter::runSelectedInterpreterLoop(const BytecodeFunction& function)
+{
+	// Turn each runtime option into a compile time flag of the loop policy one
+	// after the other. Without any options set the default policy is used.
+	auto withBoundsMode = [&](auto instrumented, auto pollSafepoints) {
+		constexpr bool Instrumented = decltype(instrumented)::value;
+		constexpr bool PollSafepoints = decltype(pollSafepoints)::value;
+
+		auto withOperandAlignment = [&](auto boundsMode) {
+			constexpr MemoryBoundsMode::TEnum BoundsMode = decltype(boundsMode)::value;
+			if (useAlignedBytecode) {
+				return runInterpreterLoop<LoopPolicy<Instrumented, PollSafepoints, BoundsMode, true>>(function);
+			}
+			return runInterpreterLoop<LoopPolicy<Instrumented, PollSafepoints, BoundsMode, false>>(function);
+		};
+
+		switch (memoryBoundsMode) {
+		case MemoryBoundsMode::Strict:
+			return withOperandAlignment(std::integral_constant<MemoryBoundsMode::TEnum, MemoryBoundsMode::Strict>{});
+		case MemoryBoundsMode::Unchecked:
+			return withOperandAlignment(std::integral_constant<MemoryBoundsMode::TEnum, MemoryBoundsMode::Unchecked>{});
+		default:
+			return withOperandAlignment(std::integral_constant<MemoryBoundsMode::TEnum, MemoryBoundsMode::Checked>{});
+		}
+	};
+
+	// Tracing variants always poll, so that the tracer can be detached again
+	auto withSafepoints = [&](auto instrumented) {
+		if (activeTracer || allowLiveTracing || allowInterrupts) {
+			return withBoundsMode(instrumented, std::true_type{});
+		}
+		return withBoundsMode(instrumented, std::false_type{});
+	};
+
+	if (attachedProfiler.has_value() || attachedBytecodeCounter.has_value() || activeTracer) {
+		return withSafepoints(std::true_type{});
+	}
+	return withSafepoints(std::false_type{});
+}
+
 Nullable<Function> Interpreter::findFunction(const std::string& moduleName, const std::string& functionName)
 {
 	auto moduleFind = moduleNameMap.find(moduleName);
@@ -240,12 +645,33 @@ InterpreterLinkedDataIndex WASM::Interpreter::indexOfLinkedDataItem(const Linked
 	return InterpreterLinkedDataIndex{ (u32)*idx };
 }
 
-void Interpreter::initState(const BytecodeFunction& function)
+void Interpreter::acquireStack()
+{
+	if (mStackBase) {
+		return;
+	}
+
+	if (!unusedStacks.empty()) {
+		mStackBase = std::move(unusedStacks.back());
+		unusedStacks.pop_back();
+		return;
+	}
+
+	// FIXME: Do not hard code the stack size
+	mStackBase = std::make_unique<u32[]>(4096);
+}
+
+void Interpreter::releaseStack(std::unique_ptr<u32[]> stack)
 {
-	if (!mStackBase) {
-		// FIXME: Do not hard code the stack size
-		mStackBase = std::make_unique<u32[]>(4096);
+	// Keep a few stacks around for the calls that replace suspended ones
+	if (stack && unusedStacks.size() < 16) {
+		unusedStacks.emplace_back(std::move(stack));
 	}
+}
+
+void Interpreter::initState(const BytecodeFunction& function)
+{
+	acquireStack();
 
 	mInstructionPointer = function.bytecode().begin();
 	mStackPointer = mStackBase.get();
@@ -253,6 +679,87 @@ void Interpreter::initState(const BytecodeFunction& function)
 	mMemoryPointer = nullptr;
 }
 
+void Interpreter::pushEntryFrame(const BytecodeFunction& function, std::span<Value> parameters)
+{
+	initState(function);
+
+	// Check stack
+	assert(function.maxStackHeight() < 4096);
+
+	// Push parameters to stack
+	u32* stackPointer = pushValuesToStack(mStackPointer, parameters, useAlignedBytecode);
+
+	u32* framePointer = stackPointer; // Put FP after the parameters
+
+	// Push frame data to stack -> RA, FP, SP, MP
+	// Leaf functions only get RA and FP
+	auto frameData = reinterpret_cast<const void**>(stackPointer);
+	frameData[0] = nullptr;
+	frameData[1] = nullptr;
+	if (!function.isLeaf()) {
+		frameData[2] = mStackBase.get();
+		frameData[3] = mMemoryPointer;
+	}
+	stackPointer += function.frameBytes() / 4;
+
+	saveState(mInstructionPointer, stackPointer, framePointer, mMemoryPointer);
+}
+
+void Interpreter::updateActiveTracer()
+{
+	std::scoped_lock lock{ tracerMutex };
+	safepointRequests.fetch_and(~(u32)SafepointRequest::SwitchTracer, std::memory_order_relaxed);
+	activeTracer = requestedTracer;
+}
+
+bool Interpreter::handleSafepointRequests()
+{
+	// Returns whether the call should be suspended to yield
+	auto requests = safepointRequests.load(std::memory_order_acquire);
+	if (requests & SafepointRequest::Interrupt) {
+		safepointRequests.fetch_and(~(u32)SafepointRequest::Interrupt, std::memory_order_relaxed);
+		throw InterruptError{ "Function was interrupted" };
+	}
+
+	if (requests & SafepointRequest::DeadlineExpired) {
+		safepointRequests.fetch_and(~(u32)SafepointRequest::DeadlineExpired, std::memory_order_relaxed);
+		throw InterruptError{ "Function exceeded its deadline" };
+	}
+
+	if (requests & SafepointRequest::SwitchTracer) {
+		updateActiveTracer();
+	}
+
+	if (requests & SafepointRequest::Yield) {
+		safepointRequests.fetch_and(~(u32)SafepointRequest::Yield, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+void Interpreter::runDeadlineTimer(std::stop_token stopToken)
+{
+	std::unique_lock lock{ deadlineMutex };
+	while (!stopToken.stop_requested()) {
+		if (!deadline.has_value()) {
+			deadlineCondition.wait(lock, stopToken, [&]() { return deadline.has_value(); });
+			continue;
+		}
+
+		// Start over when the deadline gets changed while waiting for it
+		auto time = *deadline;
+		if (deadlineCondition.wait_until(lock, stopToken, time, [&]() { return deadline != time; })) {
+			continue;
+		}
+
+		if (!stopToken.stop_requested()) {
+			deadline.reset();
+			safepointRequests.fetch_or(SafepointRequest::DeadlineExpired, std::memory_order_release);
+		}
+	}
+}
+
 void Interpreter::saveState(const u8* ip, u32* sp, u32* fp, Memory* mp)
 {
 	mInstructionPointer = ip;
@@ -283,8 +790,8 @@ void Interpreter::dumpStack(std::ostream& out) const
 	while (framePointer) {
 		auto prevInstructionPointer= *(reinterpret_cast<u8**>(framePointer) + 0);
 		auto prevFramePointer= *(reinterpret_cast<u32**>(framePointer) + 1);
-		auto prevStackPointer= *(reinterpret_cast<u32**>(framePointer) + 2);
-		auto prevMemoryPointer = *(reinterpret_cast<Memory**>(framePointer) + 3);
+		auto prevStackPointer= stackPointer;
+		auto prevMemoryPointer = memoryPointer;
 
 		out << "Frame " << --frameIdx;
 		if (frameIdx == frameCount - 1) {
@@ -316,6 +823,15 @@ void Interpreter::dumpStack(std::ostream& out) const
 			out << " Locals: " << numLocals;
 			out << " Results: " << bytecodeFunction->functionType().results().size() << std::endl;
 
+			// Leaf frames only hold RA and FP, and keep the memory pointer of the caller
+			if (bytecodeFunction->isLeaf()) {
+				prevStackPointer = framePointer - bytecodeFunction->functionType().parameterStackSectionSizeInBytes(useAlignedBytecode) / 4;
+			}
+			else {
+				prevStackPointer = *(reinterpret_cast<u32**>(framePointer) + 2);
+				prevMemoryPointer = *(reinterpret_cast<Memory**>(framePointer) + 3);
+			}
+
 			u32 stackPointerOffset = 0;
 			auto printSingleStackSlot = [&](const char* const name) {
 				out << "  " << (u64)--stackPointer << " (-" << std::setw(2) << ++stackPointerOffset << ") " << name << ": " << *stackPointer << std::endl;
@@ -330,14 +846,19 @@ void Interpreter::dumpStack(std::ostream& out) const
 				for (i64 i = endIdx - 1; i >= beginIdx; i--) {
 					auto localOffset = bytecodeFunction->localOrParameterByIndex(i);
 					assert(localOffset.has_value());
-					if (localOffset->type.sizeInBytes() == 4) {
+					auto numBytes = localOffset->type.stackSizeInBytes(useAlignedBytecode);
+					if (numBytes == 4) {
 						printSingleStackSlot(name);
 					}
-					else if (localOffset->type.sizeInBytes() == 8) {
+					else if (numBytes == 8) {
+						printDoubleStackSlot(name);
+					}
+					else if (numBytes == 16) {
+						printDoubleStackSlot(name);
 						printDoubleStackSlot(name);
 					}
 					else {
-						out << "Only types with 32bit or 64bit are supported" << std::endl;
+						out << "Only types with 32bit, 64bit or 128bit are supported" << std::endl;
 					}
 				}
 			};
@@ -349,8 +870,10 @@ void Interpreter::dumpStack(std::ostream& out) const
 
 			printTypedLocals("Local", numLocals+ numParameters, numParameters);
 			
-			printDoubleStackSlot("   MP");
-			printDoubleStackSlot("   SP");
+			if (!bytecodeFunction->isLeaf()) {
+				printDoubleStackSlot("   MP");
+				printDoubleStackSlot("   SP");
+			}
 			printDoubleStackSlot("   FP");
 			printDoubleStackSlot("   RA");
 
@@ -372,47 +895,92 @@ void Interpreter::dumpStack(std::ostream& out) const
 
 std::optional<Interpreter::FunctionLookup> Interpreter::findFunctionByBytecodePointer(const u8* bytecodePointer) const
 {
-	for (auto& module : wasmModules) {
-		auto function = module.findFunctionByBytecodePointer(bytecodePointer);
-		if (function.has_value()) {
-			return FunctionLookup{*function, module};
-		}
+	auto lookup = bytecodeArena.findFunction(bytecodePointer);
+	if (!lookup.has_value()) {
+		return {};
 	}
 
-	return {};
+	return FunctionLookup{ lookup->function, lookup->module };
 }
 
-ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std::span<Value> parameters)
+void Interpreter::sampleProfile(const u8* instructionPointer, u32* framePointer, u32 numSamples)
 {
-	assert(!isInterpreting);
-	isInterpreting = true;
+	auto& stack = attachedProfiler->mSampleStack;
+	stack.clear();
 
-	initState(function);
+	auto pushFrame = [&](const u8* bytecodePointer) {
+		auto lookup = findFunctionByBytecodePointer(bytecodePointer);
+		if (lookup.has_value()) {
+			auto bytecodeFunction = lookup->function.asBytecodeFunction();
+			assert(bytecodeFunction.has_value());
+			stack.push_back({ *bytecodeFunction, lookup->module });
+		}
+	};
+
+	// Walk the return addresses of the frame chain, see dumpStack()
+	pushFrame(instructionPointer);
+	while (framePointer) {
+		auto returnAddress = *(reinterpret_cast<u8**>(framePointer) + 0);
+		if (returnAddress) {
+			pushFrame(returnAddress);
+		}
+		framePointer = *(reinterpret_cast<u32**>(framePointer) + 1);
+	}
+
+	attachedProfiler->recordSample(numSamples);
+}
+
+template<typename Policy>
+std::optional<ValuePack> Interpreter::runInterpreterLoop(const BytecodeFunction& function)
+{
+	// Continue with the state that was pushed or saved at a safepoint
 	const u8* instructionPointer = mInstructionPointer;
 	u32* stackPointer = mStackPointer;
 	u32* framePointer = mFramePointer;
 	Memory* memoryPointer = mMemoryPointer;
 
+	// Instrumented variants only use what is attached
+	Nullable<SamplingProfiler> profiler;
+	Nullable<ExecutionTracer> tracer;
+	if constexpr (Policy::instrumented) {
+		profiler = attachedProfiler;
+		if (activeTracer) {
+			tracer = *activeTracer;
+		}
+	}
+
+	// Aligned bytecode pads each operand to its natural alignment
+	auto skipOperandPadding = [&](sizeType alignment) [[msvc::forceinline]] {
+		if constexpr (Policy::alignedOperands) {
+			instructionPointer = alignPointerUp(instructionPointer, alignment);
+		}
+	};
+
 	auto loadOperandU32 = [&]() -> u32 [[msvc::forceinline]] {
+		skipOperandPadding(4);
 		u32 operand = *reinterpret_cast<const u32*>(instructionPointer);
 		instructionPointer += 4;
 		return operand;
 	};
 
 	auto loadOperandU64 = [&]() -> u64 [[msvc::forceinline]] {
+		skipOperandPadding(8);
 		u64 operand = *reinterpret_cast<const u64*>(instructionPointer);
 		instructionPointer += 8;
 		return operand;
 	};
 
 	auto loadOperandPtr = [&]() [[msvc::forceinline]] {
+		skipOperandPadding(8);
 		void* operand = *reinterpret_cast<void*const*>(instructionPointer);
 		instructionPointer += 8;
 		return operand;
 	};
 
+	// Aligned stacks put 32bit values into full 8 byte slots
 	auto pushU32 = [&](u32 val) [[msvc::forceinline]] {
-		*(stackPointer++) = val;
+		*stackPointer = val;
+		stackPointer += stackSlotsOf<u32, Policy::alignedOperands>;
 	};
 
 	auto pushU64 = [&](u64 val) [[msvc::forceinline]] {
@@ -426,7 +994,12 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 	};
 
 	auto popU32 = [&]() -> u32 [[msvc::forceinline]] {
-		return *(--stackPointer);
+		stackPointer -= stackSlotsOf<u32, Policy::alignedOperands>;
+		return *stackPointer;
+	};
+
+	auto peekU32 = [&]() -> u32 [[msvc::forceinline]] {
+		return *(stackPointer - stackSlotsOf<u32, Policy::alignedOperands>);
 	};
 
 	auto popU64 = [&]() -> u64 [[msvc::forceinline]] {
@@ -446,7 +1019,120 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 		*reinterpret_cast<u64*>(stackPointer - offset)= value;
 	};
 
+	// Addresses of 64bit memories might overflow when the offset is added to them
+	auto effectiveAddress64 = [&](u64 address, u64 offset) -> u64 [[msvc::forceinline]] {
+		if constexpr (Policy::boundsMode != MemoryBoundsMode::Unchecked) {
+			if (address + offset < address) {
+				throw std::runtime_error{ "Out of bounds memory access" };
+			}
+		}
+		return address + offset;
+	};
+
+	// The profiler is only polled at jumps, calls and returns instead of before each
+	// bytecode. Time spent in between is attributed to the function it is polled in.
+	auto pollProfiler = [&]() -> void [[msvc::forceinline]] {
+		if constexpr (Policy::instrumented) {
+			if (profiler.has_value()) {
+				auto numSamples = profiler->takePendingSamples();
+				if (numSamples) {
+					sampleProfile(instructionPointer, framePointer, numSamples);
+				}
+			}
+		}
+	};
+
+	// Selects the counts of the function that the instruction pointer now points into.
+	// Bytecodes before and after a call are not counted as a pair.
+	Nullable<BytecodeCounter> bytecodeCounter;
+	BytecodeCounter::FunctionCounts* bytecodeCounts = nullptr;
+	if constexpr (Policy::instrumented) {
+		bytecodeCounter = attachedBytecodeCounter;
+	}
+
+	auto switchBytecodeCounts = [&]() -> void [[msvc::forceinline]] {
+		if constexpr (Policy::instrumented) {
+			if (!bytecodeCounter.has_value()) {
+				return;
+			}
+
+			auto lookup = findFunctionByBytecodePointer(instructionPointer);
+			assert(lookup.has_value());
+			bytecodeCounts = &bytecodeCounter->countsForFunction(*lookup->function.asBytecodeFunction(), lookup->module);
+			bytecodeCounts->previousBytecode = BytecodeCounter::NoBytecode;
+		}
+	};
+
+	// Safepoints are only taken at jumps, calls and returns, so that every loop and
+	// every function reaches one. The loop returns without a result to be restarted.
+	auto stopAtSafepoint = [&]() -> bool [[msvc::forceinline]] {
+		if constexpr (Policy::pollSafepoints) {
+			if (safepointRequests.load(std::memory_order_relaxed)) {
+				saveState(instructionPointer, stackPointer, framePointer, memoryPointer);
+				return true;
+			}
+		}
+		return false;
+	};
+
+	auto traceFunctionEnter = [&](const BytecodeFunction& callee) -> void [[msvc::forceinline]] {
+		if constexpr (Policy::instrumented) {
+			if (!tracer.has_value()) {
+				return;
+			}
+
+			auto lookup = findFunctionByBytecodePointer(callee.bytecode().begin());
+			assert(lookup.has_value());
+			tracer->onFunctionEnter(callee, lookup->module);
+		}
+	};
+
+	auto traceFunctionExit = [&](const u8* bytecodePointer) -> void [[msvc::forceinline]] {
+		if constexpr (Policy::instrumented) {
+			if (!tracer.has_value()) {
+				return;
+			}
+
+			auto lookup = findFunctionByBytecodePointer(bytecodePointer);
+			assert(lookup.has_value());
+			tracer->onFunctionExit(*lookup->function.asBytecodeFunction(), lookup->module);
+		}
+	};
+
+	// Waits end early when a safepoint request arrives. Once the request is handled they
+	// are restarted from their bytecode with the same operands, but the time already
+	// waited is taken off their timeout.
+	Nullable<const std::atomic<u32>> waitCancelFlags;
+	if constexpr (Policy::pollSafepoints) {
+		waitCancelFlags = safepointRequests;
+	}
+
+	auto waitStartTime = [&]() -> std::chrono::steady_clock::time_point [[msvc::forceinline]] {
+		if constexpr (Policy::pollSafepoints) {
+			return std::chrono::steady_clock::now();
+		}
+		return {};
+	};
+
+	auto stopWaitAtSafepoint = [&](const u8* waitBytecodePointer, u32* waitStackPointer, i64 timeout, std::chrono::steady_clock::time_point startTime) -> void {
+		if (timeout >= 0) {
+			auto waitedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+			*reinterpret_cast<i64*>(waitStackPointer - 2) = std::max<i64>(timeout - waitedTime.count(), 0);
+		}
+		saveState(waitBytecodePointer, waitStackPointer, framePointer, memoryPointer);
+	};
+
+	// Host functions pop their parameters before they return that they are pending. The
+	// saved state lets the call continue as if the results were returned by the function.
+	auto suspendHostFunctionCall = [&](const HostFunctionBase& callee) -> void {
+		stackPointer -= callee.functionType().parameterStackSectionSizeInBytes(Policy::alignedOperands) / 4;
+		saveState(instructionPointer, stackPointer, framePointer, memoryPointer);
+		pendingHostFunction = callee;
+	};
+
 	auto doBytecodeFunctionCall = [&](BytecodeFunction * callee, u32 stackParameterSection) -> void [[msvc::forceinline]] {
+		pollProfiler();
+
 		auto stackPointerToSave = stackPointer - stackParameterSection;
 		auto newFramePointer = stackPointer;
 
@@ -462,127 +1148,228 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 		framePointer = newFramePointer;
 		instructionPointer = callee->bytecode().begin();
 		memoryPointer = nullptr;
+
+		switchBytecodeCounts();
+		traceFunctionEnter(*callee);
 	};
 
-	// Check stack
-	assert(function.maxStackHeight() < 4096);
+	// Leaf functions do not change the memory pointer, so only RA and FP are saved
+	auto doLeafFunctionCall = [&](BytecodeFunction* callee) -> void [[msvc::forceinline]] {
+		pollProfiler();
 
-	// Push parameters to stack
-	for (auto& parameter : parameters) {
-		auto numBytes = parameter.sizeInBytes();
-		if ( numBytes == 4) {
-			pushU32(parameter.as<u32>());
+		auto newFramePointer = stackPointer;
+
+		if (callee->maxStackHeight() + stackPointer > mStackBase.get() + 4069) {
+			throw std::runtime_error{ "Stack overflow" };
 		}
-		else if (numBytes == 8) {
-			pushU64(parameter.as<u64>());
+
+		pushPtr(instructionPointer);
+		pushPtr(framePointer);
+
+		framePointer = newFramePointer;
+		instructionPointer = callee->bytecode().begin();
+
+		switchBytecodeCounts();
+		traceFunctionEnter(*callee);
+	};
+
+	// Tail calls reuse the frame of the current function. The parameters are moved
+	// down to where the parameters of the current function begin, and the registers
+	// saved for its caller are stored again in the frame of the callee.
+	auto doBytecodeFunctionTailCall = [&](BytecodeFunction* callee, u32 stackParameterSection) -> void [[msvc::forceinline]] {
+		pollProfiler();
+		traceFunctionExit(instructionPointer);
+
+		auto returnInstructionPointer = loadPtrWithFrameOffset(0);
+		auto oldFramePointer = loadPtrWithFrameOffset(1);
+		auto stackPointerToSave = (u32*)loadPtrWithFrameOffset(2);
+		auto oldMemoryPointer = loadPtrWithFrameOffset(3);
+
+		std::memmove(stackPointerToSave, stackPointer - stackParameterSection, stackParameterSection * 4);
+		stackPointer = stackPointerToSave + stackParameterSection;
+		auto newFramePointer = stackPointer;
+
+		if (callee->maxStackHeight() + stackPointer > mStackBase.get() + 4069) {
+			throw std::runtime_error{ "Stack overflow" };
+		}
+
+		pushPtr(returnInstructionPointer);
+		pushPtr(oldFramePointer);
+
+		// Leaf functions return with the memory pointer of the caller already in place
+		if (callee->isLeaf()) {
+			memoryPointer = (Memory*)oldMemoryPointer;
 		}
 		else {
-			throw std::runtime_error{ "Only 32bit and 64bit values are supported" };
+			pushPtr(stackPointerToSave);
+			pushPtr(oldMemoryPointer);
+			memoryPointer = nullptr;
 		}
-	}
 
-	framePointer = stackPointer; // Put FP after the parameters
+		framePointer = newFramePointer;
+		instructionPointer = callee->bytecode().begin();
 
-	// Push frame data to stace -> RA, FP, SP, MP
-	pushPtr(0x00);
-	pushPtr(0x00);
-	pushPtr(mStackBase.get());
-	pushPtr(memoryPointer);
+		switchBytecodeCounts();
+		traceFunctionEnter(*callee);
+	};
 
 	u64 opA, opB, opC;
 
+	switchBytecodeCounts();
+
 	using BC = Bytecode;
 	while (true) {
 		auto bytecode = *(instructionPointer++);
+		if constexpr (Policy::instrumented) {
+			if (bytecodeCounts) {
+				bytecodeCounts->count(bytecode);
+			}
+			if (tracer.has_value()) {
+				tracer->onBytecode(instructionPointer - 1, Bytecode::fromInt(bytecode));
+			}
+		}
 		//std::cout << std::hex << (u64)(instructionPointer- 1) << " Executing bytecode " << std::dec << Bytecode::fromInt(bytecode).name() << std::endl;
 
 		switch (bytecode) {
 		case BC::Unreachable:
 			throw std::runtime_error{ "unreachable code" };
 		case BC::JumpShort: {
+			pollProfiler();
 			i8 offset = *(instructionPointer++);
 			instructionPointer -= 1;
 			instructionPointer += offset;
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::JumpLong: {
+			pollProfiler();
 			i32 offset = loadOperandU32();
 			instructionPointer -= 4;
 			instructionPointer += offset;
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::IfTrueJumpShort: {
+			pollProfiler();
 			i8 offset = *(instructionPointer++);
 			opA = popU32();
 			if (opA) {
 				instructionPointer -= 1;
 				instructionPointer += offset;
 			}
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::IfTrueJumpLong: {
+			pollProfiler();
 			i32 offset = loadOperandU32();
 			opA = popU32();
 			if (opA) {
 				instructionPointer -= 4;
 				instructionPointer += offset;
 			}
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::IfFalseJumpShort: {
+			pollProfiler();
 			i8 offset = *(instructionPointer++);
 			opA = popU32();
 			if (!opA) {
 				instructionPointer -= 1;
 				instructionPointer += offset;
 			}
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::IfFalseJumpLong: {
+			pollProfiler();
 			i32 offset = loadOperandU32();
 			opA = popU32();
 			if (!opA) {
 				instructionPointer -= 4;
 				instructionPointer += offset;
 			}
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::JumpTable:
+			pollProfiler();
 			opA = loadOperandU32();
 			opB = popU32();
 			if (opB > opA) {
 				opB = opA;
 			}
 			instructionPointer += reinterpret_cast<const i32*>(instructionPointer)[opB] - 4;
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
-		case BC::ReturnFew: {
-			auto numSlotsToReturn = *(instructionPointer++);
+		case BC::ReturnFew:
+		case BC::ReturnMany:
+		case BC::ReturnLeaf: {
+			pollProfiler();
+			traceFunctionExit(instructionPointer - 1);
+			u32 numSlotsToReturn = bytecode == BC::ReturnFew ? *(instructionPointer++) : loadOperandU32();
 			auto currentStackPointer = stackPointer;
+			if (bytecode == BC::ReturnLeaf) {
+				// The parameters begin right below the leaf frame
+				stackPointer = framePointer - loadOperandU32();
+			}
+			else {
+				stackPointer = (u32*)loadPtrWithFrameOffset(2);
+				memoryPointer = (Memory*)loadPtrWithFrameOffset(3);
+			}
 			instructionPointer = (u8*)loadPtrWithFrameOffset(0);
-			auto oldFramePointer = (u32*)loadPtrWithFrameOffset(1);
-			stackPointer = (u32*)loadPtrWithFrameOffset(2);
-			memoryPointer = (Memory*)loadPtrWithFrameOffset(3);
-			framePointer = oldFramePointer;
+			framePointer = (u32*)loadPtrWithFrameOffset(1);
 
-			for (i64 i = 0; i != numSlotsToReturn; i++) {
-				pushU32(currentStackPointer[i-numSlotsToReturn]);
-			}
+			// Move the results down to the caller's stack, which might overlap with them
+			std::memmove(stackPointer, currentStackPointer - numSlotsToReturn, numSlotsToReturn * 4);
+			stackPointer += numSlotsToReturn;
 
 			if (!instructionPointer) {
 				std::cout << "Execution finished" << std::endl;
-				return ValuePack{ function.functionType(), true, {mStackBase.get(), (sizeType)(stackPointer - mStackBase.get())} };
+				return ValuePack{ function.functionType(), true, {mStackBase.get(), (sizeType)(stackPointer - mStackBase.get())}, Policy::alignedOperands };
+			}
+
+			switchBytecodeCounts();
+			if (stopAtSafepoint()) {
+				return {};
 			}
 			continue;
 		}
-		case BC::ReturnMany:
-			break;
 		case BC::Call: {
 			auto callee = (BytecodeFunction*)loadOperandPtr();
 			auto stackParameterSection = loadOperandU32();
 			doBytecodeFunctionCall(callee, stackParameterSection);
+			if (stopAtSafepoint()) {
+				return {};
+			}
+			continue;
+		}
+		case BC::ReturnCall: {
+			auto callee = (BytecodeFunction*)loadOperandPtr();
+			auto stackParameterSection = loadOperandU32();
+			doBytecodeFunctionTailCall(callee, stackParameterSection);
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
-		case BC::CallIndirect:  {
+		case BC::CallIndirect:
+		case BC::ReturnCallIndirect: {
 			auto functionIdx = popU32();
 			auto tableIdx = loadOperandU32();
 			auto typeIdx = loadOperandU32();
@@ -597,37 +1384,126 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			if (function->interpreterTypeIndex() != typeIdx) {
 				throw std::runtime_error("Invalid indirect call to mismatched function type");
 			}
+			// Tail calls to host functions are followed by a return bytecode
 			auto hostFunction = function->asHostFunction();
 			if (hostFunction.has_value()) {
-				stackPointer = hostFunction->executeFunction(stackPointer);
+				auto newStackPointer = hostFunction->executeFunction(stackPointer, Policy::alignedOperands);
+				if (!newStackPointer) {
+					suspendHostFunctionCall(*hostFunction);
+					return {};
+				}
+				stackPointer = newStackPointer;
 				continue;
 			}
 			auto bytecodeFunction = reinterpret_cast<BytecodeFunction*>(function.pointer());
-			auto stackParameterSection= bytecodeFunction->functionType().parameterStackSectionSizeInBytes() / 4;
-			doBytecodeFunctionCall(bytecodeFunction, stackParameterSection);
+			auto stackParameterSection= bytecodeFunction->functionType().parameterStackSectionSizeInBytes(Policy::alignedOperands) / 4;
+			if (bytecode == BC::ReturnCallIndirect) {
+				doBytecodeFunctionTailCall(bytecodeFunction, stackParameterSection);
+			}
+			else if (bytecodeFunction->isLeaf()) {
+				doLeafFunctionCall(bytecodeFunction);
+			}
+			else {
+				doBytecodeFunctionCall(bytecodeFunction, stackParameterSection);
+			}
+			if (stopAtSafepoint()) {
+				return {};
+			}
+			continue;
+		}
+		case BC::CallReference:
+		case BC::ReturnCallReference: {
+			// The validator already checked the type of the reference
+			auto function = reinterpret_cast<Function*>(popU64());
+			if (!function) {
+				throw std::runtime_error("Invalid reference call to null");
+			}
+			// Tail calls to host functions are followed by a return bytecode
+			auto hostFunction = function->asHostFunction();
+			if (hostFunction.has_value()) {
+				auto newStackPointer = hostFunction->executeFunction(stackPointer, Policy::alignedOperands);
+				if (!newStackPointer) {
+					suspendHostFunctionCall(*hostFunction);
+					return {};
+				}
+				stackPointer = newStackPointer;
+				continue;
+			}
+			auto bytecodeFunction = reinterpret_cast<BytecodeFunction*>(function);
+			auto stackParameterSection = bytecodeFunction->functionType().parameterStackSectionSizeInBytes(Policy::alignedOperands) / 4;
+			if (bytecode == BC::ReturnCallReference) {
+				doBytecodeFunctionTailCall(bytecodeFunction, stackParameterSection);
+			}
+			else if (bytecodeFunction->isLeaf()) {
+				doLeafFunctionCall(bytecodeFunction);
+			}
+			else {
+				doBytecodeFunctionCall(bytecodeFunction, stackParameterSection);
+			}
+			if (stopAtSafepoint()) {
+				return {};
+			}
+			continue;
+		}
+		case BC::CallLeaf: {
+			auto callee = (BytecodeFunction*)loadOperandPtr();
+			doLeafFunctionCall(callee);
+			if (stopAtSafepoint()) {
+				return {};
+			}
 			continue;
 		}
 		case BC::CallHost: {
 			auto callee = (HostFunctionBase*)loadOperandPtr();
-			stackPointer= callee->executeFunction(stackPointer);
+			auto newStackPointer = callee->executeFunction(stackPointer, Policy::alignedOperands);
+			if (!newStackPointer) {
+				suspendHostFunctionCall(*callee);
+				return {};
+			}
+			stackPointer = newStackPointer;
 			continue;
 		}
 		case BC::Entry: {
 			auto memoryIdx = loadOperandU32();
 			memoryPointer = &allMemories[memoryIdx];
 
-			auto numLocals = loadOperandU32();
-			while (numLocals-- > 0) {
-				pushU32(0);
+			auto numLocalSlots = loadOperandU32();
+			while (numLocalSlots-- > 0) {
+				*(stackPointer++) = 0;
+			}
+			continue;
+		}
+		case BC::EntryLeaf: {
+			auto numLocalSlots = loadOperandU32();
+			while (numLocalSlots-- > 0) {
+				*(stackPointer++) = 0;
+			}
+			continue;
+		}
+		case BC::ConsumeFuel: {
+			i64 cost = loadOperandU32();
+			fuelRemaining -= cost;
+			if (fuelRemaining < 0) {
+				// The block is not run, so it is not charged
+				fuelRemaining += cost;
+				throw std::runtime_error{ "Out of fuel" };
 			}
 			continue;
 		}
 		case BC::I32Drop:
-			stackPointer--;
+			popU32();
 			continue;
 		case BC::I64Drop:
 			stackPointer -= 2;
 			continue;
+		case BC::DropKeep: {
+			// Drop the slots below the kept ones, which might overlap with them
+			auto numSlotsToDrop = loadOperandU32();
+			auto numSlotsToKeep = loadOperandU32();
+			std::memmove(stackPointer - numSlotsToKeep - numSlotsToDrop, stackPointer - numSlotsToKeep, numSlotsToKeep * 4);
+			stackPointer -= numSlotsToDrop;
+			continue;
+		}
 		case BC::I32Select:
 			opC = popU32();
 			opB = popU32();
@@ -650,7 +1526,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			continue;
 		case BC::I32LocalTeeFar:
 			opA = loadOperandU32();
-			opB = stackPointer[-1];
+			opB = peekU32();
 			stackPointer[-(i32)opA] = (u32) opB;
 			continue;
 		case BC::I32LocalGetNear:
@@ -663,7 +1539,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			continue;
 		case BC::I32LocalTeeNear:
 			opA = *(instructionPointer++);
-			opB = stackPointer[-1];
+			opB = peekU32();
 			stackPointer[-(i32)opA] = (u32) opB;
 			continue;
 		case BC::I64LocalGetFar:
@@ -777,35 +1653,44 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			allTables[tableIdx].fill(val, opA, opC);
 			continue;
 		}
+		case BC::ReferenceAsNonNull:
+			if (!loadU64WithStackOffset(2)) {
+				throw std::runtime_error{ "Null reference" };
+			}
+			continue;
+		case BC::ReferenceTestNull:
+			opA = loadU64WithStackOffset(2);
+			pushU32(opA == 0);
+			continue;
 		case BC::I32LoadNear:
 			assert(memoryPointer);
 			opB = *(instructionPointer++);
 			opA = popU32();
-			pushU32(*reinterpret_cast<u32*>(memoryPointer->pointer(opB + opA)));
+			pushU32(*memoryPointer->pointer<Policy::boundsMode, u32>(opB + opA));
 			continue;
 		case BC::I64LoadNear:
 			assert(memoryPointer);
 			opB = *(instructionPointer++);
 			opA = popU32();
-			pushU64(*reinterpret_cast<u64*>(memoryPointer->pointer(opB + opA)));
+			pushU64(*memoryPointer->pointer<Policy::boundsMode, u64>(opB + opA));
 			continue;
 		case BC::I32LoadFar:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			pushU32(*reinterpret_cast<u32*>(memoryPointer->pointer(opB + opA)));
+			pushU32(*memoryPointer->pointer<Policy::boundsMode, u32>(opB + opA));
 			continue;
 		case BC::I64LoadFar:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			pushU64(*reinterpret_cast<u64*>(memoryPointer->pointer(opB + opA)));
+			pushU64(*memoryPointer->pointer<Policy::boundsMode, u64>(opB + opA));
 			continue;
 		case BC::I32Load8s: {
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			i32 val = *reinterpret_cast<i8*>(memoryPointer->pointer(opB + opA));
+			i32 val = *memoryPointer->pointer<Policy::boundsMode, i8>(opB + opA);
 			pushU32(val);
 			continue;
 		}
@@ -813,7 +1698,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			u32 val = *reinterpret_cast<u8*>(memoryPointer->pointer(opB + opA));
+			u32 val = *memoryPointer->pointer<Policy::boundsMode, u8>(opB + opA);
 			pushU32(val);
 			continue;
 		}
@@ -821,7 +1706,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			i32 val = *reinterpret_cast<i16*>(memoryPointer->pointer(opB + opA));
+			i32 val = *memoryPointer->pointer<Policy::boundsMode, i16>(opB + opA);
 			pushU32(val);
 			continue;
 		}
@@ -829,7 +1714,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			u32 val = *reinterpret_cast<u16*>(memoryPointer->pointer(opB + opA));
+			u32 val = *memoryPointer->pointer<Policy::boundsMode, u16>(opB + opA);
 			pushU32(val);
 			continue;
 		}
@@ -837,7 +1722,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			i64 val = *reinterpret_cast<i8*>(memoryPointer->pointer(opB + opA));
+			i64 val = *memoryPointer->pointer<Policy::boundsMode, i8>(opB + opA);
 			pushU64(val);
 			continue;
 		}
@@ -845,7 +1730,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			u64 val = *reinterpret_cast<u8*>(memoryPointer->pointer(opB + opA));
+			u64 val = *memoryPointer->pointer<Policy::boundsMode, u8>(opB + opA);
 			pushU64(val);
 			continue;
 		}
@@ -853,7 +1738,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			i64 val = *reinterpret_cast<i16*>(memoryPointer->pointer(opB + opA));
+			i64 val = *memoryPointer->pointer<Policy::boundsMode, i16>(opB + opA);
 			pushU64(val);
 			continue;
 		}
@@ -861,7 +1746,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			u64 val = *reinterpret_cast<u16*>(memoryPointer->pointer(opB + opA));
+			u64 val = *memoryPointer->pointer<Policy::boundsMode, u16>(opB + opA);
 			pushU64(val);
 			continue;
 		}
@@ -869,7 +1754,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			i64 val = *reinterpret_cast<i32*>(memoryPointer->pointer(opB + opA));
+			i64 val = *memoryPointer->pointer<Policy::boundsMode, i32>(opB + opA);
 			pushU64(val);
 			continue;
 		}
@@ -877,7 +1762,7 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			assert(memoryPointer);
 			opB = loadOperandU32();
 			opA = popU32();
-			u64 val = *reinterpret_cast<u32*>(memoryPointer->pointer(opB + opA));
+			u64 val = *memoryPointer->pointer<Policy::boundsMode, u32>(opB + opA);
 			pushU64(val);
 			continue;
 		}
@@ -886,63 +1771,63 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			opC = *(instructionPointer++);
 			opB = popU32();
 			opA = popU32();
-			*reinterpret_cast<u32*>(memoryPointer->pointer(opC + opA)) = (u32) opB;
+			*memoryPointer->pointer<Policy::boundsMode, u32>(opC + opA) = (u32) opB;
 			continue;
 		case BC::I64StoreNear:
 			assert(memoryPointer);
 			opC = *(instructionPointer++);
 			opB = popU64();
 			opA = popU32();
-			*reinterpret_cast<u64*>(memoryPointer->pointer(opC + opA)) = opB;
+			*memoryPointer->pointer<Policy::boundsMode, u64>(opC + opA) = opB;
 			continue;
 		case BC::I32StoreFar:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU32();
 			opA = popU32();
-			*reinterpret_cast<u32*>(memoryPointer->pointer(opC + opA)) = (u32)opB;
+			*memoryPointer->pointer<Policy::boundsMode, u32>(opC + opA) = (u32)opB;
 			continue;
 		case BC::I64StoreFar:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU64();
 			opA = popU32();
-			*reinterpret_cast<u64*>(memoryPointer->pointer(opC + opA)) = opB;
+			*memoryPointer->pointer<Policy::boundsMode, u64>(opC + opA) = opB;
 			continue;
 		case BC::I32Store8:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU32();
 			opA = popU32();
-			*reinterpret_cast<u8*>(memoryPointer->pointer(opC + opA)) = (u8)opB;
+			*memoryPointer->pointer<Policy::boundsMode, u8>(opC + opA) = (u8)opB;
 			continue;
 		case BC::I32Store16:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU32();
 			opA = popU32();
-			*reinterpret_cast<u16*>(memoryPointer->pointer(opC + opA)) = (u16)opB;
+			*memoryPointer->pointer<Policy::boundsMode, u16>(opC + opA) = (u16)opB;
 			continue;
 		case BC::I64Store8:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU64();
 			opA = popU32();
-			*reinterpret_cast<u8*>(memoryPointer->pointer(opC + opA)) = (u8)opB;
+			*memoryPointer->pointer<Policy::boundsMode, u8>(opC + opA) = (u8)opB;
 			continue;
 		case BC::I64Store16:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU64();
 			opA = popU32();
-			*reinterpret_cast<u16*>(memoryPointer->pointer(opC + opA)) = (u16)opB;
+			*memoryPointer->pointer<Policy::boundsMode, u16>(opC + opA) = (u16)opB;
 			continue;
 		case BC::I64Store32:
 			assert(memoryPointer);
 			opC = loadOperandU32();
 			opB = popU64();
 			opA = popU32();
-			*reinterpret_cast<u32*>(memoryPointer->pointer(opC + opA)) = (u32)opB;
+			*memoryPointer->pointer<Policy::boundsMode, u32>(opC + opA) = (u32)opB;
 			continue;
 		case BC::MemorySize: {
 			assert(memoryPointer);
@@ -950,11 +1835,460 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 			continue;
 		}
 		case BC::MemoryGrow:
-		case BC::MemoryInit:
+			assert(memoryPointer);
+			opA = popU32();
+			pushU32(memoryPointer->grow((i32)opA));
+			continue;
+		case BC::MemoryInit: {
+			auto dataItemIdx = loadOperandU32();
+			assert(memoryPointer);
+			assert(dataItemIdx < allDataItems.size());
+
+			opC = popU32(); // n(um) -> num bytes to init
+			opB = popU32(); // s(ource) -> data item offset
+			opA = popU32(); // d(estination) -> memory offset
+			memoryPointer->init(allDataItems[dataItemIdx], opA, opB, opC);
+			continue;
+		}
 		case BC::DataDrop:
+			opA = loadOperandU32();
+			assert(opA < allDataItems.size());
+			allDataItems[opA].drop();
+			continue;
 		case BC::MemoryCopy:
+			assert(memoryPointer);
+			opC = popU32(); // n(um) -> num bytes to copy
+			opB = popU32(); // s(ource) -> source memory offset
+			opA = popU32(); // d(estination) -> destination memory offset
+			memoryPointer->copy(opA, opB, opC);
+			continue;
 		case BC::MemoryFill:
-			break;
+			assert(memoryPointer);
+			opC = popU32(); // n(um) -> num bytes to fill
+			opB = popU32(); // val(ue) -> byte value to fill with
+			opA = popU32(); // d(estination) -> destination memory offset
+			memoryPointer->fill(opA, (u8)opB, opC);
+			continue;
+		case BC::AtomicFence:
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			continue;
+		case BC::MemoryAtomicNotify:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			pushU32(memoryPointer->atomicNotify(opC + opA, (u32)opB));
+			continue;
+		case BC::MemoryAtomicWait32: {
+			assert(memoryPointer);
+			auto waitBytecodePointer = instructionPointer - 1;
+			auto waitStackPointer = stackPointer;
+			opC = loadOperandU32();
+			opB = popU64();
+			auto expected = popU32();
+			opA = popU32();
+			auto startTime = waitStartTime();
+			auto result = memoryPointer->atomicWait32(opC + opA, expected, (i64)opB, waitCancelFlags);
+			if (!result.has_value()) {
+				stopWaitAtSafepoint(waitBytecodePointer, waitStackPointer, (i64)opB, startTime);
+				return {};
+			}
+			pushU32(*result);
+			continue;
+		}
+		case BC::MemoryAtomicWait64: {
+			assert(memoryPointer);
+			auto waitBytecodePointer = instructionPointer - 1;
+			auto waitStackPointer = stackPointer;
+			opC = loadOperandU32();
+			opB = popU64();
+			auto expected = popU64();
+			opA = popU32();
+			auto startTime = waitStartTime();
+			auto result = memoryPointer->atomicWait64(opC + opA, expected, (i64)opB, waitCancelFlags);
+			if (!result.has_value()) {
+				stopWaitAtSafepoint(waitBytecodePointer, waitStackPointer, (i64)opB, startTime);
+				return {};
+			}
+			pushU32(*result);
+			continue;
+		}
+		case BC::I32AtomicLoad:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU32(memoryPointer->atomicReference<Policy::boundsMode, u32>(opB + opA).load());
+			continue;
+		case BC::I64AtomicLoad:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU64(memoryPointer->atomicReference<Policy::boundsMode, u64>(opB + opA).load());
+			continue;
+		case BC::I32AtomicLoad8u:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU32(memoryPointer->atomicReference<Policy::boundsMode, u8>(opB + opA).load());
+			continue;
+		case BC::I32AtomicLoad16u:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU32(memoryPointer->atomicReference<Policy::boundsMode, u16>(opB + opA).load());
+			continue;
+		case BC::I64AtomicLoad8u:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU64(memoryPointer->atomicReference<Policy::boundsMode, u8>(opB + opA).load());
+			continue;
+		case BC::I64AtomicLoad16u:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU64(memoryPointer->atomicReference<Policy::boundsMode, u16>(opB + opA).load());
+			continue;
+		case BC::I64AtomicLoad32u:
+			assert(memoryPointer);
+			opB = loadOperandU32();
+			opA = popU32();
+			pushU64(memoryPointer->atomicReference<Policy::boundsMode, u32>(opB + opA).load());
+			continue;
+		case BC::I32AtomicStore:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u32>(opC + opA).store((u32)opB);
+			continue;
+		case BC::I64AtomicStore:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u64>(opC + opA).store((u64)opB);
+			continue;
+		case BC::I32AtomicStore8:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u8>(opC + opA).store((u8)opB);
+			continue;
+		case BC::I32AtomicStore16:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u16>(opC + opA).store((u16)opB);
+			continue;
+		case BC::I64AtomicStore8:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u8>(opC + opA).store((u8)opB);
+			continue;
+		case BC::I64AtomicStore16:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u16>(opC + opA).store((u16)opB);
+			continue;
+		case BC::I64AtomicStore32:
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u32>(opC + opA).store((u32)opB);
+			continue;
+		case BC::I32AtomicRmw: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u32>(opC + opA);
+			pushU32(atomicReadModifyWrite<u32>(reference, operation, (u32)opB));
+			continue;
+		}
+		case BC::I64AtomicRmw: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u64>(opC + opA);
+			pushU64(atomicReadModifyWrite<u64>(reference, operation, (u64)opB));
+			continue;
+		}
+		case BC::I32AtomicRmw8u: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u8>(opC + opA);
+			pushU32(atomicReadModifyWrite<u8>(reference, operation, (u8)opB));
+			continue;
+		}
+		case BC::I32AtomicRmw16u: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU32();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u16>(opC + opA);
+			pushU32(atomicReadModifyWrite<u16>(reference, operation, (u16)opB));
+			continue;
+		}
+		case BC::I64AtomicRmw8u: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u8>(opC + opA);
+			pushU64(atomicReadModifyWrite<u8>(reference, operation, (u8)opB));
+			continue;
+		}
+		case BC::I64AtomicRmw16u: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u16>(opC + opA);
+			pushU64(atomicReadModifyWrite<u16>(reference, operation, (u16)opB));
+			continue;
+		}
+		case BC::I64AtomicRmw32u: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			auto operation = loadOperandU32();
+			opB = popU64();
+			opA = popU32();
+			auto reference = memoryPointer->atomicReference<Policy::boundsMode, u32>(opC + opA);
+			pushU64(atomicReadModifyWrite<u32>(reference, operation, (u32)opB));
+			continue;
+		}
+		case BC::I32AtomicRmwCompareExchange: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			u32 value = (u32)popU32();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u32>(opC + opA).compare_exchange_strong(value, (u32)opB);
+			pushU32(value);
+			continue;
+		}
+		case BC::I64AtomicRmwCompareExchange: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			u64 value = (u64)popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u64>(opC + opA).compare_exchange_strong(value, (u64)opB);
+			pushU64(value);
+			continue;
+		}
+		case BC::I32AtomicRmw8CompareExchangeU: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			u8 value = (u8)popU32();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u8>(opC + opA).compare_exchange_strong(value, (u8)opB);
+			pushU32(value);
+			continue;
+		}
+		case BC::I32AtomicRmw16CompareExchangeU: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU32();
+			u16 value = (u16)popU32();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u16>(opC + opA).compare_exchange_strong(value, (u16)opB);
+			pushU32(value);
+			continue;
+		}
+		case BC::I64AtomicRmw8CompareExchangeU: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			u8 value = (u8)popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u8>(opC + opA).compare_exchange_strong(value, (u8)opB);
+			pushU64(value);
+			continue;
+		}
+		case BC::I64AtomicRmw16CompareExchangeU: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			u16 value = (u16)popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u16>(opC + opA).compare_exchange_strong(value, (u16)opB);
+			pushU64(value);
+			continue;
+		}
+		case BC::I64AtomicRmw32CompareExchangeU: {
+			assert(memoryPointer);
+			opC = loadOperandU32();
+			opB = popU64();
+			u32 value = (u32)popU64();
+			opA = popU32();
+			memoryPointer->atomicReference<Policy::boundsMode, u32>(opC + opA).compare_exchange_strong(value, (u32)opB);
+			pushU64(value);
+			continue;
+		}
+		case BC::VectorInstruction:
+			instructionPointer = executeVectorOperation<Policy::boundsMode, Policy::alignedOperands>(instructionPointer, stackPointer, memoryPointer);
+			continue;
+		case BC::Memory64Instruction: {
+			// Memories with 64bit indices prefix the far memory bytecodes, which then pop
+			// i64 addresses, sizes and page counts instead of i32 ones
+			assert(memoryPointer);
+			auto operation = *(instructionPointer++);
+			switch (operation) {
+			case BC::I32LoadFar:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU32(*memoryPointer->pointer<Policy::boundsMode, u32>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64LoadFar:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64(*memoryPointer->pointer<Policy::boundsMode, u64>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I32Load8s:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU32((i32)*memoryPointer->pointer<Policy::boundsMode, i8>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I32Load8u:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU32(*memoryPointer->pointer<Policy::boundsMode, u8>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I32Load16s:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU32((i32)*memoryPointer->pointer<Policy::boundsMode, i16>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I32Load16u:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU32(*memoryPointer->pointer<Policy::boundsMode, u16>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64Load8s:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64((i64)*memoryPointer->pointer<Policy::boundsMode, i8>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64Load8u:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64(*memoryPointer->pointer<Policy::boundsMode, u8>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64Load16s:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64((i64)*memoryPointer->pointer<Policy::boundsMode, i16>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64Load16u:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64(*memoryPointer->pointer<Policy::boundsMode, u16>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64Load32s:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64((i64)*memoryPointer->pointer<Policy::boundsMode, i32>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I64Load32u:
+				opB = loadOperandU32();
+				opA = popU64();
+				pushU64(*memoryPointer->pointer<Policy::boundsMode, u32>(effectiveAddress64(opA, opB)));
+				break;
+			case BC::I32StoreFar:
+				opC = loadOperandU32();
+				opB = popU32();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u32>(effectiveAddress64(opA, opC)) = (u32)opB;
+				break;
+			case BC::I64StoreFar:
+				opC = loadOperandU32();
+				opB = popU64();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u64>(effectiveAddress64(opA, opC)) = opB;
+				break;
+			case BC::I32Store8:
+				opC = loadOperandU32();
+				opB = popU32();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u8>(effectiveAddress64(opA, opC)) = (u8)opB;
+				break;
+			case BC::I32Store16:
+				opC = loadOperandU32();
+				opB = popU32();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u16>(effectiveAddress64(opA, opC)) = (u16)opB;
+				break;
+			case BC::I64Store8:
+				opC = loadOperandU32();
+				opB = popU64();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u8>(effectiveAddress64(opA, opC)) = (u8)opB;
+				break;
+			case BC::I64Store16:
+				opC = loadOperandU32();
+				opB = popU64();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u16>(effectiveAddress64(opA, opC)) = (u16)opB;
+				break;
+			case BC::I64Store32:
+				opC = loadOperandU32();
+				opB = popU64();
+				opA = popU64();
+				*memoryPointer->pointer<Policy::boundsMode, u32>(effectiveAddress64(opA, opC)) = (u32)opB;
+				break;
+			case BC::MemorySize:
+				pushU64(memoryPointer->currentSizeInPages());
+				break;
+			case BC::MemoryGrow:
+				opA = popU64();
+				pushU64(memoryPointer->grow((i64)opA));
+				break;
+			case BC::MemoryInit: {
+				auto dataItemIdx = loadOperandU32();
+				assert(dataItemIdx < allDataItems.size());
+
+				opC = popU32(); // n(um) -> num bytes to init
+				opB = popU32(); // s(ource) -> data item offset
+				opA = popU64(); // d(estination) -> memory offset
+				memoryPointer->init(allDataItems[dataItemIdx], opA, opB, opC);
+				break;
+			}
+			case BC::MemoryCopy:
+				opC = popU64(); // n(um) -> num bytes to copy
+				opB = popU64(); // s(ource) -> source memory offset
+				opA = popU64(); // d(estination) -> destination memory offset
+				memoryPointer->copy(opA, opB, opC);
+				break;
+			case BC::MemoryFill:
+				opC = popU64(); // n(um) -> num bytes to fill
+				opB = popU32(); // val(ue) -> byte value to fill with
+				opA = popU64(); // d(estination) -> destination memory offset
+				memoryPointer->fill(opA, (u8)opB, opC);
+				break;
+			default:
+				assert(false);
+			}
+			continue;
+		}
 		case BC::I32ConstShort:
 			pushU32(*(instructionPointer++));
 			continue;
@@ -1650,8 +2984,6 @@ ValuePack Interpreter::runInterpreterLoop(const BytecodeFunction& function, std:
 		std::cerr << "Bytecode not implemeted '" << Bytecode::fromInt(bytecode).name() << "'" << std::endl;
 		throw std::runtime_error{ "bytecode not implemented" };
 	}
-
-	isInterpreting = false;
 }
 
 void ValuePack::print(std::ostream& out) const
@@ -1672,7 +3004,7 @@ void ValuePack::print(std::ostream& out) const
 	for (auto& valType : types) {
 		out << "  - ";
 		if (slotIdx < stackSlice.size()) {
-			Value::fromStackPointer(valType, stackSlice, slotIdx).print(out);
+			Value::fromStackPointer(valType, stackSlice, slotIdx, hasAlignedSlots).print(out);
 		}
 		else {
 			out << "<missing value>";		}
@@ -1680,13 +3012,13 @@ void ValuePack::print(std::ostream& out) const
 	}
 }
 
-Value WASM::Value::fromStackPointer(ValType type, std::span<u32> stackSlice, u32& slotIdx)
+Value WASM::Value::fromStackPointer(ValType type, std::span<u32> stackSlice, u32& slotIdx, bool alignedSlots)
 {
 	switch (type) {
 	case ValType::I32:
 	case ValType::F32: {
 		Value val{ type, stackSlice[slotIdx] };
-		slotIdx += 1;
+		slotIdx += alignedSlots ? 2 : 1;
 		return val;
 	}
 
@@ -1699,13 +3031,36 @@ Value WASM::Value::fromStackPointer(ValType type, std::span<u32> stackSlice, u32
 		return val;
 	}
 
-	case ValType::V128:
-		throw std::runtime_error{"Vector types are not supported when constructing values"};
+	case ValType::V128: {
+		auto data = reinterpret_cast<u64*>(stackSlice.data() + slotIdx);
+		Value val{ type, data[0], data[1] };
+		slotIdx += 4;
+		return val;
+	}
 	default:
 		throw std::runtime_error{"Cannot construct value of unknown type"};
 	}
 }
 
+bool WASM::Value::hasType(ValType type) const
+{
+	if (mType != type) {
+		return false;
+	}
+
+	// References from the host are checked for their nullability and function type,
+	// as the bytecode relies on the validated types
+	if (!type.isReference()) {
+		return true;
+	}
+
+	if (!refData) {
+		return type.isNullable();
+	}
+
+	return !type.hasTypeIndex() || refData->interpreterTypeIndex() == type.typeIndex();
+}
+
 u64 WASM::Value::asInt() const
 {
 	if (mType == ValType::I32) {
@@ -1751,6 +3106,9 @@ void WASM::Value::print(std::ostream& out) const
 		return;
 
 	case ValType::V128:
+		out << mType.name() << " " << std::hex << std::setfill('0') << std::setw(16) << v128Data[1] << std::setw(16) << v128Data[0] << std::setfill(' ') << std::dec;
+		return;
+
 	default:
 		throw std::runtime_error{ "Cannot print value of unsupported type" };
 	}
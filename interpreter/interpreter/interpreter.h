@@ -1,8 +1,17 @@
 ﻿#pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <variant>
 
 #include "host_module.h"
+#include "profiler.h"
 
 namespace WASM {
 	class FunctionHandle {
@@ -11,11 +20,47 @@ namespace WASM {
 			: mName{ std::move(n) }, mFunction{ f } {}
 	private:
 		friend class Interpreter;
+		friend class Executor;
 
 		std::string mName;
 		Function& mFunction;
 	};
 
+	/*
+	* Suspended Call class
+	* Handle to a guest function call that was suspended by a pending host
+	* function or that yielded at a safepoint. It owns the value stack of the
+	* call together with the saved registers of the interpreter, so that any
+	* number of calls can be kept suspended at the same time until they are
+	* resumed with the results of the host function. A call can only be resumed
+	* by the interpreter that suspended it.
+	*/
+	class SuspendedCall {
+	public:
+		SuspendedCall(SuspendedCall&&) = default;
+		SuspendedCall& operator=(SuspendedCall&&) = default;
+
+		bool hasYielded() const { return !mPendingFunction.has_value(); }
+		Nullable<const HostFunctionBase> pendingFunction() const { return mPendingFunction; }
+
+	private:
+		friend class Interpreter;
+
+		SuspendedCall(const Interpreter& i, std::unique_ptr<u32[]> s, const BytecodeFunction& ef, Nullable<const HostFunctionBase> pf)
+			: mInterpreter{ i }, mStackBase{ std::move(s) }, mEntryFunction{ ef }, mPendingFunction{ pf } {}
+
+		NonNull<const Interpreter> mInterpreter;
+		std::unique_ptr<u32[]> mStackBase;
+		NonNull<const BytecodeFunction> mEntryFunction;
+		Nullable<const HostFunctionBase> mPendingFunction;
+		const u8* mInstructionPointer{ nullptr };
+		u32* mStackPointer{ nullptr };
+		u32* mFramePointer{ nullptr };
+		Memory* mMemoryPointer{ nullptr };
+	};
+
+	using ResumableResult = std::variant<ValuePack, SuspendedCall>;
+
 	class Interpreter {
 	public:
 		Interpreter();
@@ -24,6 +69,13 @@ namespace WASM {
 		void loadModule(std::string);
 		HostModuleHandle registerHostModule(HostModuleBuilder&);
 		void compileAndLinkModules();
+		void enableHotColdBytecodeLayout(bool = true);
+		void enableFuelMetering(bool = true);
+		void enableAlignedBytecode(bool = true);
+		bool usesAlignedBytecode() const { return useAlignedBytecode; }
+		void enableFunctionInlining(bool = true);
+		void enableOptimizer(bool = true);
+		void useOptimizerProfile(const BytecodeCounter&);
 
 		FunctionHandle functionByName(std::string_view, std::string_view);
 		
@@ -35,7 +87,33 @@ namespace WASM {
 			return executeFunction(handle.mFunction, argumentArray);
 		}
 
+		template<typename ...Args>
+		ResumableResult runResumableFunction(const FunctionHandle& handle, Args... args) {
+			std::array<Value, sizeof...(Args)> argumentArray{ Value::fromType<Args>( args )... };
+			return executeResumableFunction(handle.mFunction, argumentArray);
+		}
+
+		ResumableResult resumeFunction(SuspendedCall, std::span<Value> = {});
+
 		void attachIntrospector(std::unique_ptr<Introspector>);
+		void attachProfiler(SamplingProfiler&);
+		void detachProfiler();
+		void attachBytecodeCounter(BytecodeCounter&);
+		void detachBytecodeCounter();
+		void setMemoryBoundsMode(MemoryBoundsMode);
+		void enableLiveTracing(bool = true);
+		void attachExecutionTracer(std::shared_ptr<ExecutionTracer>);
+		void detachExecutionTracer();
+
+		void enableInterrupts(bool = true);
+		void interrupt();
+		void requestYield();
+		void setDeadline(std::chrono::steady_clock::time_point);
+		void clearDeadline();
+
+		void addFuel(u64);
+		u64 remainingFuel() const { return fuelRemaining; }
+		u64 consumedFuel() const { return fuelAdded - fuelRemaining; }
 
 	private:
 		friend class Module;
@@ -43,16 +121,48 @@ namespace WASM {
 		friend class ModuleLinker;
 		friend class ModuleCompiler;
 		friend class DataItem;
+		friend class Executor;
 
 		struct FunctionLookup {
 			const Function& function;
 			const Module& module;
 		};
 
+		/*
+		* Loop Policy struct
+		* Selects the features of an interpreter loop variant at compile time, so
+		* that features which are not in use do not add any code to the loop.
+		* Profiling, bytecode counting and tracing share a single instrumented
+		* variant, which checks at runtime which of them are attached, to keep
+		* the number of variants low. Fuel needs no flag, as it is charged by
+		* bytecodes that are only printed when metering is enabled. Variants
+		* that poll for safepoints can be left at jumps, calls and returns to
+		* continue execution in a different variant.
+		*/
+		template<bool Instrumented, bool PollSafepoints, MemoryBoundsMode::TEnum BoundsMode, bool AlignedOperands>
+		struct LoopPolicy {
+			static constexpr bool instrumented = Instrumented;
+			static constexpr bool pollSafepoints = PollSafepoints;
+			static constexpr MemoryBoundsMode::TEnum boundsMode = BoundsMode;
+			static constexpr bool alignedOperands = AlignedOperands;
+		};
+
+		enum SafepointRequest : u32 {
+			SwitchTracer = 0x01,
+			Interrupt = 0x02,
+			Yield = 0x04,
+			DeadlineExpired = 0x08
+		};
+
 		void registerModuleName(NonNull<ModuleBase>);
+		void layoutBytecode();
 
 		ValuePack executeFunction(Function&, std::span<Value>);
-		ValuePack runInterpreterLoop(const BytecodeFunction&, std::span<Value>);
+		ResumableResult executeResumableFunction(Function&, std::span<Value>);
+		ResumableResult runConfiguredInterpreterLoop(const BytecodeFunction&);
+		std::optional<ValuePack> runSelectedInterpreterLoop(const BytecodeFunction&);
+		template<typename Policy>
+		std::optional<ValuePack> runInterpreterLoop(const BytecodeFunction&);
 
 		Nullable<Function> findFunction(const std::string&, const std::string&);
 		ModuleBase& findModule(const std::string&);
@@ -64,14 +174,24 @@ namespace WASM {
 		InterpreterLinkedElementIndex indexOfLinkedElement(const LinkedElement&);
 		InterpreterLinkedDataIndex indexOfLinkedDataItem(const LinkedDataItem&);
 
+		void acquireStack();
+		void releaseStack(std::unique_ptr<u32[]>);
 		void initState(const BytecodeFunction& function);
+		void pushEntryFrame(const BytecodeFunction&, std::span<Value>);
+		void updateActiveTracer();
+		bool handleSafepointRequests();
+		void runDeadlineTimer(std::stop_token);
 		void saveState(const u8*, u32*, u32*, Memory*);
 		void dumpStack(std::ostream&) const;
 		std::optional<FunctionLookup> findFunctionByBytecodePointer(const u8*) const;
+		void sampleProfile(const u8*, u32*, u32);
 
 		std::list<Module> wasmModules;
 		std::list<HostModule> hostModules;
 		std::unordered_map<std::string, NonNull<ModuleBase>> moduleNameMap;
+
+		// Deduplicated types of all loaded modules, which keep their index when linking
+		std::vector<FunctionType> loadedFunctionTypes;
 		SealedVector<FunctionType> allFunctionTypes;
 		SealedVector<BytecodeFunction> allFunctions;
 		SealedVector<FunctionTable> allTables;
@@ -80,15 +200,47 @@ namespace WASM {
 		SealedVector<Global<u64>> allGlobals64;
 		SealedVector<LinkedElement> allElements;
 		SealedVector<LinkedDataItem> allDataItems;
+		BytecodeArena bytecodeArena;
 
 		bool hasLinkedAndCompiled{ false };
+		bool useHotColdBytecodeLayout{ false };
+		bool useFuelMetering{ false };
+		bool useAlignedBytecode{ false };
+		bool useFunctionInlining{ false };
+		bool useOptimizer{ false };
+		MemoryBoundsMode memoryBoundsMode{ MemoryBoundsMode::Checked };
+		bool allowLiveTracing{ false };
+		bool allowInterrupts{ false };
 		bool isInterpreting{ false };
 		std::unique_ptr<u32[]> mStackBase;
 		u32* mStackPointer{ nullptr };
 		u32* mFramePointer{ nullptr };
 		Memory* mMemoryPointer{ nullptr };
 		const u8* mInstructionPointer{ nullptr };
+		Nullable<const HostFunctionBase> pendingHostFunction;
+		std::vector<std::unique_ptr<u32[]>> unusedStacks;
+
+		// Signed, so that charging a block only needs a single subtraction and branch
+		i64 fuelRemaining{ 0 };
+		u64 fuelAdded{ 0 };
 
 		std::unique_ptr<Introspector> attachedIntrospector;
+		Nullable<SamplingProfiler> attachedProfiler;
+		Nullable<BytecodeCounter> attachedBytecodeCounter;
+		Nullable<const BytecodeCounter> optimizerProfile;
+
+		// Other threads only flag their requests, which the interpreter handles at its
+		// next safepoint. Swapping the tracer only sets the requested one.
+		std::atomic<u32> safepointRequests{ 0 };
+		std::mutex tracerMutex;
+		std::shared_ptr<ExecutionTracer> requestedTracer;
+		std::shared_ptr<ExecutionTracer> activeTracer;
+
+		std::mutex deadlineMutex;
+		std::condition_variable_any deadlineCondition;
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+
+		// Declared last, so that the thread is stopped before anything else is destroyed
+		std::jthread deadlineTimerThread;
 	};
 }
\ No newline at end of file
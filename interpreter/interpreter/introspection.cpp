@@ -1,6 +1,7 @@
 
 #include "introspection.h"
 #include "module.h"
+#include "interpreter.h"
 
 using namespace WASM;
 
@@ -431,7 +432,7 @@ void WASM::DebugLogger::onCompiledFunction(const Module& module, const BytecodeF
 		stream << "Compiled function " << modName << " :: " << functionName << " (index " << function.moduleIndex() << ") ";
 		stream << "(max stack height " << function.maxStackHeight() / 4 << " slots)" << std::endl;
 
-		ModuleCompiler::printBytecode(stream, function.bytecode());
+		ModuleCompiler::printBytecode(stream, function.bytecode(), module.interpreter().usesAlignedBytecode());
 	}
 }
 
@@ -459,3 +460,47 @@ bool WASM::ConsoleLogger::doLoggingWhenCompiling()
 {
 	return logWhenCompiling;
 }
+
+void WASM::ConsoleTracer::onFunctionEnter(const BytecodeFunction& function, const Module& module)
+{
+	printIndentation();
+	stream << "-> ";
+	printFunctionName(function, module);
+	stream << std::endl;
+	depth++;
+}
+
+void WASM::ConsoleTracer::onFunctionExit(const BytecodeFunction& function, const Module& module)
+{
+	// The tracer might have been attached while already inside of a function
+	if (depth > 0) {
+		depth--;
+	}
+
+	printIndentation();
+	stream << "<- ";
+	printFunctionName(function, module);
+	stream << std::endl;
+}
+
+void WASM::ConsoleTracer::onBytecode(const u8* instructionPointer, Bytecode bytecode)
+{
+	if (traceBytecodes) {
+		printIndentation();
+		stream << std::hex << (u64)instructionPointer << std::dec << " " << bytecode.name() << '\n';
+	}
+}
+
+void WASM::ConsoleTracer::printIndentation()
+{
+	for (u32 i = 0; i != depth; i++) {
+		stream << "  ";
+	}
+}
+
+void WASM::ConsoleTracer::printFunctionName(const BytecodeFunction& function, const Module& module)
+{
+	auto maybeFunctionName = function.lookupName(module);
+	auto* functionName = maybeFunctionName.has_value() ? maybeFunctionName->c_str() : "<unknown name>";
+	stream << module.name() << " :: " << functionName << " (index " << function.moduleIndex() << ")";
+}
@@ -8,12 +8,15 @@
 #include "util.h"
 #include "forward.h"
 #include "indices.h"
+#include "bytecode.h"
 
 namespace WASM {
 	class Introspector {
 	public:
-		using NameMap = std::unordered_map<u32, std::string>;
-		using IndirectNameMap = std::unordered_map<u32, NameMap>;
+		virtual ~Introspector() = default;
+
+		using NameMap = std::pmr::unordered_map<u32, std::pmr::string>;
+		using IndirectNameMap = std::pmr::unordered_map<u32, NameMap>;
 
 		virtual void onModuleParsingStart(std::string_view) = 0;
 		virtual void onModuleParsingFinished(std::span<FunctionCode>) = 0;
@@ -133,4 +136,37 @@ namespace WASM {
 		bool logWhenCompiling;
 		std::ostream& stream;
 	};
+
+	/*
+	* Execution Tracer class
+	* Receives events from the interpreter loop while it is attached to an
+	* interpreter. Entering and leaving functions is reported on calls and
+	* returns, and each bytecode is reported right before it is executed.
+	*/
+	class ExecutionTracer {
+	public:
+		virtual ~ExecutionTracer() = default;
+
+		virtual void onFunctionEnter(const BytecodeFunction&, const Module&) = 0;
+		virtual void onFunctionExit(const BytecodeFunction&, const Module&) = 0;
+		virtual void onBytecode(const u8*, Bytecode) = 0;
+	};
+
+	class ConsoleTracer : public ExecutionTracer {
+	public:
+		ConsoleTracer(std::ostream& s, bool tb = true)
+			: stream{ s }, traceBytecodes{ tb } {}
+
+		virtual void onFunctionEnter(const BytecodeFunction&, const Module&) override;
+		virtual void onFunctionExit(const BytecodeFunction&, const Module&) override;
+		virtual void onBytecode(const u8*, Bytecode) override;
+
+	protected:
+		void printIndentation();
+		void printFunctionName(const BytecodeFunction&, const Module&);
+
+		std::ostream& stream;
+		bool traceBytecodes;
+		u32 depth{ 0 };
+	};
 }
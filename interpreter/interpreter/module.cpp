@@ -2,11 +2,14 @@
 #include <cassert>
 #include <iomanip>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
 #include "interpreter.h"
 #include "introspection.h"
 #include "error.h"
 #include "virtual_span.h"
+#include "optimizer.h"
 
 using namespace WASM;
 
@@ -14,13 +17,15 @@ static constexpr inline bool isShortDistance(i32 distance) {
 	return distance >= -128 && distance <= 127;
 }
 
-Nullable<const std::string> Function::lookupName(const Module& module) const
+Nullable<const std::pmr::string> Function::lookupName(const Module& module) const
 {
 	return module.functionNameByIndex(mModuleIndex);
 }
 
 BytecodeFunction::BytecodeFunction(ModuleFunctionIndex idx, ModuleTypeIndex ti, const FunctionType& ft, FunctionCode c)
 	: Function{ idx }, mModuleTypeIndex{ ti }, type{ft}, code{ std::move(c.code) } {
+	// Leaf functions get a smaller frame, which changes the offsets of the locals
+	mIsLeaf = !hasCalls() && !requiresMemoryInstance();
 	uncompressLocalTypes(c.compressedLocalTypes);
 }
 
@@ -50,15 +55,15 @@ u32 BytecodeFunction::localsCount() const
 u32 BytecodeFunction::operandStackSectionOffsetInBytes() const
 {
 	if (uncompressedLocals.empty()) {
-		return SpecialFrameBytes;
+		return frameBytes();
 	}
 
 	auto& lastLocal = uncompressedLocals.back();
-	auto byteOffset= lastLocal.offset + lastLocal.type.sizeInBytes();
+	auto byteOffset= lastLocal.offset + lastLocal.type.stackSizeInBytes(mHasAlignedStack);
 
-	// Manually add the size of RA + FP + SP + MP, if there are only parameters
+	// Manually add the size of the frame, if there are only parameters
 	if (!hasLocals()) {
-		byteOffset += SpecialFrameBytes;
+		byteOffset += frameBytes();
 	}
 
 	return byteOffset;
@@ -87,7 +92,47 @@ bool BytecodeFunction::requiresMemoryInstance() const
 	return false;
 }
 
-void BytecodeFunction::uncompressLocalTypes(const std::vector<CompressedLocalTypes>& compressedLocals)
+/*
+* Leaf functions neither call other functions nor access the memory. They are
+* called with a frame that only holds RA and FP, as their stack pointer can be
+* derived from the frame pointer and the memory pointer stays untouched. Only
+* functions without calls are inlined, which also rules out recursion.
+*/
+bool BytecodeFunction::hasCalls() const
+{
+	for (auto& ins : code) {
+		switch (ins.opCode()) {
+		case InstructionType::Call:
+		case InstructionType::CallIndirect:
+		case InstructionType::ReturnCall:
+		case InstructionType::ReturnCallIndirect:
+		case InstructionType::CallReference:
+		case InstructionType::ReturnCallReference:
+			return true;
+		default:
+			break;
+		}
+	}
+
+	return false;
+}
+
+u32 BytecodeFunction::appendLocal(ValType localType)
+{
+	// Put the local behind the last one, or behind the frame if there are none yet
+	auto byteOffset = operandStackSectionOffsetInBytes();
+	uncompressedLocals.emplace_back(localType, byteOffset);
+	return uncompressedLocals.size() - 1;
+}
+
+void BytecodeFunction::removeLocalsFrom(u32 index)
+{
+	// Only appended locals are removed, so the offsets of the remaining ones stay valid
+	assert(index >= type->parameters().size() && index <= uncompressedLocals.size());
+	uncompressedLocals.erase(uncompressedLocals.begin() + index, uncompressedLocals.end());
+}
+
+void BytecodeFunction::uncompressLocalTypes(const std::pmr::vector<CompressedLocalTypes>& compressedLocals)
 {
 	// Count the parameters and locals
 	auto& params = type->parameters();
@@ -99,28 +144,112 @@ void BytecodeFunction::uncompressLocalTypes(const std::vector<CompressedLocalTyp
 	uncompressedLocals.reserve(numLocals);
 
 	// Put all parameters
-	u32 byteOffset = 0;
 	for (auto param : params) {
-		uncompressedLocals.emplace_back(param, byteOffset);
-		byteOffset += param.sizeInBytes();
+		uncompressedLocals.emplace_back(param, 0);
 	}
 
-	// Leave space for return address, stack, frame and memory pointer
-	byteOffset += SpecialFrameBytes;
-
 	// Decompress and put each local
 	for (auto& pack : compressedLocals) {
 		for (u32 i = 0; i != pack.count; i++) {
-			uncompressedLocals.emplace_back(pack.type, byteOffset);
-			byteOffset += pack.type.sizeInBytes();
+			uncompressedLocals.emplace_back(pack.type, 0);
+		}
+	}
+
+	layoutLocals();
+}
+
+void BytecodeFunction::layoutLocals()
+{
+	u32 numParameters = type->parameters().size();
+	u32 byteOffset = 0;
+	for (u32 i = 0; i != uncompressedLocals.size(); i++) {
+		// Leave space for return address, stack, frame and memory pointer
+		if (i == numParameters) {
+			byteOffset += frameBytes();
 		}
+
+		auto& local = uncompressedLocals[i];
+		local.offset = byteOffset;
+		byteOffset += local.type.stackSizeInBytes(mHasAlignedStack);
+	}
+}
+
+void BytecodeFunction::enableAlignedStack()
+{
+	// Each parameter and local moves to its own 8 byte slot
+	mHasAlignedStack = true;
+	layoutLocals();
+}
+
+void BytecodeFunction::setBytecode(Buffer bytecode)
+{
+	mCompiledBytecode = std::move(bytecode);
+	mBytecode = mCompiledBytecode.slice(0, mCompiledBytecode.size());
+}
+
+void BytecodeFunction::relocateBytecode(u8* location)
+{
+	// Jumps are relative and calls refer to the function object, so the
+	// bytecode can simply be copied to its new location
+	std::memcpy(location, mBytecode.begin(), mBytecode.size());
+	mBytecode = BufferSlice{ location, mBytecode.size() };
+	mCompiledBytecode = Buffer{};
+}
+
+BytecodeArena::BytecodeArena(std::span<Entry> functions)
+{
+	sizeType numBytes = 0;
+	for (auto& entry : functions) {
+		numBytes = alignUp(numBytes, FunctionAlignment) + entry.function->bytecode().size();
+	}
+
+	mSize = alignUp(numBytes, PageSize);
+	if (mSize == 0) {
+		return;
+	}
+
+	mData = std::unique_ptr<u8[], PageDeleter>{ static_cast<u8*>(::operator new[](mSize, std::align_val_t{ PageSize })) };
+
+	// Fill the padding between functions with traps
+	std::memset(mData.get(), (u8)Bytecode::Unreachable, mSize);
+
+	// The functions are placed in order, hence the index is sorted by address
+	mIndex.reserve(functions.size());
+
+	sizeType offset = 0;
+	for (auto& entry : functions) {
+		offset = alignUp(offset, FunctionAlignment);
+		entry.function->relocateBytecode(mData.get() + offset);
+
+		auto& bytecode = entry.function->bytecode();
+		mIndex.emplace_back(bytecode.begin(), bytecode.end(), *entry.function, *entry.module);
+		offset += bytecode.size();
+	}
+}
+
+std::optional<BytecodeArena::Lookup> BytecodeArena::findFunction(const u8* pointer) const
+{
+	// Find the last function that begins at or before the pointer
+	auto it = std::upper_bound(mIndex.begin(), mIndex.end(), pointer, [](const u8* ptr, const IndexEntry& entry) {
+		return ptr < entry.begin;
+	});
+
+	if (it == mIndex.begin()) {
+		return {};
 	}
+
+	auto& entry = *(--it);
+	if (pointer >= entry.end) {
+		return {};
+	}
+
+	return Lookup{ *entry.function, *entry.module };
 }
 
 FunctionTable::FunctionTable(ModuleTableIndex idx, const TableType& tableType)
 	: index{ idx }, mType{ tableType.valType() }, mLimits{ tableType.limits() }
 {
-	if (grow(mLimits.min(), {}) != 0) {
+	if (grow((u32)mLimits.min(), {}) != 0) {
 		throw std::runtime_error{ "Could not init table" };
 	}
 }
@@ -257,32 +386,256 @@ sizeType WASM::LinkedDataItem::initMemoryIfActive(Module& module) const
 	return mDataBytes.size();
 }
 
+void WASM::LinkedDataItem::drop()
+{
+	// Active items only reference the module's buffer, passive ones free their copy
+	mDataBytes = BufferSlice{ nullptr, 0 };
+	mOwnedBytes = Buffer{};
+}
+
 Memory::Memory(ModuleMemoryIndex idx, Limits l)
 	: mIndex{ idx }, mLimits{ l } {
+	// Memories declared as shared are backed by a shared memory object, which the
+	// host can hand to other interpreter instances
+	if (mLimits.isShared()) {
+		mSharedMemory = std::make_shared<SharedMemory>((u32)mLimits.min(), (u32)*mLimits.max());
+		mBase = mSharedMemory->data();
+		mByteSize = mSharedMemory->currentSizeInBytes();
+		return;
+	}
+
 	grow(mLimits.min());
 }
 
-i32 Memory::grow(i32 pageCountIncrease)
+Memory::Memory(ModuleMemoryIndex idx, std::shared_ptr<SharedMemory> sharedMemory)
+	: mIndex{ idx }, mLimits{ sharedMemory->limits() }, mSharedMemory{ std::move(sharedMemory) } {
+	mBase = mSharedMemory->data();
+	mByteSize = mSharedMemory->currentSizeInBytes();
+}
+
+i64 Memory::grow(i64 pageCountIncrease)
 {
+	if (mSharedMemory) {
+		auto result = mSharedMemory->grow(pageCountIncrease > 0x10000 ? -1 : (i32)pageCountIncrease);
+		mByteSize = mSharedMemory->currentSizeInBytes();
+		return result;
+	}
+
 	auto oldByteSize = mData.size();
 	auto oldPageCount = oldByteSize / PageSize;
 
-	if (mLimits.max().has_value() && (sizeType)oldPageCount + pageCountIncrease > *mLimits.max()) {
+	// Without a maximum the memory is still limited to its address space
+	auto maxPageCount = mLimits.max().has_value() ? (sizeType)*mLimits.max() : mLimits.is64() ? (sizeType)0x1000000000000 : (sizeType)0x10000;
+	if (pageCountIncrease < 0 || (sizeType)pageCountIncrease > maxPageCount - oldPageCount) {
+		return -1;
+	}
+
+	// The increase in bytes has to fit into the vector, which also keeps the multiplication
+	// below from wrapping around for the largest 64bit memories
+	if ((sizeType)pageCountIncrease > (mData.max_size() - oldByteSize) / PageSize) {
 		return -1;
 	}
 
 	try {
-		auto byteSizeIncrease = pageCountIncrease * PageSize;
+		auto byteSizeIncrease = (sizeType)pageCountIncrease * PageSize;
 		mData.reserve(oldByteSize + byteSizeIncrease);
 		mData.insert(mData.end(), byteSizeIncrease, 0x00);
+		mBase = mData.data();
+		mByteSize = mData.size();
 		return oldPageCount;
 	}
 	catch (std::bad_alloc&) {
 		return -1;
 	}
+	catch (std::length_error&) {
+		return -1;
+	}
+}
+
+void Memory::checkSharedBounds(u64 address, u64 numBytes)
+{
+	// Slow path of the bounds checks. Another instance might have grown a shared
+	// memory since this instance last saw its size
+	if (mSharedMemory) {
+		mByteSize = mSharedMemory->currentSizeInBytes();
+		if (address <= mByteSize && numBytes <= mByteSize - address) {
+			return;
+		}
+	}
+
+	throw std::runtime_error{ "Out of bounds memory access" };
+}
+
+u32 Memory::atomicNotify(u64 address, u32 count)
+{
+	pointer<MemoryBoundsMode::Strict, u32>(address);
+	if (address % sizeof(u32)) {
+		throw std::runtime_error{ "Unaligned atomic memory access" };
+	}
+
+	// Nobody can wait on a memory that is not shared
+	return mSharedMemory ? mSharedMemory->notify(address, count) : 0;
+}
+
+std::optional<u32> Memory::atomicWait32(u64 address, u32 expected, i64 timeout, Nullable<const std::atomic<u32>> cancelFlags)
+{
+	if (!mSharedMemory) {
+		throw std::runtime_error{ "Cannot wait on unshared memory" };
+	}
+
+	atomicReference<MemoryBoundsMode::Strict, u32>(address);
+	return mSharedMemory->wait(address, expected, timeout, cancelFlags);
+}
+
+std::optional<u32> Memory::atomicWait64(u64 address, u64 expected, i64 timeout, Nullable<const std::atomic<u32>> cancelFlags)
+{
+	if (!mSharedMemory) {
+		throw std::runtime_error{ "Cannot wait on unshared memory" };
+	}
+
+	atomicReference<MemoryBoundsMode::Strict, u64>(address);
+	return mSharedMemory->wait(address, expected, timeout, cancelFlags);
+}
+
+SharedMemory::SharedMemory(u32 minPages, u32 maxPages)
+	: mLimits{ minPages, maxPages, true }
+{
+	if (!mLimits.isValid(0x10000)) {
+		throw std::runtime_error{ "Invalid shared memory limits" };
+	}
+
+	// Pages beyond the current size are only committed once the memory grows into them,
+	// so that the operating system does not have to back them yet
+	mAddressSpace.emplace((sizeType)maxPages * Memory::PageSize);
+	if (grow(minPages) < 0) {
+		throw std::runtime_error{ "Could not allocate shared memory" };
+	}
+}
+
+i32 SharedMemory::grow(i32 pageCountIncrease)
+{
+	// Growing is serialized, so that new pages are zeroed before their size is published
+	std::scoped_lock lock{ mGrowMutex };
+
+	auto oldPageCount = mPageCount.load(std::memory_order_relaxed);
+	if (pageCountIncrease < 0 || (sizeType)oldPageCount + pageCountIncrease > *mLimits.max()) {
+		return -1;
+	}
+
+	// Newly committed pages are zeroed by the operating system
+	if (!mAddressSpace->commit((sizeType)oldPageCount * Memory::PageSize, (sizeType)pageCountIncrease * Memory::PageSize)) {
+		return -1;
+	}
+
+	mPageCount.store(oldPageCount + pageCountIncrease, std::memory_order_release);
+	return oldPageCount;
+}
+
+u32 SharedMemory::notify(u64 address, u32 count)
+{
+	// Waiters are woken in the order they started waiting
+	std::scoped_lock lock{ mWaitMutex };
+	auto it = mWaitQueues.find(address);
+	if (it == mWaitQueues.end()) {
+		return 0;
+	}
+
+	auto& waiters = it->second;
+	u32 numWokenWaiters = 0;
+	while (numWokenWaiters < count && !waiters.empty()) {
+		auto& waiter = *waiters.front();
+		waiters.pop_front();
+		waiter.isNotified = true;
+		waiter.condition.notify_one();
+		numWokenWaiters++;
+	}
+
+	if (waiters.empty()) {
+		mWaitQueues.erase(it);
+	}
+
+	return numWokenWaiters;
+}
+
+std::optional<u32> SharedMemory::wait(u64 address, u32 expected, i64 timeout, Nullable<const std::atomic<u32>> cancelFlags)
+{
+	return waitForNotify(address, expected, timeout, cancelFlags);
+}
+
+std::optional<u32> SharedMemory::wait(u64 address, u64 expected, i64 timeout, Nullable<const std::atomic<u32>> cancelFlags)
+{
+	return waitForNotify(address, expected, timeout, cancelFlags);
+}
+
+template<typename T>
+std::optional<u32> SharedMemory::waitForNotify(u64 address, T expected, i64 timeout, Nullable<const std::atomic<u32>> cancelFlags)
+{
+	// Returns 0 when notified, 1 when the value differs and 2 when timed out. The value
+	// is compared under the lock, so that a notify after a store cannot be missed.
+	// Negative timeouts in nanoseconds wait forever. Cancelled waits return nothing.
+	std::unique_lock lock{ mWaitMutex };
+	auto value = std::atomic_ref<T>{ *reinterpret_cast<T*>(data() + address) }.load();
+	if (value != expected) {
+		return 1;
+	}
+
+	Waiter waiter;
+	auto& waiters = mWaitQueues[address];
+	waiters.emplace_back(waiter);
+
+	// Timeouts that are too large to be represented wait forever as well
+	using Clock = std::chrono::steady_clock;
+	auto now = Clock::now();
+	std::optional<Clock::time_point> endTime;
+	if (timeout >= 0 && std::chrono::nanoseconds{ timeout } < Clock::time_point::max() - now) {
+		endTime = now + std::chrono::nanoseconds{ timeout };
+	}
+
+	auto isNotified = [&]() { return waiter.isNotified; };
+	if (!endTime.has_value() && !cancelFlags.has_value()) {
+		waiter.condition.wait(lock, isNotified);
+		return 0;
+	}
+
+	// Cancellable waits sleep in slices. A notify that arrives together with a
+	// cancel request still wins, as the waiter is already dequeued.
+	std::optional<u32> result;
+	while (true) {
+		if (isNotified()) {
+			return 0;
+		}
+
+		if (cancelFlags.has_value() && cancelFlags->load(std::memory_order_relaxed)) {
+			break;
+		}
+
+		auto sliceEndTime = cancelFlags.has_value() ? Clock::now() + WaitSliceDuration : *endTime;
+		if (endTime.has_value()) {
+			sliceEndTime = std::min(sliceEndTime, *endTime);
+		}
+
+		if (waiter.condition.wait_until(lock, sliceEndTime, isNotified)) {
+			return 0;
+		}
+
+		if (endTime.has_value() && Clock::now() >= *endTime) {
+			result = 2;
+			break;
+		}
+	}
+
+	// Waiters that timed out or were cancelled are still queued and have to remove themselves
+	auto it = mWaitQueues.find(address);
+	auto& queue = it->second;
+	queue.erase(std::find_if(queue.begin(), queue.end(), [&](auto& w) { return w.pointer() == &waiter; }));
+	if (queue.empty()) {
+		mWaitQueues.erase(it);
+	}
+
+	return result;
 }
 
-void WASM::Memory::init(const LinkedDataItem& dataItem, u32 memoryOffset, u32 itemOffset, u32 numBytes)
+void WASM::Memory::init(const LinkedDataItem& dataItem, u64 memoryOffset, u32 itemOffset, u32 numBytes)
 {
 	// https://webassembly.github.io/spec/core/exec/instructions.html#xref-syntax-instructions-syntax-instr-memory-mathsf-memory-init-x
 
@@ -291,7 +644,7 @@ void WASM::Memory::init(const LinkedDataItem& dataItem, u32 memoryOffset, u32 it
 		throw std::runtime_error{ "Invalid memory init: Data item access out of bounds" };
 	}
 
-	if ((sizeType)memoryOffset + numBytes > mData.size()) {
+	if (memoryOffset > currentSizeInBytes() || numBytes > currentSizeInBytes() - memoryOffset) {
 		throw std::runtime_error{ "Invalid memory init: Memory access out of bounds" };
 	}
 
@@ -302,6 +655,44 @@ void WASM::Memory::init(const LinkedDataItem& dataItem, u32 memoryOffset, u32 it
 	memcpy(pointer(memoryOffset), bytes.begin()+ itemOffset, numBytes);
 }
 
+void WASM::Memory::copy(u64 destinationOffset, u64 sourceOffset, u64 numBytes)
+{
+	// https://webassembly.github.io/spec/core/exec/instructions.html#xref-syntax-instructions-syntax-instr-memory-mathsf-memory-copy
+
+	// Offsets of 64bit memories might overflow when the size is added to them
+	auto byteSize = currentSizeInBytes();
+	if (numBytes > byteSize || sourceOffset > byteSize - numBytes) {
+		throw std::runtime_error{ "Invalid memory copy: Source memory access out of bounds" };
+	}
+
+	if (destinationOffset > byteSize - numBytes) {
+		throw std::runtime_error{ "Invalid memory copy: Destination memory access out of bounds" };
+	}
+
+	if (!numBytes) {
+		return;
+	}
+
+	// The areas might overlap, which memmove handles in both directions
+	memmove(pointer(destinationOffset), pointer(sourceOffset), numBytes);
+}
+
+void WASM::Memory::fill(u64 destinationOffset, u8 value, u64 numBytes)
+{
+	// https://webassembly.github.io/spec/core/exec/instructions.html#xref-syntax-instructions-syntax-instr-memory-mathsf-memory-fill
+
+	auto byteSize = currentSizeInBytes();
+	if (numBytes > byteSize || destinationOffset > byteSize - numBytes) {
+		throw std::runtime_error{ "Invalid memory fill: Memory access out of bounds" };
+	}
+
+	if (!numBytes) {
+		return;
+	}
+
+	memset(pointer(destinationOffset), value, numBytes);
+}
+
 u64 Memory::minBytes() const {
 	return mLimits.min() * PageSize;
 }
@@ -317,20 +708,25 @@ std::optional<u64> Memory::maxBytes() const {
 
 sizeType Memory::currentSizeInPages() const
 {
-	return mData.size() / PageSize;
+	return currentSizeInBytes() / PageSize;
 }
 
 sizeType WASM::Memory::currentSizeInBytes() const
 {
-	return mData.size();
+	return mSharedMemory ? mSharedMemory->currentSizeInBytes() : mByteSize;
 }
 
 
-void WASM::ModuleBase::createMemoryBase(const MemoryType& memoryType, ModuleLinker& linker, Nullable<Introspector> introspector)
+void WASM::ModuleBase::createMemoryBase(const MemoryType& memoryType, ModuleLinker& linker, Nullable<Introspector> introspector, std::shared_ptr<SharedMemory> sharedMemory)
 {
 	auto& memories = linker.createMemory();
 	mMemoryIndex = InterpreterMemoryIndex{ (u32)memories.size() };
 
+	if (sharedMemory) {
+		memories.emplace_back(ModuleMemoryIndex{ 0 }, std::move(sharedMemory));
+		return;
+	}
+
 	memories.emplace_back(ModuleMemoryIndex{ 0 }, memoryType.limits());
 }
 
@@ -373,19 +769,19 @@ Module::Module(
 	ExportTable e
 )
 	: ModuleBase{ i },
+	mArena{ s->releaseArena() },
 	mPath{ std::move(p) },
 	mName{ std::move(n) },
 	mData{ std::move(b) },
 	compilationData{ std::move(s) },
-	exports{ std::move(e) }
+	exports{ std::move(e) },
+	functionNameMap{ compilationData->releaseFunctionNames() }
 {
 	assert(compilationData);
 	numImportedFunctions = compilationData->importedFunctions().size();
 	numImportedTables = compilationData->importedTableTypes().size();
 	numImportedMemories = compilationData->importedMemoryTypes().size();
 	numImportedGlobals = compilationData->importedGlobalTypes().size();
-
-	functionNameMap = compilationData->releaseFunctionNames();
 }
 
 
@@ -460,7 +856,7 @@ void Module::createElementsAndInitTables(ModuleLinker& linker, Nullable<Introspe
 		}
 
 		ModuleElementIndex elemIdx{ i };
-		linkedElements.emplace_back(unlinkedElement.decodeAndLink(elemIdx, *this));
+		linkedElements.emplace_back(unlinkedElement.decodeAndLink(elemIdx, *this, *mArena));
 		auto initCount = linkedElements.back().initTableIfActive(moduleTables);
 
 		if (initCount > 0) {
@@ -624,22 +1020,26 @@ Nullable<LinkedElement> WASM::Module::linkedElementByIndex(ModuleElementIndex id
 Nullable<LinkedDataItem> WASM::Module::linkedDataItemByIndex(ModuleDataIndex idx)
 {
 	auto dataItems = mDataItems.span(mInterpreter->allDataItems);
-	if (idx > dataItems.size()) {
+	if (idx >= dataItems.size()) {
 		return {};
 	}
 
 	return dataItems[idx.value];
 }
 
+std::span<BytecodeFunction> Module::functions()
+{
+	return mFunctions.span(mInterpreter->allFunctions);
+}
+
 Nullable<const Function> Module::findFunctionByBytecodePointer(const u8* pointer) const
 {
-	for (auto& func : mFunctions.constSpan(mInterpreter->allFunctions)) {
-		if (func.bytecode().hasInRange(pointer)) {
-			return func;
-		}
+	auto lookup = mInterpreter->bytecodeArena.findFunction(pointer);
+	if (!lookup.has_value() || &lookup->module != this) {
+		return {};
 	}
 
-	return {};
+	return lookup->function;
 }
 
 std::optional<ExportItem> Module::exportByName(const std::string& name, ExportType type) const
@@ -697,7 +1097,7 @@ std::optional<ResolvedGlobal> Module::exportedGlobalByName(const std::string& na
 	return globalByIndex(exp->asGlobalIndex());
 }
 
-Nullable<const std::string> Module::functionNameByIndex(ModuleFunctionIndex functionIdx) const
+Nullable<const std::pmr::string> Module::functionNameByIndex(ModuleFunctionIndex functionIdx) const
 {
 	auto fnd = functionNameMap.find(functionIdx.value);
 	if (fnd == functionNameMap.end()) {
@@ -733,6 +1133,16 @@ HostModuleBuilder& WASM::HostModuleBuilder::defineMemory(std::string name, u32 m
 	return *this;
 }
 
+HostModuleBuilder& WASM::HostModuleBuilder::defineSharedMemory(std::string name, std::shared_ptr<SharedMemory> sharedMemory)
+{
+	if (mMemory.has_value()) {
+		throw std::runtime_error{ "The host module already has a memory" };
+	}
+
+	mMemory.emplace(std::move(name), HostMemory{ std::move(sharedMemory) });
+	return *this;
+}
+
 HostModule HostModuleBuilder::toModule(Interpreter& interpreter) {
 	u32 idx = 0;
 	for (auto& function : mFunctions) {
@@ -830,7 +1240,7 @@ void WASM::HostModule::instantiate(ModuleLinker& linker, Nullable<Introspector>
 void WASM::HostModule::createMemory(ModuleLinker& linker, Nullable<Introspector> introspector)
 {
 	if (mHostMemory.has_value()) {
-		createMemoryBase(mHostMemory->memory, linker, introspector);
+		createMemoryBase(mHostMemory->memory, linker, introspector, mHostMemory->memory.sharedMemory());
 	}
 }
 
@@ -917,8 +1327,6 @@ void WASM::ModuleLinker::storeLinkedItems()
 	interpreter.allMemories = std::move(allMemories);
 	interpreter.allGlobals32 = std::move(allGlobals32);
 	interpreter.allGlobals64 = std::move(allGlobals64);
-	interpreter.allElements = std::move(allElements);
-	interpreter.allDataItems = std::move(allDataItems);
 }
 
 std::vector<BytecodeFunction>& WASM::ModuleLinker::createFunctions(u32 numFunctions)
@@ -982,6 +1390,8 @@ void ModuleLinker::checkModulesLinkStatus() {
 
 void ModuleLinker::instantiateModules()
 {
+	reserveLinkedItems();
+
 	for (auto& module : interpreter.wasmModules) {
 		module.instantiate(*this, introspector);
 	}
@@ -991,6 +1401,28 @@ void ModuleLinker::instantiateModules()
 	}
 }
 
+void ModuleLinker::reserveLinkedItems()
+{
+	// Allocate the storage for all linked items of the wasm modules at once, instead
+	// of growing each vector again for every instantiated module
+	sizeType numFunctions = 0;
+	sizeType numTables = 0;
+	sizeType numElements = 0;
+	sizeType numDataItems = 0;
+	for (auto& module : interpreter.wasmModules) {
+		auto& compilationData = *module.compilationData;
+		numFunctions += compilationData.functions().size();
+		numTables += compilationData.tableTypes().size();
+		numElements += compilationData.elements().size();
+		numDataItems += compilationData.dataItems().size();
+	}
+
+	allFunctions.reserve(numFunctions);
+	allTables.reserve(numTables);
+	allElements.reserve(numElements);
+	allDataItems.reserve(numDataItems);
+}
+
 void ModuleLinker::throwLinkError(const Module& module, const Imported& item, const char* message) const
 {
 	throw LinkError{ std::string{module.name()}, item.scopedName(), std::string{message} };
@@ -1063,6 +1495,11 @@ void ModuleLinker::initializeWasmModules()
 	for (auto& module : interpreter.wasmModules) {
 		module.initializeInstance(*this, introspector);
 	}
+
+	// Elements and data items only exist after initialization, so they are
+	// handed to the interpreter after the other linked items
+	interpreter.allElements = std::move(allElements);
+	interpreter.allDataItems = std::move(allDataItems);
 }
 
 void ModuleLinker::linkMemoryInstances()
@@ -1095,8 +1532,9 @@ void ModuleLinker::linkStartFunctions()
 
 void ModuleLinker::buildDeduplicatedFunctionTypeTable()
 {
-	auto& modules = interpreter.wasmModules;
-	allFunctionTypes.reserve(modules.front().compilationData->functionTypes().size());
+	// The types of all wasm modules were already deduplicated while parsing, so that
+	// their interpreter type indices stay the same. Only host types are added
+	allFunctionTypes = std::move(interpreter.loadedFunctionTypes);
 
 	const auto insertDedupedFunctionType = [&](const FunctionType& type) {
 		auto findIt = std::find(allFunctionTypes.begin(), allFunctionTypes.end(), type);
@@ -1109,16 +1547,8 @@ void ModuleLinker::buildDeduplicatedFunctionTypeTable()
 
 	FunctionType placeholderVoidType;
 
-	std::vector<InterpreterTypeIndex> typeMap;
-	for (auto& module : modules) {
-		auto& types = module.compilationData->functionTypes();
-		typeMap.reserve(types.size());
-
-		// Map each module type index to a interpreter type index by inserting/finding
-		// it in the global array
-		for (auto& type : types) {
-			typeMap.emplace_back(insertDedupedFunctionType(type));
-		}
+	for (auto& module : interpreter.wasmModules) {
+		auto& typeMap = module.compilationData->interpreterTypeIndices();
 
 		// Use the map to set the type indices for each function and import based
 		// on their module type index
@@ -1353,7 +1783,75 @@ void ModuleCompiler::ControlFrame::processAddressPatchRequests(ModuleCompiler& c
 
 void ModuleCompiler::compile()
 {
-	for (auto& function : module.mFunctions.span(interpreter.allFunctions)) {
+	// Tables that are never modified allow to resolve monomorphic indirect calls. Hot functions
+	// are those that executed at least a hundredth of all bytecodes counted by the optimizer
+	// profile. Without a profile, functions with loops and the functions they call are
+	// estimated to be hot.
+	auto functions = module.mFunctions.span(interpreter.allFunctions);
+	auto& profile = interpreter.optimizerProfile;
+	auto profiledCount = profile.has_value() ? profile->totalCount() : 0;
+	std::vector<bool> isHotFunction(functions.size(), false);
+	for (auto& function : functions) {
+		bool hasLoops = false;
+		for (auto& ins : function.expression()) {
+			switch (ins.opCode()) {
+			case InstructionType::TableSet:
+			case InstructionType::TableInit:
+			case InstructionType::TableCopy:
+			case InstructionType::TableGrow:
+			case InstructionType::TableFill:
+				mayModifyTables = true;
+				break;
+			case InstructionType::Loop:
+				hasLoops = true;
+				break;
+			default:
+				break;
+			}
+		}
+
+		if (profile.has_value()) {
+			auto count = profile->functionCount(module.name(), function.moduleIndex());
+			isHotFunction[&function - functions.data()] = count > 0 && count * 100 >= profiledCount;
+			continue;
+		}
+
+		if (!hasLoops) {
+			continue;
+		}
+
+		isHotFunction[&function - functions.data()] = true;
+		for (auto& ins : function.expression()) {
+			if (ins == InstructionType::Call && ins.functionIndex() >= module.numImportedFunctions) {
+				auto calleeIdx = ins.functionIndex().value - module.numImportedFunctions;
+				if (calleeIdx < functions.size()) {
+					isHotFunction[calleeIdx] = true;
+				}
+			}
+		}
+	}
+
+	// Aligned stacks change the offsets of the parameters and locals
+	if (interpreter.useAlignedBytecode) {
+		for (auto& function : functions) {
+			function.enableAlignedStack();
+		}
+	}
+
+	// Optimize all hot functions first, so that they are also inlined in their optimized form.
+	// The optimizer may remove unreachable code, so each function is validated beforehand
+	if (interpreter.useOptimizer) {
+		for (u32 i = 0; i != functions.size(); i++) {
+			if (isHotFunction[i]) {
+				validateFunction(functions[i]);
+
+				FunctionOptimizer optimizer{ functions[i] };
+				optimizer.optimize();
+			}
+		}
+	}
+
+	for (auto& function : functions) {
 		compileFunction(function);
 	}
 
@@ -1366,6 +1864,18 @@ void ModuleCompiler::setFunctionContext(const BytecodeFunction& function)
 	currentFunction = &function;
 }
 
+/*
+* Validate function
+* Runs the compiler over the function without storing the printed bytecode or
+* changing the function in any way, so that it can be rewritten afterwards.
+*/
+void ModuleCompiler::validateFunction(BytecodeFunction& function)
+{
+	isOnlyValidating = true;
+	compileFunction(function);
+	isOnlyValidating = false;
+}
+
 void ModuleCompiler::compileFunction(BytecodeFunction& function)
 {
 	resetBytecodePrinter();
@@ -1373,11 +1883,22 @@ void ModuleCompiler::compileFunction(BytecodeFunction& function)
 	setFunctionContext(function);
 
 	auto typeIdx = function.moduleTypeIndex();
-	controlStack.emplace_back(InstructionType::NoOperation, BlockTypeIndex{ BlockType::TypeIndex, typeIdx }, 0, 0, false, 0);
+	controlStack.emplace_back(InstructionType::NoOperation, BlockTypeIndex{ BlockType::TypeIndex, typeIdx }, 0, 0, 0, false, 0);
+
+	// Inlined functions add their parameters and locals to the locals of the caller
+	planInlinedCalls(function);
 
 	// Print entry bytecode if the function has any locals or requires the module instance
+	// Leaf functions only need their locals, as the memory pointer stays untouched
 	auto localsSizeInBytes = function.localsSizeInBytes();
-	if (localsSizeInBytes > 0 || function.requiresMemoryInstance()) {
+	if (function.isLeaf()) {
+		if (localsSizeInBytes > 0) {
+			assert(localsSizeInBytes % 4 == 0);
+			print(Bytecode::EntryLeaf);
+			printU32(localsSizeInBytes / 4);
+		}
+	}
+	else if (localsSizeInBytes > 0 || function.requiresMemoryInstance() || inlinesMemoryAccesses) {
 		auto memory = module.memoryByIndex(ModuleMemoryIndex{ 0 });
 		assert(memory.has_value());
 		auto memoryIdx = interpreter.indexOfMemoryInstance(*memory);
@@ -1389,9 +1910,18 @@ void ModuleCompiler::compileFunction(BytecodeFunction& function)
 
 	u32 insCounter = 0;
 	for (auto& ins : function.expression()) {
+		// Loops are likely to run often, which is taken into account when ordering the bytecode
+		if (ins.opCode() == InstructionType::Loop && !isOnlyValidating) {
+			function.increaseEstimatedHotness();
+		}
+
 		compileInstruction(ins, insCounter++);
 	}
 
+	if (isOnlyValidating) {
+		return;
+	}
+
 	assert(maxStackHeightInBytes % 4 == 0);
 	maxStackHeightInBytes += localsSizeInBytes;
 	function.setMaxStackHeight(maxStackHeightInBytes / 4);
@@ -1402,16 +1932,269 @@ void ModuleCompiler::compileFunction(BytecodeFunction& function)
 	}
 }
 
-void ModuleCompiler::pushValue(ValType type)
+/*
+* Plan inlined calls
+* Selects the call sites of the function that get the code of the callee inlined.
+* Small functions are always inlined, larger ones only when called from inside a
+* loop. Each inlined function gets its parameters and locals added once to the
+* locals of the caller, which are shared by all of its call sites. Indirect calls
+* are inlined if the table can only hold a single function of the called type.
+*/
+void ModuleCompiler::planInlinedCalls(BytecodeFunction& function)
 {
-	valueStack.emplace_back(type);
-	stackHeightInBytes += type.sizeInBytes();
-	maxStackHeightInBytes = std::max(maxStackHeightInBytes, stackHeightInBytes);
-}
+	inlinedCallSites.clear();
+	inliningScratchLocalIndex.reset();
+	inlinesMemoryAccesses = false;
 
-void ModuleCompiler::pushMaybeValue(ValueRecord record)
-{
-	if (record.has_value()) {
+	// Inlining appends locals to the function, which is not done when only validating
+	if (!interpreter.useFunctionInlining || isOnlyValidating) {
+		return;
+	}
+
+	std::vector<std::pair<const BytecodeFunction*, u32>> calleeLocals;
+	auto localsBaseIndexOf = [&](const BytecodeFunction& callee) {
+		for (auto& entry : calleeLocals) {
+			if (entry.first == &callee) {
+				return entry.second;
+			}
+		}
+
+		auto numLocals = callee.functionType().parameters().size() + callee.localsCount();
+		auto baseIndex = function.localsCount() + function.functionType().parameters().size();
+		for (u32 i = 0; i != numLocals; i++) {
+			function.appendLocal(callee.localOrParameterByIndex(i)->type);
+		}
+
+		calleeLocals.emplace_back(&callee, baseIndex);
+		return (u32)baseIndex;
+	};
+
+	auto moduleFunctions = module.functions();
+	auto isModuleFunction = [&](const Function& callee) {
+		return &callee >= moduleFunctions.data() && &callee < moduleFunctions.data() + moduleFunctions.size();
+	};
+
+	std::vector<bool> loopStack;
+	u32 loopDepth = 0;
+	u32 budget = InlinedInstructionsBudget;
+	u32 insCounter = 0;
+	for (auto& ins : function.expression()) {
+		auto insIdx = insCounter++;
+		switch (ins.opCode()) {
+		case InstructionType::Block:
+		case InstructionType::If:
+			loopStack.push_back(false);
+			continue;
+		case InstructionType::Loop:
+			loopStack.push_back(true);
+			loopDepth++;
+			continue;
+		case InstructionType::End:
+			if (!loopStack.empty()) {
+				loopDepth -= loopStack.back();
+				loopStack.pop_back();
+			}
+			continue;
+		case InstructionType::Call:
+		case InstructionType::CallIndirect:
+			break;
+		default:
+			continue;
+		}
+
+		Nullable<Function> calledFunction;
+		std::optional<u32> tableElementIndex;
+		if (ins == InstructionType::Call) {
+			calledFunction = module.functionByIndex(ins.functionIndex());
+		}
+		else {
+			auto elementIndex = findMonomorphicTableElement(ins);
+			if (elementIndex.has_value()) {
+				auto table = module.tableByIndex(ins.callTableIndex());
+				assert(table.has_value());
+				calledFunction = table->at(*elementIndex);
+				tableElementIndex = *elementIndex;
+			}
+		}
+
+		if (!calledFunction.has_value() || !isModuleFunction(*calledFunction)) {
+			continue;
+		}
+
+		auto callee = calledFunction->asBytecodeFunction();
+		if (!callee.has_value() || !isInlineable(*callee, loopDepth > 0)) {
+			continue;
+		}
+
+		u32 calleeSize = callee->expression().size();
+		if (calleeSize > budget) {
+			continue;
+		}
+		budget -= calleeSize;
+
+		// Indirect calls keep the table index in a local to check it
+		if (tableElementIndex.has_value() && !inliningScratchLocalIndex.has_value()) {
+			inliningScratchLocalIndex = function.appendLocal(ValType::I32);
+		}
+
+		inlinesMemoryAccesses |= callee->requiresMemoryInstance();
+		inlinedCallSites.push_back({
+			insIdx,
+			*callee,
+			localsBaseIndexOf(*callee),
+			measureMaxPrintedInlinedCallLength(*callee, tableElementIndex.has_value()),
+			tableElementIndex
+		});
+	}
+}
+
+bool ModuleCompiler::isInlineable(const BytecodeFunction& callee, bool isHot) const
+{
+	// Functions without any calls can neither recurse nor contain inlined calls themselves
+	if (callee.hasCalls()) {
+		return false;
+	}
+
+	auto sizeLimit = isHot ? HotInlinedFunctionSizeLimit : InlinedFunctionSizeLimit;
+	if (callee.expression().size() > sizeLimit) {
+		return false;
+	}
+
+	// The locals of the callee are zeroed by integer constants
+	auto numParameters = callee.functionType().parameters().size();
+	for (u32 i = 0; i != callee.localsCount(); i++) {
+		auto local = callee.localOrParameterByIndex(numParameters + i);
+		assert(local.has_value());
+		if (local->type.sizeInBytes() != 4 && local->type.sizeInBytes() != 8) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::optional<sizeType> ModuleCompiler::findMonomorphicTableElement(Instruction instruction)
+{
+	// Imported and exported tables might be modified by other modules or the host
+	auto tableIdx = instruction.callTableIndex();
+	if (mayModifyTables || tableIdx < module.numImportedTables) {
+		return {};
+	}
+
+	for (auto& exportItem : module.exports) {
+		if (exportItem.second.mExportType == ExportType::TableIndex && exportItem.second.asTableIndex() == tableIdx) {
+			return {};
+		}
+	}
+
+	auto typeIdx = instruction.functionIndex();
+	auto table = module.tableByIndex(tableIdx);
+	if (!table.has_value() || table->type() != ValType::FuncRef || typeIdx >= module.compilationData->functionTypes().size()) {
+		return {};
+	}
+
+	// Look for a single function with a matching type
+	auto& funcType = module.compilationData->functionTypes()[typeIdx.value];
+	auto interpreterTypeIdx = interpreter.indexOfFunctionType(funcType);
+	std::optional<sizeType> elementIndex;
+	for (u32 i = 0; i != table->size(); i++) {
+		auto function = table->at(i);
+		if (function.has_value() && function->interpreterTypeIndex() == interpreterTypeIdx) {
+			if (elementIndex.has_value()) {
+				return {};
+			}
+			elementIndex = i;
+		}
+	}
+
+	return elementIndex;
+}
+
+Nullable<const ModuleCompiler::InlinedCallSite> ModuleCompiler::inlinedCallSiteByInstruction(u32 instructionIndex) const
+{
+	// Instructions of an inlined function are never inlined call sites themselves
+	if (currentInlining.has_value()) {
+		return {};
+	}
+
+	auto it = std::lower_bound(inlinedCallSites.begin(), inlinedCallSites.end(), instructionIndex, [](auto& site, u32 idx) {
+		return site.instructionIndex < idx;
+	});
+
+	if (it == inlinedCallSites.end() || it->instructionIndex != instructionIndex) {
+		return {};
+	}
+
+	return *it;
+}
+
+/*
+* Compile inlined call
+* The callee is compiled as a block that takes its parameters and leaves its
+* results on the operand stack. The parameters are moved into the locals of the
+* callee at the start of the block, where returns turn into branches to its end.
+*/
+void ModuleCompiler::compileInlinedCall(const InlinedCallSite& site)
+{
+	auto& callee = *site.callee;
+
+	printFuelChargeIfReachable();
+
+	BlockTypeIndex blockType{ BlockType::TypeIndex, callee.moduleTypeIndex() };
+	popValues(blockType.parameters());
+	pushControlFrame(InstructionType::Block, blockType);
+
+	currentInlining = InliningContext{ callee, site.localsBaseIndex, (u32)controlStack.size() - 1 };
+
+	// The last parameter is on the top of the stack
+	u32 numParameters = callee.functionType().parameters().size();
+	for (u32 i = numParameters; i-- > 0;) {
+		compileInstruction(Instruction{ InstructionType::LocalSet, i }, 0);
+	}
+
+	for (u32 i = numParameters; i != numParameters + callee.localsCount(); i++) {
+		auto local = localByIndex(i);
+		pushValue(local.type);
+		print(local.type.sizeInBytes() == 4 ? Bytecode::I32ConstShort : Bytecode::I64ConstShort);
+		printU8(0);
+		compileInstruction(Instruction{ InstructionType::LocalSet, i }, 0);
+	}
+
+	// The end instruction of the callee closes the block
+	u32 insCounter = 0;
+	for (auto& ins : callee.expression()) {
+		compileInstruction(ins, insCounter++);
+	}
+
+	assert(controlStack.size() == currentInlining->controlFrameIndex);
+	currentInlining.reset();
+}
+
+const Expression& ModuleCompiler::currentExpression() const
+{
+	if (currentInlining.has_value()) {
+		return currentInlining->callee->expression();
+	}
+
+	assert(currentFunction);
+	return currentFunction->expression();
+}
+
+u32 ModuleCompiler::stackSizeOf(ValType type) const
+{
+	return type.stackSizeInBytes(interpreter.useAlignedBytecode);
+}
+
+void ModuleCompiler::pushValue(ValType type)
+{
+	valueStack.emplace_back(type);
+	stackHeightInBytes += stackSizeOf(type);
+	maxStackHeightInBytes = std::max(maxStackHeightInBytes, stackHeightInBytes);
+}
+
+void ModuleCompiler::pushMaybeValue(ValueRecord record)
+{
+	if (record.has_value()) {
 		pushValue(*record);
 	}
 	else {
@@ -1426,7 +2209,7 @@ void ModuleCompiler::pushValues(std::span<const ValType> types)
 	valueStack.insert(valueStack.end(), types.begin(), types.end());
 
 	for (auto type : types) {
-		stackHeightInBytes += type.sizeInBytes();
+		stackHeightInBytes += stackSizeOf(type);
 		maxStackHeightInBytes = std::max(maxStackHeightInBytes, stackHeightInBytes);
 	}
 }
@@ -1438,7 +2221,7 @@ void ModuleCompiler::pushValues(std::span<const ValueRecord> types)
 
 	for (auto type : types) {
 		if (type.has_value()) {
-			stackHeightInBytes += type->sizeInBytes();
+			stackHeightInBytes += stackSizeOf(*type);
 			maxStackHeightInBytes = std::max(maxStackHeightInBytes, stackHeightInBytes);
 		}
 	}
@@ -1469,9 +2252,7 @@ void ModuleCompiler::pushValues(const BlockTypeResults& results)
 	}
 
 	if (results == BlockType::ValType) {
-		auto valType = ValType::fromInt(results.index.value);
-		assert(valType.isValid());
-		pushValue(valType);
+		pushValue(resolveValType(ValType::fromEncoded(results.index.value)));
 	}
 }
 
@@ -1496,6 +2277,14 @@ BytecodeFunction::LocalOffset ModuleCompiler::localByIndex(u32 idx) const
 {
 	assert(currentFunction);
 
+	// Inlined functions use their area in the locals of the caller
+	if (currentInlining.has_value()) {
+		if (idx >= currentInlining->callee->localsCount() + currentInlining->callee->functionType().parameters().size()) {
+			throwCompilationError("Local index out of bounds");
+		}
+		idx += currentInlining->localsBaseIndex;
+	}
+
 	auto local = currentFunction->localOrParameterByIndex(idx);
 	if (local.has_value()) {
 		return *local;
@@ -1566,7 +2355,7 @@ u32 ModuleCompiler::measureMaxPrintedBlockLength(u32 startInstruction, u32 label
 	i32 expectedNestingDepth = -labelIdx;
 	i32 relativeNestingDepth = 0;
 	u32 distance = 0;
-	auto& code = currentFunction->expression();
+	auto& code = currentExpression();
 	for (u32 i = startInstruction + 1; i < code.size(); i++) {
 		if (code[i] == InstructionType::Block || code[i] == InstructionType::Loop || code[i] == InstructionType::If) {
 			relativeNestingDepth++;
@@ -1582,18 +2371,90 @@ u32 ModuleCompiler::measureMaxPrintedBlockLength(u32 startInstruction, u32 label
 				return distance;
 			}
 		}
-		distance += code[i].maxPrintedByteLength(currentFunction->expression().bytes());
+		u32 length = measureMaxPrintedInstructionLength(code[i], code.bytes());
+
+		// Inlined calls print the whole callee instead
+		auto inlinedCallSite = inlinedCallSiteByInstruction(i);
+		if (inlinedCallSite.has_value()) {
+			length = std::max(length, inlinedCallSite->maxPrintedByteLength);
+		}
+
+		distance += length;
 	}
 
 	throwCompilationError("Invalid block nesting while measuring block length");
 }
 
+u32 ModuleCompiler::measureMaxPrintedInstructionLength(Instruction instruction, const BufferSlice& bytes) const
+{
+	u32 length = instruction.maxPrintedByteLength(bytes);
+
+	// Make room for a fuel charge before each instruction that might end a block
+	if (interpreter.useFuelMetering) {
+		switch (instruction.opCode()) {
+		case InstructionType::Loop:
+		case InstructionType::Branch:
+		case InstructionType::BranchIf:
+		case InstructionType::BranchTable:
+		case InstructionType::Return:
+		case InstructionType::Call:
+		case InstructionType::CallIndirect:
+		case InstructionType::ReturnCall:
+		case InstructionType::ReturnCallIndirect:
+		case InstructionType::CallReference:
+		case InstructionType::ReturnCallReference:
+		case InstructionType::BranchOnNull:
+		case InstructionType::BranchOnNonNull:
+			length += 5;
+			break;
+		}
+	}
+
+	// Make room for the prefix and the far form of memory instructions on 64bit memories
+	if (instruction.opCode().requiresMemoryInstance()) {
+		auto memory = module.memoryByIndex(ModuleMemoryIndex{ 0 });
+		if (memory.has_value() && memory->is64()) {
+			length += 4;
+		}
+	}
+
+	// Operand padding never exceeds the size of the operands
+	if (interpreter.useAlignedBytecode) {
+		length *= 2;
+	}
+
+	return length;
+}
+
+u32 ModuleCompiler::measureMaxPrintedInlinedCallLength(const BytecodeFunction& callee, bool checksTableIndex) const
+{
+	// Fuel charge, moving each parameter and zeroing each local, and checking the
+	// table index of indirect calls followed by the regular indirect call
+	u32 numLocals = callee.functionType().parameters().size() + callee.localsCount();
+	u32 length = 5 + numLocals * 10 + (checksTableIndex ? 34 : 0);
+	if (interpreter.useAlignedBytecode) {
+		length *= 2;
+	}
+
+	auto& code = callee.expression();
+	for (auto& ins : code) {
+		length += measureMaxPrintedInstructionLength(ins, code.bytes());
+	}
+
+	return length;
+}
+
 void ModuleCompiler::requestAddressPatch(u32 labelIdx, bool isNearJump, bool elseLabel, std::optional<u32> jumpReferencePosition)
 {
 	if (labelIdx >= controlStack.size()) {
 		throwCompilationError("Control stack underflow when requesting address patch");
 	}
 
+	// Far jumps are relative to their padded operand
+	if (!isNearJump) {
+		printOperandPadding(4);
+	}
+
 	auto printerPos = printedBytecode.size();
 	AddressPatchRequest req{ printerPos, jumpReferencePosition.value_or(printerPos), isNearJump };
 	auto& frame = controlStack[controlStack.size() - labelIdx - 1];
@@ -1656,7 +2517,7 @@ ModuleCompiler::ValueRecord ModuleCompiler::popValue()
 	valueStack.pop_back();
 
 	if (valueTop.has_value()) {
-		stackHeightInBytes -= valueTop->sizeInBytes();
+		stackHeightInBytes -= stackSizeOf(*valueTop);
 	}
 
 	return valueTop;
@@ -1669,7 +2530,7 @@ ModuleCompiler::ValueRecord ModuleCompiler::popValue(ValueRecord expected)
 		return actual;
 	}
 
-	if (*expected == *actual) {
+	if (actual->isSubtypeOf(*expected)) {
 		return actual;
 	}
 
@@ -1720,8 +2581,7 @@ const std::vector<ModuleCompiler::ValueRecord>& ModuleCompiler::popValuesToList(
 
 	if (expected == BlockType::ValType) {
 		resetCachedReturnList(1);
-		auto valType = ValType::fromInt(expected.index.value);
-		assert(valType.isValid());
+		auto valType = resolveValType(ValType::fromEncoded(expected.index.value));
 		cachedReturnList[0] = popValue(valType);
 		return cachedReturnList;
 	}
@@ -1737,9 +2597,7 @@ void ModuleCompiler::popValues(const BlockTypeResults& expected) {
 	}
 
 	if (expected == BlockType::ValType) {
-		auto valType = ValType::fromInt(expected.index.value);
-		assert(valType.isValid());
-		popValue(valType);
+		popValue(resolveValType(ValType::fromEncoded(expected.index.value)));
 	}
 }
 
@@ -1781,7 +2639,7 @@ void ModuleCompiler::popValues(const ModuleCompiler::LabelTypes& types)
 
 ModuleCompiler::ControlFrame& ModuleCompiler::pushControlFrame(InstructionType opCode, BlockTypeIndex blockTypeIndex)
 {
-	auto& newFrame = controlStack.emplace_back(opCode, blockTypeIndex, valueStack.size(), stackHeightInBytes, false, printedBytecode.size());
+	auto& newFrame = controlStack.emplace_back(opCode, blockTypeIndex, valueStack.size(), stackHeightInBytes, initializedLocals.size(), false, printedBytecode.size());
 	pushValues(blockTypeIndex.parameters());
 
 	return newFrame;
@@ -1799,6 +2657,7 @@ ModuleCompiler::ControlFrame ModuleCompiler::popControlFrame()
 		throwCompilationError("Value stack height missmatch");
 	}
 
+	initializedLocals.resize(frame.initializedLocalsHeight);
 	controlStack.pop_back();
 	return frame;
 }
@@ -1825,20 +2684,137 @@ bool ModuleCompiler::isReachable() const
 	return !frame.unreachable;
 }
 
+void ModuleCompiler::setLocalInitialized(u32 idx)
+{
+	if (!isLocalInitialized(idx)) {
+		initializedLocals.push_back(idx);
+	}
+}
+
+bool ModuleCompiler::isLocalInitialized(u32 idx) const
+{
+	// Inlined callees are validated when they are compiled on their own
+	if (currentInlining.has_value()) {
+		return true;
+	}
+
+	// Only non-nullable locals have to be set before they can be read
+	if (idx < currentFunction->functionType().parameters().size() || localByIndex(idx).type.isDefaultable()) {
+		return true;
+	}
+
+	return std::find(initializedLocals.begin(), initializedLocals.end(), idx) != initializedLocals.end();
+}
+
+ValType ModuleCompiler::resolveValType(ValType type) const
+{
+	assert(module.compilationData);
+	auto resolvedType = module.compilationData->resolveTypeIndex(type);
+	if (!resolvedType.isValid()) {
+		throwCompilationError("Instruction references invalid type index");
+	}
+	return resolvedType;
+}
+
 void ModuleCompiler::resetBytecodePrinter()
 {
 	printedBytecode.clear();
 	valueStack.clear();
 	controlStack.clear();
 	addressPatches.clear();
+	initializedLocals.clear();
 	stackHeightInBytes = 0;
 	maxStackHeightInBytes = 0;
+	unchargedFuelCost = 0;
 }
 
 void ModuleCompiler::print(Bytecode c)
 {
 	//std::cout << "  Printed at " << printedBytecode.size() << " bytecode: " << c.name() << std::endl;
 	printedBytecode.appendU8(c);
+	unchargedFuelCost++;
+}
+
+void ModuleCompiler::printFuelCharge()
+{
+	// Each bytecode costs one unit of fuel, which is charged all at once at the end
+	// of its block. Only loop headers, backward jumps, calls and returns end a block,
+	// which makes the cost an estimate: Code skipped by forward jumps is charged as
+	// if it was run, and forward jumps over a charge may leave a block uncharged.
+	// Every loop iteration and every call is charged nonetheless. The jump or call
+	// that ends the block costs at least one unit, even if it is all the block does.
+	if (!interpreter.useFuelMetering) {
+		return;
+	}
+
+	auto cost = std::max<u32>(unchargedFuelCost, 1);
+	print(Bytecode::ConsumeFuel);
+	printU32(cost);
+	unchargedFuelCost = 0;
+}
+
+void ModuleCompiler::printFuelChargeIfReachable()
+{
+	if (isReachable()) {
+		printFuelCharge();
+	}
+}
+
+void ModuleCompiler::printReturnInstruction()
+{
+	printFuelCharge();
+
+	auto resultSpaceInBytes = currentFunction->functionType().resultStackSectionSizeInBytes(interpreter.useAlignedBytecode);
+	assert(resultSpaceInBytes % 4 == 0);
+	auto resultSpaceInSlots = resultSpaceInBytes / 4;
+
+	// Leaf frames do not store the stack pointer, which is restored by dropping the parameters
+	if (currentFunction->isLeaf()) {
+		auto parameterSpaceInBytes = currentFunction->functionType().parameterStackSectionSizeInBytes(interpreter.useAlignedBytecode);
+		assert(parameterSpaceInBytes % 4 == 0);
+		print(Bytecode::ReturnLeaf);
+		printU32(resultSpaceInSlots);
+		printU32(parameterSpaceInBytes / 4);
+		return;
+	}
+
+	if (resultSpaceInSlots <= 255) {
+		print(Bytecode::ReturnFew);
+		printU8(resultSpaceInSlots);
+	}
+	else {
+		print(Bytecode::ReturnMany);
+		printU32(resultSpaceInSlots);
+	}
+}
+
+void ModuleCompiler::printBranchExit(u32 labelIdx, u32 bytesToDrop, u32 bytesToKeep)
+{
+	// Branching to the function block is the same as returning, which already
+	// moves the results in place
+	if (labelIdx == controlStack.size() - 1) {
+		printReturnInstruction();
+		return;
+	}
+
+	// Drop the values between the label values and the bottom of the block
+	if (bytesToDrop > 0) {
+		assert(bytesToDrop % 4 == 0 && bytesToKeep % 4 == 0);
+		print(Bytecode::DropKeep);
+		printU32(bytesToDrop / 4);
+		printU32(bytesToKeep / 4);
+	}
+
+	auto& frame = controlStack[controlStack.size() - labelIdx - 1];
+	print(Bytecode::JumpLong);
+	if (frame.opCode == InstructionType::Loop) {
+		printOperandPadding(4);
+		i32 distance = frame.bytecodeOffset - printedBytecode.size();
+		printU32(distance);
+	}
+	else {
+		requestAddressPatch(labelIdx, false);
+	}
 }
 
 void ModuleCompiler::printU8(u8 x)
@@ -1849,34 +2825,55 @@ void ModuleCompiler::printU8(u8 x)
 
 void ModuleCompiler::printU32(u32 x)
 {
+	printOperandPadding(4);
 	//std::cout << "  Printed at " << printedBytecode.size() << " u32: " << x << std::endl;
 	printedBytecode.appendLittleEndianU32(x);
 }
 
 void ModuleCompiler::printU64(u64 x)
 {
+	printOperandPadding(8);
 	//std::cout << "  Printed at " << printedBytecode.size() << " u64: " << x << std::endl;
 	printedBytecode.appendLittleEndianU64(x);
 }
 
 void ModuleCompiler::printF32(f32 f)
 {
+	printOperandPadding(4);
 	//std::cout << "  Printed at " << printedBytecode.size() << " f32: " << f << " as " << reinterpret_cast<u32&>(f) << std::endl;
 	printedBytecode.appendLittleEndianU32(reinterpret_cast<u32&>(f));
 }
 
 void ModuleCompiler::printF64(f64 f)
 {
+	printOperandPadding(8);
 	//std::cout << "  Printed at " << printedBytecode.size() << " f64: " << f << " as " << reinterpret_cast<u64&>(f) << std::endl;
 	printedBytecode.appendLittleEndianU32(reinterpret_cast<u64&>(f));
 }
 
 void ModuleCompiler::printPointer(const void* p)
 {
+	printOperandPadding(8);
 	//std::cout << "  Printed pointer: " << reinterpret_cast<u64&>(p) << std::endl;
 	printedBytecode.appendLittleEndianU64(reinterpret_cast<u64&>(p));
 }
 
+// Aligned bytecode places each operand at its natural alignment. The padding
+// bytes in front of it are never executed.
+void ModuleCompiler::printOperandPadding(u32 alignment)
+{
+	if (interpreter.useAlignedBytecode) {
+		while (printedBytecode.size() % alignment) {
+			printedBytecode.appendU8(Bytecode::Unreachable);
+		}
+	}
+}
+
+sizeType ModuleCompiler::operandPosition(sizeType position, u32 alignment) const
+{
+	return interpreter.useAlignedBytecode ? alignUp(position, alignment) : position;
+}
+
 void ModuleCompiler::printBytecodeExpectingNoArgumentsIfReachable(Instruction instruction)
 {
 	if (isReachable() && !instruction.opCode().isBitCastConversionOnly()) {
@@ -1895,7 +2892,8 @@ void ModuleCompiler::printLocalGetSetTeeBytecodeIfReachable(
 	Bytecode near32,
 	Bytecode far32,
 	Bytecode near64,
-	Bytecode far64
+	Bytecode far64,
+	VectorOperation vectorOperation
 )
 {
 	if (!isReachable()) {
@@ -1925,7 +2923,7 @@ void ModuleCompiler::printLocalGetSetTeeBytecodeIfReachable(
 		}
 	}
 	else if (local.type.sizeInBytes() == 8) {
-		if (distance) {
+		if (distance <= 255) {
 			print(near64);
 			printU8(distance);
 		}
@@ -1934,8 +2932,13 @@ void ModuleCompiler::printLocalGetSetTeeBytecodeIfReachable(
 			printU32(distance);
 		}
 	}
+	else if (local.type.sizeInBytes() == 16) {
+		print(Bytecode::VectorInstruction);
+		printU8(vectorOperation);
+		printU32(distance);
+	}
 	else {
-		throwCompilationError("LocalGet instruction only implemented for 32bit and 64bit");
+		throwCompilationError("LocalGet instruction only implemented for 32bit, 64bit and 128bit");
 	}
 }
 
@@ -2016,18 +3019,45 @@ void ModuleCompiler::compileMemoryDataInstruction(Instruction instruction)
 	auto operandType = opCode.operandType();
 	auto resultType = opCode.resultType();
 
+	// Memories with 64bit indices are addressed with i64 values
+	auto is64 = memoryByIndex(ModuleMemoryIndex{ 0 }).is64();
+	auto addressType = is64 ? ValType::I64 : ValType::I32;
+
 	// Load type instruction
 	using IT = InstructionType;
 	auto isLoadInstruction = resultType.has_value();
 	if (isLoadInstruction) {
-		popValue(ValType::I32);
+		popValue(addressType);
 		pushValue(*resultType);
 	}
 	// Store type instruction
 	else {
 		assert(operandType.has_value());
 		popValue(*operandType);
-		popValue(ValType::I32);
+		popValue(addressType);
+	}
+
+	// Print the far bytecode behind the prefix for 64bit addresses
+	if (is64) {
+		auto bytecode = instruction.toBytecode();
+		if (!bytecode.has_value()) {
+			switch (opCode) {
+			case IT::I32Load:
+			case IT::F32Load: bytecode = Bytecode::I32LoadFar; break;
+			case IT::I64Load:
+			case IT::F64Load: bytecode = Bytecode::I64LoadFar; break;
+			case IT::I32Store:
+			case IT::F32Store: bytecode = Bytecode::I32StoreFar; break;
+			case IT::I64Store:
+			case IT::F64Store: bytecode = Bytecode::I64StoreFar; break;
+			}
+		}
+
+		assert(bytecode.has_value());
+		print(Bytecode::Memory64Instruction);
+		printU8(*bytecode);
+		printU32(instruction.memoryOffset());
+		return;
 	}
 
 	// Print simple bytecode
@@ -2072,39 +3102,56 @@ void ModuleCompiler::compileMemoryDataInstruction(Instruction instruction)
 
 void ModuleCompiler::compileMemoryControlInstruction(Instruction instruction)
 {
+	// Memories with 64bit indices take i64 addresses, sizes and page counts
+	auto is64 = false;
 	if (instruction != InstructionType::DataDrop) {
 		// Check that the memory at least exists
-		memoryByIndex(ModuleMemoryIndex{ 0 });
+		is64 = memoryByIndex(ModuleMemoryIndex{ 0 }).is64();
 	}
+	auto addressType = is64 ? ValType::I64 : ValType::I32;
 
 	switch (instruction.opCode()) {
 	case InstructionType::MemorySize: // No popping -> Push once
-		pushValue(ValType::I32);
+		pushValue(addressType);
 		break;
 	case InstructionType::MemoryGrow: // Pop once -> Push once
-		popValue(ValType::I32);
-		pushValue(ValType::I32);
+		popValue(addressType);
+		pushValue(addressType);
 		break;
 	case InstructionType::MemoryFill: // pop thrice
+		popValue(addressType);
+		popValue(ValType::I32);
+		popValue(addressType);
+		break;
 	case InstructionType::MemoryCopy:
+		popValue(addressType);
+		popValue(addressType);
+		popValue(addressType);
+		break;
 	case InstructionType::MemoryInit:
 		popValue(ValType::I32);
 		popValue(ValType::I32);
-		popValue(ValType::I32);
+		popValue(addressType);
 		break;
 	}
 
 	InterpreterLinkedDataIndex dataItemIdx{ 0 };
 	if (instruction == InstructionType::MemoryInit || instruction == InstructionType::DataDrop) {
 		// Always check if the data item exists, even if code is not reachable
-		auto dataItem = linkedDataItemByIndex(instruction.dataSegmentIndex());
+		auto& dataItem = linkedDataItemByIndex(instruction.dataSegmentIndex());
 		dataItemIdx = interpreter.indexOfLinkedDataItem(dataItem);
 	}
 
 	if (isReachable()) {
 		auto bytecode = instruction.toBytecode();
 		assert(bytecode.has_value());
-		print(*bytecode);
+		if (is64) {
+			print(Bytecode::Memory64Instruction);
+			printU8(*bytecode);
+		}
+		else {
+			print(*bytecode);
+		}
 
 		if (instruction == InstructionType::MemoryInit || instruction == InstructionType::DataDrop) {
 			printU32(dataItemIdx.value);
@@ -2114,7 +3161,11 @@ void ModuleCompiler::compileMemoryControlInstruction(Instruction instruction)
 
 void ModuleCompiler::compileBranchTableInstruction(Instruction instruction)
 {
-	const u32 jumpReferencePosition = printedBytecode.size() + 1; // Consider the size of the bytecode -> +1
+	// Any of the labels might be a loop
+	printFuelChargeIfReachable();
+
+	// Consider the size of the bytecode -> +1
+	const u32 jumpReferencePosition = operandPosition(printedBytecode.size() + 1, 4);
 	auto printJumpAddress = [&](u32 labelIdx, const ControlFrame& frame) {
 		if (isReachable()) {
 			// Backwards jump
@@ -2131,7 +3182,7 @@ void ModuleCompiler::compileBranchTableInstruction(Instruction instruction)
 
 	popValue(ValType::I32);
 	auto defaultLabel = instruction.branchTableDefaultLabel();
-	if (defaultLabel > controlStack.size()) {
+	if (defaultLabel >= controlStack.size()) {
 		throwCompilationError("Control stack underflow in branch table default label");
 	}
 
@@ -2143,17 +3194,47 @@ void ModuleCompiler::compileBranchTableInstruction(Instruction instruction)
 		throwCompilationError("Default label type references invalid function type");
 	}
 
-	auto it = instruction.branchTableVector(currentFunction->expression().bytes());
+	auto it = instruction.branchTableVector(currentExpression().bytes());
 	auto numLabels = it.nextU32();
 
 	if (isReachable()) {
 		print(Bytecode::JumpTable);
 		printU32(numLabels);
 	}
+
+	// Labels that return or need to drop values jump to a trampoline printed
+	// behind the table, which adjusts the stack before branching
+	struct Trampoline {
+		u32 labelIdx;
+		u32 bytesToDrop;
+		u32 bytesToKeep;
+		std::vector<sizeType> tableEntryPositions;
+	};
+	std::vector<Trampoline> trampolines;
+	auto printJumpAddressOrTrampoline = [&](u32 labelIdx, const ControlFrame& frame, u32 heightWithLabelValues) {
+		if (!isReachable()) {
+			return;
+		}
+
+		auto bytesToKeep = heightWithLabelValues - stackHeightInBytes;
+		auto bytesToDrop = stackHeightInBytes - frame.heightInBytes;
+		if (bytesToDrop == 0 && labelIdx != controlStack.size() - 1) {
+			printJumpAddress(labelIdx, frame);
+			return;
+		}
+
+		auto trampoline = std::find_if(trampolines.begin(), trampolines.end(), [&](auto& t) { return t.labelIdx == labelIdx; });
+		if (trampoline == trampolines.end()) {
+			trampoline = trampolines.insert(trampolines.end(), { labelIdx, bytesToDrop, bytesToKeep, {} });
+		}
+		printOperandPadding(4);
+		trampoline->tableEntryPositions.push_back(printedBytecode.size());
+		printU32(0xFF00FF00);
+	};
 	
 	for (u32 i = 0; i != numLabels; i++) {
 		auto label = it.nextU32();
-		if (label > controlStack.size()) {
+		if (label >= controlStack.size()) {
 			throwCompilationError("Control stack underflow in branch tabel label");
 		}
 
@@ -2168,13 +3249,24 @@ void ModuleCompiler::compileBranchTableInstruction(Instruction instruction)
 			throwCompilationError("Branch table arity mismatch");
 		}
 
-		pushValues(popValuesToList(labelTypes));
-
-		printJumpAddress(label, labelFrame);
+		auto heightWithLabelValues = stackHeightInBytes;
+		auto& labelValues = popValuesToList(labelTypes);
+		printJumpAddressOrTrampoline(label, labelFrame, heightWithLabelValues);
+		pushValues(labelValues);
 	}
+
+	auto heightWithLabelValues = stackHeightInBytes;
 	popValues(defaultLabelTypes);
+	printJumpAddressOrTrampoline(defaultLabel, defaultLabelFrame, heightWithLabelValues);
+
+	for (auto& trampoline : trampolines) {
+		i32 distance = printedBytecode.size() - jumpReferencePosition;
+		for (auto position : trampoline.tableEntryPositions) {
+			printedBytecode.writeLittleEndianU32(position, distance);
+		}
 
-	printJumpAddress(defaultLabel, defaultLabelFrame);
+		printBranchExit(trampoline.labelIdx, trampoline.bytesToDrop, trampoline.bytesToKeep);
+	}
 
 	setUnreachable();
 }
@@ -2198,7 +3290,7 @@ void ModuleCompiler::compileTableInstruction(Instruction instruction)
 			throwCompilationError("Table instruction references invalid source table index");
 		}
 
-		if (table->type() != sourceTable->type()) {
+		if (!sourceTable->type().isSubtypeOf(table->type())) {
 			throwCompilationError("Table copy instruction references tables with incompatible types");
 		}
 
@@ -2208,9 +3300,9 @@ void ModuleCompiler::compileTableInstruction(Instruction instruction)
 	InterpreterLinkedElementIndex interpreterElementIdx{ 0 };
 	if (instruction == IT::TableInit) {
 		auto moduleElementIdx = instruction.elementIndex();
-		auto linkedElement = linkedElementByIndex(moduleElementIdx);
+		auto& linkedElement = linkedElementByIndex(moduleElementIdx);
 
-		if (table->type() != linkedElement.referenceType()) {
+		if (!linkedElement.referenceType().isSubtypeOf(table->type())) {
 			throwCompilationError("Table init instruction references element with incompatible type");
 		}
 
@@ -2262,6 +3354,296 @@ void ModuleCompiler::compileTableInstruction(Instruction instruction)
 	}
 }
 
+void ModuleCompiler::compileAtomicMemoryInstruction(Instruction instruction)
+{
+	using IT = InstructionType;
+	auto opCode = instruction.opCode();
+	if (opCode != IT::AtomicFence) {
+		// Check that the memory at least exists
+		if (memoryByIndex(ModuleMemoryIndex{ 0 }).is64()) {
+			throwCompilationError("Atomic instructions on memories with 64bit indices are not supported");
+		}
+	}
+
+	switch (opCode) {
+	case IT::AtomicFence:
+		break;
+	case IT::MemoryAtomicNotify: // Pop address and count -> Push number of woken waiters
+		popValue(ValType::I32);
+		popValue(ValType::I32);
+		pushValue(ValType::I32);
+		break;
+	case IT::MemoryAtomicWait32: // Pop address, expected value and timeout -> Push wait result
+		popValue(ValType::I64);
+		popValue(ValType::I32);
+		popValue(ValType::I32);
+		pushValue(ValType::I32);
+		break;
+	case IT::MemoryAtomicWait64:
+		popValue(ValType::I64);
+		popValue(ValType::I64);
+		popValue(ValType::I32);
+		pushValue(ValType::I32);
+		break;
+	default: {
+		// Loads only have a result, stores only a value operand and read-modify-write
+		// instructions have both. Compare exchange takes the expected and the new value
+		auto operandType = opCode.operandType();
+		auto resultType = opCode.resultType();
+		if (operandType.has_value()) {
+			popValue(*operandType);
+			if (opCode.atomicOperation() == AtomicOperation::CompareExchange) {
+				popValue(*operandType);
+			}
+		}
+		popValue(ValType::I32);
+		if (resultType.has_value()) {
+			pushValue(*resultType);
+		}
+	}
+	}
+
+	if (!isReachable()) {
+		return;
+	}
+
+	auto bytecode = instruction.toBytecode();
+	assert(bytecode.has_value());
+	print(*bytecode);
+
+	if (opCode != IT::AtomicFence) {
+		printU32(instruction.memoryOffset());
+	}
+
+	if (bytecode->arguments() == BytecodeArguments::DualU32) {
+		printU32(*opCode.atomicOperation());
+	}
+}
+
+void ModuleCompiler::compileVectorInstruction(Instruction instruction)
+{
+	using IT = InstructionType;
+	auto opCode = instruction.opCode();
+	if (opCode.isVectorMemory()) {
+		// Check that the memory at least exists
+		if (memoryByIndex(ModuleMemoryIndex{ 0 }).is64()) {
+			throwCompilationError("Vector instructions on memories with 64bit indices are not supported");
+		}
+	}
+
+	switch (opCode) {
+	case IT::V128Load:
+	case IT::V128Load8x8S:
+	case IT::V128Load8x8U:
+	case IT::V128Load16x4S:
+	case IT::V128Load16x4U:
+	case IT::V128Load32x2S:
+	case IT::V128Load32x2U:
+	case IT::V128Load8Splat:
+	case IT::V128Load16Splat:
+	case IT::V128Load32Splat:
+	case IT::V128Load64Splat:
+	case IT::V128Load32Zero:
+	case IT::V128Load64Zero:
+		popValue(ValType::I32);
+		pushValue(ValType::V128);
+		break;
+	case IT::V128Store:
+	case IT::V128Store8Lane:
+	case IT::V128Store16Lane:
+	case IT::V128Store32Lane:
+	case IT::V128Store64Lane:
+		popValue(ValType::V128);
+		popValue(ValType::I32);
+		break;
+	case IT::V128Load8Lane:
+	case IT::V128Load16Lane:
+	case IT::V128Load32Lane:
+	case IT::V128Load64Lane:
+		popValue(ValType::V128);
+		popValue(ValType::I32);
+		pushValue(ValType::V128);
+		break;
+	case IT::V128Const:
+		pushValue(ValType::V128);
+		break;
+	case IT::I8x16Splat:
+	case IT::I16x8Splat:
+	case IT::I32x4Splat:
+		popValue(ValType::I32);
+		pushValue(ValType::V128);
+		break;
+	case IT::I64x2Splat:
+		popValue(ValType::I64);
+		pushValue(ValType::V128);
+		break;
+	case IT::F32x4Splat:
+		popValue(ValType::F32);
+		pushValue(ValType::V128);
+		break;
+	case IT::F64x2Splat:
+		popValue(ValType::F64);
+		pushValue(ValType::V128);
+		break;
+	case IT::I8x16ExtractLaneS:
+	case IT::I8x16ExtractLaneU:
+	case IT::I16x8ExtractLaneS:
+	case IT::I16x8ExtractLaneU:
+	case IT::I32x4ExtractLane:
+		popValue(ValType::V128);
+		pushValue(ValType::I32);
+		break;
+	case IT::I64x2ExtractLane:
+		popValue(ValType::V128);
+		pushValue(ValType::I64);
+		break;
+	case IT::F32x4ExtractLane:
+		popValue(ValType::V128);
+		pushValue(ValType::F32);
+		break;
+	case IT::F64x2ExtractLane:
+		popValue(ValType::V128);
+		pushValue(ValType::F64);
+		break;
+	case IT::I8x16ReplaceLane:
+	case IT::I16x8ReplaceLane:
+	case IT::I32x4ReplaceLane:
+		popValue(ValType::I32);
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	case IT::I64x2ReplaceLane:
+		popValue(ValType::I64);
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	case IT::F32x4ReplaceLane:
+		popValue(ValType::F32);
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	case IT::F64x2ReplaceLane:
+		popValue(ValType::F64);
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	case IT::I8x16ShiftLeft:
+	case IT::I8x16ShiftRightS:
+	case IT::I8x16ShiftRightU:
+	case IT::I16x8ShiftLeft:
+	case IT::I16x8ShiftRightS:
+	case IT::I16x8ShiftRightU:
+	case IT::I32x4ShiftLeft:
+	case IT::I32x4ShiftRightS:
+	case IT::I32x4ShiftRightU:
+	case IT::I64x2ShiftLeft:
+	case IT::I64x2ShiftRightS:
+	case IT::I64x2ShiftRightU:
+		popValue(ValType::I32);
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	case IT::V128AnyTrue:
+	case IT::I8x16AllTrue:
+	case IT::I8x16Bitmask:
+	case IT::I16x8AllTrue:
+	case IT::I16x8Bitmask:
+	case IT::I32x4AllTrue:
+	case IT::I32x4Bitmask:
+	case IT::I64x2AllTrue:
+	case IT::I64x2Bitmask:
+		popValue(ValType::V128);
+		pushValue(ValType::I32);
+		break;
+	case IT::V128Not:
+	case IT::F32x4DemoteF64x2Zero:
+	case IT::F64x2PromoteLowF32x4:
+	case IT::I8x16Absolute:
+	case IT::I8x16Negate:
+	case IT::I8x16CountOnes:
+	case IT::F32x4Ceil:
+	case IT::F32x4Floor:
+	case IT::F32x4Truncate:
+	case IT::F32x4Nearest:
+	case IT::F64x2Ceil:
+	case IT::F64x2Floor:
+	case IT::F64x2Truncate:
+	case IT::I16x8ExtendAddPairwiseI8x16S:
+	case IT::I16x8ExtendAddPairwiseI8x16U:
+	case IT::I32x4ExtendAddPairwiseI16x8S:
+	case IT::I32x4ExtendAddPairwiseI16x8U:
+	case IT::I16x8Absolute:
+	case IT::I16x8Negate:
+	case IT::I16x8ExtendLowI8x16S:
+	case IT::I16x8ExtendHighI8x16S:
+	case IT::I16x8ExtendLowI8x16U:
+	case IT::I16x8ExtendHighI8x16U:
+	case IT::F64x2Nearest:
+	case IT::I32x4Absolute:
+	case IT::I32x4Negate:
+	case IT::I32x4ExtendLowI16x8S:
+	case IT::I32x4ExtendHighI16x8S:
+	case IT::I32x4ExtendLowI16x8U:
+	case IT::I32x4ExtendHighI16x8U:
+	case IT::I64x2Absolute:
+	case IT::I64x2Negate:
+	case IT::I64x2ExtendLowI32x4S:
+	case IT::I64x2ExtendHighI32x4S:
+	case IT::I64x2ExtendLowI32x4U:
+	case IT::I64x2ExtendHighI32x4U:
+	case IT::F32x4Absolute:
+	case IT::F32x4Negate:
+	case IT::F32x4SquareRoot:
+	case IT::F64x2Absolute:
+	case IT::F64x2Negate:
+	case IT::F64x2SquareRoot:
+	case IT::I32x4TruncateSaturateF32x4S:
+	case IT::I32x4TruncateSaturateF32x4U:
+	case IT::F32x4ConvertI32x4S:
+	case IT::F32x4ConvertI32x4U:
+	case IT::I32x4TruncateSaturateF64x2SZero:
+	case IT::I32x4TruncateSaturateF64x2UZero:
+	case IT::F64x2ConvertLowI32x4S:
+	case IT::F64x2ConvertLowI32x4U:
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	case IT::V128BitSelect:
+		popValue(ValType::V128);
+		// Fall through
+	default: // Binary operations and shuffles
+		popValue(ValType::V128);
+		popValue(ValType::V128);
+		pushValue(ValType::V128);
+		break;
+	}
+
+	if (!isReachable()) {
+		return;
+	}
+
+	auto operation = instruction.toVectorOperation();
+	print(Bytecode::VectorInstruction);
+	printU8(operation);
+
+	if (opCode == IT::V128Const || opCode == IT::I8x16Shuffle) {
+		for (auto byte : instruction.vectorImmediate()) {
+			printU8(byte);
+		}
+		return;
+	}
+
+	auto operandSize = operation.operandSizeInBytes();
+	if (opCode.isVectorMemory()) {
+		printU32(instruction.memoryOffset());
+	}
+
+	// Lane instructions have a lane byte with or without a memory argument
+	if (operandSize == 1 || operandSize == 5) {
+		printU8(instruction.vectorLaneIndex());
+	}
+}
+
 void ModuleCompiler::compileInstruction(Instruction instruction, u32 instructionCounter)
 {
 	auto opCode = instruction.opCode();
@@ -2280,22 +3662,40 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		return;
 	}
 
+	if (opCode.isAtomicMemory() || opCode == InstructionType::AtomicFence) {
+		compileAtomicMemoryInstruction(instruction);
+		return;
+	}
+
+	if (opCode.isVector()) {
+		compileVectorInstruction(instruction);
+		return;
+	}
+
 	auto validateBlockTypeInstruction = [&]() {
 		auto blockType = instruction.blockTypeIndex();
 		popValues(blockType.parameters());
 		pushControlFrame(instruction.opCode(), blockType);
 	};
 
-	auto validateBranchTypeInstruction = [&]() {
-		auto label = instruction.branchLabel();
-		if (label > controlStack.size() || controlStack.empty()) {
+	// Number of bytes below the label values that have to be dropped when branching
+	u32 branchBytesToDrop = 0;
+	u32 branchBytesToKeep = 0;
+	auto validateBranchTypeInstruction = [&](u32 label) {
+		if (label >= controlStack.size() || controlStack.empty()) {
 			throwCompilationError("Branch label underflows control frame stack");
 		}
 
 		auto& frame = controlStack[controlStack.size() - label - 1];
 		auto labelTypes = frame.labelTypes();
+		auto heightWithLabelValues = stackHeightInBytes;
 		popValues(labelTypes);
 
+		if (isReachable()) {
+			branchBytesToKeep = heightWithLabelValues - stackHeightInBytes;
+			branchBytesToDrop = stackHeightInBytes - frame.heightInBytes;
+		}
+
 		return labelTypes;
 	};
 
@@ -2314,20 +3714,43 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		}
 	};
 
-	auto printBranchingJump = [&](Bytecode shortJump, Bytecode longJump) {
+	auto printBranchingJump = [&](Bytecode shortJump, Bytecode longJump, u32 label) {
 		if (!isReachable()) {
 			return;
 		}
 
-		auto label = instruction.branchLabel();
 		auto& frame = controlStack[controlStack.size() - label - 1];
 
+		// Branches that return or need to drop values print a longer sequence, which
+		// is skipped by a short jump when the branch is conditional
+		if (branchBytesToDrop > 0 || label == controlStack.size() - 1) {
+			printFuelCharge();
+
+			std::optional<sizeType> skipAddressPosition;
+			if (shortJump == Bytecode::IfTrueJumpShort) {
+				print(Bytecode::IfFalseJumpShort);
+				skipAddressPosition = printedBytecode.size();
+				printU8(0xFF);
+			}
+
+			printBranchExit(label, branchBytesToDrop, branchBytesToKeep);
+
+			if (skipAddressPosition.has_value()) {
+				i32 distance = printedBytecode.size() - *skipAddressPosition;
+				assert(isShortDistance(distance));
+				printedBytecode[*skipAddressPosition] = distance;
+			}
+			return;
+		}
+
 		// Forward jump
 		if (frame.opCode != InstructionType::Loop) {
 			printForwardJump(shortJump, longJump, label, false);
 			return;
 		}
 
+		printFuelChargeIfReachable();
+
 		// Consider the bytecode not yet printed -> -1
 		i32 distance = frame.bytecodeOffset - printedBytecode.size() -1;
 		if (isShortDistance(distance)) {
@@ -2336,7 +3759,8 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		}
 		else {
 			print(longJump);
-			printU32(distance);
+			printOperandPadding(4);
+			printU32(frame.bytecodeOffset - printedBytecode.size());
 		}
 	};
 
@@ -2351,17 +3775,12 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		}
 	};
 
-	auto printReturnInstructionForCurrentFunction = [&]() {
-		auto resultSpaceInBytes = currentFunction->functionType().resultStackSectionSizeInBytes();
-		assert(resultSpaceInBytes % 4 == 0);
-		auto resultSpaceInSlots = resultSpaceInBytes / 4;
-		if (resultSpaceInSlots <= 255) {
-			print(Bytecode::ReturnFew);
-			printU8(resultSpaceInSlots);
-		}
-		else {
-			print(Bytecode::ReturnMany);
-			printU32(resultSpaceInSlots);
+	auto validateTailCallResults = [&](const FunctionType& calleeType) {
+		auto calleeResults = calleeType.results();
+		auto currentResults = currentFunction->functionType().results();
+		auto isSubtype = [](ValType calleeResult, ValType currentResult) { return calleeResult.isSubtypeOf(currentResult); };
+		if (!std::equal(calleeResults.begin(), calleeResults.end(), currentResults.begin(), currentResults.end(), isSubtype)) {
+			throwCompilationError("Tail call result types do not match the results of the calling function");
 		}
 	};
 
@@ -2374,9 +3793,13 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 			if (firstType->sizeInBytes() == 4) {
 				print(Bytecode::I32Select);
 			}
-			else {
+			else if (firstType->sizeInBytes() == 8) {
 				print(Bytecode::I64Select);
 			}
+			else {
+				print(Bytecode::VectorInstruction);
+				printU8(VectorOperation::Select);
+			}
 		}
 	};
 
@@ -2391,7 +3814,12 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		return;
 
 	case IT::Block:
+		validateBlockTypeInstruction();
+		return;
+
 	case IT::Loop:
+		// Charge the code before the loop, so that the back edges only charge its body
+		printFuelChargeIfReachable();
 		validateBlockTypeInstruction();
 		return;
 
@@ -2431,12 +3859,12 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		if (controlStack.empty() && !frame.unreachable) {
 			auto isEmpty = currentFunction->expression().size() < 2;
 			if (isEmpty) {
-				printReturnInstructionForCurrentFunction();
+				printReturnInstruction();
 			}
 			else {
 				auto& lastInstruction = *(currentFunction->expression().end() - 2);
 				if (lastInstruction != InstructionType::Return) {
-					printReturnInstructionForCurrentFunction();
+					printReturnInstruction();
 				}
 			}
 		}
@@ -2444,27 +3872,36 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 	}
 
 	case IT::Branch:
-		validateBranchTypeInstruction();
-		printBranchingJump(Bytecode::JumpShort, Bytecode::JumpLong);
+		validateBranchTypeInstruction(instruction.branchLabel());
+		printBranchingJump(Bytecode::JumpShort, Bytecode::JumpLong, instruction.branchLabel());
 		setUnreachable();
 		return;
 
 	case IT::BranchIf: {
 		popValue(ValType::I32);
-		auto labelTypes = validateBranchTypeInstruction();
+		auto labelTypes = validateBranchTypeInstruction(instruction.branchLabel());
 		pushValues(labelTypes);
-		printBranchingJump(Bytecode::IfTrueJumpShort, Bytecode::IfTrueJumpLong);
+		printBranchingJump(Bytecode::IfTrueJumpShort, Bytecode::IfTrueJumpLong, instruction.branchLabel());
 		return;
 	}
 
 	case IT::Return: {
+		// Returning from an inlined function branches to the end of its block
+		if (currentInlining.has_value()) {
+			auto label = controlStack.size() - currentInlining->controlFrameIndex - 1;
+			validateBranchTypeInstruction(label);
+			printBranchingJump(Bytecode::JumpShort, Bytecode::JumpLong, label);
+			setUnreachable();
+			return;
+		}
+
 		if (controlStack.empty()) {
 			throwCompilationError("Control stack underflow during return");
 		}
 		popValues(controlStack[0].blockTypeIndex.results());
 
 		if (isReachable()) {
-			printReturnInstructionForCurrentFunction();
+			printReturnInstruction();
 		}
 
 		setUnreachable();
@@ -2475,37 +3912,74 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		compileBranchTableInstruction(instruction);
 		return;
 
-	case IT::Call: {
+	case IT::Call:
+	case IT::ReturnCall: {
+		auto inlinedCallSite = inlinedCallSiteByInstruction(instructionCounter);
+		if (inlinedCallSite.has_value() && isReachable()) {
+			compileInlinedCall(*inlinedCallSite);
+			return;
+		}
+
 		auto functionIdx = instruction.functionIndex();
 		auto function = module.functionByIndex(functionIdx);
 		assert(function.has_value());
 		auto& funcType = function->functionType();
+		auto isTailCall = instruction == IT::ReturnCall;
+		if (isTailCall) {
+			validateTailCallResults(funcType);
+		}
+
 		popValues(funcType.parameters());
-		pushValues(funcType.results());
+		if (!isTailCall) {
+			pushValues(funcType.results());
+		}
+		else if (!isReachable()) {
+			return;
+		}
+
+		printFuelChargeIfReachable();
 
 		auto bytecodeFunction = function->asBytecodeFunction();
 		if (bytecodeFunction.has_value()) {
-			auto parameterBytes = funcType.parameterStackSectionSizeInBytes();
+			if (!isOnlyValidating) {
+				bytecodeFunction->increaseEstimatedHotness();
+			}
+
+			auto parameterBytes = funcType.parameterStackSectionSizeInBytes(interpreter.useAlignedBytecode);
 			assert(parameterBytes % 4 == 0);
 
 			// FIXME: Print the pointer to the actual bytecode instead?
-			print(Bytecode::Call);
-			printPointer(bytecodeFunction.pointer());
-			printU32(parameterBytes / 4);
+			if (bytecodeFunction->isLeaf() && !isTailCall) {
+				print(Bytecode::CallLeaf);
+				printPointer(bytecodeFunction.pointer());
+			}
+			else {
+				print(isTailCall ? Bytecode::ReturnCall : Bytecode::Call);
+				printPointer(bytecodeFunction.pointer());
+				printU32(parameterBytes / 4);
+			}
 
 		}
 		else {
 			auto hostFunction = function->asHostFunction();
 			assert(hostFunction.has_value());
 
+			// Host functions do not have a frame that could be reused
 			print(Bytecode::CallHost);
 			printPointer(hostFunction.pointer());
+			if (isTailCall) {
+				printReturnInstruction();
+			}
 		}
 
+		if (isTailCall) {
+			setUnreachable();
+		}
 		return;
 	}
 
-	case IT::CallIndirect: {
+	case IT::CallIndirect:
+	case IT::ReturnCallIndirect: {
 		auto typeIdx = instruction.functionIndex();
 		if (typeIdx >= module.compilationData->functionTypes().size()) {
 			throwCompilationError("Call indirect instruction references invalid function type");
@@ -2525,13 +3999,106 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		auto interpreterTypeIdx = interpreter.indexOfFunctionType(funcType);
 		auto interpreterTableIdx = interpreter.indexOfTableInstance(*table);
 
+		auto isTailCall = instruction == IT::ReturnCallIndirect;
+		if (isTailCall) {
+			validateTailCallResults(funcType);
+		}
+
+		// Monomorphic calls check the table index, and only take the regular indirect
+		// call if it differs to trap with the right error
+		auto inlinedCallSite = inlinedCallSiteByInstruction(instructionCounter);
+		if (inlinedCallSite.has_value() && isReachable()) {
+			assert(inlinedCallSite->tableElementIndex.has_value() && inliningScratchLocalIndex.has_value());
+			// The scratch local always holds an i32
+			auto scratchLocal = localByIndex(*inliningScratchLocalIndex);
+			auto printScratchLocalBytecode = [&](Bytecode near32, Bytecode far32) {
+				printLocalGetSetTeeBytecodeIfReachable(scratchLocal, near32, far32, Bytecode::I64LocalGetNear, Bytecode::I64LocalGetFar, VectorOperation::LocalGet);
+			};
+
+			printFuelChargeIfReachable();
+			popValue(ValType::I32);
+			printScratchLocalBytecode(Bytecode::I32LocalSetNear, Bytecode::I32LocalSetFar);
+			printScratchLocalBytecode(Bytecode::I32LocalGetNear, Bytecode::I32LocalGetFar);
+			pushValue(ValType::I32);
+			compileNumericConstantInstruction(Instruction{ IT::I32Const, Instruction::Constant{ (i32)*inlinedCallSite->tableElementIndex } });
+			popValue(ValType::I32);
+			popValue(ValType::I32);
+			print(Bytecode::I32NotEqual);
+			print(Bytecode::IfFalseJumpShort);
+			auto skipAddressPosition = printedBytecode.size();
+			printU8(0xFF);
+
+			printScratchLocalBytecode(Bytecode::I32LocalGetNear, Bytecode::I32LocalGetFar);
+			print(Bytecode::CallIndirect);
+			printU32(interpreterTableIdx.value);
+			printU32(interpreterTypeIdx.value);
+			print(Bytecode::Unreachable);
+
+			i32 distance = printedBytecode.size() - skipAddressPosition;
+			assert(isShortDistance(distance));
+			printedBytecode[skipAddressPosition] = distance;
+
+			compileInlinedCall(*inlinedCallSite);
+			return;
+		}
+
 		popValue(ValType::I32);
 		popValues(funcType.parameters());
-		pushValues(funcType.results());
+		if (!isTailCall) {
+			pushValues(funcType.results());
+		}
+		else if (!isReachable()) {
+			return;
+		}
+
+		printFuelChargeIfReachable();
 
-		print(Bytecode::CallIndirect);
+		print(isTailCall ? Bytecode::ReturnCallIndirect : Bytecode::CallIndirect);
 		printU32(interpreterTableIdx.value);
 		printU32(interpreterTypeIdx.value);
+
+		// Only reached if the callee turns out to be a host function
+		if (isTailCall) {
+			printReturnInstruction();
+			setUnreachable();
+		}
+		return;
+	}
+
+	case IT::CallReference:
+	case IT::ReturnCallReference: {
+		auto typeIdx = instruction.callTypeIndex();
+		if (typeIdx >= module.compilationData->functionTypes().size()) {
+			throwCompilationError("Call reference instruction references invalid function type");
+		}
+		auto& funcType = module.compilationData->functionTypes()[typeIdx.value];
+		auto interpreterTypeIdx = module.compilationData->interpreterTypeIndices()[typeIdx.value];
+
+		auto isTailCall = instruction == IT::ReturnCallReference;
+		if (isTailCall) {
+			validateTailCallResults(funcType);
+		}
+
+		// The reference has to be of the called type, so only null remains to be checked
+		popValue(ValType::fromTypeIndex(interpreterTypeIdx.value, true));
+		popValues(funcType.parameters());
+		if (!isTailCall) {
+			pushValues(funcType.results());
+		}
+		else if (!isReachable()) {
+			return;
+		}
+
+		printFuelChargeIfReachable();
+
+		// The reference already is the function instance, so no table lookup is necessary
+		print(isTailCall ? Bytecode::ReturnCallReference : Bytecode::CallReference);
+
+		// Only reached if the callee turns out to be a host function
+		if (isTailCall) {
+			printReturnInstruction();
+			setUnreachable();
+		}
 		return;
 	}
 
@@ -2544,8 +4111,13 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 			else if (type->sizeInBytes() == 8) {
 				print(Bytecode::I64Drop);
 			}
+			else if (type->sizeInBytes() == 16) {
+				// Vectors take up two 64bit slots
+				print(Bytecode::I64Drop);
+				print(Bytecode::I64Drop);
+			}
 			else {
-				throwCompilationError("Drop instruction only implemented for 32bit and 64bit");
+				throwCompilationError("Drop instruction only implemented for 32bit, 64bit and 128bit");
 			}
 		}
 		return;
@@ -2581,11 +4153,11 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 	}
 
 	case IT::SelectFrom: {
-		auto typeVector = instruction.selectTypeVector(currentFunction->expression().bytes());
-		if (typeVector.size() != 1) {
+		auto typeVector = instruction.selectTypeVector(currentExpression().bytes());
+		if (typeVector.nextU32() != 1) {
 			throwCompilationError("Expected a type vector of size one for SelectFrom instruction");
 		}
-		auto type = ValType::fromInt(typeVector[0]);
+		auto type = resolveValType(ValType::fromWASMBytes(typeVector));
 
 		popValue(ValType::I32);
 		popValue(type);
@@ -2598,12 +4170,16 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 
 	case IT::LocalGet: {
 		auto local = localByIndex(instruction.localIndex());
+		if (!isLocalInitialized(instruction.localIndex())) {
+			throwCompilationError("Non-nullable local is read before it is set");
+		}
 		printLocalGetSetTeeBytecodeIfReachable(
 			local,
 			Bytecode::I32LocalGetNear,
 			Bytecode::I32LocalGetFar,
 			Bytecode::I64LocalGetNear,
-			Bytecode::I64LocalGetFar
+			Bytecode::I64LocalGetFar,
+			VectorOperation::LocalGet
 		);
 		pushValue(local.type);
 		return;
@@ -2612,12 +4188,14 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 	case IT::LocalSet: {
 		auto local = localByIndex(instruction.localIndex());
 		popValue(local.type);
+		setLocalInitialized(instruction.localIndex());
 		printLocalGetSetTeeBytecodeIfReachable(
 			local,
 			Bytecode::I32LocalSetNear,
 			Bytecode::I32LocalSetFar,
 			Bytecode::I64LocalSetNear,
-			Bytecode::I64LocalSetFar
+			Bytecode::I64LocalSetFar,
+			VectorOperation::LocalSet
 		);
 		return;
 	}
@@ -2625,13 +4203,15 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 	case IT::LocalTee: {
 		auto local = localByIndex(instruction.localIndex());
 		popValue(local.type);
+		setLocalInitialized(instruction.localIndex());
 		pushValue(local.type);
 		printLocalGetSetTeeBytecodeIfReachable(
 			local,
 			Bytecode::I32LocalTeeNear,
 			Bytecode::I32LocalTeeFar,
 			Bytecode::I64LocalTeeNear,
-			Bytecode::I64LocalTeeFar
+			Bytecode::I64LocalTeeFar,
+			VectorOperation::LocalTee
 		);
 		return;
 	}
@@ -2658,27 +4238,31 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 	}
 
 	case IT::ReferenceNull:
-		pushValue(ValType::FuncRef);
+		pushValue(resolveValType(instruction.referenceType()));
 		if (isReachable()) {
 			print(Bytecode::I64ConstLong);
 			printU64(0x00);
 		}
 		return;
 
-	case IT::ReferenceIsNull:
-		popValue(ValType::FuncRef);
+	case IT::ReferenceIsNull: {
+		auto refType = popValue();
+		if (refType.has_value() && !refType->isReference()) {
+			throwCompilationError("ReferenceIsNull instruction expected reference type");
+		}
 		pushValue(ValType::I32);
 		if (isReachable()) {
 			print(Bytecode::I64EqualZero);
 		}
 		return;
+	}
 
 	case IT::ReferenceFunction: {
-		pushValue(ValType::FuncRef);
 		auto function = module.functionByIndex(instruction.functionIndex());
 		if (!function.has_value()) {
 			throwCompilationError("ReferenceFunction instruction reference invalid function index");
 		}
+		pushValue(ValType::fromTypeIndex(function->interpreterTypeIndex().value, false));
 		if (isReachable()) {
 			// FIXME: Put the actual bytecode address instead of the function instance?
 			print(Bytecode::I64ConstLong);
@@ -2687,6 +4271,75 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 		return;
 	}
 
+	case IT::ReferenceAsNonNull: {
+		auto refType = popValue();
+		if (refType.has_value() && !refType->isReference()) {
+			throwCompilationError("ReferenceAsNonNull instruction expected reference type");
+		}
+		pushMaybeValue(refType.has_value() ? refType->asNonNullable() : refType);
+		if (isReachable()) {
+			print(Bytecode::ReferenceAsNonNull);
+		}
+		return;
+	}
+
+	case IT::BranchOnNull:
+	case IT::BranchOnNonNull: {
+		// BranchOnNull keeps the reference below the label values, while
+		// BranchOnNonNull passes it to the label as its last value. Either
+		// way the reference is known not to be null where it is kept.
+		auto isOnNull = instruction == IT::BranchOnNull;
+		auto refType = popValue();
+		if (refType.has_value() && !refType->isReference()) {
+			throwCompilationError("Branch on null instruction expected reference type");
+		}
+		ValueRecord nonNullableRefType = refType.has_value() ? refType->asNonNullable() : refType;
+
+		if (!isOnNull) {
+			pushMaybeValue(nonNullableRefType);
+		}
+
+		auto label = instruction.branchLabel();
+		auto labelTypes = validateBranchTypeInstruction(label);
+		pushValues(labelTypes);
+
+		if (!isOnNull) {
+			if (labelTypes.size(module).value_or(0) == 0) {
+				throwCompilationError("BranchOnNonNull instruction expected label with reference type");
+			}
+			popValue();
+		}
+		else {
+			pushMaybeValue(nonNullableRefType);
+		}
+
+		if (!isReachable()) {
+			return;
+		}
+
+		// The reference is only dropped on the path that does not carry it
+		printFuelCharge();
+		print(Bytecode::ReferenceTestNull);
+		print(isOnNull ? Bytecode::IfFalseJumpShort : Bytecode::IfTrueJumpShort);
+		auto skipAddressPosition = printedBytecode.size();
+		printU8(0xFF);
+
+		if (isOnNull) {
+			print(Bytecode::I64Drop);
+		}
+
+		printBranchExit(label, branchBytesToDrop, branchBytesToKeep);
+
+		i32 distance = printedBytecode.size() - skipAddressPosition;
+		assert(isShortDistance(distance));
+		printedBytecode[skipAddressPosition] = distance;
+
+		if (!isOnNull) {
+			print(Bytecode::I64Drop);
+		}
+		return;
+	}
+
 	case IT::MemorySize:
 	case IT::MemoryGrow:
 	case IT::MemoryFill:
@@ -2715,7 +4368,7 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 
 	case IT::ElementDrop: {
 		auto moduleElementIdx = instruction.elementIndex();
-		auto element = linkedElementByIndex(moduleElementIdx);
+		auto& element = linkedElementByIndex(moduleElementIdx);
 		auto interpreterElementIdx = interpreter.indexOfLinkedElement(element);
 
 		print(Bytecode::ElementDrop);
@@ -2729,15 +4382,21 @@ void ModuleCompiler::compileInstruction(Instruction instruction, u32 instruction
 }
 
 void ModuleCompiler::printBytecode(std::ostream& out) {
-	printBytecode(out, printedBytecode);
+	printBytecode(out, printedBytecode.slice(0, printedBytecode.size()), interpreter.useAlignedBytecode);
 }
 
-void ModuleCompiler::printBytecode(std::ostream& out, const Buffer& bytecodeBuffer)
+void ModuleCompiler::printBytecode(std::ostream& out, const BufferSlice& bytecodeBuffer, bool alignedOperands)
 {
 	using std::setw, std::hex, std::dec;
 
 	// FIXME: Allow for const buffer iteration
-	auto it = const_cast<Buffer&>(bytecodeBuffer).iterator();
+	auto it = const_cast<BufferSlice&>(bytecodeBuffer).iterator();
+	auto skipOperandPadding = [&](sizeType alignment) {
+		if (alignedOperands) {
+			it.moveTo(alignPointerUp(it.positionPointer(), alignment));
+		}
+	};
+
 	u32 idx = 0;
 	while (it.hasNext()) {
 		auto opCodeAddress = (u64)it.positionPointer();
@@ -2746,9 +4405,12 @@ void ModuleCompiler::printBytecode(std::ostream& out, const Buffer& bytecodeBuff
 		auto opCode = Bytecode::fromInt(it.nextU8());
 		out << setw(2) << (u32)opCode << " (" << opCode.name() << ")";
 
+		// Jumps are relative to the position of their operand
 		auto args = opCode.arguments();
+		auto operandAddress = (u64)it.positionPointer();
 		if (args.isU64()) {
 			for (u32 i = 0; i != args.count(); i++) {
+				skipOperandPadding(8);
 				out << " " << it.nextLittleEndianU64();
 			}
 		}
@@ -2756,6 +4418,8 @@ void ModuleCompiler::printBytecode(std::ostream& out, const Buffer& bytecodeBuff
 		u32 lastU32= 0;
 		if (args.isU32()) {
 			for (u32 i = 0; i != args.count(); i++) {
+				skipOperandPadding(4);
+				operandAddress = (u64)it.positionPointer();
 				lastU32 = it.nextLittleEndianU32();
 				out << " " << lastU32;
 			}
@@ -2770,17 +4434,47 @@ void ModuleCompiler::printBytecode(std::ostream& out, const Buffer& bytecodeBuff
 		}
 
 		if (opCode == Bytecode::JumpShort || opCode == Bytecode::IfTrueJumpShort || opCode == Bytecode::IfFalseJumpShort) {
-			out << " (-> " << opCodeAddress+ 1 + (i8)lastU8 << ")";
+			out << " (-> " << operandAddress + (i8)lastU8 << ")";
 		}
 		else if (opCode == Bytecode::JumpLong || opCode == Bytecode::IfTrueJumpLong || opCode == Bytecode::IfFalseJumpLong) {
-			out << " (-> " << opCodeAddress+ 1 + (i32)lastU32 << ")";
+			out << " (-> " << operandAddress + (i32)lastU32 << ")";
 		}
 		else if (opCode == Bytecode::JumpTable) {
 			for (u32 i = 0; i != lastU32; i++) {
-				out << "\n      (" << setw(2) << i << " -> " << opCodeAddress + 1 + (i32)it.nextLittleEndianU32() << ")";
+				out << "\n      (" << setw(2) << i << " -> " << operandAddress + (i32)it.nextLittleEndianU32() << ")";
 			}
 
-			out << "\n      (default -> " << opCodeAddress + 1 + (i32)it.nextLittleEndianU32() << ")";
+			out << "\n      (default -> " << operandAddress + (i32)it.nextLittleEndianU32() << ")";
+		}
+		else if (opCode == Bytecode::Memory64Instruction) {
+			// The prefixed bytecode is followed by its own arguments
+			auto prefixedOpCode = Bytecode::fromInt(lastU8);
+			out << " (" << prefixedOpCode.name() << ")";
+
+			auto prefixedArgs = prefixedOpCode.arguments();
+			for (u32 i = 0; i != prefixedArgs.count(); i++) {
+				skipOperandPadding(4);
+				out << " " << it.nextLittleEndianU32();
+			}
+		}
+		else if (opCode == Bytecode::VectorInstruction) {
+			auto operation = VectorOperation::fromInt(lastU8);
+			out << " (" << operation.name() << ")";
+
+			// Lane memory operations take an offset followed by a lane index
+			auto operandSize = operation.operandSizeInBytes();
+			if (operandSize == 16) {
+				for (u32 i = 0; i != 16; i++) {
+					out << " " << (u32)it.nextU8();
+				}
+			}
+			if (operandSize == 4 || operandSize == 5) {
+				skipOperandPadding(4);
+				out << " " << it.nextLittleEndianU32();
+			}
+			if (operandSize == 1 || operandSize == 5) {
+				out << " " << (u32)it.nextU8();
+			}
 		}
 
 		out << dec << std::endl;
@@ -1,13 +1,22 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <span>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
 
 #include "decoding.h"
 #include "bytecode.h"
 #include "arraylist.h"
 #include "sealed.h"
+#include "address_space.h"
 
 namespace WASM {
 
@@ -19,7 +28,7 @@ namespace WASM {
 		virtual ~Function() = default;
 
 		ModuleFunctionIndex moduleIndex() const { return mModuleIndex; }
-		Nullable<const std::string> lookupName(const Module&) const;
+		Nullable<const std::pmr::string> lookupName(const Module&) const;
 
 		virtual Nullable<const BytecodeFunction> asBytecodeFunction() const { return {}; }
 		virtual Nullable<const HostFunctionBase> asHostFunction() const { return {}; }
@@ -45,20 +54,27 @@ namespace WASM {
 		// size of RA + FP + SP + MP
 		static constexpr u32 SpecialFrameBytes = 32;
 
+		// size of RA + FP
+		static constexpr u32 LeafFrameBytes = 16;
+
 		BytecodeFunction(ModuleFunctionIndex idx, ModuleTypeIndex ti, const FunctionType& t, FunctionCode c);
 
 		virtual Nullable<const BytecodeFunction> asBytecodeFunction() const { return *this; }
 
 		ModuleTypeIndex moduleTypeIndex() const { return mModuleTypeIndex; }
 		const Expression& expression() const { return code; }
+		Expression& expression() { return code; }
 
 		void setLinkedFunctionType(InterpreterTypeIndex idx, FunctionType& ft) { mInterpreterTypeIndex = idx;  type = ft; }
 		virtual const FunctionType& functionType() const override { return *type; }
 
 		u32 maxStackHeight() const { return mMaxStackHeight; }
 		void setMaxStackHeight(u32 h) { mMaxStackHeight = h; }
-		const Buffer& bytecode() const { return mBytecode; }
-		void setBytecode(Buffer b) { mBytecode = std::move(b); }
+		const BufferSlice& bytecode() const { return mBytecode; }
+		void setBytecode(Buffer);
+		void relocateBytecode(u8*);
+		u32 estimatedHotness() const { return mEstimatedHotness; }
+		void increaseEstimatedHotness() { mEstimatedHotness++; }
 
 		std::optional<LocalOffset> localOrParameterByIndex(u32) const;
 		bool hasLocals() const;
@@ -66,16 +82,75 @@ namespace WASM {
 		u32 operandStackSectionOffsetInBytes() const;
 		u32 localsSizeInBytes() const;
 		bool requiresMemoryInstance() const;
+		bool hasCalls() const;
+		bool isLeaf() const { return mIsLeaf; }
+		u32 frameBytes() const { return mIsLeaf ? LeafFrameBytes : SpecialFrameBytes; }
+		u32 appendLocal(ValType);
+		void removeLocalsFrom(u32);
+		void enableAlignedStack();
 
 	private:
-		void uncompressLocalTypes(const std::vector<CompressedLocalTypes>&);
+		void uncompressLocalTypes(const std::pmr::vector<CompressedLocalTypes>&);
+		void layoutLocals();
 
 		ModuleTypeIndex mModuleTypeIndex;
 		NonNull<const FunctionType> type;
 		Expression code;
 		std::vector<LocalOffset> uncompressedLocals;
 		u32 mMaxStackHeight{ 0 };
-		Buffer mBytecode;
+		u32 mEstimatedHotness{ 0 };
+		bool mIsLeaf{ false };
+		bool mHasAlignedStack{ false };
+		Buffer mCompiledBytecode;
+		BufferSlice mBytecode{ nullptr, 0 };
+	};
+
+	/*
+	* Bytecode Arena class
+	* Single page aligned block of memory that holds the bytecode of all
+	* functions after compilation. Each function starts at an aligned
+	* offset and the functions are placed in the order they are provided,
+	* so that callers can keep frequently run code close together. The
+	* address ranges of the functions are kept sorted, which allows for
+	* mapping a bytecode pointer back to its function in O(log n).
+	*/
+	class BytecodeArena {
+	public:
+		static constexpr sizeType PageSize = 4096;
+		static constexpr sizeType FunctionAlignment = 16;
+
+		struct Entry {
+			NonNull<BytecodeFunction> function;
+			NonNull<const Module> module;
+		};
+
+		struct Lookup {
+			const BytecodeFunction& function;
+			const Module& module;
+		};
+
+		BytecodeArena() = default;
+		BytecodeArena(std::span<Entry>);
+
+		sizeType size() const { return mSize; }
+		bool hasInRange(const u8* ptr) const { return mData && mData.get() <= ptr && ptr < (mData.get() + mSize); }
+		std::optional<Lookup> findFunction(const u8*) const;
+
+	private:
+		struct PageDeleter {
+			void operator()(u8* ptr) const { ::operator delete[](ptr, std::align_val_t{ PageSize }); }
+		};
+
+		struct IndexEntry {
+			const u8* begin;
+			const u8* end;
+			NonNull<const BytecodeFunction> function;
+			NonNull<const Module> module;
+		};
+
+		std::unique_ptr<u8[], PageDeleter> mData;
+		sizeType mSize{ 0 };
+		std::vector<IndexEntry> mIndex;
 	};
 
 	class FunctionTable {
@@ -114,7 +189,7 @@ namespace WASM {
 
 	class LinkedElement {
 	public:
-		LinkedElement(ModuleElementIndex idx, ElementMode m, ValType t, ModuleTableIndex i, u32 o, std::vector<Nullable<Function>> f)
+		LinkedElement(ModuleElementIndex idx, ElementMode m, ValType t, ModuleTableIndex i, u32 o, std::pmr::vector<Nullable<Function>> f)
 			: index{ idx }, mMode{ m }, refType{ t }, tableIndex{ i }, tableOffset{ o }, mFunctions{ std::move(f) } {}
 
 		LinkedElement(ModuleElementIndex idx, ElementMode m, ValType t, ModuleTableIndex i, u32 o)
@@ -126,7 +201,7 @@ namespace WASM {
 		void drop();
 
 		ValType referenceType() const { return refType; }
-		const std::vector<Nullable<Function>>& references() const { return mFunctions; }
+		const std::pmr::vector<Nullable<Function>>& references() const { return mFunctions; }
 
 	private:
 		ModuleElementIndex index;
@@ -134,27 +209,32 @@ namespace WASM {
 		ValType refType;
 		ModuleTableIndex tableIndex;
 		u32 tableOffset;
-		std::vector<Nullable<Function>> mFunctions;
+		std::pmr::vector<Nullable<Function>> mFunctions;
 	};
 
 	class LinkedDataItem {
 	public:
+		// Passive items get a copy of their bytes, so that dropping them actually
+		// releases the memory while the module's buffer stays untouched
 		LinkedDataItem(ModuleDataIndex i, DataItemMode m, BufferSlice d)
-			: mModuleIndex{ i }, mMode{ m }, mDataBytes{ std::move(d) }, mMemoryIndex{0}, mMemoryOffset{0} {}
+			: mModuleIndex{ i }, mMode{ m }, mOwnedBytes{ std::vector<u8>{ d.begin(), d.end() } },
+			mDataBytes{ mOwnedBytes.slice(0, mOwnedBytes.size()) }, mMemoryIndex{0}, mMemoryOffset{0} {}
 
-		LinkedDataItem(ModuleDataIndex i, DataItemMode m, BufferSlice d, InterpreterMemoryIndex x, u32 o)
+		LinkedDataItem(ModuleDataIndex i, DataItemMode m, BufferSlice d, InterpreterMemoryIndex x, u64 o)
 			: mModuleIndex{ i }, mMode{ m }, mDataBytes{ std::move(d) }, mMemoryIndex{ x }, mMemoryOffset{ o } {}
 
 		sizeType initMemoryIfActive(Module&) const;
+		void drop();
 
 		auto& dataBytes() const { return mDataBytes; }
 
 	private:
 		ModuleDataIndex mModuleIndex;
 		DataItemMode mMode;
+		Buffer mOwnedBytes;
 		BufferSlice mDataBytes;
 		InterpreterMemoryIndex mMemoryIndex;
-		u32 mMemoryOffset;
+		u64 mMemoryOffset;
 	};
 
 	class Memory {
@@ -162,27 +242,124 @@ namespace WASM {
 		static constexpr u64 PageSize = 65536;
 
 		Memory(ModuleMemoryIndex, Limits l);
+		Memory(ModuleMemoryIndex, std::shared_ptr<SharedMemory>);
 
-		i32 grow(i32);
-		void init(const LinkedDataItem&, u32, u32, u32);
+		i64 grow(i64);
+		void init(const LinkedDataItem&, u64, u32, u32);
+		void copy(u64, u64, u64);
+		void fill(u64, u8, u64);
 
 		auto& limits() const { return mLimits; }
+		bool is64() const { return mLimits.is64(); }
 		u64 minBytes() const;
 		std::optional<u64> maxBytes() const;
 		sizeType currentSizeInPages() const;
 		sizeType currentSizeInBytes() const;
 
-		__forceinline u8* pointer(u32 idx) {
-			if (idx > mData.size()) {
-				throw std::runtime_error{ "Out of bounds memory access" };
+		bool isShared() const { return mSharedMemory != nullptr; }
+		const std::shared_ptr<SharedMemory>& sharedMemory() const { return mSharedMemory; }
+
+		__forceinline u8* pointer(u64 idx) {
+			if (idx > mByteSize) {
+				checkSharedBounds(idx);
+			}
+			return mBase+ idx;
+		}
+
+		template<MemoryBoundsMode::TEnum Mode, typename T>
+		__forceinline T* pointer(u64 address) {
+			if constexpr (Mode == MemoryBoundsMode::Checked) {
+				return reinterpret_cast<T*>(pointer(address));
+			}
+			else if constexpr (Mode == MemoryBoundsMode::Strict) {
+				// The end of the access is never computed, as it might wrap around for 64bit addresses
+				if (address > mByteSize || sizeof(T) > mByteSize - address) {
+					checkSharedBounds(address, sizeof(T));
+				}
+				return reinterpret_cast<T*>(mBase + address);
+			}
+			else {
+				return reinterpret_cast<T*>(mBase + address);
+			}
+		}
+
+		template<MemoryBoundsMode::TEnum Mode, typename T>
+		__forceinline std::atomic_ref<T> atomicReference(u64 address) {
+			// Misaligned atomic accesses trap regardless of the bounds mode
+			if (address % sizeof(T)) {
+				throw std::runtime_error{ "Unaligned atomic memory access" };
 			}
-			return mData.data()+ idx;
+			return std::atomic_ref<T>{ *pointer<Mode, T>(address) };
 		}
 
+		u32 atomicNotify(u64, u32);
+		std::optional<u32> atomicWait32(u64, u32, i64, Nullable<const std::atomic<u32>> = {});
+		std::optional<u32> atomicWait64(u64, u64, i64, Nullable<const std::atomic<u32>> = {});
+
 	private:
+		void checkSharedBounds(u64, u64 = 0);
+
 		ModuleMemoryIndex mIndex;
 		Limits mLimits;
+		u8* mBase{ nullptr };
+		sizeType mByteSize{ 0 };
 		std::vector<u8> mData;
+		std::shared_ptr<SharedMemory> mSharedMemory;
+	};
+
+	/*
+	* Shared Memory class
+	* Linear memory that can be imported by several interpreter instances
+	* running on different threads, so that they can pass offsets instead of
+	* copying data. Address space for the maximum size is reserved up front,
+	* which keeps the data in place while it is grown, but pages are only
+	* committed once the memory grows into them. Growing is atomic and the new size
+	* becomes visible to the other instances on their next access beyond
+	* their last known size. Plain loads and stores of different instances
+	* are not ordered with each other; the host has to order them, e.g. by
+	* handing offsets over through a synchronized queue or with the atomic
+	* instructions of the threads proposal. Waiting blocks the thread of the
+	* interpreter until it is notified or times out. If the waiter passes cancel
+	* flags, they are checked in short slices and the wait ends early without a
+	* result once any of them is set, so that the interpreter can handle its
+	* interrupts and yield requests.
+	*/
+	class SharedMemory {
+	public:
+		SharedMemory(u32, u32);
+		SharedMemory(const SharedMemory&) = delete;
+		SharedMemory(SharedMemory&&) = delete;
+
+		Limits limits() const { return mLimits; }
+		u8* data() const { return mAddressSpace->data(); }
+		sizeType currentSizeInPages() const { return mPageCount.load(std::memory_order_acquire); }
+		sizeType currentSizeInBytes() const { return currentSizeInPages() * Memory::PageSize; }
+
+		i32 grow(i32);
+
+		u32 notify(u64, u32);
+		std::optional<u32> wait(u64, u32, i64, Nullable<const std::atomic<u32>> = {});
+		std::optional<u32> wait(u64, u64, i64, Nullable<const std::atomic<u32>> = {});
+
+	private:
+		// Longest time a cancellable wait sleeps before checking its cancel flags again
+		static constexpr std::chrono::milliseconds WaitSliceDuration{ 5 };
+
+		struct Waiter {
+			std::condition_variable condition;
+			bool isNotified{ false };
+		};
+
+		template<typename T>
+		std::optional<u32> waitForNotify(u64, T, i64, Nullable<const std::atomic<u32>>);
+
+		Limits mLimits;
+		std::optional<AddressSpaceReservation> mAddressSpace;
+		std::atomic<u32> mPageCount{ 0 };
+		std::mutex mGrowMutex;
+
+		std::mutex mWaitMutex;
+		std::unordered_map<u64, std::deque<NonNull<Waiter>>> mWaitQueues;
 	};
 
 	class GlobalBase {};
@@ -223,10 +400,11 @@ namespace WASM {
 
 		Nullable<const HostModule> asHostModule() const { return const_cast<ModuleBase&>(*this).asHostModule(); }
 		Nullable<const Module> asWasmModule() const { return const_cast<ModuleBase&>(*this).asWasmModule(); }
+		const Interpreter& interpreter() const { return *mInterpreter; }
 
 	protected:
 		virtual void instantiate(ModuleLinker&, Nullable<Introspector>) = 0;
-		void createMemoryBase(const MemoryType&, ModuleLinker&, Nullable<Introspector>);
+		void createMemoryBase(const MemoryType&, ModuleLinker&, Nullable<Introspector>, std::shared_ptr<SharedMemory> = {});
 		void createGlobalsBase(VirtualForwardIterator<DeclaredGlobalBase>&, ModuleLinker&, Nullable<Introspector>);
 
 		virtual void initializeInstance(ModuleLinker&, Nullable<Introspector>)= 0;
@@ -267,10 +445,11 @@ namespace WASM {
 		Nullable<Function> startFunction() const { return mLinkedStartFunction; }
 		Nullable<Memory> memoryWithIndexZero() const { return mLinkedMemory; }
 
+		std::span<BytecodeFunction> functions();
 		Nullable<const Function> findFunctionByBytecodePointer(const u8*) const;
 
 		std::optional<ExportItem> exportByName(const std::string&, ExportType) const;
-		Nullable<const std::string> functionNameByIndex(ModuleFunctionIndex) const;
+		Nullable<const std::pmr::string> functionNameByIndex(ModuleFunctionIndex) const;
 		virtual Nullable<Function> exportedFunctionByName(const std::string&) override;
 		virtual Nullable<FunctionTable> exportedTableByName(const std::string&) override;
 		virtual Nullable<Memory> exportedMemoryByName(const std::string&) override;
@@ -290,6 +469,10 @@ namespace WASM {
 		void createElementsAndInitTables(ModuleLinker&, Nullable<Introspector>);
 		void createDataItemsAndInitMemory(ModuleLinker&, Nullable<Introspector>);
 
+		// Owns the memory of the parsed function codes and names, which remain in use
+		// after the parsing state is dropped. Has to be declared before them.
+		std::unique_ptr<Arena> mArena;
+
 		std::string mPath;
 		std::string mName;
 		Buffer mData;
@@ -340,6 +523,7 @@ namespace WASM {
 
 		void checkModulesLinkStatus();
 		void instantiateModules();
+		void reserveLinkedItems();
 		void buildDeduplicatedFunctionTypeTable();
 		sizeType countDependencyItems();
 		void createDependencyItems(const Module&, VirtualSpan<Imported>);
@@ -377,7 +561,7 @@ namespace WASM {
 
 		void compile();
 
-		static void printBytecode(std::ostream&, const Buffer&);
+		static void printBytecode(std::ostream&, const BufferSlice&, bool alignedOperands = false);
 
 	private:
 		using ValueRecord = std::optional<ValType>;
@@ -409,6 +593,7 @@ namespace WASM {
 			BlockTypeIndex blockTypeIndex;
 			u32 height;
 			u32 heightInBytes;
+			u32 initializedLocalsHeight;
 			bool unreachable{ false };
 			u32 bytecodeOffset;
 			std::optional<sizeType> addressPatchList;
@@ -419,7 +604,35 @@ namespace WASM {
 			void processAddressPatchRequests(ModuleCompiler&);
 		};
 
+		struct InlinedCallSite {
+			u32 instructionIndex;
+			NonNull<const BytecodeFunction> callee;
+			u32 localsBaseIndex;
+			u32 maxPrintedByteLength;
+			std::optional<u32> tableElementIndex;
+		};
+
+		struct InliningContext {
+			NonNull<const BytecodeFunction> callee;
+			u32 localsBaseIndex;
+			u32 controlFrameIndex;
+		};
+
+		// Max number of instructions of an inlined function, called from inside a loop or not
+		static constexpr u32 InlinedFunctionSizeLimit = 12;
+		static constexpr u32 HotInlinedFunctionSizeLimit = 40;
+
+		// Max number of instructions inlined into a single function
+		static constexpr u32 InlinedInstructionsBudget = 1000;
+
+		void validateFunction(BytecodeFunction&);
 		void compileFunction(BytecodeFunction&);
+		void planInlinedCalls(BytecodeFunction&);
+		bool isInlineable(const BytecodeFunction&, bool) const;
+		std::optional<sizeType> findMonomorphicTableElement(Instruction);
+		Nullable<const InlinedCallSite> inlinedCallSiteByInstruction(u32) const;
+		void compileInlinedCall(const InlinedCallSite&);
+		const Expression& currentExpression() const;
 		
 		void resetBytecodePrinter();
 		void print(Bytecode c);
@@ -429,12 +642,19 @@ namespace WASM {
 		void printF32(f32 f);
 		void printF64(f64 f);
 		void printPointer(const void* p);
+		void printOperandPadding(u32 alignment);
+		sizeType operandPosition(sizeType, u32 alignment) const;
 
+		void printFuelCharge();
+		void printFuelChargeIfReachable();
+		void printReturnInstruction();
+		void printBranchExit(u32, u32, u32);
 		void printBytecodeExpectingNoArgumentsIfReachable(Instruction);
-		void printLocalGetSetTeeBytecodeIfReachable(BytecodeFunction::LocalOffset, Bytecode, Bytecode, Bytecode, Bytecode);
+		void printLocalGetSetTeeBytecodeIfReachable(BytecodeFunction::LocalOffset, Bytecode, Bytecode, Bytecode, Bytecode, VectorOperation);
 
 		// Based on the expression validation algorithm
 		void setFunctionContext(const BytecodeFunction&);
+		u32 stackSizeOf(ValType) const;
 		void pushValue(ValType);
 		void pushMaybeValue(ValueRecord);
 		ValueRecord popValue();
@@ -457,11 +677,16 @@ namespace WASM {
 		ControlFrame popControlFrame();
 		void setUnreachable();
 		bool isReachable() const;
+		void setLocalInitialized(u32);
+		bool isLocalInitialized(u32) const;
+		ValType resolveValType(ValType) const;
 		void compileNumericConstantInstruction(Instruction);
 		void compileNumericUnaryInstruction(Instruction);
 		void compileNumericBinaryInstruction(Instruction);
 		void compileMemoryDataInstruction(Instruction);
 		void compileMemoryControlInstruction(Instruction);
+		void compileAtomicMemoryInstruction(Instruction);
+		void compileVectorInstruction(Instruction);
 		void compileBranchTableInstruction(Instruction);
 		void compileTableInstruction(Instruction);
 		void compileInstruction(Instruction, u32);
@@ -474,6 +699,8 @@ namespace WASM {
 		const LinkedElement& linkedElementByIndex(ModuleElementIndex) const;
 		const LinkedDataItem& linkedDataItemByIndex(ModuleDataIndex) const;
 		u32 measureMaxPrintedBlockLength(u32, u32, bool= false) const;
+		u32 measureMaxPrintedInstructionLength(Instruction, const BufferSlice&) const;
+		u32 measureMaxPrintedInlinedCallLength(const BytecodeFunction&, bool) const;
 		void requestAddressPatch(u32, bool, bool = false, std::optional<u32> jumpReferencePosition = {});
 		void patchAddress(const AddressPatchRequest&);
 
@@ -489,11 +716,22 @@ namespace WASM {
 
 		u32 stackHeightInBytes{ 0 };
 		u32 maxStackHeightInBytes{ 0 };
+		u32 unchargedFuelCost{ 0 };
 		std::vector<ValueRecord> valueStack;
 		std::vector<ControlFrame> controlStack;
 		std::vector<ValueRecord> cachedReturnList;
 
+		// Non-nullable locals set in the current block, which are reset when it ends
+		std::vector<u32> initializedLocals;
+
 		ArrayList<AddressPatchRequest> addressPatches;
+
+		std::vector<InlinedCallSite> inlinedCallSites;
+		std::optional<InliningContext> currentInlining;
+		std::optional<u32> inliningScratchLocalIndex;
+		bool inlinesMemoryAccesses{ false };
+		bool mayModifyTables{ false };
+		bool isOnlyValidating{ false };
 		
 		const BytecodeFunction* currentFunction{ nullptr };
 	};
@@ -0,0 +1,901 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+#include "optimizer.h"
+#include "module.h"
+
+using namespace WASM;
+
+static Instruction i32Constant(u32 x)
+{
+	return { InstructionType::I32Const, Instruction::Constant{ (i32)x } };
+}
+
+static Instruction i64Constant(u64 x)
+{
+	return { InstructionType::I64Const, Instruction::Constant{ (i64)x } };
+}
+
+static bool isNumericConstant(const Instruction& ins)
+{
+	switch (ins.opCode()) {
+	case InstructionType::I32Const:
+	case InstructionType::I64Const:
+	case InstructionType::F32Const:
+	case InstructionType::F64Const:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Pushes a single value without any side effects or traps
+static bool isPureProducer(const Instruction& ins)
+{
+	return ins.isConstant() || ins == InstructionType::LocalGet || ins == InstructionType::V128Const;
+}
+
+// Computes a value only from its operands without any side effects or traps
+static bool isPureOperation(const Instruction& ins)
+{
+	using IT = InstructionType;
+	switch (ins.opCode()) {
+	case IT::I32DivideS:
+	case IT::I32DivideU:
+	case IT::I32RemainderS:
+	case IT::I32RemainderU:
+	case IT::I64DivideS:
+	case IT::I64DivideU:
+	case IT::I64RemainderS:
+	case IT::I64RemainderU:
+	case IT::I32TruncateF32S:
+	case IT::I32TruncateF32U:
+	case IT::I32TruncateF64S:
+	case IT::I32TruncateF64U:
+	case IT::I64TruncateF32S:
+	case IT::I64TruncateF32U:
+	case IT::I64TruncateF64S:
+	case IT::I64TruncateF64U:
+		return false;
+	default:
+		return ins.opCode().isUnary() || ins.opCode().isBinary();
+	}
+}
+
+// Compares the opcodes and the immediates of instructions used in pure expressions
+static bool isSameInstruction(const Instruction& a, const Instruction& b)
+{
+	if (a.opCode() != b.opCode()) {
+		return false;
+	}
+
+	switch (a.opCode()) {
+	case InstructionType::LocalGet: return a.localIndex() == b.localIndex();
+	case InstructionType::I32Const: return a.asI32Constant() == b.asI32Constant();
+	case InstructionType::I64Const: return a.asI64Constant() == b.asI64Constant();
+	case InstructionType::F32Const: return a.asIF32Constant() == b.asIF32Constant();
+	case InstructionType::F64Const: return a.asIF64Constant() == b.asIF64Constant();
+	default: return true;
+	}
+}
+
+// Leaves the rest of the block unreachable
+static bool isBlockTerminator(const Instruction& ins)
+{
+	switch (ins.opCode()) {
+	case InstructionType::Unreachable:
+	case InstructionType::Branch:
+	case InstructionType::BranchTable:
+	case InstructionType::Return:
+	case InstructionType::ReturnCall:
+	case InstructionType::ReturnCallIndirect:
+	case InstructionType::ReturnCallReference:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FunctionOptimizer::optimize()
+{
+	auto& code = function.expression();
+	std::vector<Instruction> instructions{ code.begin(), code.end() };
+	numOriginalLocals = function.functionType().parameters().size() + function.localsCount();
+
+	for (u32 i = 0; i != MaxPasses; i++) {
+		auto hasChanged = runPeepholePass(instructions);
+		hasChanged |= removeDeadStores();
+		hasChanged |= hoistLoopInvariants();
+		hasChanged |= eliminateCommonSubexpressions();
+		instructions.swap(optimized);
+
+		if (!hasChanged) {
+			break;
+		}
+	}
+
+	removeUnusedTemporaries(instructions);
+	function.expression().replaceInstructions(instructions);
+}
+
+bool FunctionOptimizer::runPeepholePass(const std::vector<Instruction>& instructions)
+{
+	optimized.clear();
+	optimized.reserve(instructions.size());
+	resetKnownLocals(true);
+
+	bool hasChanged = false;
+	bool isUnreachable = false;
+	u32 unreachableNestingDepth = 0;
+	for (auto& ins : instructions) {
+		// Skip everything up to the end of the unreachable block, or its else-block
+		if (isUnreachable) {
+			switch (ins.opCode()) {
+			case InstructionType::Block:
+			case InstructionType::Loop:
+			case InstructionType::If:
+				unreachableNestingDepth++;
+				hasChanged = true;
+				continue;
+			case InstructionType::Else:
+			case InstructionType::End:
+				if (!unreachableNestingDepth) {
+					isUnreachable = false;
+					break;
+				}
+				if (ins == InstructionType::End) {
+					unreachableNestingDepth--;
+				}
+				hasChanged = true;
+				continue;
+			default:
+				hasChanged = true;
+				continue;
+			}
+		}
+
+		switch (ins.opCode()) {
+		case InstructionType::Loop:
+		case InstructionType::Else:
+		case InstructionType::End:
+			// Control flow merges with values from other paths
+			clearKnownLocals();
+			break;
+		case InstructionType::LocalGet:
+			if (tryRewriteLocalGet(ins)) {
+				hasChanged = true;
+				continue;
+			}
+			break;
+		case InstructionType::LocalSet:
+		case InstructionType::LocalTee:
+			trackLocalStore(ins);
+			break;
+		case InstructionType::Drop:
+			if (tryRewriteDrop()) {
+				hasChanged = true;
+				continue;
+			}
+			break;
+		default:
+			if (tryFoldUnary(ins) || tryFoldBinary(ins)) {
+				hasChanged = true;
+				continue;
+			}
+			break;
+		}
+
+		optimized.push_back(ins);
+
+		if (isBlockTerminator(ins)) {
+			isUnreachable = true;
+			unreachableNestingDepth = 0;
+		}
+	}
+
+	return hasChanged;
+}
+
+bool FunctionOptimizer::removeDeadStores()
+{
+	auto numLocals = function.functionType().parameters().size() + function.localsCount();
+	std::vector<bool> isRead(numLocals, false);
+	for (auto& ins : optimized) {
+		if (ins == InstructionType::LocalGet && ins.localIndex() < numLocals) {
+			isRead[ins.localIndex()] = true;
+		}
+	}
+
+	// Stores become drops, which are removed with their value by the next pass
+	bool hasChanged = false;
+	auto it = optimized.begin();
+	for (auto& ins : optimized) {
+		auto isDeadStore = (ins == InstructionType::LocalSet || ins == InstructionType::LocalTee)
+			&& ins.localIndex() < numLocals && !isRead[ins.localIndex()];
+
+		if (!isDeadStore) {
+			*(it++) = ins;
+			continue;
+		}
+
+		hasChanged = true;
+		if (ins == InstructionType::LocalSet) {
+			*(it++) = Instruction{ InstructionType::Drop };
+		}
+	}
+
+	optimized.erase(it, optimized.end());
+	return hasChanged;
+}
+
+/*
+* Eliminate common subexpressions
+* Finds pure expressions of local reads, constants and non-trapping numeric
+* operations that are repeated inside the same block, while none of the locals
+* they read is written in between. The first occurrence gets its value teed to
+* a new local, which replaces each repetition. Only the largest repetition is
+* replaced, if expressions are nested.
+*/
+bool FunctionOptimizer::eliminateCommonSubexpressions()
+{
+	struct StackValue {
+		u32 begin;
+		bool isPure;
+	};
+
+	struct Subexpression {
+		u32 begin;
+		u32 end;
+		ValType type;
+		u32 numRepetitions;
+		std::optional<u32> localIdx;
+	};
+
+	struct Repetition {
+		u32 begin;
+		u32 end;
+		u32 subexpressionIdx;
+	};
+
+	// Values on the stack are only tracked since the last instruction that is not pure
+	std::vector<StackValue> stack;
+	std::vector<Subexpression> subexpressions;
+	std::vector<u32> availableSubexpressions;
+	std::vector<Repetition> repetitions;
+
+	auto isSameSubexpression = [&](const Subexpression& sub, u32 begin, u32 end) {
+		if (sub.end - sub.begin != end - begin) {
+			return false;
+		}
+
+		for (u32 i = 0; i != end - begin; i++) {
+			if (!isSameInstruction(optimized[sub.begin + i], optimized[begin + i])) {
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	auto findOrAddSubexpression = [&](u32 begin, u32 end, ValType type) {
+		for (auto idx : availableSubexpressions) {
+			if (!isSameSubexpression(subexpressions[idx], begin, end)) {
+				continue;
+			}
+
+			// Nested repetitions are replaced together with the enclosing one
+			while (!repetitions.empty() && repetitions.back().begin >= begin) {
+				subexpressions[repetitions.back().subexpressionIdx].numRepetitions--;
+				repetitions.pop_back();
+			}
+
+			subexpressions[idx].numRepetitions++;
+			repetitions.push_back({ begin, end, idx });
+			return;
+		}
+
+		if (availableSubexpressions.size() < MaxAvailableSubexpressions) {
+			availableSubexpressions.push_back(subexpressions.size());
+			subexpressions.push_back({ begin, end, type, 0, std::nullopt });
+		}
+	};
+
+	auto removeSubexpressionsReadingLocal = [&](u32 localIdx) {
+		std::erase_if(availableSubexpressions, [&](u32 idx) {
+			auto& sub = subexpressions[idx];
+			for (u32 i = sub.begin; i != sub.end; i++) {
+				if (optimized[i] == InstructionType::LocalGet && optimized[i].localIndex() == localIdx) {
+					return true;
+				}
+			}
+			return false;
+		});
+	};
+
+	for (u32 i = 0; i != optimized.size(); i++) {
+		auto& ins = optimized[i];
+		if (ins == InstructionType::LocalGet || isNumericConstant(ins)) {
+			stack.push_back({ i, true });
+			continue;
+		}
+
+		if (isPureOperation(ins)) {
+			u32 numOperands = ins.opCode().isBinary() ? 2 : 1;
+			bool isPure = stack.size() >= numOperands;
+			u32 begin = i;
+			for (u32 j = 0; j != numOperands && !stack.empty(); j++) {
+				isPure &= stack.back().isPure;
+				begin = stack.back().begin;
+				stack.pop_back();
+			}
+
+			stack.push_back({ begin, isPure });
+
+			auto type = ins.opCode().resultType();
+			if (isPure && type.has_value() && i + 1 - begin >= MinSubexpressionLength) {
+				findOrAddSubexpression(begin, i + 1, *type);
+			}
+			continue;
+		}
+
+		stack.clear();
+
+		switch (ins.opCode()) {
+		case InstructionType::LocalSet:
+		case InstructionType::LocalTee:
+			removeSubexpressionsReadingLocal(ins.localIndex());
+			break;
+		case InstructionType::Block:
+		case InstructionType::Loop:
+		case InstructionType::If:
+		case InstructionType::Else:
+		case InstructionType::End:
+			availableSubexpressions.clear();
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (repetitions.empty()) {
+		return false;
+	}
+
+	auto usedTemporaries = findUsedTemporaries(optimized);
+	for (auto& sub : subexpressions) {
+		if (sub.numRepetitions > 0) {
+			sub.localIdx = allocateTemporary(sub.type, usedTemporaries);
+		}
+	}
+
+	// Subexpressions are ordered by their end, and repetitions by their beginning
+	std::vector<Instruction> rewritten;
+	rewritten.reserve(optimized.size() + subexpressions.size());
+	auto repetition = repetitions.begin();
+	auto subexpression = subexpressions.begin();
+	for (u32 i = 0; i != optimized.size();) {
+		if (repetition != repetitions.end() && repetition->begin == i) {
+			rewritten.emplace_back(InstructionType::LocalGet, *subexpressions[repetition->subexpressionIdx].localIdx);
+			i = repetition->end;
+			repetition++;
+		}
+		else {
+			rewritten.push_back(optimized[i++]);
+		}
+
+		for (; subexpression != subexpressions.end() && subexpression->end <= i; subexpression++) {
+			if (subexpression->localIdx.has_value()) {
+				assert(subexpression->end == i);
+				rewritten.emplace_back(InstructionType::LocalTee, *subexpression->localIdx);
+			}
+		}
+	}
+
+	optimized.swap(rewritten);
+	return true;
+}
+
+/*
+* Hoist loop invariants
+* Moves pure expressions out of loops, if none of the locals they read is
+* written anywhere inside the loop. Each expression is computed in front of the
+* outermost loop it does not depend on and stored to a temporary, which then
+* replaces it inside the loop. Equal expressions hoisted in front of the same
+* loop share their temporary. As the expressions cannot trap, it is safe to
+* compute them even if the loop never reaches them.
+*/
+bool FunctionOptimizer::hoistLoopInvariants()
+{
+	struct Loop {
+		u32 begin;
+		std::vector<bool> writtenLocals;
+	};
+
+	// Values are invariant in the open loop at this depth and all loops nested in it
+	struct StackValue {
+		u32 begin;
+		bool isPure;
+		u32 invariantDepth;
+	};
+
+	struct Invariant {
+		u32 begin;
+		u32 end;
+		u32 loopBegin;
+		ValType type;
+		u32 numOccurrences;
+		std::optional<u32> localIdx;
+	};
+
+	struct Occurrence {
+		u32 begin;
+		u32 end;
+		u32 invariantIdx;
+	};
+
+	// Find the locals written in each loop, including its nested blocks
+	auto numLocals = function.functionType().parameters().size() + function.localsCount();
+	std::vector<Loop> loops;
+	std::vector<std::optional<u32>> controlStack;
+	std::vector<u32> openLoops;
+	for (u32 i = 0; i != optimized.size(); i++) {
+		auto& ins = optimized[i];
+		switch (ins.opCode()) {
+		case InstructionType::Block:
+		case InstructionType::If:
+			controlStack.emplace_back();
+			break;
+		case InstructionType::Loop:
+			controlStack.emplace_back(loops.size());
+			openLoops.push_back(loops.size());
+			loops.push_back({ i, std::vector<bool>(numLocals, false) });
+			break;
+		case InstructionType::End:
+			if (!controlStack.empty()) {
+				if (controlStack.back().has_value()) {
+					openLoops.pop_back();
+				}
+				controlStack.pop_back();
+			}
+			break;
+		case InstructionType::LocalSet:
+		case InstructionType::LocalTee:
+			for (auto loopIdx : openLoops) {
+				loops[loopIdx].writtenLocals[ins.localIndex()] = true;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (loops.empty()) {
+		return false;
+	}
+
+	std::vector<StackValue> stack;
+	std::vector<Invariant> invariants;
+	std::vector<Occurrence> occurrences;
+
+	// Inner loops only write a subset of the locals written by the loops around them
+	auto invariantDepthOfLocal = [&](u32 localIdx) {
+		u32 depth = 0;
+		while (depth != openLoops.size() && loops[openLoops[depth]].writtenLocals[localIdx]) {
+			depth++;
+		}
+		return depth;
+	};
+
+	auto isSameExpression = [&](const Invariant& invariant, u32 begin, u32 end) {
+		if (invariant.end - invariant.begin != end - begin) {
+			return false;
+		}
+
+		for (u32 i = 0; i != end - begin; i++) {
+			if (!isSameInstruction(optimized[invariant.begin + i], optimized[begin + i])) {
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	auto addOccurrence = [&](u32 begin, u32 end, u32 loopBegin, ValType type) {
+		// Nested occurrences are hoisted together with the enclosing one
+		while (!occurrences.empty() && occurrences.back().begin >= begin) {
+			invariants[occurrences.back().invariantIdx].numOccurrences--;
+			occurrences.pop_back();
+		}
+
+		u32 invariantIdx = 0;
+		while (invariantIdx != invariants.size()) {
+			auto& invariant = invariants[invariantIdx];
+			if (invariant.loopBegin == loopBegin && isSameExpression(invariant, begin, end)) {
+				break;
+			}
+			invariantIdx++;
+		}
+
+		if (invariantIdx == invariants.size()) {
+			invariants.push_back({ begin, end, loopBegin, type, 0, std::nullopt });
+		}
+
+		invariants[invariantIdx].numOccurrences++;
+		occurrences.push_back({ begin, end, invariantIdx });
+	};
+
+	u32 numVisitedLoops = 0;
+	controlStack.clear();
+	openLoops.clear();
+	for (u32 i = 0; i != optimized.size(); i++) {
+		auto& ins = optimized[i];
+		if (ins == InstructionType::LocalGet) {
+			stack.push_back({ i, true, invariantDepthOfLocal(ins.localIndex()) });
+			continue;
+		}
+
+		if (isNumericConstant(ins)) {
+			stack.push_back({ i, true, 0 });
+			continue;
+		}
+
+		if (isPureOperation(ins)) {
+			u32 numOperands = ins.opCode().isBinary() ? 2 : 1;
+			StackValue value{ i, stack.size() >= numOperands, 0 };
+			for (u32 j = 0; j != numOperands && !stack.empty(); j++) {
+				value.isPure &= stack.back().isPure;
+				value.begin = stack.back().begin;
+				value.invariantDepth = std::max(value.invariantDepth, stack.back().invariantDepth);
+				stack.pop_back();
+			}
+
+			stack.push_back(value);
+
+			auto type = ins.opCode().resultType();
+			auto isInvariant = value.invariantDepth < openLoops.size();
+			if (value.isPure && isInvariant && type.has_value() && i + 1 - value.begin >= MinSubexpressionLength) {
+				addOccurrence(value.begin, i + 1, loops[openLoops[value.invariantDepth]].begin, *type);
+			}
+			continue;
+		}
+
+		stack.clear();
+
+		switch (ins.opCode()) {
+		case InstructionType::Block:
+		case InstructionType::If:
+			controlStack.emplace_back();
+			break;
+		case InstructionType::Loop:
+			controlStack.emplace_back(numVisitedLoops);
+			openLoops.push_back(numVisitedLoops++);
+			break;
+		case InstructionType::End:
+			if (!controlStack.empty()) {
+				if (controlStack.back().has_value()) {
+					openLoops.pop_back();
+				}
+				controlStack.pop_back();
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (occurrences.empty()) {
+		return false;
+	}
+
+	auto usedTemporaries = findUsedTemporaries(optimized);
+	for (auto& invariant : invariants) {
+		if (invariant.numOccurrences > 0) {
+			invariant.localIdx = allocateTemporary(invariant.type, usedTemporaries);
+		}
+	}
+
+	// Occurrences are ordered by their beginning
+	std::vector<Instruction> rewritten;
+	rewritten.reserve(optimized.size() + 2 * invariants.size());
+	auto occurrence = occurrences.begin();
+	for (u32 i = 0; i != optimized.size();) {
+		if (optimized[i] == InstructionType::Loop) {
+			for (auto& invariant : invariants) {
+				if (invariant.loopBegin == i && invariant.localIdx.has_value()) {
+					rewritten.insert(rewritten.end(), optimized.begin() + invariant.begin, optimized.begin() + invariant.end);
+					rewritten.emplace_back(InstructionType::LocalSet, *invariant.localIdx);
+				}
+			}
+		}
+
+		if (occurrence != occurrences.end() && occurrence->begin == i) {
+			rewritten.emplace_back(InstructionType::LocalGet, *invariants[occurrence->invariantIdx].localIdx);
+			i = occurrence->end;
+			occurrence++;
+		}
+		else {
+			rewritten.push_back(optimized[i++]);
+		}
+	}
+
+	optimized.swap(rewritten);
+	return true;
+}
+
+// Temporaries are the locals appended by the optimizer
+std::vector<bool> FunctionOptimizer::findUsedTemporaries(const std::vector<Instruction>& instructions) const
+{
+	auto numLocals = function.functionType().parameters().size() + function.localsCount();
+	std::vector<bool> isUsed(numLocals - numOriginalLocals, false);
+	for (auto& ins : instructions) {
+		auto isLocalAccess = ins == InstructionType::LocalGet || ins == InstructionType::LocalSet || ins == InstructionType::LocalTee;
+		if (isLocalAccess && ins.localIndex() >= numOriginalLocals) {
+			isUsed[ins.localIndex() - numOriginalLocals] = true;
+		}
+	}
+
+	return isUsed;
+}
+
+// Hands out a temporary of the type that is not used yet, or appends a new one
+u32 FunctionOptimizer::allocateTemporary(ValType type, std::vector<bool>& usedTemporaries)
+{
+	for (u32 i = 0; i != usedTemporaries.size(); i++) {
+		if (!usedTemporaries[i] && function.localOrParameterByIndex(numOriginalLocals + i)->type == type) {
+			usedTemporaries[i] = true;
+			return numOriginalLocals + i;
+		}
+	}
+
+	usedTemporaries.push_back(true);
+	return function.appendLocal(type);
+}
+
+void FunctionOptimizer::removeUnusedTemporaries(std::vector<Instruction>& instructions)
+{
+	auto usedTemporaries = findUsedTemporaries(instructions);
+	if (std::find(usedTemporaries.begin(), usedTemporaries.end(), false) == usedTemporaries.end()) {
+		return;
+	}
+
+	// Append the used temporaries again in their order, which moves them down to fill the gaps
+	std::vector<ValType> types;
+	for (u32 i = 0; i != usedTemporaries.size(); i++) {
+		types.push_back(function.localOrParameterByIndex(numOriginalLocals + i)->type);
+	}
+
+	function.removeLocalsFrom(numOriginalLocals);
+
+	std::vector<u32> newIndices(usedTemporaries.size(), 0);
+	for (u32 i = 0; i != usedTemporaries.size(); i++) {
+		if (usedTemporaries[i]) {
+			newIndices[i] = function.appendLocal(types[i]);
+		}
+	}
+
+	for (auto& ins : instructions) {
+		auto isLocalAccess = ins == InstructionType::LocalGet || ins == InstructionType::LocalSet || ins == InstructionType::LocalTee;
+		if (isLocalAccess && ins.localIndex() >= numOriginalLocals) {
+			ins = Instruction{ ins.opCode(), newIndices[ins.localIndex() - numOriginalLocals] };
+		}
+	}
+}
+
+void FunctionOptimizer::resetKnownLocals(bool isFunctionEntry)
+{
+	auto numParameters = function.functionType().parameters().size();
+	auto numLocals = numParameters + function.localsCount();
+	knownLocalConstants.assign(numLocals, std::nullopt);
+
+	if (!isFunctionEntry) {
+		return;
+	}
+
+	// Locals start as zero, other than the parameters
+	for (u32 i = numParameters; i != numLocals; i++) {
+		auto local = function.localOrParameterByIndex(i);
+		assert(local.has_value());
+		switch (local->type) {
+		case ValType::I32: knownLocalConstants[i] = i32Constant(0); break;
+		case ValType::I64: knownLocalConstants[i] = i64Constant(0); break;
+		case ValType::F32: knownLocalConstants[i] = Instruction{ InstructionType::F32Const, Instruction::Constant{ 0.0f } }; break;
+		case ValType::F64: knownLocalConstants[i] = Instruction{ InstructionType::F64Const, Instruction::Constant{ 0.0 } }; break;
+		default: break;
+		}
+	}
+}
+
+void FunctionOptimizer::clearKnownLocals()
+{
+	resetKnownLocals(false);
+}
+
+bool FunctionOptimizer::tryRewriteLocalGet(Instruction ins)
+{
+	auto localIdx = ins.localIndex();
+	if (optimized.empty() || localIdx >= knownLocalConstants.size()) {
+		return false;
+	}
+
+	// Storing and then loading the same local is a tee
+	auto& previous = optimized.back();
+	if (previous == InstructionType::LocalSet && previous.localIndex() == localIdx) {
+		previous = Instruction{ InstructionType::LocalTee, localIdx };
+		return true;
+	}
+
+	auto& constant = knownLocalConstants[localIdx];
+	if (!constant.has_value()) {
+		return false;
+	}
+
+	optimized.push_back(*constant);
+	return true;
+}
+
+void FunctionOptimizer::trackLocalStore(Instruction ins)
+{
+	auto localIdx = ins.localIndex();
+	if (localIdx >= knownLocalConstants.size()) {
+		return;
+	}
+
+	auto& constant = knownLocalConstants[localIdx];
+	if (!optimized.empty() && isNumericConstant(optimized.back())) {
+		constant = optimized.back();
+	}
+	else {
+		constant.reset();
+	}
+}
+
+bool FunctionOptimizer::tryRewriteDrop()
+{
+	if (optimized.empty()) {
+		return false;
+	}
+
+	auto& previous = optimized.back();
+	if (isPureProducer(previous)) {
+		optimized.pop_back();
+		return true;
+	}
+
+	if (previous == InstructionType::LocalTee) {
+		previous = Instruction{ InstructionType::LocalSet, previous.localIndex() };
+		return true;
+	}
+
+	return false;
+}
+
+bool FunctionOptimizer::tryFoldUnary(Instruction ins)
+{
+	if (optimized.empty()) {
+		return false;
+	}
+
+	auto& operand = optimized.back();
+	auto isI32 = operand == InstructionType::I32Const;
+	auto isI64 = operand == InstructionType::I64Const;
+	if (!isI32 && !isI64) {
+		return false;
+	}
+
+	u32 a32 = isI32 ? operand.asI32Constant() : 0;
+	u64 a64 = isI64 ? operand.asI64Constant() : 0;
+
+	std::optional<Instruction> result;
+	using IT = InstructionType;
+	switch (ins.opCode()) {
+	case IT::I32EqualZero: if (isI32) result = i32Constant(a32 == 0); break;
+	case IT::I32CountLeadingZeros: if (isI32) result = i32Constant(std::countl_zero(a32)); break;
+	case IT::I32CountTrailingZeros: if (isI32) result = i32Constant(std::countr_zero(a32)); break;
+	case IT::I32CountOnes: if (isI32) result = i32Constant(std::popcount(a32)); break;
+	case IT::I32Extend8s: if (isI32) result = i32Constant((i32)(i8)a32); break;
+	case IT::I32Extend16s: if (isI32) result = i32Constant((i32)(i16)a32); break;
+	case IT::I64ExtendI32S: if (isI32) result = i64Constant((i64)(i32)a32); break;
+	case IT::I64ExtendI32U: if (isI32) result = i64Constant((u64)a32); break;
+	case IT::I64EqualZero: if (isI64) result = i32Constant(a64 == 0); break;
+	case IT::I64CountLeadingZeros: if (isI64) result = i64Constant(std::countl_zero(a64)); break;
+	case IT::I64CountTrailingZeros: if (isI64) result = i64Constant(std::countr_zero(a64)); break;
+	case IT::I64CountOnes: if (isI64) result = i64Constant(std::popcount(a64)); break;
+	case IT::I64Extend8s: if (isI64) result = i64Constant((i64)(i8)a64); break;
+	case IT::I64Extend16s: if (isI64) result = i64Constant((i64)(i16)a64); break;
+	case IT::I64Extend32s: if (isI64) result = i64Constant((i64)(i32)a64); break;
+	case IT::I32WrapI64: if (isI64) result = i32Constant((u32)a64); break;
+	default: break;
+	}
+
+	if (!result.has_value()) {
+		return false;
+	}
+
+	operand = *result;
+	return true;
+}
+
+bool FunctionOptimizer::tryFoldBinary(Instruction ins)
+{
+	// Both operands have to be the last two constants, where the second one is on top
+	if (optimized.size() < 2) {
+		return false;
+	}
+
+	auto& first = *(optimized.end() - 2);
+	auto& second = optimized.back();
+	auto isI32 = first == InstructionType::I32Const && second == InstructionType::I32Const;
+	auto isI64 = first == InstructionType::I64Const && second == InstructionType::I64Const;
+	if (!isI32 && !isI64) {
+		return false;
+	}
+
+	// Divisions and remainders are left alone, as they might trap
+	std::optional<Instruction> result;
+	using IT = InstructionType;
+	if (isI32) {
+		u32 a = first.asI32Constant();
+		u32 b = second.asI32Constant();
+		switch (ins.opCode()) {
+		case IT::I32Add: result = i32Constant(a + b); break;
+		case IT::I32Subtract: result = i32Constant(a - b); break;
+		case IT::I32Multiply: result = i32Constant(a * b); break;
+		case IT::I32And: result = i32Constant(a & b); break;
+		case IT::I32Or: result = i32Constant(a | b); break;
+		case IT::I32Xor: result = i32Constant(a ^ b); break;
+		case IT::I32ShiftLeft: result = i32Constant(a << (b % 32)); break;
+		case IT::I32ShiftRightS: result = i32Constant((i32)a >> (b % 32)); break;
+		case IT::I32ShiftRightU: result = i32Constant(a >> (b % 32)); break;
+		case IT::I32RotateLeft: result = i32Constant(std::rotl(a, b % 32)); break;
+		case IT::I32RotateRight: result = i32Constant(std::rotr(a, b % 32)); break;
+		case IT::I32Equal: result = i32Constant(a == b); break;
+		case IT::I32NotEqual: result = i32Constant(a != b); break;
+		case IT::I32LesserS: result = i32Constant((i32)a < (i32)b); break;
+		case IT::I32LesserU: result = i32Constant(a < b); break;
+		case IT::I32GreaterS: result = i32Constant((i32)a > (i32)b); break;
+		case IT::I32GreaterU: result = i32Constant(a > b); break;
+		case IT::I32LesserEqualS: result = i32Constant((i32)a <= (i32)b); break;
+		case IT::I32LesserEqualU: result = i32Constant(a <= b); break;
+		case IT::I32GreaterEqualS: result = i32Constant((i32)a >= (i32)b); break;
+		case IT::I32GreaterEqualU: result = i32Constant(a >= b); break;
+		default: break;
+		}
+	}
+	else {
+		u64 a = first.asI64Constant();
+		u64 b = second.asI64Constant();
+		switch (ins.opCode()) {
+		case IT::I64Add: result = i64Constant(a + b); break;
+		case IT::I64Subtract: result = i64Constant(a - b); break;
+		case IT::I64Multiply: result = i64Constant(a * b); break;
+		case IT::I64And: result = i64Constant(a & b); break;
+		case IT::I64Or: result = i64Constant(a | b); break;
+		case IT::I64Xor: result = i64Constant(a ^ b); break;
+		case IT::I64ShiftLeft: result = i64Constant(a << (b % 64)); break;
+		case IT::I64ShiftRightS: result = i64Constant((i64)a >> (b % 64)); break;
+		case IT::I64ShiftRightU: result = i64Constant(a >> (b % 64)); break;
+		case IT::I64RotateLeft: result = i64Constant(std::rotl(a, (i32)(b % 64))); break;
+		case IT::I64RotateRight: result = i64Constant(std::rotr(a, (i32)(b % 64))); break;
+		case IT::I64Equal: result = i32Constant(a == b); break;
+		case IT::I64NotEqual: result = i32Constant(a != b); break;
+		case IT::I64LesserS: result = i32Constant((i64)a < (i64)b); break;
+		case IT::I64LesserU: result = i32Constant(a < b); break;
+		case IT::I64GreaterS: result = i32Constant((i64)a > (i64)b); break;
+		case IT::I64GreaterU: result = i32Constant(a > b); break;
+		case IT::I64LesserEqualS: result = i32Constant((i64)a <= (i64)b); break;
+		case IT::I64LesserEqualU: result = i32Constant(a <= b); break;
+		case IT::I64GreaterEqualS: result = i32Constant((i64)a >= (i64)b); break;
+		case IT::I64GreaterEqualU: result = i32Constant(a >= b); break;
+		default: break;
+		}
+	}
+
+	if (!result.has_value()) {
+		return false;
+	}
+
+	optimized.pop_back();
+	optimized.back() = *result;
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "util.h"
+#include "forward.h"
+#include "instruction.h"
+
+namespace WASM {
+	/*
+	* Function Optimizer class
+	* Rewrites the instructions of a hot function before it gets compiled. Each
+	* pass runs over the instructions once and tracks which locals hold known
+	* constants until the next merge of control flow. It propagates and folds
+	* constants, turns stores followed by loads into tees, drops pure values that
+	* are never used, removes stores to locals that are never read and skips the
+	* unreachable code behind branches. Pure expressions that are repeated inside
+	* a block are computed once and kept in a temporary local, the same is done
+	* in front of loops for pure expressions that do not change inside. Passes are
+	* repeated as long as they find anything to rewrite, as each one may enable
+	* further rewrites. Temporaries that are no longer read are reused by later
+	* passes and removed in the end.
+	*/
+	class FunctionOptimizer {
+	public:
+		FunctionOptimizer(BytecodeFunction& f) : function{ f } {}
+
+		void optimize();
+
+	private:
+		static constexpr u32 MaxPasses = 4;
+
+		// Shorter expressions are not worth the additional local
+		static constexpr u32 MinSubexpressionLength = 3;
+		static constexpr u32 MaxAvailableSubexpressions = 32;
+
+		bool runPeepholePass(const std::vector<Instruction>&);
+		bool removeDeadStores();
+		bool eliminateCommonSubexpressions();
+		bool hoistLoopInvariants();
+		std::vector<bool> findUsedTemporaries(const std::vector<Instruction>&) const;
+		u32 allocateTemporary(ValType, std::vector<bool>&);
+		void removeUnusedTemporaries(std::vector<Instruction>&);
+		void resetKnownLocals(bool);
+		void clearKnownLocals();
+
+		bool tryRewriteLocalGet(Instruction);
+		void trackLocalStore(Instruction);
+		bool tryRewriteDrop();
+		bool tryFoldUnary(Instruction);
+		bool tryFoldBinary(Instruction);
+
+		BytecodeFunction& function;
+		u32 numOriginalLocals{ 0 };
+		std::vector<Instruction> optimized;
+		std::vector<std::optional<Instruction>> knownLocalConstants;
+	};
+}
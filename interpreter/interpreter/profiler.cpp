@@ -0,0 +1,332 @@
+#include <cassert>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "profiler.h"
+#include "module.h"
+
+using namespace WASM;
+
+static std::string functionName(const BytecodeFunction& function, const Module& module)
+{
+	auto name = function.lookupName(module);
+	if (name.has_value()) {
+		return std::string{ name->begin(), name->end() };
+	}
+
+	std::stringstream stream;
+	stream << "function[" << function.moduleIndex() << ']';
+	return stream.str();
+}
+
+static std::string qualifiedFunctionName(const BytecodeFunction& function, const Module& module)
+{
+	std::string name{ module.name() };
+	name += ':';
+	name += functionName(function, module);
+	return name;
+}
+
+SamplingProfiler::SamplingProfiler(std::chrono::microseconds interval)
+	: mInterval{ interval }
+{
+	if (mInterval.count() <= 0) {
+		throw std::runtime_error{ "Profiler sampling interval has to be positive" };
+	}
+
+	mTimerThread = std::jthread{ [this](std::stop_token stopToken) {
+		// Sleep until absolute points in time, so that late wakeups are caught up
+		// with instead of accumulating drift
+		auto nextTick = std::chrono::steady_clock::now() + mInterval;
+		while (!stopToken.stop_requested()) {
+			std::this_thread::sleep_until(nextTick);
+			mPendingSamples.fetch_add(1, std::memory_order_relaxed);
+			nextTick += mInterval;
+		}
+	} };
+}
+
+void SamplingProfiler::reset()
+{
+	mSampleCount = 0;
+	mRecordCount = 0;
+	mFunctionStats.clear();
+	mCollapsedStacks.clear();
+}
+
+void SamplingProfiler::recordSample(u32 numSamples)
+{
+	// The sample stack is ordered from the current function to the outermost one
+	if (mSampleStack.empty()) {
+		return;
+	}
+
+	mSampleCount += numSamples;
+	mRecordCount++;
+
+	bool isTopFrame = true;
+	for (auto& frame : mSampleStack) {
+		auto result = mFunctionStats.try_emplace(frame.function.pointer(), FunctionStats{ frame.module });
+		auto& stats = result.first->second;
+
+		if (isTopFrame) {
+			stats.selfSamples += numSamples;
+			isTopFrame = false;
+		}
+
+		// Recursive functions only count once per sample towards their total time
+		if (stats.lastRecordIndex != mRecordCount) {
+			stats.totalSamples += numSamples;
+			stats.lastRecordIndex = mRecordCount;
+		}
+	}
+
+	std::vector<const BytecodeFunction*> collapsedStack;
+	collapsedStack.reserve(mSampleStack.size());
+	for (auto it = mSampleStack.rbegin(); it != mSampleStack.rend(); it++) {
+		collapsedStack.emplace_back(it->function.pointer());
+	}
+
+	mCollapsedStacks[std::move(collapsedStack)] += numSamples;
+}
+
+double SamplingProfiler::samplesToMilliseconds(u64 numSamples) const
+{
+	return std::chrono::duration<double, std::milli>{ mInterval * numSamples }.count();
+}
+
+void SamplingProfiler::printReport(std::ostream& out) const
+{
+	using std::setw, std::fixed, std::setprecision;
+
+	out << "Profile: " << mSampleCount << " samples at " << mInterval.count() << "us intervals ("
+		<< samplesToMilliseconds(mSampleCount) << "ms)" << std::endl;
+
+	if (!mSampleCount) {
+		return;
+	}
+
+	// Sort the functions by their self time, using their total time as tie breaker
+	std::vector<std::pair<const BytecodeFunction*, const FunctionStats*>> functions;
+	functions.reserve(mFunctionStats.size());
+	for (auto& entry : mFunctionStats) {
+		functions.emplace_back(entry.first, &entry.second);
+	}
+
+	std::sort(functions.begin(), functions.end(), [](auto& a, auto& b) {
+		if (a.second->selfSamples != b.second->selfSamples) {
+			return a.second->selfSamples > b.second->selfSamples;
+		}
+		return a.second->totalSamples > b.second->totalSamples;
+	});
+
+	auto percentage = [&](u64 numSamples) {
+		return 100.0 * (double)numSamples / (double)mSampleCount;
+	};
+
+	auto oldFlags = out.flags();
+	auto oldPrecision = out.precision();
+
+	out << "      Self                 Total           Function" << std::endl;
+	out << fixed << setprecision(1);
+	for (auto& [function, stats] : functions) {
+		out << setw(6) << percentage(stats->selfSamples) << "% " << setw(10) << samplesToMilliseconds(stats->selfSamples) << "ms  "
+			<< setw(6) << percentage(stats->totalSamples) << "% " << setw(10) << samplesToMilliseconds(stats->totalSamples) << "ms  "
+			<< qualifiedFunctionName(*function, *stats->module) << std::endl;
+	}
+	out.flags(oldFlags);
+	out.precision(oldPrecision);
+}
+
+void SamplingProfiler::printCollapsedStacks(std::ostream& out) const
+{
+	// One line per unique stack from the outermost function to the innermost one
+	// followed by its sample count, as expected by flame graph tools
+	for (auto& [stack, numSamples] : mCollapsedStacks) {
+		bool isFirst = true;
+		for (auto function : stack) {
+			if (!isFirst) {
+				out << ';';
+			}
+			isFirst = false;
+
+			auto& stats = mFunctionStats.at(function);
+			out << qualifiedFunctionName(*function, *stats.module);
+		}
+
+		out << ' ' << numSamples << '\n';
+	}
+
+	out << std::flush;
+}
+
+static std::vector<std::pair<u32, u64>> sortedPairCounts(const std::unordered_map<u32, u64>& pairs)
+{
+	// Most frequent pairs first
+	std::vector<std::pair<u32, u64>> sortedPairs{ pairs.begin(), pairs.end() };
+	std::sort(sortedPairs.begin(), sortedPairs.end(), [](auto& a, auto& b) {
+		if (a.second != b.second) {
+			return a.second > b.second;
+		}
+		return a.first < b.first;
+	});
+
+	return sortedPairs;
+}
+
+u64 BytecodeCounter::totalCount() const
+{
+	u64 count = 0;
+	for (auto& entry : mFunctionCounts) {
+		for (auto bytecodeCount : entry.second.bytecodes) {
+			count += bytecodeCount;
+		}
+	}
+
+	return count;
+}
+
+u64 BytecodeCounter::functionCount(std::string_view moduleName, ModuleFunctionIndex functionIndex) const
+{
+	// Functions are looked up by name and index, as they may belong to another interpreter
+	u64 count = 0;
+	for (auto& entry : mFunctionCounts) {
+		auto& counts = entry.second;
+		if (counts.module->name() != moduleName || counts.function->moduleIndex() != functionIndex) {
+			continue;
+		}
+
+		for (auto bytecodeCount : counts.bytecodes) {
+			count += bytecodeCount;
+		}
+	}
+
+	return count;
+}
+
+BytecodeCounter::FunctionCounts& BytecodeCounter::countsForFunction(const BytecodeFunction& function, const Module& module)
+{
+	auto result = mFunctionCounts.try_emplace(&function, FunctionCounts{ function, module });
+	return result.first->second;
+}
+
+std::vector<const BytecodeCounter::FunctionCounts*> BytecodeCounter::sortedFunctionCounts() const
+{
+	// Order by module and function index to get a stable output
+	std::vector<const FunctionCounts*> functions;
+	functions.reserve(mFunctionCounts.size());
+	for (auto& entry : mFunctionCounts) {
+		functions.emplace_back(&entry.second);
+	}
+
+	std::sort(functions.begin(), functions.end(), [](auto* a, auto* b) {
+		if (a->module != b->module) {
+			return a->module->name() < b->module->name();
+		}
+		return a->function->moduleIndex().value < b->function->moduleIndex().value;
+	});
+
+	return functions;
+}
+
+void BytecodeCounter::exportJSON(std::ostream& out) const
+{
+	auto printString = [&](std::string_view string) {
+		out << '"';
+		for (auto c : string) {
+			if (c == '"' || c == '\\') {
+				out << '\\' << c;
+			}
+			else if ((u8)c < 0x20) {
+				out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (u32)c << std::dec << std::setfill(' ');
+			}
+			else {
+				out << c;
+			}
+		}
+		out << '"';
+	};
+
+	out << "{\n  \"functions\": [";
+
+	bool isFirstFunction = true;
+	for (auto counts : sortedFunctionCounts()) {
+		out << (isFirstFunction ? "\n" : ",\n") << "    {\n      \"module\": ";
+		isFirstFunction = false;
+
+		printString(counts->module->name());
+		out << ",\n      \"function\": ";
+		printString(functionName(*counts->function, *counts->module));
+		out << ",\n      \"index\": " << counts->function->moduleIndex().value << ",\n      \"bytecodes\": {";
+
+		bool isFirstItem = true;
+		for (u32 i = 0; i != counts->bytecodes.size(); i++) {
+			if (counts->bytecodes[i]) {
+				out << (isFirstItem ? " " : ", ");
+				isFirstItem = false;
+				printString(Bytecode::fromInt(i).name());
+				out << ": " << counts->bytecodes[i];
+			}
+		}
+
+		out << " },\n      \"pairs\": [";
+
+		isFirstItem = true;
+		for (auto& [pair, count] : sortedPairCounts(counts->pairs)) {
+			out << (isFirstItem ? "\n" : ",\n") << "        { \"first\": ";
+			isFirstItem = false;
+			printString(Bytecode::fromInt(pair / Bytecode::NumberOfItems).name());
+			out << ", \"second\": ";
+			printString(Bytecode::fromInt(pair % Bytecode::NumberOfItems).name());
+			out << ", \"count\": " << count << " }";
+		}
+
+		out << (isFirstItem ? "]\n    }" : "\n      ]\n    }");
+	}
+
+	out << (isFirstFunction ? "]\n}" : "\n  ]\n}") << std::endl;
+}
+
+void BytecodeCounter::exportCSV(std::ostream& out) const
+{
+	// Single bytecodes leave the second column empty
+	auto printString = [&](std::string_view string) {
+		out << '"';
+		for (auto c : string) {
+			if (c == '"') {
+				out << '"';
+			}
+			out << c;
+		}
+		out << '"';
+	};
+
+	out << "module,function,index,first,second,count\n";
+
+	for (auto counts : sortedFunctionCounts()) {
+		auto name = functionName(*counts->function, *counts->module);
+		auto printPrefix = [&]() {
+			printString(counts->module->name());
+			out << ',';
+			printString(name);
+			out << ',' << counts->function->moduleIndex().value << ',';
+		};
+
+		for (u32 i = 0; i != counts->bytecodes.size(); i++) {
+			if (counts->bytecodes[i]) {
+				printPrefix();
+				out << Bytecode::fromInt(i).name() << ",," << counts->bytecodes[i] << '\n';
+			}
+		}
+
+		for (auto& [pair, count] : sortedPairCounts(counts->pairs)) {
+			printPrefix();
+			out << Bytecode::fromInt(pair / Bytecode::NumberOfItems).name() << ','
+				<< Bytecode::fromInt(pair % Bytecode::NumberOfItems).name() << ',' << count << '\n';
+		}
+	}
+
+	out << std::flush;
+}
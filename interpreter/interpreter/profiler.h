@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "util.h"
+#include "forward.h"
+#include "indices.h"
+#include "nullable.h"
+#include "bytecode.h"
+
+namespace WASM {
+	/*
+	* Sampling Profiler class
+	* Samples the call stack of the interpreter in fixed time intervals. A
+	* timer thread counts the elapsed intervals, which the interpreter only
+	* picks up at jumps, calls and returns, where it records its current call
+	* stack for them. Time spent between two of these points is therefore
+	* charged to the function that polls next. The samples are aggregated into
+	* self and total time per function and into collapsed stacks that can be
+	* turned into flame graphs. Time spent in host functions is attributed to
+	* the calling function.
+	*/
+	class SamplingProfiler {
+	public:
+		SamplingProfiler(std::chrono::microseconds = std::chrono::milliseconds{ 1 });
+		SamplingProfiler(const SamplingProfiler&) = delete;
+		SamplingProfiler(SamplingProfiler&&) = delete;
+
+		std::chrono::microseconds interval() const { return mInterval; }
+		u64 sampleCount() const { return mSampleCount; }
+
+		void reset();
+		void printReport(std::ostream&) const;
+		void printCollapsedStacks(std::ostream&) const;
+
+	private:
+		friend class Interpreter;
+
+		struct Frame {
+			NonNull<const BytecodeFunction> function;
+			NonNull<const Module> module;
+		};
+
+		struct FunctionStats {
+			NonNull<const Module> module;
+			u64 selfSamples{ 0 };
+			u64 totalSamples{ 0 };
+			u64 lastRecordIndex{ 0 };
+		};
+
+		__forceinline u32 takePendingSamples() {
+			if (!mPendingSamples.load(std::memory_order_relaxed)) {
+				return 0;
+			}
+			return mPendingSamples.exchange(0, std::memory_order_relaxed);
+		}
+
+		void discardPendingSamples() { mPendingSamples.store(0, std::memory_order_relaxed); }
+		void recordSample(u32);
+		double samplesToMilliseconds(u64) const;
+
+		std::chrono::microseconds mInterval;
+		u64 mSampleCount{ 0 };
+		u64 mRecordCount{ 0 };
+		std::vector<Frame> mSampleStack;
+		std::unordered_map<const BytecodeFunction*, FunctionStats> mFunctionStats;
+		std::map<std::vector<const BytecodeFunction*>, u64> mCollapsedStacks;
+
+		std::atomic<u32> mPendingSamples{ 0 };
+
+		// Declared last, so that the thread is stopped before anything else is destroyed
+		std::jthread mTimerThread;
+	};
+
+	/*
+	* Bytecode Counter class
+	* Counts how often each bytecode and each pair of consecutive bytecodes
+	* is executed per function. Attaching a counter makes the interpreter run
+	* an instrumented variant of its loop. Pairs are only counted between
+	* bytecodes that follow each other in the same function without a call or
+	* return in between. The counts can be exported as JSON or CSV, or be used
+	* by the optimizer of another interpreter to find the hot functions.
+	*/
+	class BytecodeCounter {
+	public:
+		u64 totalCount() const;
+		u64 functionCount(std::string_view, ModuleFunctionIndex) const;
+
+		void reset() { mFunctionCounts.clear(); }
+		void exportJSON(std::ostream&) const;
+		void exportCSV(std::ostream&) const;
+
+	private:
+		friend class Interpreter;
+
+		static constexpr u32 NoBytecode = Bytecode::NumberOfItems;
+
+		struct FunctionCounts {
+			NonNull<const BytecodeFunction> function;
+			NonNull<const Module> module;
+			std::array<u64, Bytecode::NumberOfItems> bytecodes{};
+			std::unordered_map<u32, u64> pairs;
+			u32 previousBytecode{ NoBytecode };
+
+			__forceinline void count(u8 bytecode) {
+				bytecodes[bytecode]++;
+				if (previousBytecode != NoBytecode) {
+					pairs[previousBytecode * Bytecode::NumberOfItems + bytecode]++;
+				}
+				previousBytecode = bytecode;
+			}
+		};
+
+		FunctionCounts& countsForFunction(const BytecodeFunction&, const Module&);
+		std::vector<const FunctionCounts*> sortedFunctionCounts() const;
+
+		std::unordered_map<const BytecodeFunction*, FunctionCounts> mFunctionCounts;
+	};
+}
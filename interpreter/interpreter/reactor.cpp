@@ -0,0 +1,201 @@
+#if defined(__linux__)
+
+#include <array>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "reactor.h"
+
+using namespace WASM;
+
+static bool wouldBlock(i32 result)
+{
+	return result == -EAGAIN || result == -EWOULDBLOCK;
+}
+
+static void setNonBlocking(int fileDescriptor)
+{
+	auto flags = fcntl(fileDescriptor, F_GETFL);
+	if (flags < 0) {
+		throw std::runtime_error{ "Invalid file descriptor" };
+	}
+
+	if (!(flags & O_NONBLOCK) && fcntl(fileDescriptor, F_SETFL, flags | O_NONBLOCK) < 0) {
+		throw std::runtime_error{ "Could not make file descriptor non-blocking" };
+	}
+}
+
+Reactor::Reactor(Interpreter& i)
+	: interpreter{ i }
+{
+	epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+	if (epollDescriptor < 0) {
+		throw std::runtime_error{ "Could not create epoll instance" };
+	}
+}
+
+Reactor::~Reactor()
+{
+	close(epollDescriptor);
+}
+
+HostResult<i32> Reactor::read(int fileDescriptor, HostMemory& memory, u32 address, u32 length)
+{
+	return startOperation({ fileDescriptor, false, memory, address, length });
+}
+
+HostResult<i32> Reactor::write(int fileDescriptor, HostMemory& memory, u32 address, u32 length)
+{
+	return startOperation({ fileDescriptor, true, memory, address, length });
+}
+
+static i32 performOperation(int fileDescriptor, bool isWrite, HostMemory& memory, u32 address, u32 length)
+{
+	// Memory can be grown while the guest waits, so the buffer is looked up just in time.
+	// As memory never shrinks, the bounds checked when the operation started still hold
+	auto buffer = memory.memoryView<u8>().data() + address;
+	auto result = isWrite ? ::write(fileDescriptor, buffer, length) : ::read(fileDescriptor, buffer, length);
+	return result < 0 ? -errno : (i32)result;
+}
+
+HostResult<i32> Reactor::startOperation(Operation operation)
+{
+	if ((u64)operation.address + operation.length > operation.memory->memoryView<u8>().size()) {
+		throw std::runtime_error{ "Out of bounds memory access" };
+	}
+
+	setNonBlocking(operation.fileDescriptor);
+
+	// Complete right away if possible, otherwise the guest is suspended and waits for
+	// the descriptor once the interpreter returns its call
+	auto result = performOperation(operation.fileDescriptor, operation.isWrite, *operation.memory, operation.address, operation.length);
+	if (!wouldBlock(result)) {
+		return result;
+	}
+
+	pendingOperation.emplace(operation);
+	return HostResult<i32>::pending();
+}
+
+void Reactor::handleResult(ResumableResult result, ResultCallback onResult)
+{
+	if (auto values = std::get_if<ValuePack>(&result)) {
+		if (onResult) {
+			onResult(*values);
+		}
+		return;
+	}
+
+	if (!pendingOperation.has_value()) {
+		throw std::runtime_error{ "Guest was suspended without a pending reactor operation" };
+	}
+
+	auto operation = *pendingOperation;
+	pendingOperation.reset();
+
+	auto guest = std::make_unique<Guest>(Guest{ std::move(std::get<SuspendedCall>(result)), operation, std::move(onResult) });
+	auto& descriptor = descriptors[operation.fileDescriptor];
+	auto& waitingGuests = operation.isWrite ? descriptor.writers : descriptor.readers;
+	waitingGuests.emplace_back(std::move(guest));
+	numSuspendedGuests++;
+
+	updateRegisteredEvents(operation.fileDescriptor);
+}
+
+void Reactor::run()
+{
+	// Runs until all guests have finished. Traps in resumed guests are thrown from here
+	std::array<epoll_event, 64> events;
+	while (numSuspendedGuests) {
+		auto numEvents = epoll_wait(epollDescriptor, events.data(), (int)events.size(), -1);
+		if (numEvents < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error{ "Could not wait for reactor events" };
+		}
+
+		for (int i = 0; i != numEvents; i++) {
+			dispatchEvents(events[i].data.fd, events[i].events);
+		}
+	}
+}
+
+void Reactor::dispatchEvents(int fileDescriptor, u32 events)
+{
+	auto it = descriptors.find(fileDescriptor);
+	if (it == descriptors.end()) {
+		return;
+	}
+
+	// Errors and hangups are reported to the guests by their failing operations. The
+	// descriptor stays in the map while guests are resumed, as it still has waiting guests
+	auto& descriptor = it->second;
+	if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+		completeOperations(descriptor.readers);
+	}
+
+	if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+		completeOperations(descriptor.writers);
+	}
+
+	updateRegisteredEvents(fileDescriptor);
+}
+
+void Reactor::completeOperations(std::deque<std::unique_ptr<Guest>>& waitingGuests)
+{
+	// Guests that wait on the same descriptor again are queued at the back and only served
+	// with the next event, so that a busy descriptor cannot stall the loop
+	for (auto numGuests = waitingGuests.size(); numGuests && !waitingGuests.empty(); numGuests--) {
+		auto& operation = waitingGuests.front()->operation;
+		auto result = performOperation(operation.fileDescriptor, operation.isWrite, *operation.memory, operation.address, operation.length);
+		if (wouldBlock(result)) {
+			return;
+		}
+
+		auto guest = std::move(waitingGuests.front());
+		waitingGuests.pop_front();
+		numSuspendedGuests--;
+
+		std::array<Value, 1> results{ Value::fromType<i32>(result) };
+		pendingOperation.reset();
+		handleResult(interpreter.resumeFunction(std::move(guest->call), results), std::move(guest->onResult));
+	}
+}
+
+void Reactor::updateRegisteredEvents(int fileDescriptor)
+{
+	// Descriptors are only registered with epoll while guests wait for them
+	auto it = descriptors.find(fileDescriptor);
+	auto& descriptor = it->second;
+
+	u32 events = (descriptor.readers.empty() ? 0 : EPOLLIN) | (descriptor.writers.empty() ? 0 : EPOLLOUT);
+	if (events == descriptor.registeredEvents) {
+		if (!events) {
+			descriptors.erase(it);
+		}
+		return;
+	}
+
+	epoll_event event{};
+	event.events = events;
+	event.data.fd = fileDescriptor;
+
+	auto operation = !descriptor.registeredEvents ? EPOLL_CTL_ADD : events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+	if (epoll_ctl(epollDescriptor, operation, fileDescriptor, &event) < 0) {
+		throw std::runtime_error{ "Could not register file descriptor with reactor" };
+	}
+
+	if (!events) {
+		descriptors.erase(it);
+		return;
+	}
+
+	descriptor.registeredEvents = events;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+#include "interpreter.h"
+
+namespace WASM {
+	/*
+	* Reactor class
+	* Event loop based on epoll that runs many I/O bound guests on a single
+	* interpreter and thread. Host functions forward guest reads and writes to
+	* the reactor, which performs them right away if the file descriptor is
+	* ready and otherwise suspends the guest until epoll reports it as ready.
+	* Data is transfered directly from and to the guest memory. Results are
+	* the number of transfered bytes or a negated errno value. Registered file
+	* descriptors are switched to non-blocking mode.
+	*/
+	class Reactor {
+	public:
+		using ResultCallback = std::function<void(const ValuePack&)>;
+
+		Reactor(Interpreter&);
+		Reactor(const Reactor&) = delete;
+		Reactor(Reactor&&) = delete;
+		~Reactor();
+
+		template<typename ...Args>
+		void spawn(const FunctionHandle& handle, ResultCallback onResult, Args... args) {
+			pendingOperation.reset();
+			handleResult(interpreter.runResumableFunction(handle, args...), std::move(onResult));
+		}
+
+		HostResult<i32> read(int, HostMemory&, u32, u32);
+		HostResult<i32> write(int, HostMemory&, u32, u32);
+
+		u32 suspendedGuestCount() const { return numSuspendedGuests; }
+		void run();
+
+	private:
+		struct Operation {
+			int fileDescriptor;
+			bool isWrite;
+			NonNull<HostMemory> memory;
+			u32 address;
+			u32 length;
+		};
+
+		struct Guest {
+			SuspendedCall call;
+			Operation operation;
+			ResultCallback onResult;
+		};
+
+		struct Descriptor {
+			std::deque<std::unique_ptr<Guest>> readers;
+			std::deque<std::unique_ptr<Guest>> writers;
+			u32 registeredEvents{ 0 };
+		};
+
+		HostResult<i32> startOperation(Operation);
+		void handleResult(ResumableResult, ResultCallback);
+		void dispatchEvents(int, u32);
+		void completeOperations(std::deque<std::unique_ptr<Guest>>&);
+		void updateRegisteredEvents(int);
+
+		Interpreter& interpreter;
+		int epollDescriptor{ -1 };
+		u32 numSuspendedGuests{ 0 };
+		std::optional<Operation> pendingOperation;
+		std::unordered_map<int, Descriptor> descriptors;
+	};
+}
+
+#endif
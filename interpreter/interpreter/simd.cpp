@@ -0,0 +1,916 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define WASM_VECTOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define WASM_VECTOR_SSE41
+#include <smmintrin.h>
+#endif
+
+#include "simd.h"
+
+using namespace WASM;
+
+// Vector as it is stored in four stack slots or in memory. Lanes are accessed
+// with memcpy, as neither of them is guaranteed to be 16 byte aligned
+struct VectorValue {
+	u8 bytes[16];
+
+	template<typename T>
+	T lane(u32 idx) const {
+		T value;
+		std::memcpy(&value, bytes + idx * sizeof(T), sizeof(T));
+		return value;
+	}
+
+	template<typename T>
+	void setLane(u32 idx, T value) {
+		std::memcpy(bytes + idx * sizeof(T), &value, sizeof(T));
+	}
+};
+
+template<typename T>
+static constexpr u32 numLanes = 16 / sizeof(T);
+
+// Integer type with the size of a lane, used for comparison masks
+template<typename T>
+using LaneBits = std::conditional_t<sizeof(T) == 1, u8, std::conditional_t<sizeof(T) == 2, u16, std::conditional_t<sizeof(T) == 4, u32, u64>>>;
+
+static VectorValue popVector(u32*& stackPointer)
+{
+	stackPointer -= 4;
+	VectorValue value;
+	std::memcpy(value.bytes, stackPointer, 16);
+	return value;
+}
+
+static void pushVector(u32*& stackPointer, const VectorValue& value)
+{
+	std::memcpy(stackPointer, value.bytes, 16);
+	stackPointer += 4;
+}
+
+// Aligned stacks put 32bit scalars into full 8 byte slots
+template<typename T, bool AlignedStack>
+static T popScalar(u32*& stackPointer)
+{
+	stackPointer -= stackSlotsOf<T, AlignedStack>;
+	T value;
+	std::memcpy(&value, stackPointer, sizeof(T));
+	return value;
+}
+
+template<typename T, bool AlignedStack>
+static void pushScalar(u32*& stackPointer, T value)
+{
+	std::memcpy(stackPointer, &value, sizeof(T));
+	stackPointer += stackSlotsOf<T, AlignedStack>;
+}
+
+template<MemoryBoundsMode::TEnum Mode, typename T>
+static T loadFromMemory(Memory* memory, u64 address)
+{
+	assert(memory);
+	T value;
+	std::memcpy(&value, memory->pointer<Mode, T>(address), sizeof(T));
+	return value;
+}
+
+template<MemoryBoundsMode::TEnum Mode, typename T>
+static void storeToMemory(Memory* memory, u64 address, T value)
+{
+	assert(memory);
+	std::memcpy(memory->pointer<Mode, T>(address), &value, sizeof(T));
+}
+
+template<typename T>
+static VectorValue splatLanes(T value)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<T>; i++) {
+		result.setLane<T>(i, value);
+	}
+	return result;
+}
+
+template<typename T, typename F>
+static VectorValue mapLanes(const VectorValue& a, F function)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<T>; i++) {
+		result.setLane<T>(i, (T)function(a.lane<T>(i)));
+	}
+	return result;
+}
+
+template<typename T, typename F>
+static VectorValue zipLanes(const VectorValue& a, const VectorValue& b, F function)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<T>; i++) {
+		result.setLane<T>(i, (T)function(a.lane<T>(i), b.lane<T>(i)));
+	}
+	return result;
+}
+
+template<typename T, typename F>
+static VectorValue compareLanes(const VectorValue& a, const VectorValue& b, F function)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<T>; i++) {
+		result.setLane<LaneBits<T>>(i, function(a.lane<T>(i), b.lane<T>(i)) ? (LaneBits<T>)~0ull : 0);
+	}
+	return result;
+}
+
+template<typename T>
+static VectorValue shiftLanes(const VectorValue& a, u32 count, bool isLeft)
+{
+	// Shift counts wrap around at the lane width
+	count %= sizeof(T) * 8;
+	return mapLanes<T>(a, [&](T x) { return isLeft ? (T)(x << count) : (T)(x >> count); });
+}
+
+template<typename From, typename To>
+static VectorValue extendLanes(const VectorValue& a, u32 firstLane)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<To>; i++) {
+		result.setLane<To>(i, (To)a.lane<From>(firstLane + i));
+	}
+	return result;
+}
+
+template<typename From, typename To>
+static VectorValue extendMultiplyLanes(const VectorValue& a, const VectorValue& b, u32 firstLane)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<To>; i++) {
+		result.setLane<To>(i, (To)a.lane<From>(firstLane + i) * (To)b.lane<From>(firstLane + i));
+	}
+	return result;
+}
+
+template<typename From, typename To>
+static VectorValue extendAddPairwiseLanes(const VectorValue& a)
+{
+	VectorValue result;
+	for (u32 i = 0; i != numLanes<To>; i++) {
+		result.setLane<To>(i, (To)a.lane<From>(2 * i) + (To)a.lane<From>(2 * i + 1));
+	}
+	return result;
+}
+
+template<typename T, typename U>
+static T saturate(U value)
+{
+	if (value < (U)std::numeric_limits<T>::min()) {
+		return std::numeric_limits<T>::min();
+	}
+	if (value > (U)std::numeric_limits<T>::max()) {
+		return std::numeric_limits<T>::max();
+	}
+	return (T)value;
+}
+
+template<typename From, typename To>
+static VectorValue narrowLanes(const VectorValue& a, const VectorValue& b)
+{
+	// The lanes of the first vector end up in the lower half of the result
+	VectorValue result;
+	constexpr u32 numSourceLanes = numLanes<From>;
+	for (u32 i = 0; i != numSourceLanes; i++) {
+		result.setLane<To>(i, saturate<To>(a.lane<From>(i)));
+		result.setLane<To>(i + numSourceLanes, saturate<To>(b.lane<From>(i)));
+	}
+	return result;
+}
+
+template<typename T>
+static u32 bitmaskOfLanes(const VectorValue& a)
+{
+	u32 mask = 0;
+	for (u32 i = 0; i != numLanes<T>; i++) {
+		mask |= (a.lane<T>(i) < 0 ? 1u : 0u) << i;
+	}
+	return mask;
+}
+
+template<typename T>
+static bool allLanesTrue(const VectorValue& a)
+{
+	for (u32 i = 0; i != numLanes<T>; i++) {
+		if (!a.lane<T>(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename T>
+static T absoluteWrapping(T x)
+{
+	// The smallest value is its own absolute value
+	using U = std::make_unsigned_t<T>;
+	return x < 0 ? (T)(U)(0 - (U)x) : x;
+}
+
+template<typename T>
+static T floatMinimum(T a, T b)
+{
+	// Propagate NaNs and order negative zero below positive zero
+	if (std::isnan(a) || std::isnan(b)) {
+		return std::numeric_limits<T>::quiet_NaN();
+	}
+	if (a == b) {
+		return std::signbit(a) ? a : b;
+	}
+	return a < b ? a : b;
+}
+
+template<typename T>
+static T floatMaximum(T a, T b)
+{
+	if (std::isnan(a) || std::isnan(b)) {
+		return std::numeric_limits<T>::quiet_NaN();
+	}
+	if (a == b) {
+		return std::signbit(a) ? b : a;
+	}
+	return a > b ? a : b;
+}
+
+template<typename U, typename T>
+static U truncateSaturate(T x)
+{
+	if (std::isnan(x)) {
+		return 0;
+	}
+
+	// The lower limit and the value above the upper limit are powers of two and exact
+	if (x <= (T)std::numeric_limits<U>::min()) {
+		return std::numeric_limits<U>::min();
+	}
+
+	constexpr T upperLimit = (T)std::numeric_limits<U>::max() + (T)1;
+	if (x >= upperLimit) {
+		return std::numeric_limits<U>::max();
+	}
+
+	return (U)x;
+}
+
+template<MemoryBoundsMode::TEnum Mode, typename From, typename To>
+static void loadExtended(u32*& stackPointer, Memory* memory, u64 address)
+{
+	VectorValue value{};
+	value.setLane<u64>(0, loadFromMemory<Mode, u64>(memory, address));
+	pushVector(stackPointer, extendLanes<From, To>(value, 0));
+}
+
+template<MemoryBoundsMode::TEnum Mode, typename T>
+static void loadZeroExtended(u32*& stackPointer, Memory* memory, u64 address)
+{
+	VectorValue value{};
+	value.setLane<T>(0, loadFromMemory<Mode, T>(memory, address));
+	pushVector(stackPointer, value);
+}
+
+// Lane memory operations pop the vector before the address, and the lane index
+// follows the memory offset in the operands
+template<MemoryBoundsMode::TEnum Mode, typename T, bool AlignedStack>
+static const u8* loadLane(const u8* instructionPointer, u32*& stackPointer, Memory* memory)
+{
+	auto value = popVector(stackPointer);
+	u32 offset;
+	std::memcpy(&offset, instructionPointer, 4);
+	auto address = (u64)offset + popScalar<u32, AlignedStack>(stackPointer);
+	value.setLane<T>(instructionPointer[4], loadFromMemory<Mode, T>(memory, address));
+	pushVector(stackPointer, value);
+	return instructionPointer + 5;
+}
+
+template<MemoryBoundsMode::TEnum Mode, typename T, bool AlignedStack>
+static const u8* storeLane(const u8* instructionPointer, u32*& stackPointer, Memory* memory)
+{
+	auto value = popVector(stackPointer);
+	u32 offset;
+	std::memcpy(&offset, instructionPointer, 4);
+	auto address = (u64)offset + popScalar<u32, AlignedStack>(stackPointer);
+	storeToMemory<Mode, T>(memory, address, value.lane<T>(instructionPointer[4]));
+	return instructionPointer + 5;
+}
+
+template<typename T, typename U, bool AlignedStack>
+static void extractLane(u32*& stackPointer, u32 lane)
+{
+	pushScalar<U, AlignedStack>(stackPointer, (U)popVector(stackPointer).lane<T>(lane));
+}
+
+template<typename T, typename U, bool AlignedStack>
+static void replaceLane(u32*& stackPointer, u32 lane)
+{
+	auto scalar = popScalar<U, AlignedStack>(stackPointer);
+	auto value = popVector(stackPointer);
+	value.setLane<T>(lane, (T)scalar);
+	pushVector(stackPointer, value);
+}
+
+#ifdef WASM_VECTOR_SSE2
+// Kernels for operations that map to a few SSE instructions. Returns false if there
+// is no kernel for the operation, so that it is computed lane by lane instead
+template<bool AlignedStack>
+static bool executeVectorOperationWithSSE(VectorOperation operation, u32*& stackPointer)
+{
+	auto load = [](const u32* pointer) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pointer)); };
+	auto store = [](u32* pointer, __m128i value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(pointer), value); };
+
+	auto unary = [&](auto kernel) {
+		store(stackPointer - 4, kernel(load(stackPointer - 4)));
+		return true;
+	};
+
+	auto binary = [&](auto kernel) {
+		stackPointer -= 4;
+		store(stackPointer - 4, kernel(load(stackPointer - 4), load(stackPointer)));
+		return true;
+	};
+
+	auto binaryF32 = [&](auto kernel) {
+		return binary([&](__m128i a, __m128i b) { return _mm_castps_si128(kernel(_mm_castsi128_ps(a), _mm_castsi128_ps(b))); });
+	};
+
+	auto binaryF64 = [&](auto kernel) {
+		return binary([&](__m128i a, __m128i b) { return _mm_castpd_si128(kernel(_mm_castsi128_pd(a), _mm_castsi128_pd(b))); });
+	};
+
+	auto shift = [&](u32 laneBits, auto kernel) {
+		auto count = _mm_cvtsi32_si128((int)(popScalar<u32, AlignedStack>(stackPointer) % laneBits));
+		return unary([&](__m128i a) { return kernel(a, count); });
+	};
+
+	auto allOnes = _mm_set1_epi32(-1);
+
+	using VO = VectorOperation;
+	switch (operation) {
+	case VO::V128Not: return unary([&](__m128i a) { return _mm_xor_si128(a, allOnes); });
+	case VO::V128And: return binary([](__m128i a, __m128i b) { return _mm_and_si128(a, b); });
+	case VO::V128AndNot: return binary([](__m128i a, __m128i b) { return _mm_andnot_si128(b, a); });
+	case VO::V128Or: return binary([](__m128i a, __m128i b) { return _mm_or_si128(a, b); });
+	case VO::V128Xor: return binary([](__m128i a, __m128i b) { return _mm_xor_si128(a, b); });
+	case VO::V128BitSelect: {
+		stackPointer -= 8;
+		auto a = load(stackPointer - 4);
+		auto b = load(stackPointer);
+		auto mask = load(stackPointer + 4);
+		store(stackPointer - 4, _mm_or_si128(_mm_and_si128(a, mask), _mm_andnot_si128(mask, b)));
+		return true;
+	}
+
+	case VO::I8x16Equal: return binary([](__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); });
+	case VO::I8x16NotEqual: return binary([&](__m128i a, __m128i b) { return _mm_xor_si128(_mm_cmpeq_epi8(a, b), allOnes); });
+	case VO::I8x16LesserS: return binary([](__m128i a, __m128i b) { return _mm_cmplt_epi8(a, b); });
+	case VO::I8x16GreaterS: return binary([](__m128i a, __m128i b) { return _mm_cmpgt_epi8(a, b); });
+	case VO::I16x8Equal: return binary([](__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); });
+	case VO::I16x8NotEqual: return binary([&](__m128i a, __m128i b) { return _mm_xor_si128(_mm_cmpeq_epi16(a, b), allOnes); });
+	case VO::I16x8LesserS: return binary([](__m128i a, __m128i b) { return _mm_cmplt_epi16(a, b); });
+	case VO::I16x8GreaterS: return binary([](__m128i a, __m128i b) { return _mm_cmpgt_epi16(a, b); });
+	case VO::I32x4Equal: return binary([](__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); });
+	case VO::I32x4NotEqual: return binary([&](__m128i a, __m128i b) { return _mm_xor_si128(_mm_cmpeq_epi32(a, b), allOnes); });
+	case VO::I32x4LesserS: return binary([](__m128i a, __m128i b) { return _mm_cmplt_epi32(a, b); });
+	case VO::I32x4GreaterS: return binary([](__m128i a, __m128i b) { return _mm_cmpgt_epi32(a, b); });
+
+	case VO::I8x16Add: return binary([](__m128i a, __m128i b) { return _mm_add_epi8(a, b); });
+	case VO::I8x16Subtract: return binary([](__m128i a, __m128i b) { return _mm_sub_epi8(a, b); });
+	case VO::I8x16AddSaturateS: return binary([](__m128i a, __m128i b) { return _mm_adds_epi8(a, b); });
+	case VO::I8x16AddSaturateU: return binary([](__m128i a, __m128i b) { return _mm_adds_epu8(a, b); });
+	case VO::I8x16SubtractSaturateS: return binary([](__m128i a, __m128i b) { return _mm_subs_epi8(a, b); });
+	case VO::I8x16SubtractSaturateU: return binary([](__m128i a, __m128i b) { return _mm_subs_epu8(a, b); });
+	case VO::I8x16MinimumU: return binary([](__m128i a, __m128i b) { return _mm_min_epu8(a, b); });
+	case VO::I8x16MaximumU: return binary([](__m128i a, __m128i b) { return _mm_max_epu8(a, b); });
+	case VO::I8x16AverageU: return binary([](__m128i a, __m128i b) { return _mm_avg_epu8(a, b); });
+	case VO::I8x16NarrowI16x8S: return binary([](__m128i a, __m128i b) { return _mm_packs_epi16(a, b); });
+	case VO::I8x16NarrowI16x8U: return binary([](__m128i a, __m128i b) { return _mm_packus_epi16(a, b); });
+
+	case VO::I16x8Add: return binary([](__m128i a, __m128i b) { return _mm_add_epi16(a, b); });
+	case VO::I16x8Subtract: return binary([](__m128i a, __m128i b) { return _mm_sub_epi16(a, b); });
+	case VO::I16x8Multiply: return binary([](__m128i a, __m128i b) { return _mm_mullo_epi16(a, b); });
+	case VO::I16x8AddSaturateS: return binary([](__m128i a, __m128i b) { return _mm_adds_epi16(a, b); });
+	case VO::I16x8AddSaturateU: return binary([](__m128i a, __m128i b) { return _mm_adds_epu16(a, b); });
+	case VO::I16x8SubtractSaturateS: return binary([](__m128i a, __m128i b) { return _mm_subs_epi16(a, b); });
+	case VO::I16x8SubtractSaturateU: return binary([](__m128i a, __m128i b) { return _mm_subs_epu16(a, b); });
+	case VO::I16x8MinimumS: return binary([](__m128i a, __m128i b) { return _mm_min_epi16(a, b); });
+	case VO::I16x8MaximumS: return binary([](__m128i a, __m128i b) { return _mm_max_epi16(a, b); });
+	case VO::I16x8AverageU: return binary([](__m128i a, __m128i b) { return _mm_avg_epu16(a, b); });
+	case VO::I16x8NarrowI32x4S: return binary([](__m128i a, __m128i b) { return _mm_packs_epi32(a, b); });
+	case VO::I16x8ShiftLeft: return shift(16, [](__m128i a, __m128i count) { return _mm_sll_epi16(a, count); });
+	case VO::I16x8ShiftRightS: return shift(16, [](__m128i a, __m128i count) { return _mm_sra_epi16(a, count); });
+	case VO::I16x8ShiftRightU: return shift(16, [](__m128i a, __m128i count) { return _mm_srl_epi16(a, count); });
+
+	case VO::I32x4Add: return binary([](__m128i a, __m128i b) { return _mm_add_epi32(a, b); });
+	case VO::I32x4Subtract: return binary([](__m128i a, __m128i b) { return _mm_sub_epi32(a, b); });
+	case VO::I32x4DotI16x8S: return binary([](__m128i a, __m128i b) { return _mm_madd_epi16(a, b); });
+	case VO::I32x4ShiftLeft: return shift(32, [](__m128i a, __m128i count) { return _mm_sll_epi32(a, count); });
+	case VO::I32x4ShiftRightS: return shift(32, [](__m128i a, __m128i count) { return _mm_sra_epi32(a, count); });
+	case VO::I32x4ShiftRightU: return shift(32, [](__m128i a, __m128i count) { return _mm_srl_epi32(a, count); });
+
+	case VO::I64x2Add: return binary([](__m128i a, __m128i b) { return _mm_add_epi64(a, b); });
+	case VO::I64x2Subtract: return binary([](__m128i a, __m128i b) { return _mm_sub_epi64(a, b); });
+	case VO::I64x2ShiftLeft: return shift(64, [](__m128i a, __m128i count) { return _mm_sll_epi64(a, count); });
+	case VO::I64x2ShiftRightU: return shift(64, [](__m128i a, __m128i count) { return _mm_srl_epi64(a, count); });
+
+	case VO::F32x4Equal: return binaryF32([](__m128 a, __m128 b) { return _mm_cmpeq_ps(a, b); });
+	case VO::F32x4NotEqual: return binaryF32([](__m128 a, __m128 b) { return _mm_cmpneq_ps(a, b); });
+	case VO::F32x4Lesser: return binaryF32([](__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); });
+	case VO::F32x4Greater: return binaryF32([](__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); });
+	case VO::F32x4LesserEqual: return binaryF32([](__m128 a, __m128 b) { return _mm_cmple_ps(a, b); });
+	case VO::F32x4GreaterEqual: return binaryF32([](__m128 a, __m128 b) { return _mm_cmpge_ps(a, b); });
+	case VO::F32x4Add: return binaryF32([](__m128 a, __m128 b) { return _mm_add_ps(a, b); });
+	case VO::F32x4Subtract: return binaryF32([](__m128 a, __m128 b) { return _mm_sub_ps(a, b); });
+	case VO::F32x4Multiply: return binaryF32([](__m128 a, __m128 b) { return _mm_mul_ps(a, b); });
+	case VO::F32x4Divide: return binaryF32([](__m128 a, __m128 b) { return _mm_div_ps(a, b); });
+	// The pseudo variants are defined as b < a ? b : a, which is exactly what SSE computes
+	case VO::F32x4PseudoMinimum: return binaryF32([](__m128 a, __m128 b) { return _mm_min_ps(b, a); });
+	case VO::F32x4PseudoMaximum: return binaryF32([](__m128 a, __m128 b) { return _mm_max_ps(b, a); });
+	case VO::F32x4SquareRoot: return unary([](__m128i a) { return _mm_castps_si128(_mm_sqrt_ps(_mm_castsi128_ps(a))); });
+	case VO::F32x4Absolute: return unary([](__m128i a) { return _mm_and_si128(a, _mm_set1_epi32(0x7FFFFFFF)); });
+	case VO::F32x4Negate: return unary([](__m128i a) { return _mm_xor_si128(a, _mm_set1_epi32((int)0x80000000)); });
+	case VO::F32x4ConvertI32x4S: return unary([](__m128i a) { return _mm_castps_si128(_mm_cvtepi32_ps(a)); });
+
+	case VO::F64x2Equal: return binaryF64([](__m128d a, __m128d b) { return _mm_cmpeq_pd(a, b); });
+	case VO::F64x2NotEqual: return binaryF64([](__m128d a, __m128d b) { return _mm_cmpneq_pd(a, b); });
+	case VO::F64x2Lesser: return binaryF64([](__m128d a, __m128d b) { return _mm_cmplt_pd(a, b); });
+	case VO::F64x2Greater: return binaryF64([](__m128d a, __m128d b) { return _mm_cmpgt_pd(a, b); });
+	case VO::F64x2LesserEqual: return binaryF64([](__m128d a, __m128d b) { return _mm_cmple_pd(a, b); });
+	case VO::F64x2GreaterEqual: return binaryF64([](__m128d a, __m128d b) { return _mm_cmpge_pd(a, b); });
+	case VO::F64x2Add: return binaryF64([](__m128d a, __m128d b) { return _mm_add_pd(a, b); });
+	case VO::F64x2Subtract: return binaryF64([](__m128d a, __m128d b) { return _mm_sub_pd(a, b); });
+	case VO::F64x2Multiply: return binaryF64([](__m128d a, __m128d b) { return _mm_mul_pd(a, b); });
+	case VO::F64x2Divide: return binaryF64([](__m128d a, __m128d b) { return _mm_div_pd(a, b); });
+	case VO::F64x2PseudoMinimum: return binaryF64([](__m128d a, __m128d b) { return _mm_min_pd(b, a); });
+	case VO::F64x2PseudoMaximum: return binaryF64([](__m128d a, __m128d b) { return _mm_max_pd(b, a); });
+	case VO::F64x2SquareRoot: return unary([](__m128i a) { return _mm_castpd_si128(_mm_sqrt_pd(_mm_castsi128_pd(a))); });
+	case VO::F64x2Absolute: return unary([](__m128i a) { return _mm_and_si128(a, _mm_set1_epi64x(0x7FFFFFFFFFFFFFFF)); });
+	case VO::F64x2Negate: return unary([](__m128i a) { return _mm_xor_si128(a, _mm_set1_epi64x((i64)0x8000000000000000)); });
+	case VO::F64x2ConvertLowI32x4S: return unary([](__m128i a) { return _mm_castpd_si128(_mm_cvtepi32_pd(a)); });
+
+#ifdef WASM_VECTOR_SSE41
+	case VO::I8x16Swizzle:
+		// Indices above 15 get their high bit set by the saturating add, which zeroes the lane
+		return binary([](__m128i a, __m128i b) { return _mm_shuffle_epi8(a, _mm_adds_epu8(b, _mm_set1_epi8(0x70))); });
+	case VO::I8x16MinimumS: return binary([](__m128i a, __m128i b) { return _mm_min_epi8(a, b); });
+	case VO::I8x16MaximumS: return binary([](__m128i a, __m128i b) { return _mm_max_epi8(a, b); });
+	case VO::I16x8MinimumU: return binary([](__m128i a, __m128i b) { return _mm_min_epu16(a, b); });
+	case VO::I16x8MaximumU: return binary([](__m128i a, __m128i b) { return _mm_max_epu16(a, b); });
+	case VO::I16x8NarrowI32x4U: return binary([](__m128i a, __m128i b) { return _mm_packus_epi32(a, b); });
+	case VO::I16x8ExtendLowI8x16S: return unary([](__m128i a) { return _mm_cvtepi8_epi16(a); });
+	case VO::I16x8ExtendLowI8x16U: return unary([](__m128i a) { return _mm_cvtepu8_epi16(a); });
+	case VO::I32x4Multiply: return binary([](__m128i a, __m128i b) { return _mm_mullo_epi32(a, b); });
+	case VO::I32x4MinimumS: return binary([](__m128i a, __m128i b) { return _mm_min_epi32(a, b); });
+	case VO::I32x4MinimumU: return binary([](__m128i a, __m128i b) { return _mm_min_epu32(a, b); });
+	case VO::I32x4MaximumS: return binary([](__m128i a, __m128i b) { return _mm_max_epi32(a, b); });
+	case VO::I32x4MaximumU: return binary([](__m128i a, __m128i b) { return _mm_max_epu32(a, b); });
+	case VO::I32x4ExtendLowI16x8S: return unary([](__m128i a) { return _mm_cvtepi16_epi32(a); });
+	case VO::I32x4ExtendLowI16x8U: return unary([](__m128i a) { return _mm_cvtepu16_epi32(a); });
+	case VO::I64x2Equal: return binary([](__m128i a, __m128i b) { return _mm_cmpeq_epi64(a, b); });
+	case VO::I64x2ExtendLowI32x4S: return unary([](__m128i a) { return _mm_cvtepi32_epi64(a); });
+	case VO::I64x2ExtendLowI32x4U: return unary([](__m128i a) { return _mm_cvtepu32_epi64(a); });
+	case VO::F32x4Ceil: return unary([](__m128i a) { return _mm_castps_si128(_mm_round_ps(_mm_castsi128_ps(a), _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC)); });
+	case VO::F32x4Floor: return unary([](__m128i a) { return _mm_castps_si128(_mm_round_ps(_mm_castsi128_ps(a), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)); });
+	case VO::F32x4Truncate: return unary([](__m128i a) { return _mm_castps_si128(_mm_round_ps(_mm_castsi128_ps(a), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)); });
+	case VO::F32x4Nearest: return unary([](__m128i a) { return _mm_castps_si128(_mm_round_ps(_mm_castsi128_ps(a), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); });
+	case VO::F64x2Ceil: return unary([](__m128i a) { return _mm_castpd_si128(_mm_round_pd(_mm_castsi128_pd(a), _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC)); });
+	case VO::F64x2Floor: return unary([](__m128i a) { return _mm_castpd_si128(_mm_round_pd(_mm_castsi128_pd(a), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)); });
+	case VO::F64x2Truncate: return unary([](__m128i a) { return _mm_castpd_si128(_mm_round_pd(_mm_castsi128_pd(a), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)); });
+	case VO::F64x2Nearest: return unary([](__m128i a) { return _mm_castpd_si128(_mm_round_pd(_mm_castsi128_pd(a), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); });
+#endif
+
+	default:
+		return false;
+	}
+}
+#endif
+
+template<MemoryBoundsMode::TEnum Mode, bool AlignedOperands>
+const u8* WASM::executeVectorOperation(const u8* instructionPointer, u32*& stackPointer, Memory* memory)
+{
+	auto operation = VectorOperation::fromInt(*(instructionPointer++));
+
+#ifdef WASM_VECTOR_SSE2
+	if (executeVectorOperationWithSSE<AlignedOperands>(operation, stackPointer)) {
+		return instructionPointer;
+	}
+#endif
+
+	// Aligned bytecode pads the offset operands to four bytes
+	auto skipOperandPadding = [&]() {
+		if constexpr (AlignedOperands) {
+			instructionPointer = alignPointerUp(instructionPointer, 4);
+		}
+	};
+
+	auto loadOperandU32 = [&]() {
+		skipOperandPadding();
+		u32 operand;
+		std::memcpy(&operand, instructionPointer, 4);
+		instructionPointer += 4;
+		return operand;
+	};
+
+	auto loadOperandU8 = [&]() {
+		return *(instructionPointer++);
+	};
+
+	// Address of a memory access made up of the static offset and the dynamic address
+	auto popAddress = [&]() -> u64 {
+		auto offset = loadOperandU32();
+		return (u64)offset + popScalar<u32, AlignedOperands>(stackPointer);
+	};
+
+	auto unary = [&](auto function) {
+		pushVector(stackPointer, function(popVector(stackPointer)));
+	};
+
+	auto binary = [&](auto function) {
+		auto b = popVector(stackPointer);
+		auto a = popVector(stackPointer);
+		pushVector(stackPointer, function(a, b));
+	};
+
+	auto shift = [&](auto function) {
+		auto count = popScalar<u32, AlignedOperands>(stackPointer);
+		pushVector(stackPointer, function(popVector(stackPointer), count));
+	};
+
+	auto test = [&](auto function) {
+		pushScalar<u32, AlignedOperands>(stackPointer, function(popVector(stackPointer)));
+	};
+
+	using VO = VectorOperation;
+	switch (operation) {
+	case VO::LocalGet: {
+		auto distance = loadOperandU32();
+		std::memmove(stackPointer, stackPointer - distance, 16);
+		stackPointer += 4;
+		break;
+	}
+	case VO::LocalSet: {
+		auto distance = loadOperandU32();
+		stackPointer -= 4;
+		std::memmove(stackPointer - distance, stackPointer, 16);
+		break;
+	}
+	case VO::LocalTee: {
+		auto distance = loadOperandU32();
+		std::memmove(stackPointer - distance, stackPointer - 4, 16);
+		break;
+	}
+	case VO::Select: {
+		auto condition = popScalar<u32, AlignedOperands>(stackPointer);
+		auto b = popVector(stackPointer);
+		auto a = popVector(stackPointer);
+		pushVector(stackPointer, condition ? a : b);
+		break;
+	}
+
+	case VO::V128Load: pushVector(stackPointer, loadFromMemory<Mode, VectorValue>(memory, popAddress())); break;
+	case VO::V128Load8x8S: loadExtended<Mode, i8, i16>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load8x8U: loadExtended<Mode, u8, u16>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load16x4S: loadExtended<Mode, i16, i32>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load16x4U: loadExtended<Mode, u16, u32>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load32x2S: loadExtended<Mode, i32, i64>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load32x2U: loadExtended<Mode, u32, u64>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load8Splat: pushVector(stackPointer, splatLanes(loadFromMemory<Mode, u8>(memory, popAddress()))); break;
+	case VO::V128Load16Splat: pushVector(stackPointer, splatLanes(loadFromMemory<Mode, u16>(memory, popAddress()))); break;
+	case VO::V128Load32Splat: pushVector(stackPointer, splatLanes(loadFromMemory<Mode, u32>(memory, popAddress()))); break;
+	case VO::V128Load64Splat: pushVector(stackPointer, splatLanes(loadFromMemory<Mode, u64>(memory, popAddress()))); break;
+	case VO::V128Load32Zero: loadZeroExtended<Mode, u32>(stackPointer, memory, popAddress()); break;
+	case VO::V128Load64Zero: loadZeroExtended<Mode, u64>(stackPointer, memory, popAddress()); break;
+	case VO::V128Store: {
+		auto value = popVector(stackPointer);
+		storeToMemory<Mode, VectorValue>(memory, popAddress(), value);
+		break;
+	}
+	case VO::V128Load8Lane: skipOperandPadding(); instructionPointer = loadLane<Mode, u8, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Load16Lane: skipOperandPadding(); instructionPointer = loadLane<Mode, u16, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Load32Lane: skipOperandPadding(); instructionPointer = loadLane<Mode, u32, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Load64Lane: skipOperandPadding(); instructionPointer = loadLane<Mode, u64, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Store8Lane: skipOperandPadding(); instructionPointer = storeLane<Mode, u8, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Store16Lane: skipOperandPadding(); instructionPointer = storeLane<Mode, u16, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Store32Lane: skipOperandPadding(); instructionPointer = storeLane<Mode, u32, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+	case VO::V128Store64Lane: skipOperandPadding(); instructionPointer = storeLane<Mode, u64, AlignedOperands>(instructionPointer, stackPointer, memory); break;
+
+	case VO::V128Const: {
+		VectorValue value;
+		std::memcpy(value.bytes, instructionPointer, 16);
+		instructionPointer += 16;
+		pushVector(stackPointer, value);
+		break;
+	}
+	case VO::I8x16Shuffle: {
+		auto b = popVector(stackPointer);
+		auto a = popVector(stackPointer);
+		VectorValue result;
+		for (u32 i = 0; i != 16; i++) {
+			auto lane = instructionPointer[i];
+			result.bytes[i] = lane < 16 ? a.bytes[lane] : b.bytes[lane - 16];
+		}
+		instructionPointer += 16;
+		pushVector(stackPointer, result);
+		break;
+	}
+	case VO::I8x16Swizzle:
+		binary([](const VectorValue& a, const VectorValue& b) {
+			VectorValue result;
+			for (u32 i = 0; i != 16; i++) {
+				result.bytes[i] = b.bytes[i] < 16 ? a.bytes[b.bytes[i]] : 0;
+			}
+			return result;
+		});
+		break;
+
+	case VO::I8x16Splat: pushVector(stackPointer, splatLanes((u8)popScalar<u32, AlignedOperands>(stackPointer))); break;
+	case VO::I16x8Splat: pushVector(stackPointer, splatLanes((u16)popScalar<u32, AlignedOperands>(stackPointer))); break;
+	case VO::I32x4Splat: pushVector(stackPointer, splatLanes(popScalar<u32, AlignedOperands>(stackPointer))); break;
+	case VO::I64x2Splat: pushVector(stackPointer, splatLanes(popScalar<u64, AlignedOperands>(stackPointer))); break;
+	case VO::F32x4Splat: pushVector(stackPointer, splatLanes(popScalar<f32, AlignedOperands>(stackPointer))); break;
+	case VO::F64x2Splat: pushVector(stackPointer, splatLanes(popScalar<f64, AlignedOperands>(stackPointer))); break;
+
+	case VO::I8x16ExtractLaneS: extractLane<i8, i32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I8x16ExtractLaneU: extractLane<u8, u32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I8x16ReplaceLane: replaceLane<u8, u32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I16x8ExtractLaneS: extractLane<i16, i32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I16x8ExtractLaneU: extractLane<u16, u32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I16x8ReplaceLane: replaceLane<u16, u32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I32x4ExtractLane: extractLane<u32, u32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I32x4ReplaceLane: replaceLane<u32, u32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I64x2ExtractLane: extractLane<u64, u64, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::I64x2ReplaceLane: replaceLane<u64, u64, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::F32x4ExtractLane: extractLane<f32, f32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::F32x4ReplaceLane: replaceLane<f32, f32, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::F64x2ExtractLane: extractLane<f64, f64, AlignedOperands>(stackPointer, loadOperandU8()); break;
+	case VO::F64x2ReplaceLane: replaceLane<f64, f64, AlignedOperands>(stackPointer, loadOperandU8()); break;
+
+	case VO::I8x16Equal: binary([](auto a, auto b) { return compareLanes<u8>(a, b, std::equal_to{}); }); break;
+	case VO::I8x16NotEqual: binary([](auto a, auto b) { return compareLanes<u8>(a, b, std::not_equal_to{}); }); break;
+	case VO::I8x16LesserS: binary([](auto a, auto b) { return compareLanes<i8>(a, b, std::less{}); }); break;
+	case VO::I8x16LesserU: binary([](auto a, auto b) { return compareLanes<u8>(a, b, std::less{}); }); break;
+	case VO::I8x16GreaterS: binary([](auto a, auto b) { return compareLanes<i8>(a, b, std::greater{}); }); break;
+	case VO::I8x16GreaterU: binary([](auto a, auto b) { return compareLanes<u8>(a, b, std::greater{}); }); break;
+	case VO::I8x16LesserEqualS: binary([](auto a, auto b) { return compareLanes<i8>(a, b, std::less_equal{}); }); break;
+	case VO::I8x16LesserEqualU: binary([](auto a, auto b) { return compareLanes<u8>(a, b, std::less_equal{}); }); break;
+	case VO::I8x16GreaterEqualS: binary([](auto a, auto b) { return compareLanes<i8>(a, b, std::greater_equal{}); }); break;
+	case VO::I8x16GreaterEqualU: binary([](auto a, auto b) { return compareLanes<u8>(a, b, std::greater_equal{}); }); break;
+	case VO::I16x8Equal: binary([](auto a, auto b) { return compareLanes<u16>(a, b, std::equal_to{}); }); break;
+	case VO::I16x8NotEqual: binary([](auto a, auto b) { return compareLanes<u16>(a, b, std::not_equal_to{}); }); break;
+	case VO::I16x8LesserS: binary([](auto a, auto b) { return compareLanes<i16>(a, b, std::less{}); }); break;
+	case VO::I16x8LesserU: binary([](auto a, auto b) { return compareLanes<u16>(a, b, std::less{}); }); break;
+	case VO::I16x8GreaterS: binary([](auto a, auto b) { return compareLanes<i16>(a, b, std::greater{}); }); break;
+	case VO::I16x8GreaterU: binary([](auto a, auto b) { return compareLanes<u16>(a, b, std::greater{}); }); break;
+	case VO::I16x8LesserEqualS: binary([](auto a, auto b) { return compareLanes<i16>(a, b, std::less_equal{}); }); break;
+	case VO::I16x8LesserEqualU: binary([](auto a, auto b) { return compareLanes<u16>(a, b, std::less_equal{}); }); break;
+	case VO::I16x8GreaterEqualS: binary([](auto a, auto b) { return compareLanes<i16>(a, b, std::greater_equal{}); }); break;
+	case VO::I16x8GreaterEqualU: binary([](auto a, auto b) { return compareLanes<u16>(a, b, std::greater_equal{}); }); break;
+	case VO::I32x4Equal: binary([](auto a, auto b) { return compareLanes<u32>(a, b, std::equal_to{}); }); break;
+	case VO::I32x4NotEqual: binary([](auto a, auto b) { return compareLanes<u32>(a, b, std::not_equal_to{}); }); break;
+	case VO::I32x4LesserS: binary([](auto a, auto b) { return compareLanes<i32>(a, b, std::less{}); }); break;
+	case VO::I32x4LesserU: binary([](auto a, auto b) { return compareLanes<u32>(a, b, std::less{}); }); break;
+	case VO::I32x4GreaterS: binary([](auto a, auto b) { return compareLanes<i32>(a, b, std::greater{}); }); break;
+	case VO::I32x4GreaterU: binary([](auto a, auto b) { return compareLanes<u32>(a, b, std::greater{}); }); break;
+	case VO::I32x4LesserEqualS: binary([](auto a, auto b) { return compareLanes<i32>(a, b, std::less_equal{}); }); break;
+	case VO::I32x4LesserEqualU: binary([](auto a, auto b) { return compareLanes<u32>(a, b, std::less_equal{}); }); break;
+	case VO::I32x4GreaterEqualS: binary([](auto a, auto b) { return compareLanes<i32>(a, b, std::greater_equal{}); }); break;
+	case VO::I32x4GreaterEqualU: binary([](auto a, auto b) { return compareLanes<u32>(a, b, std::greater_equal{}); }); break;
+	case VO::I64x2Equal: binary([](auto a, auto b) { return compareLanes<u64>(a, b, std::equal_to{}); }); break;
+	case VO::I64x2NotEqual: binary([](auto a, auto b) { return compareLanes<u64>(a, b, std::not_equal_to{}); }); break;
+	case VO::I64x2LesserS: binary([](auto a, auto b) { return compareLanes<i64>(a, b, std::less{}); }); break;
+	case VO::I64x2GreaterS: binary([](auto a, auto b) { return compareLanes<i64>(a, b, std::greater{}); }); break;
+	case VO::I64x2LesserEqualS: binary([](auto a, auto b) { return compareLanes<i64>(a, b, std::less_equal{}); }); break;
+	case VO::I64x2GreaterEqualS: binary([](auto a, auto b) { return compareLanes<i64>(a, b, std::greater_equal{}); }); break;
+	case VO::F32x4Equal: binary([](auto a, auto b) { return compareLanes<f32>(a, b, std::equal_to{}); }); break;
+	case VO::F32x4NotEqual: binary([](auto a, auto b) { return compareLanes<f32>(a, b, std::not_equal_to{}); }); break;
+	case VO::F32x4Lesser: binary([](auto a, auto b) { return compareLanes<f32>(a, b, std::less{}); }); break;
+	case VO::F32x4Greater: binary([](auto a, auto b) { return compareLanes<f32>(a, b, std::greater{}); }); break;
+	case VO::F32x4LesserEqual: binary([](auto a, auto b) { return compareLanes<f32>(a, b, std::less_equal{}); }); break;
+	case VO::F32x4GreaterEqual: binary([](auto a, auto b) { return compareLanes<f32>(a, b, std::greater_equal{}); }); break;
+	case VO::F64x2Equal: binary([](auto a, auto b) { return compareLanes<f64>(a, b, std::equal_to{}); }); break;
+	case VO::F64x2NotEqual: binary([](auto a, auto b) { return compareLanes<f64>(a, b, std::not_equal_to{}); }); break;
+	case VO::F64x2Lesser: binary([](auto a, auto b) { return compareLanes<f64>(a, b, std::less{}); }); break;
+	case VO::F64x2Greater: binary([](auto a, auto b) { return compareLanes<f64>(a, b, std::greater{}); }); break;
+	case VO::F64x2LesserEqual: binary([](auto a, auto b) { return compareLanes<f64>(a, b, std::less_equal{}); }); break;
+	case VO::F64x2GreaterEqual: binary([](auto a, auto b) { return compareLanes<f64>(a, b, std::greater_equal{}); }); break;
+
+	case VO::V128Not: unary([](auto a) { return mapLanes<u64>(a, [](u64 x) { return ~x; }); }); break;
+	case VO::V128And: binary([](auto a, auto b) { return zipLanes<u64>(a, b, std::bit_and{}); }); break;
+	case VO::V128AndNot: binary([](auto a, auto b) { return zipLanes<u64>(a, b, [](u64 x, u64 y) { return x & ~y; }); }); break;
+	case VO::V128Or: binary([](auto a, auto b) { return zipLanes<u64>(a, b, std::bit_or{}); }); break;
+	case VO::V128Xor: binary([](auto a, auto b) { return zipLanes<u64>(a, b, std::bit_xor{}); }); break;
+	case VO::V128BitSelect: {
+		auto mask = popVector(stackPointer);
+		auto b = popVector(stackPointer);
+		auto a = popVector(stackPointer);
+		VectorValue result;
+		for (u32 i = 0; i != 2; i++) {
+			auto m = mask.lane<u64>(i);
+			result.setLane<u64>(i, (a.lane<u64>(i) & m) | (b.lane<u64>(i) & ~m));
+		}
+		pushVector(stackPointer, result);
+		break;
+	}
+	case VO::V128AnyTrue: test([](auto a) { return a.template lane<u64>(0) || a.template lane<u64>(1); }); break;
+
+	case VO::I8x16Absolute: unary([](auto a) { return mapLanes<i8>(a, absoluteWrapping<i8>); }); break;
+	case VO::I8x16Negate: unary([](auto a) { return mapLanes<u8>(a, [](u8 x) { return 0 - x; }); }); break;
+	case VO::I8x16CountOnes: unary([](auto a) { return mapLanes<u8>(a, [](u8 x) { return std::popcount(x); }); }); break;
+	case VO::I8x16AllTrue: test(allLanesTrue<u8>); break;
+	case VO::I8x16Bitmask: test(bitmaskOfLanes<i8>); break;
+	case VO::I8x16NarrowI16x8S: binary(narrowLanes<i16, i8>); break;
+	case VO::I8x16NarrowI16x8U: binary(narrowLanes<i16, u8>); break;
+	case VO::I8x16ShiftLeft: shift([](auto a, u32 count) { return shiftLanes<u8>(a, count, true); }); break;
+	case VO::I8x16ShiftRightS: shift([](auto a, u32 count) { return shiftLanes<i8>(a, count, false); }); break;
+	case VO::I8x16ShiftRightU: shift([](auto a, u32 count) { return shiftLanes<u8>(a, count, false); }); break;
+	case VO::I8x16Add: binary([](auto a, auto b) { return zipLanes<u8>(a, b, std::plus{}); }); break;
+	case VO::I8x16AddSaturateS: binary([](auto a, auto b) { return zipLanes<i8>(a, b, [](i8 x, i8 y) { return saturate<i8>(x + y); }); }); break;
+	case VO::I8x16AddSaturateU: binary([](auto a, auto b) { return zipLanes<u8>(a, b, [](u8 x, u8 y) { return saturate<u8>(x + y); }); }); break;
+	case VO::I8x16Subtract: binary([](auto a, auto b) { return zipLanes<u8>(a, b, std::minus{}); }); break;
+	case VO::I8x16SubtractSaturateS: binary([](auto a, auto b) { return zipLanes<i8>(a, b, [](i8 x, i8 y) { return saturate<i8>(x - y); }); }); break;
+	case VO::I8x16SubtractSaturateU: binary([](auto a, auto b) { return zipLanes<u8>(a, b, [](u8 x, u8 y) { return saturate<u8>(x - y); }); }); break;
+	case VO::I8x16MinimumS: binary([](auto a, auto b) { return zipLanes<i8>(a, b, [](i8 x, i8 y) { return std::min(x, y); }); }); break;
+	case VO::I8x16MinimumU: binary([](auto a, auto b) { return zipLanes<u8>(a, b, [](u8 x, u8 y) { return std::min(x, y); }); }); break;
+	case VO::I8x16MaximumS: binary([](auto a, auto b) { return zipLanes<i8>(a, b, [](i8 x, i8 y) { return std::max(x, y); }); }); break;
+	case VO::I8x16MaximumU: binary([](auto a, auto b) { return zipLanes<u8>(a, b, [](u8 x, u8 y) { return std::max(x, y); }); }); break;
+	case VO::I8x16AverageU: binary([](auto a, auto b) { return zipLanes<u8>(a, b, [](u8 x, u8 y) { return (x + y + 1) / 2; }); }); break;
+
+	case VO::I16x8ExtendAddPairwiseI8x16S: unary(extendAddPairwiseLanes<i8, i16>); break;
+	case VO::I16x8ExtendAddPairwiseI8x16U: unary(extendAddPairwiseLanes<u8, u16>); break;
+	case VO::I32x4ExtendAddPairwiseI16x8S: unary(extendAddPairwiseLanes<i16, i32>); break;
+	case VO::I32x4ExtendAddPairwiseI16x8U: unary(extendAddPairwiseLanes<u16, u32>); break;
+
+	case VO::I16x8Absolute: unary([](auto a) { return mapLanes<i16>(a, absoluteWrapping<i16>); }); break;
+	case VO::I16x8Negate: unary([](auto a) { return mapLanes<u16>(a, [](u16 x) { return 0 - x; }); }); break;
+	case VO::I16x8Q15MultiplyRoundSaturateS:
+		binary([](auto a, auto b) { return zipLanes<i16>(a, b, [](i16 x, i16 y) { return saturate<i16>((x * y + 0x4000) >> 15); }); });
+		break;
+	case VO::I16x8AllTrue: test(allLanesTrue<u16>); break;
+	case VO::I16x8Bitmask: test(bitmaskOfLanes<i16>); break;
+	case VO::I16x8NarrowI32x4S: binary(narrowLanes<i32, i16>); break;
+	case VO::I16x8NarrowI32x4U: binary(narrowLanes<i32, u16>); break;
+	case VO::I16x8ExtendLowI8x16S: unary([](auto a) { return extendLanes<i8, i16>(a, 0); }); break;
+	case VO::I16x8ExtendHighI8x16S: unary([](auto a) { return extendLanes<i8, i16>(a, 8); }); break;
+	case VO::I16x8ExtendLowI8x16U: unary([](auto a) { return extendLanes<u8, u16>(a, 0); }); break;
+	case VO::I16x8ExtendHighI8x16U: unary([](auto a) { return extendLanes<u8, u16>(a, 8); }); break;
+	case VO::I16x8ShiftLeft: shift([](auto a, u32 count) { return shiftLanes<u16>(a, count, true); }); break;
+	case VO::I16x8ShiftRightS: shift([](auto a, u32 count) { return shiftLanes<i16>(a, count, false); }); break;
+	case VO::I16x8ShiftRightU: shift([](auto a, u32 count) { return shiftLanes<u16>(a, count, false); }); break;
+	case VO::I16x8Add: binary([](auto a, auto b) { return zipLanes<u16>(a, b, std::plus{}); }); break;
+	case VO::I16x8AddSaturateS: binary([](auto a, auto b) { return zipLanes<i16>(a, b, [](i16 x, i16 y) { return saturate<i16>(x + y); }); }); break;
+	case VO::I16x8AddSaturateU: binary([](auto a, auto b) { return zipLanes<u16>(a, b, [](u16 x, u16 y) { return saturate<u16>(x + y); }); }); break;
+	case VO::I16x8Subtract: binary([](auto a, auto b) { return zipLanes<u16>(a, b, std::minus{}); }); break;
+	case VO::I16x8SubtractSaturateS: binary([](auto a, auto b) { return zipLanes<i16>(a, b, [](i16 x, i16 y) { return saturate<i16>(x - y); }); }); break;
+	case VO::I16x8SubtractSaturateU: binary([](auto a, auto b) { return zipLanes<u16>(a, b, [](u16 x, u16 y) { return saturate<u16>(x - y); }); }); break;
+	case VO::I16x8Multiply: binary([](auto a, auto b) { return zipLanes<u16>(a, b, [](u16 x, u16 y) { return (u32)x * y; }); }); break;
+	case VO::I16x8MinimumS: binary([](auto a, auto b) { return zipLanes<i16>(a, b, [](i16 x, i16 y) { return std::min(x, y); }); }); break;
+	case VO::I16x8MinimumU: binary([](auto a, auto b) { return zipLanes<u16>(a, b, [](u16 x, u16 y) { return std::min(x, y); }); }); break;
+	case VO::I16x8MaximumS: binary([](auto a, auto b) { return zipLanes<i16>(a, b, [](i16 x, i16 y) { return std::max(x, y); }); }); break;
+	case VO::I16x8MaximumU: binary([](auto a, auto b) { return zipLanes<u16>(a, b, [](u16 x, u16 y) { return std::max(x, y); }); }); break;
+	case VO::I16x8AverageU: binary([](auto a, auto b) { return zipLanes<u16>(a, b, [](u16 x, u16 y) { return (x + y + 1) / 2; }); }); break;
+	case VO::I16x8ExtendMultiplyLowI8x16S: binary([](auto a, auto b) { return extendMultiplyLanes<i8, i16>(a, b, 0); }); break;
+	case VO::I16x8ExtendMultiplyHighI8x16S: binary([](auto a, auto b) { return extendMultiplyLanes<i8, i16>(a, b, 8); }); break;
+	case VO::I16x8ExtendMultiplyLowI8x16U: binary([](auto a, auto b) { return extendMultiplyLanes<u8, u16>(a, b, 0); }); break;
+	case VO::I16x8ExtendMultiplyHighI8x16U: binary([](auto a, auto b) { return extendMultiplyLanes<u8, u16>(a, b, 8); }); break;
+
+	case VO::I32x4Absolute: unary([](auto a) { return mapLanes<i32>(a, absoluteWrapping<i32>); }); break;
+	case VO::I32x4Negate: unary([](auto a) { return mapLanes<u32>(a, [](u32 x) { return 0 - x; }); }); break;
+	case VO::I32x4AllTrue: test(allLanesTrue<u32>); break;
+	case VO::I32x4Bitmask: test(bitmaskOfLanes<i32>); break;
+	case VO::I32x4ExtendLowI16x8S: unary([](auto a) { return extendLanes<i16, i32>(a, 0); }); break;
+	case VO::I32x4ExtendHighI16x8S: unary([](auto a) { return extendLanes<i16, i32>(a, 4); }); break;
+	case VO::I32x4ExtendLowI16x8U: unary([](auto a) { return extendLanes<u16, u32>(a, 0); }); break;
+	case VO::I32x4ExtendHighI16x8U: unary([](auto a) { return extendLanes<u16, u32>(a, 4); }); break;
+	case VO::I32x4ShiftLeft: shift([](auto a, u32 count) { return shiftLanes<u32>(a, count, true); }); break;
+	case VO::I32x4ShiftRightS: shift([](auto a, u32 count) { return shiftLanes<i32>(a, count, false); }); break;
+	case VO::I32x4ShiftRightU: shift([](auto a, u32 count) { return shiftLanes<u32>(a, count, false); }); break;
+	case VO::I32x4Add: binary([](auto a, auto b) { return zipLanes<u32>(a, b, std::plus{}); }); break;
+	case VO::I32x4Subtract: binary([](auto a, auto b) { return zipLanes<u32>(a, b, std::minus{}); }); break;
+	case VO::I32x4Multiply: binary([](auto a, auto b) { return zipLanes<u32>(a, b, std::multiplies{}); }); break;
+	case VO::I32x4MinimumS: binary([](auto a, auto b) { return zipLanes<i32>(a, b, [](i32 x, i32 y) { return std::min(x, y); }); }); break;
+	case VO::I32x4MinimumU: binary([](auto a, auto b) { return zipLanes<u32>(a, b, [](u32 x, u32 y) { return std::min(x, y); }); }); break;
+	case VO::I32x4MaximumS: binary([](auto a, auto b) { return zipLanes<i32>(a, b, [](i32 x, i32 y) { return std::max(x, y); }); }); break;
+	case VO::I32x4MaximumU: binary([](auto a, auto b) { return zipLanes<u32>(a, b, [](u32 x, u32 y) { return std::max(x, y); }); }); break;
+	case VO::I32x4DotI16x8S:
+		binary([](const VectorValue& a, const VectorValue& b) {
+			VectorValue result;
+			for (u32 i = 0; i != 4; i++) {
+				// Only the product of two minimal values overflows, which wraps around
+				u32 sum = (u32)((i32)a.lane<i16>(2 * i) * b.lane<i16>(2 * i)) + (u32)((i32)a.lane<i16>(2 * i + 1) * b.lane<i16>(2 * i + 1));
+				result.setLane<u32>(i, sum);
+			}
+			return result;
+		});
+		break;
+	case VO::I32x4ExtendMultiplyLowI16x8S: binary([](auto a, auto b) { return extendMultiplyLanes<i16, i32>(a, b, 0); }); break;
+	case VO::I32x4ExtendMultiplyHighI16x8S: binary([](auto a, auto b) { return extendMultiplyLanes<i16, i32>(a, b, 4); }); break;
+	case VO::I32x4ExtendMultiplyLowI16x8U: binary([](auto a, auto b) { return extendMultiplyLanes<u16, u32>(a, b, 0); }); break;
+	case VO::I32x4ExtendMultiplyHighI16x8U: binary([](auto a, auto b) { return extendMultiplyLanes<u16, u32>(a, b, 4); }); break;
+
+	case VO::I64x2Absolute: unary([](auto a) { return mapLanes<i64>(a, absoluteWrapping<i64>); }); break;
+	case VO::I64x2Negate: unary([](auto a) { return mapLanes<u64>(a, [](u64 x) { return 0 - x; }); }); break;
+	case VO::I64x2AllTrue: test(allLanesTrue<u64>); break;
+	case VO::I64x2Bitmask: test(bitmaskOfLanes<i64>); break;
+	case VO::I64x2ExtendLowI32x4S: unary([](auto a) { return extendLanes<i32, i64>(a, 0); }); break;
+	case VO::I64x2ExtendHighI32x4S: unary([](auto a) { return extendLanes<i32, i64>(a, 2); }); break;
+	case VO::I64x2ExtendLowI32x4U: unary([](auto a) { return extendLanes<u32, u64>(a, 0); }); break;
+	case VO::I64x2ExtendHighI32x4U: unary([](auto a) { return extendLanes<u32, u64>(a, 2); }); break;
+	case VO::I64x2ShiftLeft: shift([](auto a, u32 count) { return shiftLanes<u64>(a, count, true); }); break;
+	case VO::I64x2ShiftRightS: shift([](auto a, u32 count) { return shiftLanes<i64>(a, count, false); }); break;
+	case VO::I64x2ShiftRightU: shift([](auto a, u32 count) { return shiftLanes<u64>(a, count, false); }); break;
+	case VO::I64x2Add: binary([](auto a, auto b) { return zipLanes<u64>(a, b, std::plus{}); }); break;
+	case VO::I64x2Subtract: binary([](auto a, auto b) { return zipLanes<u64>(a, b, std::minus{}); }); break;
+	case VO::I64x2Multiply: binary([](auto a, auto b) { return zipLanes<u64>(a, b, std::multiplies{}); }); break;
+	case VO::I64x2ExtendMultiplyLowI32x4S: binary([](auto a, auto b) { return extendMultiplyLanes<i32, i64>(a, b, 0); }); break;
+	case VO::I64x2ExtendMultiplyHighI32x4S: binary([](auto a, auto b) { return extendMultiplyLanes<i32, i64>(a, b, 2); }); break;
+	case VO::I64x2ExtendMultiplyLowI32x4U: binary([](auto a, auto b) { return extendMultiplyLanes<u32, u64>(a, b, 0); }); break;
+	case VO::I64x2ExtendMultiplyHighI32x4U: binary([](auto a, auto b) { return extendMultiplyLanes<u32, u64>(a, b, 2); }); break;
+
+	case VO::F32x4Absolute: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::fabs(x); }); }); break;
+	case VO::F32x4Negate: unary([](auto a) { return mapLanes<f32>(a, std::negate{}); }); break;
+	case VO::F32x4SquareRoot: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::sqrt(x); }); }); break;
+	case VO::F32x4Ceil: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::ceil(x); }); }); break;
+	case VO::F32x4Floor: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::floor(x); }); }); break;
+	case VO::F32x4Truncate: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::trunc(x); }); }); break;
+	case VO::F32x4Nearest: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::nearbyint(x); }); }); break;
+	case VO::F32x4Add: binary([](auto a, auto b) { return zipLanes<f32>(a, b, std::plus{}); }); break;
+	case VO::F32x4Subtract: binary([](auto a, auto b) { return zipLanes<f32>(a, b, std::minus{}); }); break;
+	case VO::F32x4Multiply: binary([](auto a, auto b) { return zipLanes<f32>(a, b, std::multiplies{}); }); break;
+	case VO::F32x4Divide: binary([](auto a, auto b) { return zipLanes<f32>(a, b, std::divides{}); }); break;
+	case VO::F32x4Minimum: binary([](auto a, auto b) { return zipLanes<f32>(a, b, floatMinimum<f32>); }); break;
+	case VO::F32x4Maximum: binary([](auto a, auto b) { return zipLanes<f32>(a, b, floatMaximum<f32>); }); break;
+	case VO::F32x4PseudoMinimum: binary([](auto a, auto b) { return zipLanes<f32>(a, b, [](f32 x, f32 y) { return y < x ? y : x; }); }); break;
+	case VO::F32x4PseudoMaximum: binary([](auto a, auto b) { return zipLanes<f32>(a, b, [](f32 x, f32 y) { return x < y ? y : x; }); }); break;
+
+	case VO::F64x2Absolute: unary([](auto a) { return mapLanes<f64>(a, [](f64 x) { return std::fabs(x); }); }); break;
+	case VO::F64x2Negate: unary([](auto a) { return mapLanes<f64>(a, std::negate{}); }); break;
+	case VO::F64x2SquareRoot: unary([](auto a) { return mapLanes<f64>(a, [](f64 x) { return std::sqrt(x); }); }); break;
+	case VO::F64x2Ceil: unary([](auto a) { return mapLanes<f64>(a, [](f64 x) { return std::ceil(x); }); }); break;
+	case VO::F64x2Floor: unary([](auto a) { return mapLanes<f64>(a, [](f64 x) { return std::floor(x); }); }); break;
+	case VO::F64x2Truncate: unary([](auto a) { return mapLanes<f64>(a, [](f64 x) { return std::trunc(x); }); }); break;
+	case VO::F64x2Nearest: unary([](auto a) { return mapLanes<f64>(a, [](f64 x) { return std::nearbyint(x); }); }); break;
+	case VO::F64x2Add: binary([](auto a, auto b) { return zipLanes<f64>(a, b, std::plus{}); }); break;
+	case VO::F64x2Subtract: binary([](auto a, auto b) { return zipLanes<f64>(a, b, std::minus{}); }); break;
+	case VO::F64x2Multiply: binary([](auto a, auto b) { return zipLanes<f64>(a, b, std::multiplies{}); }); break;
+	case VO::F64x2Divide: binary([](auto a, auto b) { return zipLanes<f64>(a, b, std::divides{}); }); break;
+	case VO::F64x2Minimum: binary([](auto a, auto b) { return zipLanes<f64>(a, b, floatMinimum<f64>); }); break;
+	case VO::F64x2Maximum: binary([](auto a, auto b) { return zipLanes<f64>(a, b, floatMaximum<f64>); }); break;
+	case VO::F64x2PseudoMinimum: binary([](auto a, auto b) { return zipLanes<f64>(a, b, [](f64 x, f64 y) { return y < x ? y : x; }); }); break;
+	case VO::F64x2PseudoMaximum: binary([](auto a, auto b) { return zipLanes<f64>(a, b, [](f64 x, f64 y) { return x < y ? y : x; }); }); break;
+
+	case VO::F32x4DemoteF64x2Zero:
+		unary([](const VectorValue& a) {
+			VectorValue result{};
+			result.setLane<f32>(0, (f32)a.lane<f64>(0));
+			result.setLane<f32>(1, (f32)a.lane<f64>(1));
+			return result;
+		});
+		break;
+	case VO::F64x2PromoteLowF32x4: unary([](auto a) { return extendLanes<f32, f64>(a, 0); }); break;
+	case VO::I32x4TruncateSaturateF32x4S: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::bit_cast<f32>(truncateSaturate<i32>(x)); }); }); break;
+	case VO::I32x4TruncateSaturateF32x4U: unary([](auto a) { return mapLanes<f32>(a, [](f32 x) { return std::bit_cast<f32>(truncateSaturate<u32>(x)); }); }); break;
+	case VO::F32x4ConvertI32x4S: unary([](auto a) { return mapLanes<i32>(a, [](i32 x) { return std::bit_cast<i32>((f32)x); }); }); break;
+	case VO::F32x4ConvertI32x4U: unary([](auto a) { return mapLanes<u32>(a, [](u32 x) { return std::bit_cast<u32>((f32)x); }); }); break;
+	case VO::I32x4TruncateSaturateF64x2SZero:
+	case VO::I32x4TruncateSaturateF64x2UZero: {
+		auto a = popVector(stackPointer);
+		VectorValue result{};
+		for (u32 i = 0; i != 2; i++) {
+			auto x = a.lane<f64>(i);
+			result.setLane<u32>(i, operation == VO::I32x4TruncateSaturateF64x2SZero ? (u32)truncateSaturate<i32>(x) : truncateSaturate<u32>(x));
+		}
+		pushVector(stackPointer, result);
+		break;
+	}
+	case VO::F64x2ConvertLowI32x4S: unary([](auto a) { return extendLanes<i32, f64>(a, 0); }); break;
+	case VO::F64x2ConvertLowI32x4U: unary([](auto a) { return extendLanes<u32, f64>(a, 0); }); break;
+
+	default:
+		throw std::runtime_error{ "Unknown vector operation" };
+	}
+
+	return instructionPointer;
+}
+
+template const u8* WASM::executeVectorOperation<MemoryBoundsMode::Checked, false>(const u8*, u32*&, Memory*);
+template const u8* WASM::executeVectorOperation<MemoryBoundsMode::Strict, false>(const u8*, u32*&, Memory*);
+template const u8* WASM::executeVectorOperation<MemoryBoundsMode::Unchecked, false>(const u8*, u32*&, Memory*);
+template const u8* WASM::executeVectorOperation<MemoryBoundsMode::Checked, true>(const u8*, u32*&, Memory*);
+template const u8* WASM::executeVectorOperation<MemoryBoundsMode::Strict, true>(const u8*, u32*&, Memory*);
+template const u8* WASM::executeVectorOperation<MemoryBoundsMode::Unchecked, true>(const u8*, u32*&, Memory*);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "bytecode.h"
+#include "module.h"
+
+namespace WASM {
+	/*
+	* Vector operations
+	* Runs the operation of a VectorInstruction bytecode on the operand stack,
+	* where each vector takes up four slots. The instruction pointer points to
+	* the operation byte, and the pointer behind the operands of the operation
+	* is returned. Common kernels use SSE2 on x64 and SSE4.1 where the compiler
+	* targets it, everything else is computed lane by lane. Aligned bytecode
+	* pads the offset operands to four bytes and puts scalars into 8 byte slots.
+	*/
+	template<MemoryBoundsMode::TEnum Mode, bool AlignedOperands>
+	const u8* executeVectorOperation(const u8*, u32*&, Memory*);
+}
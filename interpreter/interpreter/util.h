@@ -19,6 +19,20 @@ namespace WASM {
 
 	using sizeType = std::size_t;
 
+	constexpr sizeType alignUp(sizeType value, sizeType alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	template<typename T>
+	T* alignPointerUp(T* pointer, sizeType alignment) {
+		return reinterpret_cast<T*>(alignUp(reinterpret_cast<std::uintptr_t>(pointer), alignment));
+	}
+
+	// Number of u32 stack slots taken by a value. Aligned stacks put each value
+	// into full 8 byte slots.
+	template<typename T, bool AlignedStack>
+	constexpr sizeType stackSlotsOf = alignUp(sizeof(T), AlignedStack ? 8 : 4) / 4;
+
 
 	namespace Detail {
 
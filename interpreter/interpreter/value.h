@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstring>
+
 #include "util.h"
 
 namespace WASM {
@@ -7,8 +9,9 @@ namespace WASM {
 	public:
 
 		Value(ValType t, u64 data) : mType{ t }, u64Data{ data } {}
+		Value(ValType t, u64 low, u64 high) : mType{ t }, v128Data{ low, high } {}
 
-		static Value fromStackPointer(ValType, std::span<u32>, u32&);
+		static Value fromStackPointer(ValType, std::span<u32>, u32&, bool);
 
 		template<typename T>
 		static Value fromType(T val) {
@@ -16,6 +19,7 @@ namespace WASM {
 		}
 
 		auto type() const { return mType; }
+		bool hasType(ValType) const;
 		u32 sizeInBytes() const { return mType.sizeInBytes(); }
 
 		template<typename T>
@@ -33,6 +37,8 @@ namespace WASM {
 		u64 asInt() const;
 		f64 asFloat() const;
 
+		void copyVectorTo(u32* slots) const { std::memcpy(slots, v128Data, 16); }
+
 		void print(std::ostream&) const;
 
 	private:
@@ -42,14 +48,15 @@ namespace WASM {
 			u64 u64Data;
 			f32 f32Data;
 			f64 f64Data;
+			u64 v128Data[2];
 			Function* refData;
 		};
 	};
 
 	class ValuePack {
 	public:
-		ValuePack(const FunctionType& ft, bool r, std::span<u32> s)
-			: functionType{ ft }, isResult{ r }, stackSlice{ s } {}
+		ValuePack(const FunctionType& ft, bool r, std::span<u32> s, bool a)
+			: functionType{ ft }, isResult{ r }, stackSlice{ s }, hasAlignedSlots{ a } {}
 
 		void print(std::ostream&) const;
 
@@ -57,5 +64,6 @@ namespace WASM {
 		const FunctionType& functionType;
 		bool isResult;
 		std::span<u32> stackSlice;
+		bool hasAlignedSlots;
 	};
 }
@@ -0,0 +1,199 @@
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <cstring>
+
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../interpreter/reactor.h"
+#include "../interpreter/error.h"
+
+#include "../benchmarks/module_writer.h"
+
+/*
+* This example runs guests on the reactor that read from and write to pipes
+* and sockets. It walks through the three ways an operation can complete:
+* Right away, after the guest was suspended, and after the guest memory was
+* grown while the guest was suspended. The example checks its results and
+* exits with a non-zero status if any of them is wrong.
+*/
+
+using WASM::u8, WASM::u32, WASM::i32;
+
+// Guests store the results of their operations at these addresses
+constexpr u32 resultAddress = 0;
+constexpr u32 bufferAddress = 64;
+constexpr u32 bufferLength = 32;
+
+static int numFailures = 0;
+
+static void check(bool condition, std::string_view message) {
+	std::cout << (condition ? "  ok:     " : "  FAILED: ") << message << "\n";
+	if (!condition) {
+		numFailures++;
+	}
+}
+
+static ModuleWriter generateModule() {
+	constexpr u8 I32 = 0x7F;
+
+	ModuleWriter writer;
+	auto ioType = writer.addType({ { I32, I32, I32 }, { I32 } });
+	auto guestType = writer.addType({ { I32 }, {} });
+
+	auto readIdx = writer.importFunction("env", "read", ioType);
+	auto writeIdx = writer.importFunction("env", "write", ioType);
+	writer.importMemory("env", "memory", 1);
+
+	// store(resultAddress, read/write(fd, bufferAddress, bufferLength))
+	auto ioFunction = [&](u32 importIdx) {
+		ModuleWriter::Bytes body;
+		body.byte(0x41).i32Leb(resultAddress);
+		body.byte(0x20).u32Leb(0).byte(0x41).i32Leb(bufferAddress).byte(0x41).i32Leb(bufferLength);
+		body.byte(0x10).u32Leb(importIdx).byte(0x36).u32Leb(2).u32Leb(0);
+		return body;
+	};
+	writer.exportFunction("read", writer.addFunction(guestType, {}, ioFunction(readIdx)));
+	writer.exportFunction("write", writer.addFunction(guestType, {}, ioFunction(writeIdx)));
+
+	// drop(memory.grow(pages))
+	ModuleWriter::Bytes grow;
+	grow.byte(0x20).u32Leb(0).bytes({ 0x40, 0x00, 0x1A });
+	writer.exportFunction("grow", writer.addFunction(guestType, {}, grow));
+
+	return writer;
+}
+
+int main() {
+	// Writes to closed sockets should fail with an error code instead
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		WASM::Interpreter interpreter;
+		WASM::Nullable<WASM::Reactor> reactor;
+		WASM::Nullable<WASM::HostMemory> memory;
+
+		// Host functions receive their arguments in reverse order
+		WASM::HostModuleBuilder envModuleBuilder{ "env" };
+		envModuleBuilder
+			.defineFunction("read", [&](u32 length, u32 address, i32 fd) { return reactor->read(fd, *memory, address, length); })
+			.defineFunction("write", [&](u32 length, u32 address, i32 fd) { return reactor->write(fd, *memory, address, length); })
+			.defineMemory("memory", 1);
+
+		auto envModule = interpreter.registerHostModule(envModuleBuilder);
+		interpreter.loadModule(generateModule().writeTemporary("reactorguest"));
+		interpreter.compileAndLinkModules();
+
+		memory = *envModule.hostMemoryByName("memory");
+		WASM::Reactor reactorInstance{ interpreter };
+		reactor = reactorInstance;
+
+		auto readFunction = interpreter.functionByName("reactorguest", "read");
+		auto writeFunction = interpreter.functionByName("reactorguest", "write");
+		auto growFunction = interpreter.functionByName("reactorguest", "grow");
+
+		auto result = [&]() { return memory->memoryView<i32>()[resultAddress / sizeof(i32)]; };
+		auto buffer = [&](u32 length) {
+			return std::string_view{ (const char*)memory->memoryView<u8>().data() + bufferAddress, length };
+		};
+
+		bool isFinished = false;
+		auto onFinished = [&](const WASM::ValuePack&) { isFinished = true; };
+
+		{
+			std::cout << "Immediate read from a pipe\n";
+			int fds[2];
+			pipe(fds);
+			::write(fds[1], "hello", 5);
+
+			isFinished = false;
+			reactor->spawn(readFunction, onFinished, (i32)fds[0]);
+			check(isFinished && reactor->suspendedGuestCount() == 0, "guest finished without suspending");
+			check(result() == 5 && buffer(5) == "hello", "guest read the data");
+
+			close(fds[0]);
+			close(fds[1]);
+		}
+
+		{
+			std::cout << "Suspended read from a socket\n";
+			int fds[2];
+			socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+			isFinished = false;
+			reactor->spawn(readFunction, onFinished, (i32)fds[0]);
+			check(!isFinished && reactor->suspendedGuestCount() == 1, "guest is suspended");
+
+			::write(fds[1], "world", 5);
+			reactor->run();
+			check(isFinished && reactor->suspendedGuestCount() == 0, "guest was resumed");
+			check(result() == 5 && buffer(5) == "world", "guest read the data");
+
+			close(fds[0]);
+			close(fds[1]);
+		}
+
+		{
+			std::cout << "Suspended write to a full pipe\n";
+			int fds[2];
+			pipe(fds);
+
+			// Fill the pipe until it cannot take any more bytes
+			std::string fill(4096, 'x');
+			fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+			while (::write(fds[1], fill.data(), fill.size()) > 0) {}
+
+			std::memcpy(memory->memoryView<u8>().data() + bufferAddress, "0123456789abcdef0123456789abcdef", bufferLength);
+			isFinished = false;
+			reactor->spawn(writeFunction, onFinished, (i32)fds[1]);
+			check(!isFinished && reactor->suspendedGuestCount() == 1, "guest is suspended");
+
+			::read(fds[0], fill.data(), fill.size());
+			reactor->run();
+			check(isFinished && result() == (i32)bufferLength, "guest was resumed and wrote the data");
+
+			close(fds[0]);
+			close(fds[1]);
+		}
+
+		{
+			std::cout << "Suspended read while another guest grows the memory\n";
+			int fds[2];
+			pipe(fds);
+
+			isFinished = false;
+			reactor->spawn(readFunction, onFinished, (i32)fds[0]);
+			check(!isFinished && reactor->suspendedGuestCount() == 1, "guest is suspended");
+
+			auto oldBase = memory->memoryView<u8>().data();
+			auto oldSize = memory->memoryView<u8>().size();
+			reactor->spawn(growFunction, {}, (i32)256);
+			check(memory->memoryView<u8>().size() > oldSize, "memory was grown");
+			if (memory->memoryView<u8>().data() != oldBase) {
+				std::cout << "  memory was moved to a new address\n";
+			}
+
+			::write(fds[1], "grown", 5);
+			reactor->run();
+			check(isFinished && result() == 5 && buffer(5) == "grown", "guest read the data into the grown memory");
+
+			close(fds[0]);
+			close(fds[1]);
+		}
+	}
+	catch (WASM::Error& e) {
+		std::cerr << "Caught wasm error: " << e << std::endl;
+		return 1;
+	}
+	catch (std::exception& e) {
+		std::cerr << "Caught generic error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << (numFailures ? "Some checks failed\n" : "All checks passed\n");
+	return numFailures ? 1 : 0;
+}